@@ -23,6 +23,7 @@
 #define EXRAY_VERSION				0x0015
 #define EXRAY_VERSION_STRING		"0.1.5 ALPHA"
 //#define EXRAY_WINNT6			 // Windows XP SP3, Windows Vista.
+//#define EXRAY_FASTMATH		 // Przyblione pow/exp/normalizacja przy cieniowaniu (Math/FastMath.h).
 
 #include <stdio.h>
 #include <math.h>
@@ -32,6 +33,26 @@
 #include <map>
 #include <string>
 
+// cieki SSE2 (x64 lub kompilacja z /arch:SSE2).
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define EXRAY_SSE2
+#include <emmintrin.h>
+#endif
+
+// Warianty jder AVX2 i AVX-512 wybierane w czasie dziaania (Core/Kernels.h); wymagaj Visual C++ 2012 / 2017.
+// Pliki jder kompilowane s bez /arch (Visual C++ tumaczy funkcje wewntrzne AVX bez tej opcji).
+// Doczony projekt exRay.vcproj (Visual Studio 2008) nie definiuje EXRAY_AVX2 ani EXRAY_AVX512: pliki
+// KernelsAVX2.cpp i KernelsAVX512.cpp kompilowane s jako puste, a program zawiera wycznie jdra skalarne
+// i SSE2. Warianty AVX powstaj tylko po przeniesieniu projektu do nowszego Visual Studio. Niezalenie
+// od kompilatora przecicia i przejcie hierarchii nie s jdrami tablicy, a occludePacket ma tylko
+// wersje skalarn i SSE2.
+#if defined(EXRAY_SSE2) && defined(_MSC_VER) && _MSC_VER >= 1700
+#define EXRAY_AVX2
+#endif
+#if defined(EXRAY_AVX2) && _MSC_VER >= 1911
+#define EXRAY_AVX512
+#endif
+
 #include "math/math.h"
 
 
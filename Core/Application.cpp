@@ -20,7 +20,9 @@
 #include "Application.h"
 #include "Engine.h"
 #include "Renderer.h"
+#include "Kernels.h"
 #include "../Types/Image.h"
+#include "../Types/ImageHDR.h"
 
 #ifdef WIN32 // WIN32 PLATFORM SPECIFIC
 #define WIN32_LEAN_AND_MEAN
@@ -35,6 +37,11 @@ Application::Application(void)
 
 	argCores	= 0; // Engine::Autodetect
 	argDepth	= 8;
+	argTime		= 0;
+	argNoise	= 0.0f;
+	argProgressive = false;
+	argStream	= 0;
+	argISA		= 0; // Engine::Autodetect
 
 	errorMap[Application::WrongArgCount] = "Wrong number of arguments. Use '-h' for help";
 	errorMap[Application::UnknownOption] = "Unknown option";
@@ -43,6 +50,8 @@ Application::Application(void)
 	errorMap[Application::InputNotFound] = "Input file does not exist";
 	errorMap[Application::OutputNotKnown]= "No output file specified";
 	errorMap[Application::TooManyCores]	 = "Maximum allowed logical CPUs number is 8";
+	errorMap[Application::StreamConflict]= "Streamed output cannot be used with progressive rendering";
+	errorMap[Application::StreamFormat]	 = "Streamed output requires a BMP or TGA output file";
 }
 
 Application::~Application(void)
@@ -63,9 +72,27 @@ void Application::printHelp(void)
 	printf("\t\tIf not specified the default value of 8 will be used.\n");
 
 	printf(" --output -o\tSpecifiers the output image filename. Supported output formats\n");
-	printf("\t\tare BMP and TGA and are determined by passed file extension.\n");
+	printf("\t\tare BMP, TGA, PFM and EXR and are determined by passed file\n\t\textension. PFM and EXR store unclamped floating-point color.\n");
 	printf("\t\tIf an unknown extension is passed the engine uses BMP\n\t\tby default.\n");
 
+	printf(" --time -t\tEnables progressive rendering and stops it after the given\n");
+	printf("\t\tnumber of seconds. The image accumulated so far is written out.\n");
+
+	printf(" --noise -n\tEnables progressive rendering and stops it when the average\n");
+	printf("\t\trelative pixel noise drops below the given value (eg. 0.02).\n");
+
+	printf(" --preview -p\tEnables progressive rendering and writes the partial image\n");
+	printf("\t\tto the given file after every completed pass.\n");
+
+	printf(" --stream -s\tWrites finished lines directly to the BMP/TGA output file,\n");
+	printf("\t\tkeeping only the given number of lines in memory. Intended for\n\t\tvery large images.\n");
+
+	printf(" --compile -C\tParses the input script and saves it in the compiled binary\n");
+	printf("\t\tform to the given file instead of rendering. A compiled scene\n\t\tis loaded directly as input without parsing.\n");
+
+	printf(" --isa -i\tForces the instruction set of the computational kernels: scalar,\n");
+	printf("\t\tsse2, avx2 or avx512. If not specified the widest set supported\n\t\tby the CPU is detected. Unsupported sets fall back to it.\n");
+
 	printf(" <input>\tThe input scene configuration script to be rendered.\n");
 }
 
@@ -86,6 +113,12 @@ bool Application::isValue(const char *string)
 	return sscanf(string, "%i", &test) > 0;
 }
 
+bool Application::isFloatValue(const char *string)
+{
+	float	test;
+	return sscanf(string, "%f", &test) > 0;
+}
+
 bool Application::reportError(const int errorID, const char *info)
 {
 	printf("%s", errorMap[errorID].c_str());
@@ -106,12 +139,13 @@ bool Application::parseArguments(int argc, char **argv)
 		printHelp();
 		return false;
 	}
-	if(argc < 4 || argc > 8)
+	if(argc < 4 || argc > 18)
 		return reportError(Application::WrongArgCount);
 	if(argc % 2 != 0)
 		return reportError(Application::WrongArgCount);
 
 	bool	cores=false, depth=false, output=false;
+	bool	time=false, noise=false, preview=false, stream=false, compile=false, isa=false;
 	for(int i=1; i<argc-1; i+=2)
 	{
 		if(isArgument(argv[i], "-c", "--cores"))
@@ -145,6 +179,65 @@ bool Application::parseArguments(int argc, char **argv)
 			argOutput = std::string(argv[i+1]);
 			output    = true;
 		}
+		else if(isArgument(argv[i], "-t", "--time"))
+		{
+			if(time)
+				return reportError(Application::DupeOption, argv[i]);
+			if(!isValue(argv[i+1]))
+				return reportError(Application::InvalidValue, argv[i+1]);
+			sscanf(argv[i+1], "%i", &argTime);
+			if(argTime <= 0)
+				return reportError(Application::InvalidValue, argv[i+1]);
+			time			= true;
+			argProgressive	= true;
+		}
+		else if(isArgument(argv[i], "-n", "--noise"))
+		{
+			if(noise)
+				return reportError(Application::DupeOption, argv[i]);
+			if(!isFloatValue(argv[i+1]))
+				return reportError(Application::InvalidValue, argv[i+1]);
+			sscanf(argv[i+1], "%f", &argNoise);
+			if(argNoise <= 0.0f)
+				return reportError(Application::InvalidValue, argv[i+1]);
+			noise			= true;
+			argProgressive	= true;
+		}
+		else if(isArgument(argv[i], "-p", "--preview"))
+		{
+			if(preview)
+				return reportError(Application::DupeOption, argv[i]);
+			argPreview		= std::string(argv[i+1]);
+			preview			= true;
+			argProgressive	= true;
+		}
+		else if(isArgument(argv[i], "-s", "--stream"))
+		{
+			if(stream)
+				return reportError(Application::DupeOption, argv[i]);
+			if(!isValue(argv[i+1]))
+				return reportError(Application::InvalidValue, argv[i+1]);
+			sscanf(argv[i+1], "%i", &argStream);
+			if(argStream <= 0)
+				return reportError(Application::InvalidValue, argv[i+1]);
+			stream = true;
+		}
+		else if(isArgument(argv[i], "-C", "--compile"))
+		{
+			if(compile)
+				return reportError(Application::DupeOption, argv[i]);
+			argCompile = std::string(argv[i+1]);
+			compile    = true;
+		}
+		else if(isArgument(argv[i], "-i", "--isa"))
+		{
+			if(isa)
+				return reportError(Application::DupeOption, argv[i]);
+			argISA = Kernels::findISA(argv[i+1]);
+			if(argISA == Kernels::ISAUnknown)
+				return reportError(Application::InvalidValue, argv[i+1]);
+			isa = true;
+		}
 		else return reportError(Application::UnknownOption, argv[i]);
 	}
 
@@ -153,8 +246,12 @@ bool Application::parseArguments(int argc, char **argv)
 		return reportError(Application::InputNotFound, argv[argc-1]);
 	testFile.close();
 
-	if(!output)
+	if(!output && !compile)
 		return reportError(Application::OutputNotKnown);
+	if(stream && argProgressive)
+		return reportError(Application::StreamConflict);
+	if(stream && ImageHDR::isHDRFormat(argOutput))
+		return reportError(Application::StreamFormat);
 
 	argInput = std::string(argv[argc-1]);
 	return true;
@@ -224,7 +321,7 @@ void Application::getTime(const unsigned int timestamp, char *buffer)
 void Application::showSceneInfo(Engine *engine) const
 {
 	std::string	superSampling, shadowSampling;
-	int			samples[2];
+	int			samples[3];
 
 	if(engine->getParameter(exRay::Supersampling) == exRay::Full)
 		superSampling	= "Full";
@@ -235,16 +332,33 @@ void Application::showSceneInfo(Engine *engine) const
 
 	samples[0] = engine->getParameter(exRay::RenderSamples);
 	samples[1] = engine->getParameter(exRay::ShadowSamples);
+	samples[2] = engine->getParameter(exRay::LightSamples);
 
 	printf("  Input script : \"%s\"\n", argInput.c_str());
 	printf("  Output image : \"%s\"\n", argOutput.c_str());
-	printf("  Logical CPUs : %u assigned.\n\n", engine->getCPUs());
+	printf("  Logical CPUs : %u assigned.\n", engine->getCPUs());
+	printf("  Kernel ISA   : %s (supported: %s).\n\n", Kernels::getISAName(engine->getISA()),
+		Kernels::getISAName(Kernels::getSupportedISA()));
 
 	printf("  Frame Width  : %u\t\t", engine->getFramebuffer()->getWidth());
 	printf("  Supersampling  : %s (%ux%u)\n", superSampling.c_str(), samples[0], samples[0]);
 
 	printf("  Frame Height : %u\t\t", engine->getFramebuffer()->getHeight());
 	printf("  Shadow Approx. : %s (%ux%u)\n", shadowSampling.c_str(), samples[1], samples[1]);
+	if(samples[2] > 0)
+		printf("\t\t\t\t  Light Sampling  : %u per hit\n", samples[2]);
+
+	if(argProgressive)
+	{
+		printf("\n  Progressive  : ");
+		if(argTime > 0)
+			printf("time limit %us ", argTime);
+		if(argNoise > 0.0f)
+			printf("noise target %.3f ", argNoise);
+		if(argTime == 0 && argNoise <= 0.0f)
+			printf("%u samples per pixel", samples[0]*samples[0]);
+		printf("\n");
+	}
 }
 
 void Application::showProgress(Engine *engine) const
@@ -263,7 +377,10 @@ void Application::showProgress(Engine *engine) const
 		engine->getTracer(i)->resetRayCounters();
 	}
 
-	printf("  [%3.0f %%] [", engine->getProgressF()*100.0f);
+	if(engine->getRenderMode() == Engine::RenderProgressive)
+		printf("  [P%02u %3.0f %%] [", engine->getPass()+1, engine->getProgressF()*100.0f);
+	else
+		printf("  [%3.0f %%] [", engine->getProgressF()*100.0f);
 	for(int i=0; i<fullFactor; i++) putc('#', stdout);
 	for(int i=0; i<Application::ProgressBarWidth-fullFactor; i++) putc('.', stdout);
 	printf("]\r");
@@ -38,9 +38,17 @@ private:
 	unsigned int	argDepth;
 	std::string		argInput;
 	std::string		argOutput;
+	std::string		argPreview;
+	unsigned int	argTime;
+	float			argNoise;
+	bool			argProgressive;
+	unsigned int	argStream;
+	std::string		argCompile;
+	int				argISA;
 private:
 	static bool	isArgument(const char *argv, const char *shortForm, const char *longForm);
 	static bool	isValue(const char *string);
+	static bool	isFloatValue(const char *string);
 	bool		reportError(const int errorID, const char *info="");
 public:
 	Application(void);
@@ -67,6 +75,13 @@ public:
 	unsigned int	getDepth(void) const	{ return argDepth; }
 	std::string		getInput(void) const	{ return argInput; }
 	std::string		getOutput(void) const	{ return argOutput; }
+	std::string		getPreview(void) const	{ return argPreview; }
+	unsigned int	getTimeLimit(void) const{ return argTime; }
+	float			getNoiseTarget(void) const { return argNoise; }
+	bool			isProgressive(void) const { return argProgressive; }
+	unsigned int	getStreamRows(void) const { return argStream; }
+	std::string		getCompileOutput(void) const { return argCompile; }
+	int				getISA(void) const		{ return argISA; }
 
 	enum
 	{
@@ -77,6 +92,8 @@ public:
 		InputNotFound,
 		OutputNotKnown,
 		TooManyCores,
+		StreamConflict,
+		StreamFormat,
 
 		ProgressBarWidth = 60,
 		MainThreadIdle   = 200,
@@ -19,7 +19,12 @@
 #include "../Config.h"
 #include "Renderer.h"
 #include "../Graph/Node.h"
+#include "../Graph/NodeGraph.h"
+#include "RenderScene.h"
+#include "Kernels.h"
 #include "../Types/Image.h"
+#include "../Types/ImageHDR.h"
+#include "../Types/Arena.h"
 
 #ifdef WIN32 // WIN32 PLATFORM SPECIFIC
 #define WIN32_LEAN_AND_MEAN
@@ -30,17 +35,56 @@
 
 using namespace exRay;
 
-Engine::Engine(Image *outBuffer, const int depth, const int threads)
+// Operacje atomowe na licznikach wspdzielonych przez wtki renderujce.
+static unsigned int lockedCompareExchange(volatile unsigned int *dest, unsigned int value, unsigned int comparand)
 {
-	rootNode		= new Node("root", NULL);
+#ifdef WIN32
+	return (unsigned int)InterlockedCompareExchange((volatile LONG*)dest, (LONG)value, (LONG)comparand);
+#else
+	unsigned int result = *dest;
+	if(result == comparand)
+		*dest = value;
+	return result;
+#endif
+}
+
+static unsigned int lockedIncrement(volatile unsigned int *dest)
+{
+#ifdef WIN32
+	return (unsigned int)InterlockedIncrement((volatile LONG*)dest);
+#else
+	return ++(*dest);
+#endif
+}
+
+Engine::Engine(Image *outBuffer, const int depth, const int threads, const int isa)
+{
+	kernelISA		= Kernels::select((isa == Engine::Autodetect) ? Kernels::ISAUnknown : isa);
+	graphArena		= new Arena;
+	rootNode		= new(graphArena) Node("root", NULL, graphArena);
 	frameBuffer		= outBuffer;
+	hdrBuffer		= NULL;
+	frameStatus		= NULL;
 	traceDepth		= depth;
 
+	renderMode		= Engine::RenderDirect;
+	accumBuffer		= NULL;
+	lineSamples		= NULL;
+	lineVersion		= NULL;
+	currentPass		= 0;
+	renderStopped	= 0;
+	startTime		= 0;
+	timeLimit		= 0;
+	noiseTarget		= 0.0f;
+	noiseLevel		= 0.0f;
+
 	if(threads == Engine::Autodetect)
 		cpuCores	= getLogicalCPUsCount();
 	else cpuCores	= threads;
 	if(cpuCores == 0)
 		cpuCores = 1;
+	nodeGraph		= new NodeGraph(rootNode, cpuCores);
+	renderScene		= new RenderScene;
 
 	threadStatus	= new volatile unsigned int[cpuCores];
 	for(unsigned int i=0; i<cpuCores; i++)
@@ -65,11 +109,18 @@ Engine::~Engine(void)
 	for(std::vector<Renderer*>::iterator i=renderThread.begin(); i<renderThread.end(); i++)
 		delete (*i);
 
+	freeAccumBuffer();
+
 	delete[]	threadStatus;
 	delete[]	frameStatus;
-	delete		rootNode;
+	delete		renderScene;
+	delete		nodeGraph;
+	delete		graphArena;		// Wzy grafu zwalniane s razem z obszarem, bez destruktorw.
 }
 
+int Engine::getISA(void) const
+{ return kernelISA; }
+
 unsigned int Engine::getTraceDepth(void) const
 { return traceDepth; }
 
@@ -79,9 +130,31 @@ unsigned int Engine::getCPUs(void) const
 Node* Engine::getRootNode(void) const
 { return rootNode; }
 
+NodeGraph* Engine::getGraph(void) const
+{ return nodeGraph; }
+
+const RenderScene* Engine::getRenderScene(void) const
+{ return renderScene; }
+
 Image* Engine::getFramebuffer(void) const
 { return frameBuffer; }
 
+ImageHDR* Engine::getHDRFramebuffer(void) const
+{ return hdrBuffer; }
+
+bool Engine::setHDRFramebuffer(ImageHDR *buffer)
+{
+	if(buffer && frameBuffer)
+	{
+		if(buffer->getWidth() != frameBuffer->getWidth() || buffer->getHeight() != frameBuffer->getHeight())
+			return false;
+	}
+	hdrBuffer = buffer;
+	for(unsigned int i=0; i<renderThread.size(); i++)
+		renderThread[i]->setHDRFramebuffer(hdrBuffer);
+	return true;
+}
+
 bool Engine::setFramebuffer(Image *buffer)
 { 
 	if(!buffer)
@@ -98,6 +171,197 @@ bool Engine::setFramebuffer(Image *buffer)
 	frameBuffer = buffer;
 	for(unsigned int i=0; i<cpuCores; i++)
 		renderThread[i]->setFramebuffer(frameBuffer);
+	if(accumBuffer)
+		return allocateAccumBuffer();
+	return true;
+}
+
+void Engine::setRenderMode(const int mode)
+{
+	renderMode = mode;
+	if(renderMode != Engine::RenderProgressive)
+		freeAccumBuffer();
+}
+
+int Engine::getRenderMode(void) const
+{ return renderMode; }
+
+void Engine::setTimeLimit(const unsigned int seconds)
+{ timeLimit = seconds * 1000; }
+
+void Engine::setNoiseTarget(const float target)
+{ noiseTarget = target; }
+
+unsigned int Engine::getPass(void) const
+{ return currentPass; }
+
+float Engine::getNoiseLevel(void) const
+{ return noiseLevel; }
+
+unsigned int Engine::getSamplesPerPixel(void) const
+{
+	if(renderMode != Engine::RenderProgressive)
+		return SQR(getParameter(exRay::RenderSamples));
+
+	unsigned int samples = 0;
+	for(unsigned int i=0; i<currentPass; i++)
+		samples += getPassSamples(i);
+	return samples;
+}
+
+bool Engine::allocateAccumBuffer(void)
+{
+	freeAccumBuffer();
+	if(!frameBuffer)
+		return false;
+
+	unsigned int pixels = frameBuffer->getWidth() * frameBuffer->getHeight();
+	accumBuffer	= new float[pixels*4];
+	lineSamples	= new volatile unsigned int[frameBuffer->getHeight()];
+	lineVersion	= new volatile unsigned int[frameBuffer->getHeight()];
+	memset(accumBuffer, 0, pixels*4*sizeof(float));
+	memset(const_cast<unsigned int*>(lineSamples), 0, frameBuffer->getHeight()*sizeof(unsigned int));
+	memset(const_cast<unsigned int*>(lineVersion), 0, frameBuffer->getHeight()*sizeof(unsigned int));
+
+	currentPass		= 0;
+	renderStopped	= 0;
+	noiseLevel		= 0.0f;
+	return true;
+}
+
+void Engine::freeAccumBuffer(void)
+{
+	if(accumBuffer)
+		delete[] accumBuffer;
+	if(lineSamples)
+		delete[] lineSamples;
+	if(lineVersion)
+		delete[] lineVersion;
+	accumBuffer	= NULL;
+	lineSamples	= NULL;
+	lineVersion	= NULL;
+}
+
+// Liczba prbek na piksel renderowanych w danym przebiegu: 1, 2, 4, ... MaxPassSamples.
+unsigned int Engine::getPassSamples(const unsigned int pass) const
+{
+	unsigned int samples = 1 << pass;
+	if(samples > Engine::MaxPassSamples)
+		samples = Engine::MaxPassSamples;
+	return samples;
+}
+
+unsigned int Engine::getTickCount(void)
+{
+#ifdef WIN32
+	return GetTickCount();
+#else
+	return 0;
+#endif
+}
+
+bool Engine::isTimeLimitReached(void) const
+{
+	if(timeLimit == 0 || startTime == 0)
+		return false;
+	return (getTickCount() - startTime) >= timeLimit;
+}
+
+// Wywoywana przez wtek, ktry ukoczy ostatni lini przebiegu. Decyduje o kolejnym przebiegu.
+void Engine::finishPass(void)
+{
+	unsigned int samples = getSamplesPerPixel() + getPassSamples(currentPass);
+	noiseLevel = estimateNoise();
+
+	bool stop = false;
+	if(currentPass+1 >= Engine::MaxPasses)
+		stop = true;
+	else if(isTimeLimitReached())
+		stop = true;
+	else if(noiseTarget > 0.0f && currentPass > 0 && noiseLevel <= noiseTarget)
+		stop = true;
+	else if(timeLimit == 0 && noiseTarget <= 0.0f && samples >= (unsigned int)SQR(getParameter(exRay::RenderSamples)))
+		stop = true;
+
+	if(stop)
+	{
+		renderStopped = 1;
+		return;
+	}
+	linesRendered = 0;
+	currentPass++;
+}
+
+// redni wzgldny bd standardowy luminancji pikseli (szacowany z sumy kwadratw prbek).
+float Engine::estimateNoise(void) const
+{
+	if(!accumBuffer)
+		return 0.0f;
+
+	unsigned int	width	= frameBuffer->getWidth();
+	unsigned int	height	= frameBuffer->getHeight();
+	unsigned int	pixels	= 0;
+	float			noise	= 0.0f;
+
+	for(unsigned int y=0; y<height; y++)
+	{
+		unsigned int n = lineSamples[y];
+		if(n < 2)
+			continue;
+
+		float *pixel = &accumBuffer[y*width*4];
+		for(unsigned int x=0; x<width; x++, pixel+=4)
+		{
+			float	mean	 = (0.2126f*pixel[0] + 0.7152f*pixel[1] + 0.0722f*pixel[2]) / float(n);
+			float	variance = (pixel[3] / float(n) - SQR(mean)) * float(n) / float(n-1);
+			if(variance < 0.0f)
+				variance = 0.0f;
+			noise += sqrtf(variance / float(n)) / (mean + 0.1f);
+			pixels++;
+		}
+	}
+	if(pixels == 0)
+		return 0.0f;
+	return noise / float(pixels);
+}
+
+/** Przepisuje zawarto bufora akumulacji do bufora klatki. Moe by wywoana w trakcie renderowania:
+	linia odczytywana jest ponownie, jeli w trakcie odczytu wtek dopisa do niej przebieg (zmiana
+	lineVersion), wic suma prbek i ich liczba zawsze pochodz z tego samego stanu linii.
+*/
+bool Engine::resolveFramebuffer(void)
+{
+	if(!accumBuffer || !frameBuffer)
+		return false;
+
+	unsigned int	width	= frameBuffer->getWidth();
+	unsigned int	height	= frameBuffer->getHeight();
+	float			*span	= new float[width*3];
+
+	for(unsigned int y=0; y<height; y++)
+	{
+		unsigned int	n, version;
+		for(;;)
+		{
+			version = lineVersion[y];
+			if(version & 1)
+				continue;
+
+			n = lineSamples[y];
+			if(n > 0)
+				Kernels::get().resolveSpan(span, &accumBuffer[y*width*4], width, 1.0f / float(n));
+			if(lockedCompareExchange(&lineVersion[y], version, version) == version)
+				break;
+		}
+		if(n == 0)
+			continue;
+
+		if(hdrBuffer)
+			hdrBuffer->putSpan(0, y, span, width);
+		else
+			frameBuffer->putSpan(0, y, span, width);
+	}
+	delete[] span;
 	return true;
 }
 
@@ -188,12 +452,15 @@ bool Engine::resetTracers(void)
 	{
 		delete renderThread[i];
 		renderThread[i] = new Renderer(frameBuffer, rootNode, traceDepth);
+		renderThread[i]->setHDRFramebuffer(hdrBuffer);
 		renderITC[i]	= ThreadData();
 		renderTH[i]		= NULL;
 	}
 	if(frameBuffer)
 		memset(const_cast<unsigned int*>(frameStatus), 0, frameBuffer->getHeight()*sizeof(unsigned int));
 	linesRendered = 0;
+	if(accumBuffer)
+		return allocateAccumBuffer();
 	return true;
 }
 
@@ -213,12 +480,22 @@ float Engine::getProgressF(void) const
 
 bool Engine::createRenderingThreads(void)
 {
+	unsigned long (__stdcall *routine)(void*) = Engine::threadProc;
+	if(renderMode == Engine::RenderProgressive)
+	{
+		if(!allocateAccumBuffer())
+			return false;
+		routine = Engine::threadProcProgressive;
+	}
+
+	// Scena renderowania budowana jest raz i wspdzielona przez wszystkie wtki.
+	renderScene->build(rootNode);
 	for(unsigned int i=0; i<renderThread.size(); i++)
 	{
-		renderThread[i]->cacheSceneGraph();
-		renderITC[i]	= ThreadData(renderThread[i], frameStatus, &threadStatus[i], &linesRendered);
+		renderThread[i]->setScene(renderScene);
+		renderITC[i]	= ThreadData(this, renderThread[i], frameStatus, &threadStatus[i], &linesRendered);
 #ifdef WIN32
-		renderTH[i]		= CreateThread(NULL, 0, Engine::threadProc, &renderITC[i], CREATE_SUSPENDED, NULL);
+		renderTH[i]		= CreateThread(NULL, 0, routine, &renderITC[i], CREATE_SUSPENDED, NULL);
 #endif
 		threadStatus[i] = Engine::ThreadIdle;
 		if(renderTH[i] == NULL)
@@ -229,6 +506,8 @@ bool Engine::createRenderingThreads(void)
 
 void Engine::resumeRendering(void)
 {
+	if(startTime == 0)
+		startTime = getTickCount();
 	for(std::vector<void*>::iterator i=renderTH.begin(); i<renderTH.end(); i++)
 	{ 
 		if(*i) 
@@ -302,4 +581,66 @@ unsigned long __stdcall Engine::threadProc(void *pITC)
 	}
 	*ITC->threadStatus = Engine::ThreadFinished;
 	return 0;
+}
+
+unsigned long __stdcall Engine::threadProcProgressive(void *pITC)
+{
+	ThreadData	*ITC	= (ThreadData*)pITC;
+	Engine		*kernel	= ITC->kernel;
+	*ITC->threadStatus	= Engine::ThreadInProgress;
+
+	unsigned int	width		= ITC->tracer->getFramebuffer()->getWidth();
+	unsigned int	height		= ITC->tracer->getFramebuffer()->getHeight();
+	float			*lineAccum	= new float[width*4];
+
+	while(!kernel->renderStopped)
+	{
+		unsigned int	pass	= kernel->currentPass;
+		unsigned int	samples	= kernel->getPassSamples(pass);
+		bool			claimed	= false;
+
+		for(unsigned int y=0; y<height; y++)
+		{
+			if(kernel->renderStopped)
+				break;
+			if(kernel->isTimeLimitReached())
+			{
+				kernel->renderStopped = 1;
+				break;
+			}
+
+			// frameStatus[y] przechowuje liczb przebiegw, w ktrych linia zostaa ju zablokowana.
+			if(ITC->frameStatus[y] != pass)
+				continue;
+			if(lockedCompareExchange(&ITC->frameStatus[y], pass+1, pass) != pass)
+				continue;
+
+			// Przebieg akumulowany jest w buforze wtku, a suma i liczba prbek publikowane razem
+			// (resolveFramebuffer nie odczyta linii w trakcie publikacji).
+			claimed = true;
+			memset(lineAccum, 0, width*4*sizeof(float));
+			ITC->tracer->accumulateScanline(y, lineAccum, samples);
+
+			float	*accum = &kernel->accumBuffer[y*width*4];
+			lockedIncrement(&kernel->lineVersion[y]);
+			for(unsigned int i=0; i<width*4; i++)
+				accum[i] += lineAccum[i];
+			kernel->lineSamples[y] += samples;
+			lockedIncrement(&kernel->lineVersion[y]);
+
+			if(lockedIncrement(ITC->linesRendered) == height)
+				kernel->finishPass();
+		}
+
+		// Wszystkie linie przebiegu s zablokowane - czekaj na pozostae wtki.
+		if(!claimed)
+		{
+#ifdef WIN32
+			Sleep(1);
+#endif
+		}
+	}
+	delete[] lineAccum;
+	*ITC->threadStatus = Engine::ThreadFinished;
+	return 0;
 }
\ No newline at end of file
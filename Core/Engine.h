@@ -24,7 +24,12 @@ namespace exRay {
 
 class Renderer;
 class Image;
+class ImageHDR;
 class Node;
+class Arena;
+class NodeGraph;
+class RenderScene;
+class Engine;
 
 /// Klasa - containter. Bierze udzia w komunikacji midzy wtkami.
 /** Podstawowy "pakiet" komunikacyjny ITC. Kademu wtkowi renderujcemu
@@ -33,16 +38,18 @@ class Node;
 class ThreadData
 {
 public:
+	Engine					*kernel;
 	Renderer				*tracer;
 	volatile unsigned int	*frameStatus;
 	volatile unsigned int	*threadStatus;
 	volatile unsigned int	*linesRendered;
 public:
 	ThreadData(void)
-	{ tracer = NULL; frameStatus = NULL; threadStatus = NULL; linesRendered = NULL; }
-	ThreadData(Renderer *newTracer, volatile unsigned int *newFrameStatus, 
+	{ kernel = NULL; tracer = NULL; frameStatus = NULL; threadStatus = NULL; linesRendered = NULL; }
+	ThreadData(Engine *newKernel, Renderer *newTracer, volatile unsigned int *newFrameStatus, 
 		volatile unsigned int *newThreadStatus, volatile unsigned int *newLinesRendered)
 	{ 
+		kernel			= newKernel;
 		tracer			= newTracer;
 		frameStatus		= newFrameStatus;
 		threadStatus	= newThreadStatus;
@@ -58,36 +65,75 @@ public:
 	komunikacji midzy nimi (interthread communication). Udostpnia ona rwnie interfejs pozwalajcy
 	pobiera i ustawia parametry rendererw. Przechowuje aktualny bufor klatki oraz graf sceny.
 	Na systemach Windows XP SP3 oraz Windows Vista pozwala take wykry ilo rdzeni procesora.
+	Przy tworzeniu wybiera warianty jder obliczeniowych (Kernels) dla najszerszego zestawu instrukcji
+	obsugiwanego przez procesor lub dla zestawu wymuszonego parametrem.
+	W trybie progresywnym obraz renderowany jest w kolejnych przebiegach o rosncej liczbie prbek,
+	akumulowanych w buforze zmiennoprzecinkowym. Renderowanie koczy si po osigniciu limitu czasu,
+	zadanego poziomu szumu lub docelowej liczby prbek, a czciowy obraz mona pobra po kadym przebiegu.
+	Opcjonalny bufor HDR (ImageHDR) przejmuje wynik renderowania bez obcinania wartoci; konwersj
+	do 8-bitowego bufora klatki wykonuje wtedy jawnie ImageHDR::resolve().
 */
 class Engine
 {
 private:
 	unsigned int			cpuCores;
 	unsigned int			traceDepth;
+	int						kernelISA;		// Zestaw instrukcji wybranych wariantw jder (Kernels)
 	std::vector<Renderer*>	renderThread;
 	std::vector<ThreadData>	renderITC;	// Inter-Thread Communication
 	std::vector<void*>		renderTH;
 
 	Image*					frameBuffer;
+	ImageHDR*				hdrBuffer;
 	Node*					rootNode;
+	Arena*					graphArena;		// Pami wzw i atrybutw grafu sceny
+	NodeGraph*				nodeGraph;
+	RenderScene*			renderScene;	// Wspdzielona przez renderery, budowana przy tworzeniu wtkw
 
 	volatile unsigned int*	frameStatus;
 	volatile unsigned int*	threadStatus;
 	volatile unsigned int	linesRendered;
+
+	// Tryb progresywny
+	int						renderMode;
+	float*					accumBuffer;	// RGB + suma kwadratw luminancji (4 floaty na piksel)
+	volatile unsigned int*	lineSamples;
+	volatile unsigned int*	lineVersion;	// Licznik publikacji linii (nieparzysty w trakcie dopisywania przebiegu)
+	volatile unsigned int	currentPass;
+	volatile unsigned int	renderStopped;
+	unsigned int			startTime;
+	unsigned int			timeLimit;
+	float					noiseTarget;
+	float					noiseLevel;
 private:
-	static int						getLogicalCPUsCount(void);
+	static unsigned int				getTickCount(void);
 	static unsigned long __stdcall	threadProc(void *pITC);
+	static unsigned long __stdcall	threadProcProgressive(void *pITC);
+
+	bool			allocateAccumBuffer(void);
+	void			freeAccumBuffer(void);
+	unsigned int	getPassSamples(const unsigned int pass) const;
+	bool			isTimeLimitReached(void) const;
+	void			finishPass(void);
+	float			estimateNoise(void) const;
 public:
-	Engine(Image *outBuffer, const int depth, const int threads);
+	Engine(Image *outBuffer, const int depth, const int threads, const int isa=Engine::Autodetect);
 	virtual ~Engine(void);
 
+	static int		getLogicalCPUsCount(void);
+
 	unsigned int	getCPUs(void) const;
 	unsigned int	getTraceDepth(void) const;
+	int				getISA(void) const;
 	Node*			getRootNode(void) const;
+	NodeGraph*		getGraph(void) const;
+	const RenderScene*	getRenderScene(void) const;
 	Image*			getFramebuffer(void) const;
+	ImageHDR*		getHDRFramebuffer(void) const;
 	Renderer*		getTracer(const unsigned int id) const;
 
 	bool			setFramebuffer(Image *buffer);
+	bool			setHDRFramebuffer(ImageHDR *buffer);
 	bool			resetTracers(void);
 	bool			resetThreads(void);
 
@@ -98,6 +144,15 @@ public:
 
 	bool			threadsFinished(void) const;
 
+	void			setRenderMode(const int mode);
+	int				getRenderMode(void) const;
+	void			setTimeLimit(const unsigned int seconds);
+	void			setNoiseTarget(const float target);
+	unsigned int	getPass(void) const;
+	unsigned int	getSamplesPerPixel(void) const;
+	float			getNoiseLevel(void) const;
+	bool			resolveFramebuffer(void);
+
 	unsigned int	getProgressI(void) const;
 	float			getProgressF(void) const;
 
@@ -113,6 +168,13 @@ public:
 		ThreadIdle,
 		ThreadInProgress,
 		ThreadFinished,
+
+		// Tryby renderowania.
+		RenderDirect,
+		RenderProgressive,
+
+		MaxPasses		= 16,
+		MaxPassSamples	= 64,
 	};
 };
 
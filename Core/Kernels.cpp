@@ -0,0 +1,575 @@
+/*
+	This file is part of EX-Ray Raytracing Engine.
+	(C)2007 - 2008 Micha Siejak.
+
+    EX-Ray is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EX-Ray is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with EX-Ray.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../Config.h"
+#include "Kernels.h"
+#include "RenderScene.h"
+#include "../Types/Shader.h"
+
+#if defined(WIN32) && defined(EXRAY_SSE2)
+#include <intrin.h>
+#endif
+
+using namespace exRay;
+
+// Odlego pocztkowa testu prymitywu (jak w RenderScene).
+static const float	farDistance = 1.0e30f;
+
+// Warianty bazowe kompilacji, aktywne do czasu wywoania Kernels::select().
+#ifdef EXRAY_SSE2
+KernelTable Kernels::activeTable = { Kernels::ISASSE2,
+	Kernels::encodeSpanSSE2, Kernels::exposeSpanSSE2, Kernels::resolveSpanSSE2, Kernels::shadePhongSSE2,
+	Kernels::shadeDiffuseSSE2, Kernels::occludePacketSSE2 };
+#else
+KernelTable Kernels::activeTable = { Kernels::ISAScalar,
+	Kernels::encodeSpanScalar, Kernels::exposeSpanScalar, Kernels::resolveSpanScalar, Kernels::shadePhongScalar,
+	Kernels::shadeDiffuseScalar, Kernels::occludePacketScalar };
+#endif
+
+// Zwraca najszerszy zestaw instrukcji, dla ktrego skompilowano warianty jder i ktry obsuguje
+// zarwno procesor, jak i system operacyjny (zapis rozszerzonych rejestrw przy przeczaniu wtkw).
+int Kernels::getSupportedISA(void)
+{
+#if defined(WIN32) && defined(EXRAY_SSE2)
+	int		cpuInfo[4];
+	int		isa = Kernels::ISAScalar;
+
+	__cpuid(cpuInfo, 0);
+	const int maxLeaf = cpuInfo[0];
+	__cpuid(cpuInfo, 1);
+	if(!(cpuInfo[3] & (1 << 26)))					// SSE2
+		return isa;
+	isa = Kernels::ISASSE2;
+
+#ifdef EXRAY_AVX2
+	if(maxLeaf < 7 || (cpuInfo[2] & (3 << 27)) != (3 << 27))	// OSXSAVE, AVX
+		return isa;
+	const unsigned __int64 xcr0 = _xgetbv(0);
+	__cpuidex(cpuInfo, 7, 0);
+	if((xcr0 & 0x06) != 0x06 || !(cpuInfo[1] & (1 << 5)))	// Rejestry XMM/YMM, AVX2
+		return isa;
+	isa = Kernels::ISAAVX2;
+
+#ifdef EXRAY_AVX512
+	if((xcr0 & 0xe6) == 0xe6 && (cpuInfo[1] & (1 << 16)))	// Rejestry maski/ZMM, AVX-512F
+		isa = Kernels::ISAAVX512;
+#endif
+#endif
+	return isa;
+#elif defined(EXRAY_SSE2)
+	return Kernels::ISASSE2;
+#else
+	return Kernels::ISAScalar;
+#endif
+}
+
+// Wypenia aktywn tablic jder wariantami dla zadanego zestawu instrukcji (ISAUnknown - autodetekcja).
+// Zestaw szerszy od obsugiwanego jest ograniczany do obsugiwanego. Zwraca wybrany zestaw.
+int Kernels::select(const int isa)
+{
+	const int	supported	= getSupportedISA();
+	int			selected	= isa;
+	if(selected == Kernels::ISAUnknown || selected > supported)
+		selected = supported;
+
+	KernelTable	table		= { Kernels::ISAScalar,
+		Kernels::encodeSpanScalar, Kernels::exposeSpanScalar, Kernels::resolveSpanScalar, Kernels::shadePhongScalar,
+		Kernels::shadeDiffuseScalar, Kernels::occludePacketScalar };
+
+#ifdef EXRAY_SSE2
+	if(selected >= Kernels::ISASSE2)
+	{
+		table.encodeSpan	= Kernels::encodeSpanSSE2;
+		table.exposeSpan	= Kernels::exposeSpanSSE2;
+		table.resolveSpan	= Kernels::resolveSpanSSE2;
+		table.shadePhong	= Kernels::shadePhongSSE2;
+		table.shadeDiffuse	= Kernels::shadeDiffuseSSE2;
+		table.occludePacket	= Kernels::occludePacketSSE2;
+	}
+#endif
+#ifdef EXRAY_AVX2
+	if(selected >= Kernels::ISAAVX2)
+	{
+		table.encodeSpan	= Kernels::encodeSpanAVX2;
+		table.exposeSpan	= Kernels::exposeSpanAVX2;
+		table.shadePhong	= Kernels::shadePhongAVX2;
+		table.shadeDiffuse	= Kernels::shadeDiffuseAVX2;
+	}
+#endif
+#ifdef EXRAY_AVX512
+	if(selected >= Kernels::ISAAVX512)
+	{
+		table.encodeSpan	= Kernels::encodeSpanAVX512;
+		table.exposeSpan	= Kernels::exposeSpanAVX512;
+	}
+#endif
+
+	table.isa	= selected;
+	activeTable	= table;
+	return selected;
+}
+
+const char* Kernels::getISAName(const int isa)
+{
+	switch(isa)
+	{
+	case Kernels::ISAScalar:	return "Scalar";
+	case Kernels::ISASSE2:		return "SSE2";
+	case Kernels::ISAAVX2:		return "AVX2";
+	case Kernels::ISAAVX512:	return "AVX-512";
+	}
+	return "Unknown";
+}
+
+// Nazwy zestaww instrukcji przyjmowane w wierszu polece.
+int Kernels::findISA(const char *name)
+{
+	if(strcmp(name, "scalar") == 0)	return Kernels::ISAScalar;
+	if(strcmp(name, "sse2") == 0)	return Kernels::ISASSE2;
+	if(strcmp(name, "avx2") == 0)	return Kernels::ISAAVX2;
+	if(strcmp(name, "avx512") == 0)	return Kernels::ISAAVX512;
+	return Kernels::ISAUnknown;
+}
+
+void Kernels::encodeSpanScalar(unsigned char *dest, const float *span, const unsigned int count)
+{
+	for(unsigned int i=0; i<count; i++, span+=3, dest+=3)
+	{
+		for(int c=0; c<3; c++)
+		{
+			float value = span[2-c];
+			if(value > 1.0f) value = 1.0f;
+			if(value < 0.0f) value = 0.0f;
+			dest[c] = unsigned char(value*255.0f);
+		}
+	}
+}
+
+void Kernels::exposeSpanScalar(float *dest, const float *source, const unsigned int count, const float exposure, const bool reinhard)
+{
+	for(unsigned int i=0; i<count; i++)
+	{
+		float value = source[i] * exposure;
+		if(reinhard)
+			value /= 1.0f + value;
+		dest[i] = value;
+	}
+}
+
+void Kernels::resolveSpanScalar(float *dest, const float *accum, const unsigned int count, const float scale)
+{
+	for(unsigned int i=0; i<count; i++, accum+=4, dest+=3)
+	{
+		dest[0]	= accum[0]*scale;
+		dest[1]	= accum[1]*scale;
+		dest[2]	= accum[2]*scale;
+	}
+}
+
+// Kolejno dziaa odpowiada cieniowaniu pojedynczego trafienia (wektor wiata, iloczyny skalarne,
+// odbicie kierunku wiata wzgldem normalnej), dziki czemu warianty SIMD daj identyczny wynik.
+// Wariant bez skadowej odbitej (Specular = false) obsuguje materiay wycznie rozpraszajce.
+template<bool Specular> static void shadeScalar(ShadingQueue *queue, const unsigned int first)
+{
+	for(unsigned int j=first; j<queue->count; j++)
+	{
+		float	pixel[3]	= { 0.0f, 0.0f, 0.0f };
+		float	normal[3]	= { queue->normal[0][j], queue->normal[1][j], queue->normal[2][j] };
+
+		const unsigned int	last = queue->hitLightFirst[j] + queue->hitLightCount[j];
+		for(unsigned int i=queue->hitLightFirst[j]; i<last; i++)
+		{
+			const unsigned int	light	= queue->hitLight[i];
+			float	diffuse		= 0.0f;
+			float	specular	= 0.0f;
+			float	visibility	= queue->hitLightWeight[i];
+			float	lightDir[3], reflect[3];
+
+			for(int k=0; k<3; k++)
+				lightDir[k] = queue->lightPosition[k][light] - queue->position[k][j];
+#ifdef EXRAY_FASTMATH
+			float	sqLength = lightDir[0]*lightDir[0] + lightDir[1]*lightDir[1] + lightDir[2]*lightDir[2];
+			if(sqLength != 0.0f)
+			{
+				float invLength = fastRsqrt(sqLength);
+				for(int k=0; k<3; k++)
+					lightDir[k] *= invLength;
+			}
+#else
+			float	length = sqrtf(lightDir[0]*lightDir[0] + lightDir[1]*lightDir[1] + lightDir[2]*lightDir[2]);
+			if(length != 0.0f && length != 1.0f)
+			{
+				for(int k=0; k<3; k++)
+					lightDir[k] /= length;
+			}
+#endif
+
+			float	dotNL = normal[0]*lightDir[0] + normal[1]*lightDir[1] + normal[2]*lightDir[2];
+			if(dotNL > 0.0f)
+			{
+				diffuse = queue->materialDiffuse[j] * dotNL * visibility;
+				if(Specular)
+				{
+					for(int k=0; k<3; k++)
+						reflect[k] = 2.0f*normal[k]*dotNL - lightDir[k];
+					float	dotNR = normal[0]*reflect[0] + normal[1]*reflect[1] + normal[2]*reflect[2];
+					if(dotNR > 0.0f)
+						specular = MPOW(dotNR, queue->materialExponent[j]) * queue->materialSpecular[j] * visibility;
+				}
+			}
+
+			for(int k=0; k<3; k++)
+			{
+				pixel[k] += diffuse * queue->lightColor[k][light] * queue->materialColor[k][j];
+				if(Specular)
+					pixel[k] += specular * queue->lightColor[k][light];
+			}
+		}
+
+		queue->color[0][j] = pixel[0];
+		queue->color[1][j] = pixel[1];
+		queue->color[2][j] = pixel[2];
+	}
+}
+
+void Kernels::shadePhongScalar(ShadingQueue *queue, const unsigned int first)
+{ shadeScalar<true>(queue, first); }
+
+void Kernels::shadeDiffuseScalar(ShadingQueue *queue, const unsigned int first)
+{ shadeScalar<false>(queue, first); }
+
+// Test promieni pakietu od pozycji [first] funkcj RenderScene::intersect - wzorzec wariantw SIMD.
+static unsigned int occludeScalar(RenderShadowPacket *packet, const RenderPrimitive &primitive, const bool before,
+								  const unsigned int first)
+{
+	unsigned int	active = 0;
+	int				factor, flag;
+
+	for(unsigned int j=first; j<packet->size(); j++)
+	{
+		if(!packet->isVisible(j))
+			continue;
+
+		float	distance = farDistance;
+		if(RenderScene::intersect(primitive, packet->getOrigin(j), packet->getDirection(j), distance, factor, flag) &&
+		  (distance < packet->limit[j] || (before && distance == packet->limit[j])))
+			packet->limit[j] = -1.0f;
+		else
+			active++;
+	}
+	return active;
+}
+
+unsigned int Kernels::occludePacketScalar(RenderShadowPacket *packet, const RenderPrimitive &primitive, const bool before)
+{ return occludeScalar(packet, primitive, before, 0); }
+
+#ifdef EXRAY_SSE2
+// 4 piksele (12 skadowych) na iteracj, kanay zamieniane na BGR jeszcze w rejestrach.
+void Kernels::encodeSpanSSE2(unsigned char *dest, const float *span, const unsigned int count)
+{
+	const __m128	zero	= _mm_setzero_ps();
+	const __m128	one		= _mm_set1_ps(1.0f);
+	const __m128	scale	= _mm_set1_ps(255.0f);
+	unsigned int	i		= 0;
+
+	for(; i+4 <= count; i+=4, span+=12, dest+=12)
+	{
+		__m128 v[3], t, u;
+		v[0] = _mm_loadu_ps(span);		// R0 G0 B0 R1
+		v[1] = _mm_loadu_ps(span+4);	// G1 B1 R2 G2
+		v[2] = _mm_loadu_ps(span+8);	// B2 R3 G3 B3
+
+		for(int k=0; k<3; k++)
+			v[k] = _mm_mul_ps(_mm_min_ps(_mm_max_ps(v[k], zero), one), scale);
+
+		// RGB -> BGR
+		__m128 o[3];
+		t	 = _mm_shuffle_ps(v[0], v[1], _MM_SHUFFLE(1,1,0,0));
+		o[0] = _mm_shuffle_ps(v[0], t, _MM_SHUFFLE(2,0,1,2));		// B0 G0 R0 B1
+		t	 = _mm_shuffle_ps(v[1], v[0], _MM_SHUFFLE(3,3,0,0));
+		u	 = _mm_shuffle_ps(v[2], v[1], _MM_SHUFFLE(3,3,0,0));
+		o[1] = _mm_shuffle_ps(t, u, _MM_SHUFFLE(2,0,2,0));			// G1 R1 B2 G2
+		t	 = _mm_shuffle_ps(v[1], v[2], _MM_SHUFFLE(3,3,2,2));
+		o[2] = _mm_shuffle_ps(t, v[2], _MM_SHUFFLE(1,2,2,0));		// R2 B3 G3 R3
+
+		__m128i	lo		= _mm_packs_epi32(_mm_cvttps_epi32(o[0]), _mm_cvttps_epi32(o[1]));
+		__m128i	hi		= _mm_packs_epi32(_mm_cvttps_epi32(o[2]), _mm_setzero_si128());
+		__m128i	bytes	= _mm_packus_epi16(lo, hi);
+
+		_mm_storel_epi64((__m128i*)dest, bytes);
+		*(int*)(dest+8) = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 8));
+	}
+	encodeSpanScalar(dest, span, count-i);
+}
+
+void Kernels::exposeSpanSSE2(float *dest, const float *source, const unsigned int count, const float exposure, const bool reinhard)
+{
+	const __m128	scale	= _mm_set1_ps(exposure);
+	const __m128	one		= _mm_set1_ps(1.0f);
+	unsigned int	i		= 0;
+
+	for(; i+4 <= count; i+=4)
+	{
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(source+i), scale);
+		if(reinhard)
+			v = _mm_div_ps(v, _mm_add_ps(one, v));
+		_mm_storeu_ps(dest+i, v);
+	}
+	exposeSpanScalar(dest+i, source+i, count-i, exposure, reinhard);
+}
+
+// Zapis 4 skadowych na piksel; czwarta nadpisywana jest przez kolejny piksel, ostatni liczony skalarnie.
+void Kernels::resolveSpanSSE2(float *dest, const float *accum, const unsigned int count, const float scale)
+{
+	const __m128	factor	= _mm_set1_ps(scale);
+	unsigned int	i		= 0;
+
+	for(; i+1 < count; i++, accum+=4, dest+=3)
+		_mm_storeu_ps(dest, _mm_mul_ps(_mm_loadu_ps(accum), factor));
+	resolveSpanScalar(dest, accum, count-i, scale);
+}
+
+// Skadowe tablicy wiate dla 4 trafie.
+static inline __m128 gatherSSE2(const float *table, const unsigned int *index)
+{ return _mm_setr_ps(table[index[0]], table[index[1]], table[index[2]], table[index[3]]); }
+
+// 4 trafienia na iteracj; potga liczona jest skalarnie tylko dla owietlonych trafie (z EXRAY_FASTMATH
+// przez fastPow4 dla caego rejestru), reszta kolejki przekazywana jest wariantowi skalarnemu.
+// Krok n obejmuje n-te wpisy list wiate trafie. Trafienie o krtszej licie dostaje w nim wpis o zerowej
+// widocznoci, wyczany z owietlenia mask, wic liczba krokw to najdusza z 4 list.
+template<bool Specular> static void shadeSSE2(ShadingQueue *queue, const unsigned int first)
+{
+	const __m128	zero	= _mm_setzero_ps();
+	const __m128	two		= _mm_set1_ps(2.0f);
+#ifndef EXRAY_FASTMATH
+	const __m128	one		= _mm_set1_ps(1.0f);
+#endif
+	unsigned int	j		= first;
+
+	for(; j+4 <= queue->count; j+=4)
+	{
+		__m128	position[3], normal[3], materialColor[3], pixel[3];
+		for(int k=0; k<3; k++)
+		{
+			position[k]		 = _mm_loadu_ps(queue->position[k]+j);
+			normal[k]		 = _mm_loadu_ps(queue->normal[k]+j);
+			materialColor[k] = _mm_loadu_ps(queue->materialColor[k]+j);
+			pixel[k]		 = zero;
+		}
+		const __m128	materialDiffuse		= _mm_loadu_ps(queue->materialDiffuse+j);
+		const __m128	materialSpecular	= _mm_loadu_ps(queue->materialSpecular+j);
+
+		unsigned int	steps = 0;
+		for(int k=0; k<4; k++)
+		{
+			if(queue->hitLightCount[j+k] > steps)
+				steps = queue->hitLightCount[j+k];
+		}
+
+		for(unsigned int n=0; n<steps; n++)
+		{
+			unsigned int	light[4];
+			float			weight[4];
+			for(int k=0; k<4; k++)
+			{
+				const bool			valid	= n < queue->hitLightCount[j+k];
+				const unsigned int	entry	= queue->hitLightFirst[j+k] + n;
+				light[k]	= valid ? queue->hitLight[entry] : 0;
+				weight[k]	= valid ? queue->hitLightWeight[entry] : 0.0f;
+			}
+			const __m128	visibility = _mm_loadu_ps(weight);
+			__m128			lightDir[3], reflect[3], mask;
+
+			for(int k=0; k<3; k++)
+				lightDir[k] = _mm_sub_ps(gatherSSE2(queue->lightPosition[k], light), position[k]);
+			__m128	sqLength = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lightDir[0], lightDir[0]), _mm_mul_ps(lightDir[1], lightDir[1])),
+										  _mm_mul_ps(lightDir[2], lightDir[2]));
+#ifdef EXRAY_FASTMATH
+			__m128	invLength = fastRsqrt4(sqLength);
+			mask = _mm_cmpneq_ps(sqLength, zero);
+			for(int k=0; k<3; k++)
+				lightDir[k] = _mm_or_ps(_mm_and_ps(mask, _mm_mul_ps(lightDir[k], invLength)), _mm_andnot_ps(mask, lightDir[k]));
+#else
+			__m128	length = _mm_sqrt_ps(sqLength);
+			mask = _mm_andnot_ps(_mm_cmpeq_ps(length, zero), _mm_cmpneq_ps(length, one));
+			for(int k=0; k<3; k++)
+				lightDir[k] = _mm_or_ps(_mm_and_ps(mask, _mm_div_ps(lightDir[k], length)), _mm_andnot_ps(mask, lightDir[k]));
+#endif
+
+			__m128	dotNL = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normal[0], lightDir[0]), _mm_mul_ps(normal[1], lightDir[1])),
+									   _mm_mul_ps(normal[2], lightDir[2]));
+			__m128	lit = _mm_and_ps(_mm_cmpneq_ps(visibility, zero), _mm_cmpgt_ps(dotNL, zero));
+			__m128	diffuse = _mm_and_ps(lit, _mm_mul_ps(_mm_mul_ps(materialDiffuse, dotNL), visibility));
+
+			__m128	specular = zero;
+			if(Specular)
+			{
+				for(int k=0; k<3; k++)
+					reflect[k] = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(two, normal[k]), dotNL), lightDir[k]);
+				__m128	dotNR = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normal[0], reflect[0]), _mm_mul_ps(normal[1], reflect[1])),
+										   _mm_mul_ps(normal[2], reflect[2]));
+				mask = _mm_and_ps(lit, _mm_cmpgt_ps(dotNR, zero));
+
+				int		lanes	 = _mm_movemask_ps(mask);
+				if(lanes)
+				{
+#ifdef EXRAY_FASTMATH
+					__m128	power = fastPow4(dotNR, _mm_loadu_ps(queue->materialExponent+j));
+#else
+					float	base[4], powers[4];
+					_mm_storeu_ps(base, dotNR);
+					for(int k=0; k<4; k++)
+						powers[k] = (lanes & (1 << k)) ? powf(base[k], queue->materialExponent[j+k]) : 0.0f;
+					__m128	power = _mm_loadu_ps(powers);
+#endif
+					specular = _mm_and_ps(mask, _mm_mul_ps(_mm_mul_ps(power, materialSpecular), visibility));
+				}
+			}
+
+			for(int k=0; k<3; k++)
+			{
+				__m128	color = gatherSSE2(queue->lightColor[k], light);
+				pixel[k] = _mm_add_ps(pixel[k], _mm_mul_ps(_mm_mul_ps(diffuse, color), materialColor[k]));
+				if(Specular)
+					pixel[k] = _mm_add_ps(pixel[k], _mm_mul_ps(specular, color));
+			}
+		}
+
+		for(int k=0; k<3; k++)
+			_mm_storeu_ps(queue->color[k]+j, pixel[k]);
+	}
+	shadeScalar<Specular>(queue, j);
+}
+
+void Kernels::shadePhongSSE2(ShadingQueue *queue, const unsigned int first)
+{ shadeSSE2<true>(queue, first); }
+
+void Kernels::shadeDiffuseSSE2(ShadingQueue *queue, const unsigned int first)
+{ shadeSSE2<false>(queue, first); }
+
+static inline __m128 selectSSE2(const __m128 mask, const __m128 a, const __m128 b)
+{ return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+static inline __m128 dotSSE2(const __m128 *a, const __m128 *b)
+{ return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2])); }
+
+// Odlego przecicia 4 promieni z prymitywem (farDistance przy braku przecicia). Dziaania odpowiadaj
+// RenderScene::intersect, wic wynik jest identyczny z testem pojedynczego promienia.
+static __m128 intersectSSE2(const RenderPrimitive &primitive, const __m128 *origin, const __m128 *direction)
+{
+	const __m128	zero	= _mm_setzero_ps();
+	const __m128	miss	= _mm_set1_ps(farDistance);
+	const __m128	scalar	= _mm_set1_ps(primitive.scalar);
+	__m128			data[3];
+
+	for(int k=0; k<3; k++)
+		data[k] = _mm_set1_ps(primitive.data[0].cell[k]);
+
+	switch(primitive.type)
+	{
+	case RenderScene::PrimitiveSphere:
+		{
+			__m128	oc[3];
+			for(int k=0; k<3; k++)
+				oc[k] = _mm_sub_ps(data[k], origin[k]);
+
+			__m128	ocSqLen	 = dotSSE2(oc, oc);
+			__m128	t		 = dotSSE2(oc, direction);
+			__m128	halfcord = _mm_add_ps(_mm_sub_ps(scalar, ocSqLen), _mm_mul_ps(t, t));
+			__m128	root	 = _mm_sqrt_ps(halfcord);
+			__m128	inside	 = _mm_cmplt_ps(ocSqLen, scalar);
+			__m128	outside	 = _mm_and_ps(_mm_cmpnlt_ps(t, zero), _mm_cmpnlt_ps(halfcord, zero));
+			__m128	distance = selectSSE2(inside, _mm_add_ps(t, root), _mm_sub_ps(t, root));
+			return selectSSE2(_mm_or_ps(inside, outside), distance, miss);
+		}
+	case RenderScene::PrimitivePlane:
+		{
+			const __m128	sign = _mm_set1_ps(-0.0f);
+			__m128	dotND	 = dotSSE2(data, direction);
+			__m128	distance = _mm_div_ps(_mm_xor_ps(_mm_add_ps(dotSSE2(data, origin), scalar), sign), dotND);
+			__m128	hit		 = _mm_and_ps(_mm_cmpneq_ps(dotND, zero), _mm_cmpgt_ps(distance, zero));
+			return selectSSE2(hit, distance, miss);
+		}
+	case RenderScene::PrimitiveBox:
+		{
+			const vector3	*dim	= primitive.data;
+			const __m128	none	= _mm_set1_ps(-1.0f);
+			__m128			dist[6], nearest = miss;
+
+			// Przecicia z trzema parami paszczyzn ("pytami").
+			for(int k=0; k<3; k++)
+			{
+				__m128	valid = _mm_cmpneq_ps(direction[k], zero);
+				dist[k]	  = selectSSE2(valid, _mm_div_ps(_mm_sub_ps(_mm_set1_ps(dim[0].cell[k]), origin[k]), direction[k]), none);
+				dist[k+3] = selectSSE2(valid, _mm_div_ps(_mm_sub_ps(_mm_set1_ps(dim[1].cell[k]), origin[k]), direction[k]), none);
+			}
+
+			for(int i=0; i<6; i++)
+			{
+				// Ograniczanie punktu przecicia do wymiarw prostopadocianu.
+				__m128	valid = _mm_and_ps(_mm_cmpgt_ps(dist[i], zero), _mm_cmplt_ps(dist[i], nearest));
+				for(int k=0; k<3; k++)
+				{
+					__m128	point = _mm_add_ps(origin[k], _mm_mul_ps(dist[i], direction[k]));
+					valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(point, _mm_set1_ps(dim[0].cell[k] - MEPSILON)),
+														 _mm_cmplt_ps(point, _mm_set1_ps(dim[1].cell[k] + MEPSILON))));
+				}
+				nearest = selectSSE2(valid, dist[i], nearest);
+			}
+			return nearest;
+		}
+	}
+	return miss;
+}
+
+// 4 promienie na iteracj, reszta pakietu (oraz prymitywy innych typw) testowana jest wariantem skalarnym.
+unsigned int Kernels::occludePacketSSE2(RenderShadowPacket *packet, const RenderPrimitive &primitive, const bool before)
+{
+	const __m128	zero	= _mm_setzero_ps();
+	const __m128	none	= _mm_set1_ps(-1.0f);
+	unsigned int	active	= 0;
+	unsigned int	j		= 0;
+
+	if(primitive.type != RenderScene::PrimitiveSphere && primitive.type != RenderScene::PrimitivePlane &&
+	   primitive.type != RenderScene::PrimitiveBox)
+		return occludeScalar(packet, primitive, before, 0);
+
+	for(; j+4 <= packet->size(); j+=4)
+	{
+		__m128	limit	= _mm_loadu_ps(&packet->limit[j]);
+		__m128	visible	= _mm_cmpge_ps(limit, zero);
+		if(_mm_movemask_ps(visible) == 0)
+			continue;
+
+		__m128	origin[3], direction[3];
+		for(int k=0; k<3; k++)
+		{
+			origin[k]	 = _mm_loadu_ps(&packet->origin[k][j]);
+			direction[k] = _mm_loadu_ps(&packet->direction[k][j]);
+		}
+
+		__m128	distance = intersectSSE2(primitive, origin, direction);
+		__m128	occluded = _mm_and_ps(visible, before ? _mm_cmple_ps(distance, limit) : _mm_cmplt_ps(distance, limit));
+		_mm_storeu_ps(&packet->limit[j], selectSSE2(occluded, none, limit));
+
+		const int	lanes = _mm_movemask_ps(_mm_andnot_ps(occluded, visible));
+		active += (lanes & 1) + ((lanes >> 1) & 1) + ((lanes >> 2) & 1) + ((lanes >> 3) & 1);
+	}
+	return active + occludeScalar(packet, primitive, before, j);
+}
+#endif
\ No newline at end of file
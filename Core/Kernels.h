@@ -0,0 +1,110 @@
+/*
+	This file is part of EX-Ray Raytracing Engine.
+	(C)2007 - 2008 Micha Siejak.
+
+    EX-Ray is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EX-Ray is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with EX-Ray.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __KERNELS_H
+#define __KERNELS_H
+
+namespace exRay {
+
+class ShadingQueue;
+class RenderPrimitive;
+class RenderShadowPacket;
+
+/// Tablica jder obliczeniowych wybranego wariantu.
+/** Kade pole wskazuje implementacj jdra dla aktywnego zestawu instrukcji. Warianty szersze
+	zastpuj tylko te jdra, dla ktrych istnieje ich wasna implementacja, pozostae pozostaj wsze.
+*/
+class KernelTable
+{
+public:
+	int		isa;
+	void	(*encodeSpan)(unsigned char *dest, const float *span, const unsigned int count);
+	void	(*exposeSpan)(float *dest, const float *source, const unsigned int count, const float exposure, const bool reinhard);
+	void	(*resolveSpan)(float *dest, const float *accum, const unsigned int count, const float scale);
+	void	(*shadePhong)(ShadingQueue *queue, const unsigned int first);
+	void	(*shadeDiffuse)(ShadingQueue *queue, const unsigned int first);
+	unsigned int	(*occludePacket)(RenderShadowPacket *packet, const RenderPrimitive &primitive, const bool before);
+};
+
+/// Wybr wariantw jder obliczeniowych w czasie dziaania programu.
+/** Najszerszy zestaw rozszerze obsugiwany jednoczenie przez procesor (cpuid), system (XCR0) oraz
+	kompilator (EXRAY_AVX2, EXRAY_AVX512 w Config.h) wykrywany jest przy tworzeniu silnika, ktry wypenia
+	nim aktywn tablic jder. Jeden plik wykonywalny korzysta wic z najszerszej cieki dostpnej
+	na danej maszynie. Do czasu wyboru aktywny jest wariant bazowy kompilacji (SSE2 lub skalarny).
+	Wszystkie warianty danego jdra daj identyczne wyniki.
+	Tablica jest globalna dla procesu i moe by zmieniana wycznie, gdy wtki renderujce nie dziaaj.
+*/
+class Kernels
+{
+private:
+	static KernelTable	activeTable;
+public:
+	static int					getSupportedISA(void);
+	static int					select(const int isa);
+	static const KernelTable&	get(void)	{ return activeTable; }
+
+	static const char*			getISAName(const int isa);
+	static int					findISA(const char *name);
+
+	// Kwantyzacja [count] pikseli RGB do bajtw BGR (obcicie do [0,1]).
+	static void	encodeSpanScalar(unsigned char *dest, const float *span, const unsigned int count);
+	static void	encodeSpanSSE2(unsigned char *dest, const float *span, const unsigned int count);
+	static void	encodeSpanAVX2(unsigned char *dest, const float *span, const unsigned int count);
+	static void	encodeSpanAVX512(unsigned char *dest, const float *span, const unsigned int count);
+
+	// Przemnoenie [count] skadowych przez ekspozycj, opcjonalnie z mapowaniem tonw Reinharda x/(1+x).
+	static void	exposeSpanScalar(float *dest, const float *source, const unsigned int count, const float exposure, const bool reinhard);
+	static void	exposeSpanSSE2(float *dest, const float *source, const unsigned int count, const float exposure, const bool reinhard);
+	static void	exposeSpanAVX2(float *dest, const float *source, const unsigned int count, const float exposure, const bool reinhard);
+	static void	exposeSpanAVX512(float *dest, const float *source, const unsigned int count, const float exposure, const bool reinhard);
+
+	// Urednienie [count] pikseli bufora akumulacji (4 floaty na piksel) do RGB (3 floaty na piksel).
+	static void	resolveSpanScalar(float *dest, const float *accum, const unsigned int count, const float scale);
+	static void	resolveSpanSSE2(float *dest, const float *accum, const unsigned int count, const float scale);
+
+	// Owietlenie Lambert/Phong trafie kolejki od pozycji [first] (ShaderPhong) wiatami kolejki;
+	// wynik w tablicach color.
+	static void	shadePhongScalar(ShadingQueue *queue, const unsigned int first);
+	static void	shadePhongSSE2(ShadingQueue *queue, const unsigned int first);
+	static void	shadePhongAVX2(ShadingQueue *queue, const unsigned int first);
+
+	// Jak shadePhong*, bez skadowej odbitej - dla kolejek materiaw wycznie rozpraszajcych.
+	static void	shadeDiffuseScalar(ShadingQueue *queue, const unsigned int first);
+	static void	shadeDiffuseSSE2(ShadingQueue *queue, const unsigned int first);
+	static void	shadeDiffuseAVX2(ShadingQueue *queue, const unsigned int first);
+
+	// Przesanianie promieni pakietu cienia przez prymityw (kula, paszczyzna, prostopadocian): promie
+	// trafiajcy prymityw bliej ni wiato (przy rwnej odlegoci - gdy [before]) otrzymuje ujemny limit.
+	// Zwraca liczb promieni nieprzesonitych.
+	static unsigned int	occludePacketScalar(RenderShadowPacket *packet, const RenderPrimitive &primitive, const bool before);
+	static unsigned int	occludePacketSSE2(RenderShadowPacket *packet, const RenderPrimitive &primitive, const bool before);
+
+	enum
+	{
+		// Zestawy instrukcji (w kolejnoci rosncej szerokoci).
+		ISAUnknown = 0,
+		ISAScalar,
+		ISASSE2,
+		ISAAVX2,
+		ISAAVX512,
+	};
+};
+
+} // exRay
+
+#endif
\ No newline at end of file
@@ -0,0 +1,243 @@
+/*
+	This file is part of EX-Ray Raytracing Engine.
+	(C)2007 - 2008 Micha Siejak.
+
+    EX-Ray is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EX-Ray is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with EX-Ray.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../Config.h"
+#include "Kernels.h"
+#include "../Types/Shader.h"
+
+// Warianty AVX2 jder obliczeniowych, wywoywane wycznie po wykryciu AVX2 przez Kernels::getSupportedISA().
+// Plik nie wywouje funkcji inline wsplnych z innymi plikami (std::vector, Math/FastMath.h): kompilator
+// generujcy tu kod AVX2 mgby przy czeniu podstawi tak wersj w miejsce wersji SSE2.
+#ifdef EXRAY_AVX2
+#include <immintrin.h>
+
+using namespace exRay;
+
+// Kwantyzacja 4 pikseli (12 skadowych w trzech rejestrach) i zapis w kolejnoci BGR.
+static inline void storeBGR(unsigned char *dest, const __m128i &a, const __m128i &b, const __m128i &c)
+{
+	const __m128i	order	= _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 12, 13, 14, 15);
+	__m128i			bytes	= _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, _mm_setzero_si128()));
+
+	bytes = _mm_shuffle_epi8(bytes, order);
+	_mm_storel_epi64((__m128i*)dest, bytes);
+	*(int*)(dest+8) = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 8));
+}
+
+// 8 pikseli (24 skadowe) na iteracj. Dziaania na skadowych nie zale od kanau, wic kolejno
+// BGR ustalana jest dopiero na bajtach; reszta przekazywana jest wariantowi SSE2.
+void Kernels::encodeSpanAVX2(unsigned char *dest, const float *span, const unsigned int count)
+{
+	const __m256	zero	= _mm256_setzero_ps();
+	const __m256	one		= _mm256_set1_ps(1.0f);
+	const __m256	scale	= _mm256_set1_ps(255.0f);
+	unsigned int	i		= 0;
+
+	for(; i+8 <= count; i+=8, span+=24, dest+=24)
+	{
+		__m256i q[3];
+		for(int k=0; k<3; k++)
+		{
+			__m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(span+k*8), zero), one);
+			q[k] = _mm256_cvttps_epi32(_mm256_mul_ps(v, scale));
+		}
+		storeBGR(dest,	  _mm256_castsi256_si128(q[0]), _mm256_extracti128_si256(q[0], 1), _mm256_castsi256_si128(q[1]));
+		storeBGR(dest+12, _mm256_extracti128_si256(q[1], 1), _mm256_castsi256_si128(q[2]), _mm256_extracti128_si256(q[2], 1));
+	}
+	_mm256_zeroupper();
+	encodeSpanSSE2(dest, span, count-i);
+}
+
+void Kernels::exposeSpanAVX2(float *dest, const float *source, const unsigned int count, const float exposure, const bool reinhard)
+{
+	const __m256	scale	= _mm256_set1_ps(exposure);
+	const __m256	one		= _mm256_set1_ps(1.0f);
+	unsigned int	i		= 0;
+
+	for(; i+8 <= count; i+=8)
+	{
+		__m256 v = _mm256_mul_ps(_mm256_loadu_ps(source+i), scale);
+		if(reinhard)
+			v = _mm256_div_ps(v, _mm256_add_ps(one, v));
+		_mm256_storeu_ps(dest+i, v);
+	}
+	_mm256_zeroupper();
+	exposeSpanSSE2(dest+i, source+i, count-i, exposure, reinhard);
+}
+
+#ifdef EXRAY_FASTMATH
+// Potga x^y (8 wartoci), dziaania jak w fastPow4 z Math/FastMath.h; lanes nie jest potrzebne.
+static inline __m256 powerAVX2(const __m256 x, const float *exponent, const int lanes)
+{
+	const __m256	one		= _mm256_set1_ps(1.0f);
+	__m256i			bits	= _mm256_castps_si256(x);
+	__m256i			e		= _mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0xff)), _mm256_set1_epi32(127));
+	__m256			m		= _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+
+	// log2(x): mantysa sprowadzana do przedziau [sqrt(0.5), sqrt(2)).
+	__m256	high = _mm256_cmp_ps(m, _mm256_set1_ps(1.41421356f), _CMP_GT_OQ);
+	m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), high);
+	__m256	ef	= _mm256_add_ps(_mm256_cvtepi32_ps(e), _mm256_and_ps(high, one));
+	__m256	s	= _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+	__m256	s2	= _mm256_mul_ps(s, s);
+	__m256	p	= _mm256_set1_ps(FASTMATH_LOG2_C7);
+	p = _mm256_add_ps(_mm256_mul_ps(p, s2), _mm256_set1_ps(FASTMATH_LOG2_C5));
+	p = _mm256_add_ps(_mm256_mul_ps(p, s2), _mm256_set1_ps(FASTMATH_LOG2_C3));
+	p = _mm256_add_ps(_mm256_mul_ps(p, s2), _mm256_set1_ps(FASTMATH_LOG2_C1));
+
+	// 2^(y*log2(x)).
+	__m256	t			= _mm256_mul_ps(_mm256_loadu_ps(exponent), _mm256_add_ps(_mm256_mul_ps(p, s), ef));
+	__m256	underflow	= _mm256_cmp_ps(t, _mm256_set1_ps(-126.0f), _CMP_LT_OQ);
+	t = _mm256_min_ps(_mm256_max_ps(t, _mm256_set1_ps(-126.0f)), _mm256_set1_ps(127.0f));
+
+	__m256i	i		= _mm256_cvtps_epi32(t);
+	__m256	f		= _mm256_sub_ps(t, _mm256_cvtepi32_ps(i));
+	__m256	scale	= _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(i, _mm256_set1_epi32(127)), 23));
+	p = _mm256_set1_ps(FASTMATH_EXP2_C5);
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(FASTMATH_EXP2_C4));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(FASTMATH_EXP2_C3));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(FASTMATH_EXP2_C2));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(FASTMATH_EXP2_C1));
+	p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(FASTMATH_EXP2_C0));
+
+	__m256	positive = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ);
+	return _mm256_and_ps(positive, _mm256_andnot_ps(underflow, _mm256_mul_ps(p, scale)));
+}
+#else
+// Potga x^y liczona przez powf tylko dla skadowych z maski lanes.
+static inline __m256 powerAVX2(const __m256 x, const float *exponent, const int lanes)
+{
+	float	base[8], power[8];
+	_mm256_storeu_ps(base, x);
+	for(int k=0; k<8; k++)
+		power[k] = (lanes & (1 << k)) ? powf(base[k], exponent[k]) : 0.0f;
+	return _mm256_loadu_ps(power);
+}
+#endif
+
+// 8 trafie na iteracj, dziaania i kroki list wiate jak w wariancie SSE2; wpisy list i skadowe wiate
+// pobierane s instrukcjami gather. Reszta kolejki przekazywana jest wariantowi SSE2.
+template<bool Specular> static void shadeAVX2(ShadingQueue *queue, const unsigned int first)
+{
+	const __m256	zero	= _mm256_setzero_ps();
+	const __m256	two		= _mm256_set1_ps(2.0f);
+#ifdef EXRAY_FASTMATH
+	const __m256	half	= _mm256_set1_ps(0.5f);
+	const __m256	threeHalves = _mm256_set1_ps(1.5f);
+#else
+	const __m256	one		= _mm256_set1_ps(1.0f);
+#endif
+	unsigned int	j		= first;
+
+	for(; j+8 <= queue->count; j+=8)
+	{
+		__m256	position[3], normal[3], materialColor[3], pixel[3];
+		for(int k=0; k<3; k++)
+		{
+			position[k]		 = _mm256_loadu_ps(queue->position[k]+j);
+			normal[k]		 = _mm256_loadu_ps(queue->normal[k]+j);
+			materialColor[k] = _mm256_loadu_ps(queue->materialColor[k]+j);
+			pixel[k]		 = zero;
+		}
+		const __m256	materialDiffuse		= _mm256_loadu_ps(queue->materialDiffuse+j);
+		const __m256	materialSpecular	= _mm256_loadu_ps(queue->materialSpecular+j);
+
+		const __m256i	hitFirst	= _mm256_loadu_si256((const __m256i*)(queue->hitLightFirst+j));
+		const __m256i	hitCount	= _mm256_loadu_si256((const __m256i*)(queue->hitLightCount+j));
+		unsigned int	steps		= 0;
+		for(int k=0; k<8; k++)
+		{
+			if(queue->hitLightCount[j+k] > steps)
+				steps = queue->hitLightCount[j+k];
+		}
+
+		for(unsigned int n=0; n<steps; n++)
+		{
+			const __m256i	step	= _mm256_set1_epi32((int)n);
+			const __m256i	entry	= _mm256_add_epi32(hitFirst, step);
+			const __m256i	valid	= _mm256_cmpgt_epi32(hitCount, step);
+			const __m256i	light	= _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int*)queue->hitLight, entry, valid, 4);
+			const __m256	visibility = _mm256_mask_i32gather_ps(zero, queue->hitLightWeight, entry, _mm256_castsi256_ps(valid), 4);
+			__m256			lightDir[3], reflect[3], mask;
+
+			for(int k=0; k<3; k++)
+				lightDir[k] = _mm256_sub_ps(_mm256_i32gather_ps(queue->lightPosition[k], light, 4), position[k]);
+			__m256	sqLength = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(lightDir[0], lightDir[0]), _mm256_mul_ps(lightDir[1], lightDir[1])),
+											 _mm256_mul_ps(lightDir[2], lightDir[2]));
+#ifdef EXRAY_FASTMATH
+			// Jak fastRsqrt: przyblienie sprztowe i krok Newtona.
+			__m256	invLength = _mm256_rsqrt_ps(sqLength);
+			invLength = _mm256_mul_ps(invLength, _mm256_sub_ps(threeHalves,
+						_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(half, sqLength), invLength), invLength)));
+			mask = _mm256_cmp_ps(sqLength, zero, _CMP_NEQ_UQ);
+			for(int k=0; k<3; k++)
+				lightDir[k] = _mm256_blendv_ps(lightDir[k], _mm256_mul_ps(lightDir[k], invLength), mask);
+#else
+			__m256	length = _mm256_sqrt_ps(sqLength);
+			mask = _mm256_andnot_ps(_mm256_cmp_ps(length, zero, _CMP_EQ_OQ), _mm256_cmp_ps(length, one, _CMP_NEQ_UQ));
+			for(int k=0; k<3; k++)
+				lightDir[k] = _mm256_blendv_ps(lightDir[k], _mm256_div_ps(lightDir[k], length), mask);
+#endif
+
+			__m256	dotNL = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normal[0], lightDir[0]), _mm256_mul_ps(normal[1], lightDir[1])),
+										  _mm256_mul_ps(normal[2], lightDir[2]));
+			__m256	lit = _mm256_and_ps(_mm256_castsi256_ps(valid), _mm256_cmp_ps(dotNL, zero, _CMP_GT_OQ));
+			__m256	diffuse = _mm256_and_ps(lit, _mm256_mul_ps(_mm256_mul_ps(materialDiffuse, dotNL), visibility));
+
+			__m256	specular = zero;
+			if(Specular)
+			{
+				for(int k=0; k<3; k++)
+					reflect[k] = _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(two, normal[k]), dotNL), lightDir[k]);
+				__m256	dotNR = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normal[0], reflect[0]), _mm256_mul_ps(normal[1], reflect[1])),
+											  _mm256_mul_ps(normal[2], reflect[2]));
+				mask = _mm256_and_ps(lit, _mm256_cmp_ps(dotNR, zero, _CMP_GT_OQ));
+
+				int		lanes	 = _mm256_movemask_ps(mask);
+				if(lanes)
+				{
+					__m256	power = powerAVX2(dotNR, queue->materialExponent+j, lanes);
+					specular = _mm256_and_ps(mask, _mm256_mul_ps(_mm256_mul_ps(power, materialSpecular), visibility));
+				}
+			}
+
+			for(int k=0; k<3; k++)
+			{
+				__m256	color = _mm256_i32gather_ps(queue->lightColor[k], light, 4);
+				pixel[k] = _mm256_add_ps(pixel[k], _mm256_mul_ps(_mm256_mul_ps(diffuse, color), materialColor[k]));
+				if(Specular)
+					pixel[k] = _mm256_add_ps(pixel[k], _mm256_mul_ps(specular, color));
+			}
+		}
+
+		for(int k=0; k<3; k++)
+			_mm256_storeu_ps(queue->color[k]+j, pixel[k]);
+	}
+	_mm256_zeroupper();
+	if(Specular)
+		Kernels::shadePhongSSE2(queue, j);
+	else
+		Kernels::shadeDiffuseSSE2(queue, j);
+}
+
+void Kernels::shadePhongAVX2(ShadingQueue *queue, const unsigned int first)
+{ shadeAVX2<true>(queue, first); }
+
+void Kernels::shadeDiffuseAVX2(ShadingQueue *queue, const unsigned int first)
+{ shadeAVX2<false>(queue, first); }
+#endif
\ No newline at end of file
@@ -0,0 +1,91 @@
+/*
+	This file is part of EX-Ray Raytracing Engine.
+	(C)2007 - 2008 Micha Siejak.
+
+    EX-Ray is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EX-Ray is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with EX-Ray.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../Config.h"
+#include "Kernels.h"
+
+// Warianty AVX-512 jder obliczeniowych, wywoywane wycznie po wykryciu AVX-512F przez Kernels::getSupportedISA().
+// Jak w KernelsAVX2.cpp, plik nie wywouje funkcji inline wsplnych z innymi plikami.
+#ifdef EXRAY_AVX512
+#include <immintrin.h>
+
+using namespace exRay;
+
+// Kwantyzacja 4 pikseli (12 skadowych w trzech rejestrach) i zapis w kolejnoci BGR.
+static inline void storeBGR(unsigned char *dest, const __m128i &a, const __m128i &b, const __m128i &c)
+{
+	const __m128i	order	= _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 12, 13, 14, 15);
+	__m128i			bytes	= _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, _mm_setzero_si128()));
+
+	bytes = _mm_shuffle_epi8(bytes, order);
+	_mm_storel_epi64((__m128i*)dest, bytes);
+	*(int*)(dest+8) = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 8));
+}
+
+// 16 pikseli (48 skadowych) na iteracj, jak w wariancie AVX2; reszta przekazywana jest wariantowi AVX2.
+void Kernels::encodeSpanAVX512(unsigned char *dest, const float *span, const unsigned int count)
+{
+	const __m512	zero	= _mm512_setzero_ps();
+	const __m512	one		= _mm512_set1_ps(1.0f);
+	const __m512	scale	= _mm512_set1_ps(255.0f);
+	unsigned int	i		= 0;
+
+	for(; i+16 <= count; i+=16, span+=48, dest+=48)
+	{
+		__m128i q[12];
+		for(int k=0; k<3; k++)
+		{
+			__m512 v = _mm512_min_ps(_mm512_max_ps(_mm512_loadu_ps(span+k*16), zero), one);
+			__m512i n = _mm512_cvttps_epi32(_mm512_mul_ps(v, scale));
+			q[k*4]	 = _mm512_castsi512_si128(n);
+			q[k*4+1] = _mm512_extracti32x4_epi32(n, 1);
+			q[k*4+2] = _mm512_extracti32x4_epi32(n, 2);
+			q[k*4+3] = _mm512_extracti32x4_epi32(n, 3);
+		}
+		for(int k=0; k<4; k++)
+			storeBGR(dest+k*12, q[k*3], q[k*3+1], q[k*3+2]);
+	}
+	_mm256_zeroupper();
+#ifdef EXRAY_AVX2
+	encodeSpanAVX2(dest, span, count-i);
+#else
+	encodeSpanSSE2(dest, span, count-i);
+#endif
+}
+
+void Kernels::exposeSpanAVX512(float *dest, const float *source, const unsigned int count, const float exposure, const bool reinhard)
+{
+	const __m512	scale	= _mm512_set1_ps(exposure);
+	const __m512	one		= _mm512_set1_ps(1.0f);
+	unsigned int	i		= 0;
+
+	for(; i+16 <= count; i+=16)
+	{
+		__m512 v = _mm512_mul_ps(_mm512_loadu_ps(source+i), scale);
+		if(reinhard)
+			v = _mm512_div_ps(v, _mm512_add_ps(one, v));
+		_mm512_storeu_ps(dest+i, v);
+	}
+	_mm256_zeroupper();
+#ifdef EXRAY_AVX2
+	exposeSpanAVX2(dest+i, source+i, count-i, exposure, reinhard);
+#else
+	exposeSpanSSE2(dest+i, source+i, count-i, exposure, reinhard);
+#endif
+}
+#endif
\ No newline at end of file
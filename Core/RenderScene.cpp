@@ -0,0 +1,1057 @@
+/*
+	This file is part of EX-Ray Raytracing Engine.
+	(C)2007 - 2008 Micha Siejak.
+
+    EX-Ray is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EX-Ray is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with EX-Ray.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../Config.h"
+#include <algorithm>
+#include "../Graph/Variable.h"
+#include "../Graph/Node.h"
+#include "../Graph/Object.h"
+#include "../Graph/NodeBox.h"
+#include "../Graph/NodeLight.h"
+#include "../Graph/NodeMaterial.h"
+#include "../Types/Shader.h"
+#include "RenderScene.h"
+#include "Kernels.h"
+
+using namespace exRay;
+
+// Odlego pocztkowa testu pojedynczego prymitywu (wiksza od kadej odlegoci przecicia).
+static const float	farDistance = 1.0e30f;
+
+/// Porzdek prymityww wedug rodka bryy otaczajcej na zadanej osi (podzia wza BVH).
+class CentreOrder
+{
+public:
+	const std::vector<vector3>	*centres;
+	int							axis;
+
+	CentreOrder(const std::vector<vector3> *newCentres, const int newAxis) : centres(newCentres), axis(newAxis) { }
+	bool operator()(const unsigned int a, const unsigned int b) const
+	{ return (*centres)[a].cell[axis] < (*centres)[b].cell[axis]; }
+};
+
+RenderScene::RenderScene(void)
+{
+	NodeCamera	defaultCamera("", NULL);
+	camera = getCamera(&defaultCamera);
+}
+
+RenderScene::~RenderScene(void)
+{
+}
+
+void RenderLightTable::push(const vector3 &lightPosition, const vector3 &lightColor, const vector2 &lightArea,
+							const float lightRadius, const int lightType, const int lightPrimitive)
+{
+	for(int i=0; i<3; i++)
+	{
+		position[i].push_back(lightPosition.cell[i]);
+		color[i].push_back(lightColor.cell[i]);
+	}
+	area[0].push_back(lightArea.x);
+	area[1].push_back(lightArea.y);
+	radius.push_back(lightRadius);
+	type.push_back(lightType);
+	primitive.push_back(lightPrimitive);
+}
+
+void RenderLightTable::clear(void)
+{
+	for(int i=0; i<3; i++)
+	{
+		position[i].clear();
+		color[i].clear();
+	}
+	area[0].clear();
+	area[1].clear();
+	radius.clear();
+	type.clear();
+	primitive.clear();
+}
+
+void RenderShadowPacket::push(const vector3 &rayOrigin, const vector3 &rayDirection, const float rayDistance)
+{
+	for(int i=0; i<3; i++)
+	{
+		origin[i].push_back(rayOrigin.cell[i]);
+		direction[i].push_back(rayDirection.cell[i]);
+	}
+	distance.push_back(rayDistance);
+	limit.push_back(-1.0f);
+}
+
+void RenderShadowPacket::clear(void)
+{
+	for(int i=0; i<3; i++)
+	{
+		origin[i].clear();
+		direction[i].clear();
+	}
+	distance.clear();
+	limit.clear();
+	primitives.clear();
+}
+
+// Prostopadocian zasigu wiata. Zwraca false dla wiata o nieograniczonym zasigu.
+bool RenderLightTable::getBounds(const unsigned int index, vector3 *bounds) const
+{
+	if(radius[index] <= 0.0f)
+		return false;
+
+	const vector3	corner	= getPosition(index);
+	const vector3	extent	= (type[index] == RenderLightTable::LightArea) ?
+							  vector3(area[0][index], 0.0f, area[1][index]) : vector3();
+	for(int i=0; i<3; i++)
+	{
+		bounds[0].cell[i] = std::min(corner.cell[i], corner.cell[i] + extent.cell[i]) - radius[index];
+		bounds[1].cell[i] = std::max(corner.cell[i], corner.cell[i] + extent.cell[i]) + radius[index];
+	}
+	return true;
+}
+
+float RenderLightTable::getAttenuation(const unsigned int index, const vector3 &point) const
+{
+	if(radius[index] <= 0.0f)
+		return 1.0f;
+
+	vector3	nearest = getPosition(index);
+	if(type[index] == RenderLightTable::LightArea)
+	{
+		float	x[2] = { nearest.x, nearest.x + area[0][index] };
+		float	z[2] = { nearest.z, nearest.z + area[1][index] };
+		nearest.x = std::min(std::max(point.x, std::min(x[0], x[1])), std::max(x[0], x[1]));
+		nearest.z = std::min(std::max(point.z, std::min(z[0], z[1])), std::max(z[0], z[1]));
+	}
+
+	const float	ratio = (point - nearest).sqLength() / SQR(radius[index]);
+	if(ratio >= 1.0f)
+		return 0.0f;
+	return SQR(1.0f - ratio);
+}
+
+void RenderScene::clear(void)
+{
+	primitives.clear();
+	lights.clear();
+	materials.clear();
+	shaders.clear();
+	shaderLights.clear();
+	shaderLightRows.clear();
+	bvhNodes.clear();
+	bvhPrimitives.clear();
+	unboundedPrimitives.clear();
+	lightBVHNodes.clear();
+	bvhLights.clear();
+	unboundedLights.clear();
+	lightClusters.clear();
+	shaderNodePower.clear();
+	shaderUnboundedPower.clear();
+}
+
+RenderCamera RenderScene::getCamera(Node *camNode)
+{
+	RenderCamera	result;
+	matrix4			viewMatrix = ((Object*)camNode)->getTM();
+
+	vector2	screenPlane;
+	camNode->getAttribValue(attrOrigin, result.origin);
+	camNode->getAttribValue(attrScreen, screenPlane);
+
+	result.corners[0]	= vector3(-screenPlane.x*0.5f, -screenPlane.y*0.5f, 0.0f);
+	result.corners[1]	= vector3(screenPlane.x*0.5f, -screenPlane.y*0.5f, 0.0f);
+	result.corners[2]	= vector3(screenPlane.x*0.5f, screenPlane.y*0.5f, 0.0f);
+	result.corners[3]	= vector3(-screenPlane.x*0.5f, screenPlane.y*0.5f, 0.0f);
+
+	viewMatrix.transformPoints(&result.origin, &result.origin, 1);
+	viewMatrix.transformPoints(result.corners, result.corners, 4);
+	return result;
+}
+
+/** Zbiera obiekty, wiata i kamer tak samo jak dotychczasowy cache renderera. Obiekty bez geometrii
+	(grupy, kamery, wiata punktowe) s pomijane; kolejno pozostaych decyduje o rozstrzyganiu przeci
+	w tej samej odlegoci, wic pozostaje kolejnoci grafu. Materiay i shadery trafiaj do tablic bez
+	powtrze. Zwraca false, jeli scena nie zawiera adnych obiektw.
+*/
+bool RenderScene::build(Node *root)
+{
+	clear();
+
+	NodeList	objectNodes;
+	NodeList	lightNodes;
+	NodeList	cameraNodes;
+
+	root->getObjectsArray(&objectNodes);
+	root->getNodesArray("light", &lightNodes);
+	root->getNodesArray("camera", &cameraNodes);
+
+	if(cameraNodes.size() > 0)
+		camera = getCamera(cameraNodes[0]);
+
+	std::map<Node*, unsigned int>	materialMap;
+	std::map<Shader*, unsigned int>	shaderMap;
+	std::map<Node*, int>			primitiveMap;
+
+	// Materia o indeksie 0 przypisywany jest obiektom bez materiau.
+	materials.push_back(RenderMaterial());
+	materialMap[NULL] = 0;
+
+	for(NodeList::iterator i=objectNodes.begin(); i<objectNodes.end(); i++)
+	{
+		RenderPrimitive	primitive;
+		if(!(*i)->getRenderPrimitive(&primitive))
+			continue;
+
+		Object	*object		 = (Object*)(*i);
+		Node	*material	 = object->getCachedMaterial();
+		Shader	*shader		 = object->getCachedShader();
+
+		std::map<Node*, unsigned int>::iterator m = materialMap.find(material);
+		if(m == materialMap.end())
+		{
+			RenderMaterial	data;
+			((NodeMaterial*)material)->getRenderMaterial(&data);
+			m = materialMap.insert(std::make_pair(material, (unsigned int)materials.size())).first;
+			materials.push_back(data);
+		}
+
+		std::map<Shader*, unsigned int>::iterator s = shaderMap.find(shader);
+		if(s == shaderMap.end())
+		{
+			s = shaderMap.insert(std::make_pair(shader, (unsigned int)shaders.size())).first;
+			shaders.push_back(shader);
+		}
+
+		primitive.ignore	= (*i)->ignoreIntersection();
+		primitive.material	= m->second;
+		primitive.shader	= s->second;
+		primitive.node		= (*i);
+		primitiveMap[(*i)]	= (int)primitives.size();
+		primitives.push_back(primitive);
+	}
+
+	std::map<Node*, unsigned int>	lightMap;
+	for(NodeList::iterator i=lightNodes.begin(); i<lightNodes.end(); i++)
+	{
+		NodeLight	*lightNode	= (NodeLight*)(*i);
+		int			primitive	= RenderScene::NoPrimitive;
+
+		std::map<Node*, int>::iterator p = primitiveMap.find(lightNode);
+		if(p != primitiveMap.end())
+			primitive = p->second;
+		lightMap[lightNode] = lights.size();
+		lights.push(lightNode->getCachedPosition(), lightNode->getCachedColor(), lightNode->getCachedArea(),
+					lightNode->getCachedRadius(),
+					lightNode->isAreaLight() ? RenderLightTable::LightArea : RenderLightTable::LightPoint, primitive);
+	}
+
+	// wiata shadera (env_light) jako indeksy tablicy wiate sceny, w kolejnoci mapowania.
+	shaderLights.resize(shaders.size());
+	shaderLightRows.resize(shaders.size());
+	for(unsigned int i=0; i<shaders.size(); i++)
+	{
+		shaderLightRows[i].assign(lights.size(), -1);
+		if(!shaders[i])
+			continue;
+
+		const std::vector<Node*>	&shaderLightNodes = shaders[i]->getLightNodes();
+		for(unsigned int j=0; j<shaderLightNodes.size(); j++)
+		{
+			std::map<Node*, unsigned int>::iterator l = lightMap.find(shaderLightNodes[j]);
+			if(l != lightMap.end() && shaderLightRows[i][l->second] < 0)
+			{
+				shaderLightRows[i][l->second] = (int)shaderLights[i].size();
+				shaderLights[i].push_back(l->second);
+			}
+		}
+	}
+
+	buildHierarchy();
+	buildLightHierarchy();
+	buildLightDistribution();
+	return !objectNodes.empty();
+}
+
+bool RenderScene::getBounds(const RenderPrimitive &primitive, vector3 *bounds)
+{
+	switch(primitive.type)
+	{
+	case RenderScene::PrimitiveSphere:
+		{
+			float	radius = sqrtf(primitive.scalar);
+			bounds[0] = primitive.data[0] - vector3(radius, radius, radius);
+			bounds[1] = primitive.data[0] + vector3(radius, radius, radius);
+			break;
+		}
+	case RenderScene::PrimitiveBox:
+	case RenderScene::PrimitiveAreaLight:
+		for(int i=0; i<3; i++)
+		{
+			bounds[0].cell[i] = std::min(primitive.data[0].cell[i], primitive.data[1].cell[i]);
+			bounds[1].cell[i] = std::max(primitive.data[0].cell[i], primitive.data[1].cell[i]);
+		}
+		break;
+	default:
+		return false; // Prymityw nieograniczony (paszczyzna).
+	}
+
+	// Margines pokrywa tolerancj testu prostopadocianu (MEPSILON) i bdy zaokrgle.
+	for(int i=0; i<3; i++)
+	{
+		bounds[0].cell[i] -= MEPSILON + fabsf(bounds[0].cell[i])*1.0e-5f;
+		bounds[1].cell[i] += MEPSILON + fabsf(bounds[1].cell[i])*1.0e-5f;
+	}
+	return true;
+}
+
+void RenderScene::buildHierarchy(void)
+{
+	std::vector<vector3>	centres(primitives.size());
+	std::vector<vector3>	bounds(primitives.size()*2);
+
+	for(unsigned int i=0; i<(unsigned int)primitives.size(); i++)
+	{
+		if(!getBounds(primitives[i], &bounds[i*2]))
+		{
+			unboundedPrimitives.push_back(i);
+			continue;
+		}
+		centres[i] = (bounds[i*2] + bounds[i*2+1]) * 0.5f;
+		bvhPrimitives.push_back(i);
+	}
+	if(bvhPrimitives.empty())
+		return;
+
+	bvhNodes.reserve(bvhPrimitives.size()*2);
+	buildNode(bvhNodes, bvhPrimitives, centres, bounds, 0, (unsigned int)bvhPrimitives.size());
+}
+
+void RenderScene::buildLightHierarchy(void)
+{
+	std::vector<vector3>	centres(lights.size());
+	std::vector<vector3>	bounds(lights.size()*2);
+
+	for(unsigned int i=0; i<lights.size(); i++)
+	{
+		if(!lights.getBounds(i, &bounds[i*2]))
+		{
+			unboundedLights.push_back(i);
+			continue;
+		}
+		centres[i] = (bounds[i*2] + bounds[i*2+1]) * 0.5f;
+		bvhLights.push_back(i);
+	}
+	if(bvhLights.empty())
+		return;
+
+	lightBVHNodes.reserve(bvhLights.size()*2);
+	buildNode(lightBVHNodes, bvhLights, centres, bounds, 0, (unsigned int)bvhLights.size());
+}
+
+// Moc wiata (najwiksza skadowa koloru, jak w Renderer::estimateLight); 0 dla wiate spoza shadera.
+float RenderScene::getShaderLightPower(const unsigned int shader, const unsigned int light) const
+{
+	if(shaderLightRows[shader][light] < 0)
+		return 0.0f;
+	return std::max(std::max(lights.color[0][light], lights.color[1][light]), std::max(lights.color[2][light], 0.0f));
+}
+
+/** Wze hierarchii zawiera moc swoich wiate nalecych do shadera oraz bry ich pooe i najwikszy zasig.
+	Wzy zapisywane s w preorder, wic dzieci wza wewntrznego maj wiksze indeksy i sumy liczone s od koca.
+*/
+void RenderScene::buildLightDistribution(void)
+{
+	lightClusters.resize(lightBVHNodes.size());
+	for(unsigned int n=(unsigned int)lightBVHNodes.size(); n-- > 0; )
+	{
+		const RenderBVHNode	&node		= lightBVHNodes[n];
+		RenderLightCluster	&cluster	= lightClusters[n];
+		if(node.count == 0)
+		{
+			const RenderLightCluster	&left	= lightClusters[n+1];
+			const RenderLightCluster	&right	= lightClusters[node.offset];
+			for(int k=0; k<3; k++)
+			{
+				cluster.bounds[0].cell[k] = std::min(left.bounds[0].cell[k], right.bounds[0].cell[k]);
+				cluster.bounds[1].cell[k] = std::max(left.bounds[1].cell[k], right.bounds[1].cell[k]);
+			}
+			cluster.radius	= std::max(left.radius, right.radius);
+			cluster.first	= left.first;
+			cluster.count	= left.count + right.count;
+			continue;
+		}
+
+		// Brya zasigu wiata pomniejszona o zasig to brya jego pooe.
+		cluster.first	= node.offset;
+		cluster.count	= node.count;
+		for(unsigned int i=node.offset; i<node.offset+node.count; i++)
+		{
+			vector3	bounds[2];
+			lights.getBounds(bvhLights[i], bounds);
+			const float	radius = lights.radius[bvhLights[i]];
+			for(int k=0; k<3; k++)
+			{
+				bounds[0].cell[k] += radius;
+				bounds[1].cell[k] -= radius;
+				cluster.bounds[0].cell[k] = (i == node.offset) ? bounds[0].cell[k] : std::min(cluster.bounds[0].cell[k], bounds[0].cell[k]);
+				cluster.bounds[1].cell[k] = (i == node.offset) ? bounds[1].cell[k] : std::max(cluster.bounds[1].cell[k], bounds[1].cell[k]);
+			}
+			cluster.radius = (i == node.offset) ? radius : std::max(cluster.radius, radius);
+		}
+	}
+
+	shaderNodePower.resize(shaders.size());
+	shaderUnboundedPower.resize(shaders.size());
+	for(unsigned int s=0; s<shaders.size(); s++)
+	{
+		std::vector<float>	&nodePower	= shaderNodePower[s];
+		std::vector<float>	&unbounded	= shaderUnboundedPower[s];
+		float				total		= 0.0f;
+
+		unbounded.resize(unboundedLights.size());
+		for(unsigned int i=0; i<(unsigned int)unboundedLights.size(); i++)
+		{
+			total += getShaderLightPower(s, unboundedLights[i]);
+			unbounded[i] = total;
+		}
+
+		nodePower.resize(lightBVHNodes.size());
+		for(unsigned int n=(unsigned int)lightBVHNodes.size(); n-- > 0; )
+		{
+			const RenderBVHNode	&node = lightBVHNodes[n];
+			if(node.count == 0)
+			{
+				nodePower[n] = nodePower[n+1] + nodePower[node.offset];
+				continue;
+			}
+			nodePower[n] = 0.0f;
+			for(unsigned int i=node.offset; i<node.offset+node.count; i++)
+				nodePower[n] += getShaderLightPower(s, bvhLights[i]);
+		}
+	}
+}
+
+/** Podzia po medianie rodkw wzdu najduszej osi. Zwraca indeks utworzonego wza. Wsplny dla
+	hierarchii prymityww i wiate: [items] to indeksy elementw porzdkowane podczas podziau.
+*/
+unsigned int RenderScene::buildNode(std::vector<RenderBVHNode> &nodes, std::vector<unsigned int> &items,
+									const std::vector<vector3> &centres, const std::vector<vector3> &bounds,
+									const unsigned int first, const unsigned int last)
+{
+	unsigned int	index = (unsigned int)nodes.size();
+	RenderBVHNode	node;
+	vector3			centreBounds[2];
+
+	node.bounds[0]	= bounds[items[first]*2];
+	node.bounds[1]	= bounds[items[first]*2+1];
+	centreBounds[0]	= centres[items[first]];
+	centreBounds[1]	= centreBounds[0];
+	for(unsigned int i=first+1; i<last; i++)
+	{
+		const unsigned int p = items[i];
+		for(int k=0; k<3; k++)
+		{
+			node.bounds[0].cell[k]	= std::min(node.bounds[0].cell[k], bounds[p*2].cell[k]);
+			node.bounds[1].cell[k]	= std::max(node.bounds[1].cell[k], bounds[p*2+1].cell[k]);
+			centreBounds[0].cell[k]	= std::min(centreBounds[0].cell[k], centres[p].cell[k]);
+			centreBounds[1].cell[k]	= std::max(centreBounds[1].cell[k], centres[p].cell[k]);
+		}
+	}
+
+	vector3	extent	= centreBounds[1] - centreBounds[0];
+	int		axis	= 0;
+	if(extent.y > extent.cell[axis]) axis = 1;
+	if(extent.z > extent.cell[axis]) axis = 2;
+
+	node.offset	= first;
+	node.count	= last - first;
+	nodes.push_back(node);
+	if(node.count <= RenderScene::LeafSize || extent.cell[axis] <= 0.0f)
+		return index;
+
+	const unsigned int middle = (first + last) / 2;
+	std::nth_element(items.begin()+first, items.begin()+middle, items.begin()+last, CentreOrder(&centres, axis));
+
+	buildNode(nodes, items, centres, bounds, first, middle);
+	unsigned int right = buildNode(nodes, items, centres, bounds, middle, last);
+	nodes[index].offset	= right;
+	nodes[index].count	= 0;
+	return index;
+}
+
+bool RenderScene::intersectBounds(const vector3 *bounds, const vector3 &rayOrigin, const vector3 &rayDirection,
+								  const vector3 &invDirection, const float maxDistance)
+{
+	float	tNear = -farDistance;
+	float	tFar  = maxDistance;
+
+	for(int i=0; i<3; i++)
+	{
+		if(rayDirection.cell[i] != 0.0f)
+		{
+			float	t0 = (bounds[0].cell[i] - rayOrigin.cell[i]) * invDirection.cell[i];
+			float	t1 = (bounds[1].cell[i] - rayOrigin.cell[i]) * invDirection.cell[i];
+			if(t0 > t1) { float t = t0; t0 = t1; t1 = t; }
+			if(t0 > tNear) tNear = t0;
+			if(t1 < tFar)  tFar  = t1;
+			if(tNear > tFar)
+				return false;
+		}
+		else if(rayOrigin.cell[i] < bounds[0].cell[i] || rayOrigin.cell[i] > bounds[1].cell[i])
+			return false;
+	}
+	return (tFar >= 0.0f);
+}
+
+// Prostopadocian ley w caoci po ujemnej stronie paszczyzny (dalej ni margin).
+bool RenderScene::outsidePlane(const vector3 *bounds, const vector3 &planeNormal, const vector3 &planePoint,
+							   const float margin)
+{
+	float	reach = 0.0f;
+	for(int i=0; i<3; i++)
+		reach += planeNormal.cell[i] * (bounds[planeNormal.cell[i] > 0.0f ? 1 : 0].cell[i] - planePoint.cell[i]);
+	return (reach < -margin);
+}
+
+bool RenderScene::intersect(const RenderPrimitive &primitive, const vector3 &rayOrigin, const vector3 &rayDirection,
+							float &rayDistance, int &factor, int &flag)
+{
+	switch(primitive.type)
+	{
+	// Geometryczna metoda (czasem szybsza od podejcia algebraicznego)
+	case RenderScene::PrimitiveSphere:
+		{
+			factor	   = 0;
+			flag	   = 0;
+			vector3	oc = primitive.data[0] - rayOrigin; // Wektor od pocztku promienia do rodka kuli.
+
+			float	ocSqLen	= oc.dot(oc);
+			if(ocSqLen < primitive.scalar) // Promie ma swj pocztek w rodku kuli.
+			{
+				float	t		 = oc.dot(rayDirection);
+				float	halfcord = primitive.scalar - ocSqLen + SQR(t);
+				rayDistance		 = t + sqrtf(halfcord);
+				factor			 = -1;
+			}
+			else // Promie ma swj pocztek na zewntrz kuli.
+			{
+				float	t = oc.dot(rayDirection);
+				if(t < 0.0f) return false; // Promie nie trafia w kul.
+				float	halfcord = primitive.scalar - ocSqLen + SQR(t);
+				if(halfcord < 0.0f) return false;
+				rayDistance = t - sqrtf(halfcord);
+				factor		= 1;
+			}
+			return true;
+		}
+	case RenderScene::PrimitivePlane:
+		{
+			factor		  = 0;
+			flag		  = 0;
+			float	dotND = primitive.data[0].dot(rayDirection);
+			if(dotND != 0.0f)
+			{
+				float	testDistance = -(primitive.data[0].dot(rayOrigin) + primitive.scalar) / dotND;
+				if(testDistance > 0.0f)
+				{
+					rayDistance = testDistance;
+					factor		= 1;
+					return true;
+				}
+			}
+			return false;
+		}
+	case RenderScene::PrimitiveBox:
+	case RenderScene::PrimitiveAreaLight:
+		{
+			const vector3	*dim = primitive.data;
+			float			dist[6];
+			bool			result = false;
+
+			if(primitive.type == RenderScene::PrimitiveAreaLight)
+			{
+				factor	= 0;
+				flag	= 0;
+			}
+			for(int i=0; i<6; i++)
+				dist[i] = -1.0f;
+
+			// Przecicia z trzema parami paszczyzn ("pytami").
+			if(rayDirection.x != 0.0f)
+			{
+				dist[0] = (dim[0].x - rayOrigin.x) / rayDirection.x;
+				dist[3] = (dim[1].x - rayOrigin.x) / rayDirection.x;
+			}
+			if(rayDirection.y != 0.0f)
+			{
+				dist[1] = (dim[0].y - rayOrigin.y) / rayDirection.y;
+				dist[4] = (dim[1].y - rayOrigin.y) / rayDirection.y;
+			}
+			if(rayDirection.z != 0.0f)
+			{
+				dist[2] = (dim[0].z - rayOrigin.z) / rayDirection.z;
+				dist[5] = (dim[1].z - rayOrigin.z) / rayDirection.z;
+			}
+
+			for(int i=0; i<6; i++) if(dist[i] > 0.0f)
+			{
+				// Ograniczanie punktu przecicia do wymiarw prostopadocianu.
+				vector3	intPoint = rayOrigin + dist[i]*rayDirection;
+				if((intPoint.x > (dim[0].x - MEPSILON)) && (intPoint.x < (dim[1].x + MEPSILON)) &&
+				   (intPoint.y > (dim[0].y - MEPSILON)) && (intPoint.y < (dim[1].y + MEPSILON)) &&
+				   (intPoint.z > (dim[0].z - MEPSILON)) && (intPoint.z < (dim[1].z + MEPSILON)))
+				{
+					if(dist[i] < rayDistance)
+					{
+						if(primitive.type == RenderScene::PrimitiveBox)
+						{
+							switch(i)
+							{
+							case 0: flag = NodeBox::BoxIntNegativeX; break;
+							case 3: flag = NodeBox::BoxIntPositiveX; break;
+							case 1: flag = NodeBox::BoxIntNegativeY; break;
+							case 4: flag = NodeBox::BoxIntPositiveY; break;
+							case 2: flag = NodeBox::BoxIntNegativeZ; break;
+							case 5: flag = NodeBox::BoxIntPositiveZ; break;
+							}
+						}
+						rayDistance = dist[i];
+						result		= true;
+						factor		= 1;
+					}
+				}
+			}
+			return result;
+		}
+	}
+	return false;
+}
+
+vector3 RenderScene::getNormal(const RenderPrimitive &primitive, const vector3 &intPoint, const int intersectFlag)
+{
+	switch(primitive.type)
+	{
+	case RenderScene::PrimitiveSphere:
+		return (intPoint - primitive.data[0]).getNormalized();
+	case RenderScene::PrimitivePlane:
+		return primitive.data[0];
+	case RenderScene::PrimitiveBox:
+		switch(intersectFlag)
+		{
+		case NodeBox::BoxIntNegativeX:	return vector3(-1.0f, 0.0f, 0.0f);
+		case NodeBox::BoxIntNegativeY:	return vector3(0.0f, -1.0f, 0.0f);
+		case NodeBox::BoxIntNegativeZ:	return vector3(0.0f, 0.0f, -1.0f);
+		case NodeBox::BoxIntPositiveX:	return vector3(1.0f, 0.0f, 0.0f);
+		case NodeBox::BoxIntPositiveY:	return vector3(0.0f, 1.0f, 0.0f);
+		case NodeBox::BoxIntPositiveZ:	return vector3(0.0f, 0.0f, 1.0f);
+		}
+		break;
+	}
+	return vector3();
+}
+
+void RenderScene::testPrimitive(const unsigned int index, const vector3 &rayOrigin, const vector3 &rayDirection,
+								float &rayDistance, int &hitPrimitive, int &hitFactor, int &hitFlag, const int force) const
+{
+	const RenderPrimitive	&primitive = primitives[index];
+	float					testDistance = farDistance;
+	int						testFactor, testFlag;
+
+	if(primitive.ignore && (int)index != force)
+		return;
+	if(!intersect(primitive, rayOrigin, rayDirection, testDistance, testFactor, testFlag))
+		return;
+	if(testDistance < rayDistance ||
+	  (testDistance == rayDistance && hitPrimitive != RenderScene::NoPrimitive && (int)index < hitPrimitive))
+	{
+		hitPrimitive = (int)index;
+		hitFactor	 = testFactor;
+		hitFlag		 = testFlag;
+		rayDistance	 = testDistance;
+	}
+}
+
+/** Zwraca wiata, ktre mog owietli punkt o zadanej normalnej: wszystkie wiata o nieograniczonym
+	zasigu oraz te, ktrych zasig obejmuje punkt. Pomijane s wzy hierarchii lece w caoci za
+	paszczyzn styczn. Lista jest nadmiarowa - dokadny test zasigu wykonuje getAttenuation().
+*/
+void RenderScene::findLights(const vector3 &point, const vector3 &normal, std::vector<unsigned int> &result) const
+{
+	unsigned int	stack[RenderScene::StackSize];
+	unsigned int	stackSize = 0;
+
+	result.assign(unboundedLights.begin(), unboundedLights.end());
+	if(lightBVHNodes.empty())
+		return;
+
+	stack[stackSize++] = 0;
+	while(stackSize > 0)
+	{
+		const RenderBVHNode	&node	= lightBVHNodes[stack[--stackSize]];
+		float				reach	= 0.0f;
+		bool				inside	= true;
+		for(int i=0; i<3; i++)
+		{
+			if(point.cell[i] < node.bounds[0].cell[i] || point.cell[i] > node.bounds[1].cell[i])
+				inside = false;
+			reach += normal.cell[i] * (node.bounds[normal.cell[i] > 0.0f ? 1 : 0].cell[i] - point.cell[i]);
+		}
+		if(!inside || reach <= 0.0f)
+			continue;
+
+		if(node.count > 0)
+			result.insert(result.end(), bvhLights.begin()+node.offset, bvhLights.begin()+node.offset+node.count);
+		else
+		{
+			stack[stackSize++] = node.offset;
+			stack[stackSize++] = (unsigned int)(&node - &lightBVHNodes[0]) + 1;
+		}
+	}
+}
+
+/** Waga wiata licia przy losowaniu: moc razy osabienie i kosinus kta padania (jak Renderer::estimateLight).
+	wiato za paszczyzn normalnej nie owietla punktu i ma wag 0.
+*/
+float RenderScene::getLightWeight(const unsigned int shader, const unsigned int light, const vector3 &point,
+								  const vector3 &normal) const
+{
+	const float	power	= getShaderLightPower(shader, light);
+	if(power <= 0.0f)
+		return 0.0f;
+
+	const vector3	lightDir	= lights.getPosition(light) - point;
+	const float		cosine		= normal.dot(lightDir);
+	if(cosine <= 0.0f)
+		return 0.0f;
+	return power * lights.getAttenuation(light, point) * cosine / lightDir.length();
+}
+
+/** Waga wza hierarchii przy losowaniu: moc jego wiate shadera razy ograniczenie osabienia wiata
+	najbliszego punktowi (odlego od bryy pooe, najwikszy zasig). Wze, ktrego brya zasigu nie
+	obejmuje punktu lub ley za paszczyzn normalnej (jak w findLights), ma wag 0.
+*/
+float RenderScene::getNodeWeight(const unsigned int shader, const unsigned int node, const vector3 &point,
+								 const vector3 &normal) const
+{
+	const RenderBVHNode			&bvhNode	= lightBVHNodes[node];
+	const RenderLightCluster	&cluster	= lightClusters[node];
+	const float					power		= shaderNodePower[shader][node];
+	float						reach		= 0.0f;
+	float						sqDistance	= 0.0f;
+	if(power <= 0.0f)
+		return 0.0f;
+
+	for(int i=0; i<3; i++)
+	{
+		if(point.cell[i] < bvhNode.bounds[0].cell[i] || point.cell[i] > bvhNode.bounds[1].cell[i])
+			return 0.0f;
+		reach += normal.cell[i] * (bvhNode.bounds[normal.cell[i] > 0.0f ? 1 : 0].cell[i] - point.cell[i]);
+
+		const float	outside = std::max(cluster.bounds[0].cell[i] - point.cell[i], point.cell[i] - cluster.bounds[1].cell[i]);
+		if(outside > 0.0f)
+			sqDistance += SQR(outside);
+	}
+	if(reach <= 0.0f)
+		return 0.0f;
+
+	const float	ratio = sqDistance / SQR(cluster.radius);
+	if(ratio >= 1.0f)
+		return 0.0f;
+	return power * SQR(1.0f - ratio);
+}
+
+/** Losuje wiato shadera dla punktu [point] i zwraca prawdopodobiestwo jego wyboru (0, jeli adne
+	wiato nie moe owietli punktu). [u] to liczba losowa z [0, 1). wiata nieograniczone wybierane s
+	proporcjonalnie do mocy, wiata hierarchii - schodzc od korzenia do dziecka proporcjonalnie do jego wagi
+	(getNodeWeight) a do poddrzewa o najwyej ClusterSize wiatach, a w nim proporcjonalnie do getLightWeight.
+	Ta sama liczba [u], przeskalowana, wybiera kolejne gazie. Koszt nie zaley od liczby wiate, jedynie
+	od gbokoci hierarchii i ClusterSize.
+*/
+float RenderScene::sampleLight(const unsigned int shader, const vector3 &point, const vector3 &normal, const float u,
+							   unsigned int &light) const
+{
+	const std::vector<float>	&unbounded	= shaderUnboundedPower[shader];
+	const float	unboundedTotal	= unbounded.empty() ? 0.0f : unbounded.back();
+	const float	boundedTotal	= lightBVHNodes.empty() ? 0.0f : getNodeWeight(shader, 0, point, normal);
+	const float	total			= unboundedTotal + boundedTotal;
+	if(total <= 0.0f)
+		return 0.0f;
+
+	float	x = std::min(u, 1.0f) * total;
+	if(x < unboundedTotal || boundedTotal <= 0.0f)
+	{
+		unsigned int c = (unsigned int)(std::upper_bound(unbounded.begin(), unbounded.end(), x) - unbounded.begin());
+		if(c >= (unsigned int)unbounded.size())
+			c = (unsigned int)unbounded.size()-1;
+		light = unboundedLights[c];
+		return (unbounded[c] - (c > 0 ? unbounded[c-1] : 0.0f)) / total;
+	}
+
+	// x przeskalowane do [0, weight) wybranej gazi.
+	float			probability	= boundedTotal / total;
+	float			weight		= boundedTotal;
+	unsigned int	index		= 0;
+	x = std::min(x - unboundedTotal, boundedTotal);
+	while(lightClusters[index].count > RenderScene::ClusterSize && lightBVHNodes[index].count == 0)
+	{
+		const unsigned int	child[2]	= { index+1, lightBVHNodes[index].offset };
+		float				power[2];
+		for(int k=0; k<2; k++)
+			power[k] = getNodeWeight(shader, child[k], point, normal);
+
+		const float	sum = power[0] + power[1];
+		if(sum <= 0.0f)
+			return 0.0f;
+		x = x / weight * sum;
+
+		const int	k = (x < power[0] || power[1] <= 0.0f) ? 0 : 1;
+		if(k == 1)
+			x -= power[0];
+		probability	*= power[k] / sum;
+		weight		= power[k];
+		index		= child[k];
+	}
+
+	// Poddrzewo moe przekracza ClusterSize (wiate o wsplnym rodku nie da si podzieli), wic wagi liczone
+	// s dwukrotnie zamiast w tablicy.
+	const RenderLightCluster	&leaf	= lightClusters[index];
+	float						sum		= 0.0f;
+	for(unsigned int i=leaf.first; i<leaf.first+leaf.count; i++)
+		sum += getLightWeight(shader, bvhLights[i], point, normal);
+	if(sum <= 0.0f)
+		return 0.0f;
+	x = x / weight * sum;
+
+	float	chosen = 0.0f;
+	for(unsigned int i=leaf.first; i<leaf.first+leaf.count; i++)
+	{
+		const float power = getLightWeight(shader, bvhLights[i], point, normal);
+		if(power <= 0.0f)
+			continue;
+		light	= bvhLights[i];
+		chosen	= power;
+		if(x < power)
+			break;
+		x -= power;
+	}
+	return probability * chosen / sum;
+}
+
+/** Test widocznoci pakietu prbek wiata powierzchniowego [light] z punktu [apex]; [corners] to naroniki
+	prostokta wiata. Promie jest widoczny (RenderShadowPacket::isVisible), gdy findNearestIntersection
+	z wymuszonym wiatem zwrciby prymityw wiata: trafia wiato i aden inny prymityw nie ley bliej
+	(przy rwnej odlegoci - prymityw o niszym indeksie).
+	Wachlarz promieni ograniczony jest ostrosupem o wierzchoku [apex] i podstawie w prostokcie wiata
+	oraz prostopadocianem otaczajcym odcinki promieni. Hierarchia i paszczyzny odrzucane s wzgldem tej
+	bryy raz dla caego pakietu, a pozostae prymitywy testowane s ze wszystkimi promieniami jdrem
+	KernelTable::occludePacket. Marginesy odrzucania pokrywaj bdy zaokrgle, wic wynik jest identyczny
+	z testem pojedynczych promieni.
+*/
+void RenderScene::traceShadowPacket(RenderShadowPacket &packet, const vector3 &apex, const vector3 *corners, const int light) const
+{
+	const unsigned int	count	= packet.size();
+	unsigned int		active	= 0;
+	int					factor, flag;
+
+	// Trafienie w wiato wyznacza koniec odcinka kadego promienia.
+	packet.primitives.clear();
+	for(unsigned int r=0; r<count; r++)
+	{
+		float	distance = farDistance;
+		packet.limit[r]	 = -1.0f;
+		if(light != RenderScene::NoPrimitive &&
+		   intersect(primitives[light], packet.getOrigin(r), packet.getDirection(r), distance, factor, flag) &&
+		   distance < packet.distance[r])
+		{
+			packet.limit[r] = distance;
+			active++;
+		}
+	}
+	if(active == 0)
+		return;
+
+	// Prostopadocian otaczajcy odcinki promieni.
+	vector3	box[2]	= { apex, apex };
+	float	scale	= 0.0f;
+	for(unsigned int r=0; r<count; r++) if(packet.isVisible(r))
+	{
+		vector3	ends[2] = { packet.getOrigin(r), packet.getOrigin(r) + packet.getDirection(r)*packet.limit[r] };
+		for(int e=0; e<2; e++) for(int i=0; i<3; i++)
+		{
+			box[0].cell[i] = std::min(box[0].cell[i], ends[e].cell[i]);
+			box[1].cell[i] = std::max(box[1].cell[i], ends[e].cell[i]);
+		}
+	}
+	for(int i=0; i<3; i++)
+		scale = std::max(scale, std::max(fabsf(box[0].cell[i]), fabsf(box[1].cell[i])));
+
+	const float	margin = MEPSILON + scale*1.0e-5f;
+	for(int i=0; i<3; i++)
+	{
+		box[0].cell[i] -= margin;
+		box[1].cell[i] += margin;
+	}
+
+	// Boczne paszczyzny ostrosupa (normalne skierowane do rodka). Przy wierzchoku lecym blisko
+	// paszczyzny wiata ostrosup jest zdegenerowany i odrzucanie korzysta tylko z prostopadocianu.
+	vector3			planes[4];
+	unsigned int	planeCount	= 0;
+	const vector3	centre		= (corners[0] + corners[2]) * 0.5f;
+	for(int i=0; i<4; i++)
+	{
+		vector3	normal	= (corners[i] - apex).cross(corners[(i+1)%4] - apex);
+		float	length	= normal.length();
+		if(length == 0.0f)
+		{ planeCount = 0; break; }
+		normal /= length;
+
+		float	side	= normal.dot(centre - apex);
+		if(fabsf(side) <= margin)
+		{ planeCount = 0; break; }
+		planes[planeCount++] = (side > 0.0f) ? normal : -normal;
+	}
+
+	// Paszczyzny sceny odrzucane s, gdy wszystkie odcinki promieni le po jednej ich stronie.
+	for(unsigned int i=0; i<(unsigned int)unboundedPrimitives.size(); i++)
+	{
+		const RenderPrimitive	&primitive	= primitives[unboundedPrimitives[i]];
+		int						sides		= 0;
+		if(primitive.type == RenderScene::PrimitivePlane)
+		{
+			for(unsigned int r=0; r<count && sides != 3; r++) if(packet.isVisible(r))
+			{
+				vector3	ends[2] = { packet.getOrigin(r), packet.getOrigin(r) + packet.getDirection(r)*packet.limit[r] };
+				for(int e=0; e<2; e++)
+				{
+					float	side = primitive.data[0].dot(ends[e]) + primitive.scalar;
+					sides |= (side > margin) ? 1 : (side < -margin) ? 2 : 3;
+				}
+			}
+		}
+		else
+			sides = 3;
+		if(sides == 3)
+			packet.primitives.push_back(unboundedPrimitives[i]);
+	}
+
+	if(!bvhNodes.empty())
+	{
+		unsigned int	stack[RenderScene::StackSize];
+		unsigned int	stackSize = 0;
+
+		stack[stackSize++] = 0;
+		while(stackSize > 0)
+		{
+			const RenderBVHNode	&node	= bvhNodes[stack[--stackSize]];
+			bool				inside	= true;
+			for(int i=0; i<3 && inside; i++)
+			{
+				if(node.bounds[1].cell[i] < box[0].cell[i] || node.bounds[0].cell[i] > box[1].cell[i])
+					inside = false;
+			}
+			for(unsigned int p=0; p<planeCount && inside; p++)
+			{
+				if(outsidePlane(node.bounds, planes[p], apex, margin))
+					inside = false;
+			}
+			if(!inside)
+				continue;
+
+			if(node.count > 0)
+				packet.primitives.insert(packet.primitives.end(), bvhPrimitives.begin()+node.offset,
+										 bvhPrimitives.begin()+node.offset+node.count);
+			else
+			{
+				stack[stackSize++] = node.offset;
+				stack[stackSize++] = (unsigned int)(&node - &bvhNodes[0]) + 1;
+			}
+		}
+	}
+
+	// Pozostae prymitywy ze wszystkimi promieniami pakietu.
+	const KernelTable	&kernels = Kernels::get();
+	for(unsigned int i=0; i<(unsigned int)packet.primitives.size() && active > 0; i++)
+	{
+		const unsigned int		index		= packet.primitives[i];
+		const RenderPrimitive	&primitive	= primitives[index];
+		if((int)index == light || primitive.ignore)
+			continue;
+		active = kernels.occludePacket(&packet, primitive, (int)index < light);
+	}
+}
+
+/** Wynik nie zaley od kolejnoci odwiedzania prymityww: wygrywa najblisze przecicie, a przy rwnych
+	odlegociach prymityw o najniszym indeksie (jak w ptli po obiektach w kolejnoci grafu).
+	Prymitywy pomijane (wiata powierzchniowe) testowane s tylko, gdy wskazuje je [force].
+*/
+int RenderScene::findNearestIntersection(const vector3 &rayOrigin, const vector3 &rayDirection, float &rayDistance,
+										 int &hitFactor, int &hitFlag, const int force) const
+{
+	int				hitPrimitive = RenderScene::NoPrimitive;
+	unsigned int	stack[RenderScene::StackSize];
+	unsigned int	stackSize	 = 0;
+
+	for(unsigned int i=0; i<(unsigned int)unboundedPrimitives.size(); i++)
+		testPrimitive(unboundedPrimitives[i], rayOrigin, rayDirection, rayDistance, hitPrimitive, hitFactor, hitFlag, force);
+	if(bvhNodes.empty())
+		return hitPrimitive;
+
+	vector3	invDirection;
+	for(int i=0; i<3; i++)
+		invDirection.cell[i] = (rayDirection.cell[i] != 0.0f) ? 1.0f / rayDirection.cell[i] : 0.0f;
+
+	stack[stackSize++] = 0;
+	while(stackSize > 0)
+	{
+		const RenderBVHNode	&node = bvhNodes[stack[--stackSize]];
+		if(!intersectBounds(node.bounds, rayOrigin, rayDirection, invDirection, rayDistance))
+			continue;
+
+		if(node.count > 0)
+		{
+			for(unsigned int i=node.offset; i<node.offset+node.count; i++)
+				testPrimitive(bvhPrimitives[i], rayOrigin, rayDirection, rayDistance, hitPrimitive, hitFactor, hitFlag, force);
+		}
+		else
+		{
+			// Lewy potomek odwiedzany jest jako pierwszy.
+			stack[stackSize++] = node.offset;
+			stack[stackSize++] = (unsigned int)(&node - &bvhNodes[0]) + 1;
+		}
+	}
+	return hitPrimitive;
+}
+
+int RenderScene::findAnyIntersection(const vector3 &rayOrigin, const vector3 &rayDirection, float &rayDistance,
+									 int &hitFactor, int &hitFlag, const int force) const
+{
+	int		testFactor, testFlag;
+
+	const unsigned int count = (unsigned int)primitives.size();
+	for(unsigned int i=0; i<count; i++)
+	{
+		if(primitives[i].ignore && (int)i != force)
+			continue;
+		if(intersect(primitives[i], rayOrigin, rayDirection, rayDistance, testFactor, testFlag))
+		{
+			hitFactor	= testFactor;
+			hitFlag		= testFlag;
+			return (int)i;
+		}
+	}
+	return RenderScene::NoPrimitive;
+}
\ No newline at end of file
@@ -0,0 +1,282 @@
+/*
+	This file is part of EX-Ray Raytracing Engine.
+	(C)2007 - 2008 Micha Siejak.
+
+    EX-Ray is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EX-Ray is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with EX-Ray.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __RENDER_SCENE_H
+#define __RENDER_SCENE_H
+
+namespace exRay {
+
+class Node;
+class Shader;
+
+/// Prymityw sceny renderowania.
+/** Kopia geometrii obiektu w przestrzeni wiata. Znaczenie pl zaley od typu:
+	kula - data[0] rodek, scalar kwadrat promienia; paszczyzna - data[0] normalna, scalar odlego;
+	prostopadocian i wiato powierzchniowe - data[0], data[1] naroniki.
+*/
+class RenderPrimitive
+{
+public:
+	int				type;
+	bool			ignore;		// Testowany tylko jawnie (wiato powierzchniowe w tecie cienia)
+	unsigned int	material;
+	unsigned int	shader;
+	vector3			data[2];
+	float			scalar;
+	Node*			node;		// Wze rdowy - wycznie do identyfikacji, renderer go nie odczytuje
+};
+
+/// Tablica wiate sceny renderowania.
+/** Skadowe wiate przechowywane s w osobnych tablicach (SoA), wsplnych dla ledzenia promieni cienia
+	i cieniowania. Shadery odwouj si do wiate wycznie przez listy indeksw tej tablicy
+	(RenderScene::getShaderLights).
+	wiata o ograniczonym zasigu wygaszane s oknem (1 - d^2/r^2)^2, gdzie d to odlego od najbliszego
+	punktu wiata; poza zasigiem ich wkad jest zerowy.
+*/
+class RenderLightTable
+{
+public:
+	std::vector<float>	position[3];
+	std::vector<float>	color[3];
+	std::vector<float>	area[2];	// Wymiary wiata powierzchniowego w paszczynie XZ
+	std::vector<float>	radius;		// Zasig wiata (0 - nieograniczony)
+	std::vector<int>	type;
+	std::vector<int>	primitive;	// Prymityw wiata powierzchniowego (test widocznoci)
+
+	void			push(const vector3 &lightPosition, const vector3 &lightColor, const vector2 &lightArea,
+						 const float lightRadius, const int lightType, const int lightPrimitive);
+	void			clear(void);
+	bool			getBounds(const unsigned int index, vector3 *bounds) const;
+	float			getAttenuation(const unsigned int index, const vector3 &point) const;
+	unsigned int	size(void) const
+	{ return (unsigned int)type.size(); }
+	vector3			getPosition(const unsigned int index) const
+	{ return vector3(position[0][index], position[1][index], position[2][index]); }
+
+	enum
+	{
+		// Typy wiate.
+		LightPoint = 0,
+		LightArea,
+	};
+};
+
+/// Pakiet promieni cienia o wsplnym pocztku (prbki wiata powierzchniowego).
+/** Promienie przechowywane s w osobnych tablicach (SoA), dziki czemu jdro przesaniania
+	(KernelTable::occludePacket) testuje prymityw z kilkoma promieniami naraz. limit to odlego trafienia
+	w wiato; promie przesonity lub niesigajcy wiata ma limit ujemny. Lista primitives zawiera
+	prymitywy, ktre przeszy odrzucanie bry pakietu (RenderScene::traceShadowPacket).
+	Pakiet naley do renderera i jest uywany ponownie bez zwalniania pamici.
+*/
+class RenderShadowPacket
+{
+public:
+	std::vector<float>			origin[3];
+	std::vector<float>			direction[3];
+	std::vector<float>			distance;	// Odlego do prbki wiata
+	std::vector<float>			limit;
+	std::vector<unsigned int>	primitives;
+
+	void			push(const vector3 &rayOrigin, const vector3 &rayDirection, const float rayDistance);
+	void			clear(void);
+	unsigned int	size(void) const
+	{ return (unsigned int)distance.size(); }
+	bool			isVisible(const unsigned int index) const
+	{ return limit[index] >= 0.0f; }
+	vector3			getOrigin(const unsigned int index) const
+	{ return vector3(origin[0][index], origin[1][index], origin[2][index]); }
+	vector3			getDirection(const unsigned int index) const
+	{ return vector3(direction[0][index], direction[1][index], direction[2][index]); }
+};
+
+/// Materia sceny renderowania.
+/** Zestaw cech (features) ustalany jest przy budowie sceny i wybiera wyspecjalizowane warianty ledzenia
+	i cieniowania trafie materiau; materia wycznie rozpraszajcy nie paci za pozostae skadowe.
+*/
+class RenderMaterial
+{
+public:
+	vector3			color;
+	float			diffuse;
+	float			specular;
+	float			specularExponent;
+	float			reflectance;
+	float			refraction;
+	float			density;
+	unsigned int	features;
+
+	// Materia domylny: czarny, bez owietlenia, wycznie rozpraszajcy.
+	RenderMaterial(void) : color(), diffuse(0.0f), specular(0.0f), specularExponent(0.0f), reflectance(0.0f),
+						   refraction(0.0f), density(0.0f), features(FeatureDiffuse)
+	{ }
+
+	enum
+	{
+		// Cechy materiau (maska bitowa).
+		FeatureDiffuse		= 0,
+		FeatureSpecular		= 1,
+		FeatureReflection	= 2,
+		FeatureRefraction	= 4,
+		FeatureSets			= 8,	// Liczba moliwych zestaww cech
+		ShadingFeatures		= FeatureSpecular,	// Cechy, od ktrych zaley owietlenie bezporednie
+	};
+};
+
+/// Kamera sceny renderowania (rodek rzutowania i naroniki ekranu w przestrzeni wiata).
+class RenderCamera
+{
+public:
+	vector3			origin;
+	vector3			corners[4];
+};
+
+/// Wze hierarchii bry otaczajcych (BVH) sceny renderowania.
+/** Wze wewntrzny ma count == 0; jego lewy potomek ley bezporednio za nim, prawy pod indeksem offset.
+	Li obejmuje count kolejnych indeksw prymityww poczwszy od offset.
+*/
+class RenderBVHNode
+{
+public:
+	vector3			bounds[2];
+	unsigned int	offset;
+	unsigned int	count;
+};
+
+/// wiata wza hierarchii wiate: brya ich pooe (z powierzchni wiate powierzchniowych), najwikszy zasig
+/// oraz zakres poddrzewa w RenderScene::bvhLights.
+class RenderLightCluster
+{
+public:
+	vector3			bounds[2];
+	float			radius;
+	unsigned int	first;
+	unsigned int	count;
+};
+
+/// Niezmienna, spaszczona scena renderowania.
+/** Tworzona jednorazowo z grafu sceny (po jego zbuforowaniu) i wspdzielona przez wszystkie renderery
+	wycznie do odczytu. Przechowuje tablice prymityww, wiate, materiaw i shaderw oraz kamer, dziki
+	czemu renderowanie nie odwouje si do wzw grafu, ktry pozostaje edytowalny. Zmiany grafu wymagaj
+	ponownego zbudowania sceny.
+	Prymitywy ograniczone zebrane s w hierarchi bry otaczajcych budowan razem ze scen; paszczyzny
+	testowane s osobno. Podobn hierarchi maj wiata o ograniczonym zasigu (findLights). Wzy tej
+	hierarchii przechowuj te moc wiate kadego shadera, co pozwala losowa wiato trafienia (sampleLight)
+	kosztem zalenym od gbokoci hierarchii, a nie od liczby wiate.
+*/
+class RenderScene
+{
+private:
+	std::vector<RenderPrimitive>	primitives;
+	RenderLightTable				lights;
+	std::vector< std::vector<unsigned int> >	shaderLights;
+	std::vector< std::vector<int> >				shaderLightRows;	// Wiersz wiata w kolejce shadera lub -1
+	std::vector<RenderMaterial>		materials;
+	std::vector<Shader*>			shaders;
+	RenderCamera					camera;
+
+	std::vector<RenderBVHNode>		bvhNodes;
+	std::vector<unsigned int>		bvhPrimitives;
+	std::vector<unsigned int>		unboundedPrimitives;
+
+	std::vector<RenderBVHNode>		lightBVHNodes;
+	std::vector<unsigned int>		bvhLights;
+	std::vector<unsigned int>		unboundedLights;
+
+	// Rozkad losowania wiate shadera (sampleLight): pooenie i zasig wiate wzw hierarchii, moc wiate
+	// shadera w wzach oraz dystrybuanta mocy wiate nieograniczonych.
+	std::vector<RenderLightCluster>		lightClusters;
+	std::vector< std::vector<float> >	shaderNodePower;
+	std::vector< std::vector<float> >	shaderUnboundedPower;
+private:
+	RenderScene(const RenderScene&);
+	RenderScene& operator=(const RenderScene&);
+
+	void			buildHierarchy(void);
+	void			buildLightHierarchy(void);
+	void			buildLightDistribution(void);
+	float			getShaderLightPower(const unsigned int shader, const unsigned int light) const;
+	float			getLightWeight(const unsigned int shader, const unsigned int light, const vector3 &point,
+								   const vector3 &normal) const;
+	float			getNodeWeight(const unsigned int shader, const unsigned int node, const vector3 &point,
+								  const vector3 &normal) const;
+	static unsigned int	buildNode(std::vector<RenderBVHNode> &nodes, std::vector<unsigned int> &items,
+								  const std::vector<vector3> &centres, const std::vector<vector3> &bounds,
+								  const unsigned int first, const unsigned int last);
+	static bool		getBounds(const RenderPrimitive &primitive, vector3 *bounds);
+	static bool		intersectBounds(const vector3 *bounds, const vector3 &rayOrigin, const vector3 &rayDirection,
+									const vector3 &invDirection, const float maxDistance);
+	static bool		outsidePlane(const vector3 *bounds, const vector3 &planeNormal, const vector3 &planePoint,
+								 const float margin);
+	void			testPrimitive(const unsigned int index, const vector3 &rayOrigin, const vector3 &rayDirection,
+								  float &rayDistance, int &hitPrimitive, int &hitFactor, int &hitFlag, const int force) const;
+public:
+	RenderScene(void);
+	~RenderScene(void);
+
+	bool	build(Node *root);
+	void	clear(void);
+
+	static RenderCamera	getCamera(Node *camNode);
+
+	unsigned int			getPrimitiveCount(void) const	{ return (unsigned int)primitives.size();	}
+	unsigned int			getLightCount(void) const		{ return (unsigned int)lights.size();		}
+	unsigned int			getShaderCount(void) const		{ return (unsigned int)shaders.size();		}
+	unsigned int			getHierarchySize(void) const	{ return (unsigned int)bvhNodes.size();		}
+	unsigned int			getLightHierarchySize(void) const	{ return (unsigned int)lightBVHNodes.size();	}
+	const RenderPrimitive&	getPrimitive(const unsigned int index) const	{ return primitives[index];	}
+	const RenderLightTable&	getLights(void) const							{ return lights;			}
+	const std::vector<unsigned int>&	getShaderLights(const unsigned int shader) const	{ return shaderLights[shader];	}
+	int						getShaderLightRow(const unsigned int shader, const unsigned int light) const
+	{ return shaderLightRows[shader][light]; }
+	const RenderMaterial&	getMaterial(const unsigned int index) const		{ return materials[index];	}
+	Shader*					getShader(const unsigned int index) const		{ return shaders[index];	}
+	const RenderCamera&		getCamera(void) const							{ return camera;			}
+
+	int		findNearestIntersection(const vector3 &rayOrigin, const vector3 &rayDirection, float &rayDistance,
+									int &hitFactor, int &hitFlag, const int force=RenderScene::NoPrimitive) const;
+	int		findAnyIntersection(const vector3 &rayOrigin, const vector3 &rayDirection, float &rayDistance,
+								int &hitFactor, int &hitFlag, const int force=RenderScene::NoPrimitive) const;
+	void	findLights(const vector3 &point, const vector3 &normal, std::vector<unsigned int> &result) const;
+	float	sampleLight(const unsigned int shader, const vector3 &point, const vector3 &normal, const float u,
+						unsigned int &light) const;
+	void	traceShadowPacket(RenderShadowPacket &packet, const vector3 &apex, const vector3 *corners, const int light) const;
+
+	static bool		intersect(const RenderPrimitive &primitive, const vector3 &rayOrigin, const vector3 &rayDirection,
+							  float &rayDistance, int &factor, int &flag);
+	static vector3	getNormal(const RenderPrimitive &primitive, const vector3 &intPoint, const int intersectFlag);
+
+	enum
+	{
+		NoPrimitive	= -1,
+
+		// Hierarchia bry otaczajcych.
+		LeafSize	= 4,	// Maksymalna liczba prymityww w liciu
+		StackSize	= 64,	// Gboko stosu przejcia (podzia po medianie daje gboko log2(n))
+		ClusterSize	= 16,	// Liczba wiate poddrzewa, wrd ktrych sampleLight losuje dokadnie
+
+		// Typy prymityww.
+		PrimitiveSphere = 0,
+		PrimitivePlane,
+		PrimitiveBox,
+		PrimitiveAreaLight,
+	};
+};
+
+} // exRay
+
+#endif
\ No newline at end of file
@@ -17,15 +17,17 @@
 */
 
 #include "../Config.h"
+#include <algorithm>
 #include "../Types/Image.h"
+#include "../Types/ImageHDR.h"
 #include "Renderer.h"
 
 #include "../Graph/Variable.h"
 #include "../Graph/Node.h"
 #include "../Graph/Object.h"
-#include "../Graph/NodeMaterial.h"
 #include "../Graph/NodeLight.h"
 #include "../Types/Shader.h"
+#include "RenderScene.h"
 
 using namespace exRay;
 
@@ -34,32 +36,24 @@ int Renderer::instanceCount = 0;
 Renderer::Renderer(Image *newBuffer, Node *newRoot, unsigned int depth)
 {
 	frameBuffer			= newBuffer;
+	hdrBuffer			= NULL;
+	lineBuffer			= NULL;
+	if(frameBuffer)
+		lineBuffer		= new float[frameBuffer->getWidth()*3];
 	rootNode			= newRoot;
+	scene				= NULL;
+	shadowPacket		= new RenderShadowPacket();
 
-	lastHitNode[0]		= NULL;
-	lastHitNode[1]		= NULL;
+	lastHitNode			= NULL;
 	lastRenderedNode	= NULL;
 
-	cacheNodes			= NULL;
-	cacheSize			= 0;
-	cacheLights			= NULL;
-	cacheLightsSize		= 0;
-
 	primaryRays			= 0;
 	secondaryRays		= 0;
 
-	cacheShader			= new ShaderUniforms*[depth+1];
-	cacheLightVisibility= new float*[depth+1];
-	for(unsigned int i=0; i<=depth; i++)
-	{
-		cacheLightVisibility[i] = NULL;
-		cacheShader[i]			= new ShaderUniforms;
-	}
-
 	params[TraceDepth]	= depth;
 
 	NodeCamera	defaultCamera("", NULL);
-	applyCamera(&defaultCamera);
+	applyCamera(RenderScene::getCamera(&defaultCamera));
 
 	id = ++instanceCount;
 	setDefaultParameters();
@@ -67,25 +61,10 @@ Renderer::Renderer(Image *newBuffer, Node *newRoot, unsigned int depth)
 
 Renderer::~Renderer(void)
 {
-	if(cacheShader)
-	{
-		for(unsigned int i=0; i<(unsigned int)params[TraceDepth]; i++)
-			delete cacheShader[i];
-		delete[] cacheShader;
-	}
-	if(cacheNodes)
-		delete[] cacheNodes;
-	if(cacheLights)
-		delete[] cacheLights;
-	if(cacheLightVisibility)
-	{
-		for(unsigned int i=0; i<(unsigned int)params[TraceDepth]; i++)
-		{
-			if(cacheLightVisibility[i])
-				delete[] cacheLightVisibility[i];
-		}
-		delete[] cacheLightVisibility;
-	}
+	if(lineBuffer)
+		delete[] lineBuffer;
+	delete shadowPacket;
+	freeShadingQueues();
 }
 
 void Renderer::setDefaultParameters(void)
@@ -94,26 +73,40 @@ void Renderer::setDefaultParameters(void)
 	params[ShadowSampling]	=	MonteCarlo;
 	params[RenderSamples]	=	1;
 	params[ShadowSamples]	=	8;
+	params[LightSamples]	=	0;
 
 	paramsf[EnvRIndex]		= 1.0f;
+	paramsf[LightThreshold]	= 0.0f;
 }
 
 Node* Renderer::getRootNode(void) const
 { return rootNode; }
 
+const RenderScene* Renderer::getScene(void) const
+{ return scene; }
+
 Node* Renderer::getLastHitNode(void) const
-{ return lastHitNode[0]; }
+{ return lastHitNode ? lastHitNode->node : NULL; }
 
 Image* Renderer::getFramebuffer(void) const
 { return frameBuffer; }
 
 void Renderer::setFramebuffer(Image *buffer)
 { 
+	if(lineBuffer)
+		delete[] lineBuffer;
 	frameBuffer		= buffer;
+	lineBuffer		= new float[frameBuffer->getWidth()*3];
 	camDelta[0]		= (camPosition[1] - camPosition[0]) / float(frameBuffer->getWidth());
 	camDelta[1]		= (camPosition[3] - camPosition[0]) / float(frameBuffer->getHeight());
 }
 
+ImageHDR* Renderer::getHDRFramebuffer(void) const
+{ return hdrBuffer; }
+
+void Renderer::setHDRFramebuffer(ImageHDR *buffer)
+{ hdrBuffer = buffer; }
+
 void Renderer::setParameter(const int id, const int value)
 { params[id] = value; }
 
@@ -138,26 +131,13 @@ void Renderer::resetRayCounters(void)
 	secondaryRays	= 0;
 }
 
-void Renderer::applyCamera(Node *camNode)
+void Renderer::applyCamera(const RenderCamera &camera)
 {
-	if(!camNode->isObject())
-		return;
-	matrix4	viewMatrix = ((Object*)camNode)->getTM();
-
-	vector2	screenPlane;
-	camNode->getAttrib("origin")->getValue(camOrigin);
-	camNode->getAttrib("screen")->getValue(screenPlane);
-
-	camPosition[0]	= vector3(-screenPlane.x*0.5f, -screenPlane.y*0.5f, 0.0f);
-	camPosition[1]	= vector3(screenPlane.x*0.5f, -screenPlane.y*0.5f, 0.0f);
-	camPosition[2]	= vector3(screenPlane.x*0.5f, screenPlane.y*0.5f, 0.0f);
-	camPosition[3]	= vector3(-screenPlane.x*0.5f, screenPlane.y*0.5f, 0.0f);
-
-	camOrigin		= viewMatrix * camOrigin;
-	camPosition[0]	= viewMatrix * camPosition[0];
-	camPosition[1]	= viewMatrix * camPosition[1];
-	camPosition[2]	= viewMatrix * camPosition[2];
-	camPosition[3]	= viewMatrix * camPosition[3];
+	camOrigin		= camera.origin;
+	camPosition[0]	= camera.corners[0];
+	camPosition[1]	= camera.corners[1];
+	camPosition[2]	= camera.corners[2];
+	camPosition[3]	= camera.corners[3];
 
 	if(frameBuffer)
 	{
@@ -166,83 +146,105 @@ void Renderer::applyCamera(Node *camNode)
 	}
 }
 
-bool Renderer::cacheSceneGraph(void)
+void Renderer::freeShadingQueues(void)
 {
-	if(cacheNodes)
-	{
-		delete[] cacheNodes;
-		cacheNodes = NULL;
-		cacheSize  = 0;
-	}
-	if(cacheLights)
-	{
-		delete[] cacheLights;
-		for(unsigned int i=0; i<=(unsigned int)params[TraceDepth]; i++) if(cacheLightVisibility[i])
-			delete[] cacheLightVisibility[i];
-		cacheLights		= NULL;
-		cacheLightsSize = 0;
-	}
-
-	NodeList	*STLNodes	= new NodeList;
-	NodeList	*STLLights	= new NodeList;
-	NodeList	*STLCamera	= new NodeList;
-
-	rootNode->getObjectsArray(STLNodes);
-	rootNode->getNodesArray("light", STLLights);
-	rootNode->getNodesArray("camera", STLCamera);
+	for(std::vector<ShadingQueue*>::iterator i=shadingQueues.begin(); i<shadingQueues.end(); i++)
+		delete (*i);
+	shadingQueues.clear();
+}
 
-	if(STLCamera->size() > 0)
-		applyCamera(STLCamera->at(0));
+/** Scena jest wspdzielona przez wszystkie renderery i tylko odczytywana; renderer alokuje jedynie
+	wasne kolejki cieniowania, po jednej na shader sceny.
+*/
+bool Renderer::setScene(const RenderScene *renderScene)
+{
+	freeShadingQueues();
 
-	if(STLNodes->size() == 0)
-	{
-		delete STLNodes;
+	scene				= renderScene;
+	lastHitNode			= NULL;
+	lastRenderedNode	= NULL;
+	if(!scene)
 		return false;
-	}
-
-	cacheSize		= (unsigned int)STLNodes->size();
-	cacheLightsSize	= (unsigned int)STLLights->size();
-
-	cacheNodes = new Node*[cacheSize];
-	if(cacheLightsSize > 0)
-	{
-		cacheLights			= new Node*[cacheLightsSize];
-		for(unsigned int i=0; i<=(unsigned int)params[TraceDepth]; i++)
-			cacheLightVisibility[i] = new float[cacheLightsSize];
-	}
 
-	for(unsigned int i=0; i<cacheSize; i++)
-		cacheNodes[i] = STLNodes->at(i);
-	for(unsigned int i=0; i<cacheLightsSize; i++)
-		cacheLights[i] = STLLights->at(i);
+	applyCamera(scene->getCamera());
+	if(scene->getPrimitiveCount() == 0)
+		return false;
 
-	delete STLNodes;
-	delete STLLights;
-	delete STLCamera;
+	// Kolejki tworzone s przy pierwszym trafieniu danego shadera i zestawu cech.
+	shadingQueues.assign(scene->getShaderCount()*(RenderMaterial::ShadingFeatures+1), (ShadingQueue*)NULL);
 	return true;
 }
 
-Node* Renderer::renderRay(const vector3 rayStart, vector3 &pixel)
+int Renderer::renderRay(const vector3 rayStart)
 {
 	float	rayDistance;
 	vector3	rayDirection	= rayStart - camOrigin;
 	rayDirection.normalize();
 
-	return raytrace(camOrigin, rayDirection, pixel, rayDistance, paramsf[EnvRIndex], 0); 
+	return raytrace(camOrigin, rayDirection, rayDistance, paramsf[EnvRIndex], 0); 
+}
+
+void Renderer::beginLine(void)
+{
+	for(std::vector<ShadingQueue*>::iterator i=shadingQueues.begin(); i<shadingQueues.end(); i++)
+	{
+		if(*i)
+			(*i)->clear();
+	}
+	hits.clear();
+	lineSamples.clear();
+	pixelSamples.clear();
+}
+
+// Owietla wsadowo trafienia zebrane w kolejkach cieniowania.
+void Renderer::shadeLine(void)
+{
+	for(unsigned int i=0; i<(unsigned int)shadingQueues.size(); i++)
+	{
+		if(shadingQueues[i] && shadingQueues[i]->count > 0)
+			scene->getShader(i / (RenderMaterial::ShadingFeatures+1))->computeShading(shadingQueues[i]);
+	}
+}
+
+// Skada kolor trafienia z owietlenia bezporedniego i kolorw trafie promieni wtrnych.
+vector3 Renderer::composeHit(const int index) const
+{
+	if(index < 0)
+		return vector3(0.0f, 0.0f, 0.0f);
+
+	const RenderHit	&hit = hits[index];
+	vector3	reflected, refracted;
+	if(hit.reflect != RenderHit::NotTraced)
+		reflected = composeHit(hit.reflect);
+	if(hit.refract != RenderHit::NotTraced)
+		refracted = composeHit(hit.refract);
+
+	return scene->getShader(hit.shader)->composeShading(shadingQueues[hit.queue]->getColor(hit.slot), *hit.material,
+		(hit.reflect != RenderHit::NotTraced) ? &reflected : NULL,
+		(hit.refract != RenderHit::NotTraced) ? &refracted : NULL, hit.absorbance);
 }
 
 void Renderer::renderScanline(const unsigned int y)
 {
 	vector3  rayStart	 = camPosition[0] + float(y) * camDelta[1];
 	float	 sampleDelta = 1.0f / float(params[RenderSamples]);
-	Node*	 currentNode = NULL;
+	const RenderPrimitive*	currentNode = NULL;
+	float*	 span		 = lineBuffer;
 
-	vector3	 pixelColor, pixelSample;
-	
+	vector3	 pixelColor;
+
+	// Linii, ktrej nie da si zapisa do pliku strumienia, nie trzeba renderowa (bd zgasza closeStream).
+	if(frameBuffer->hasWriteFailed())
+		return;
+
+	// ledzenie wszystkich prbek linii; kolory skadane s dopiero po cieniowaniu kolejek.
+	beginLine();
 	for(unsigned int x=0; x<frameBuffer->getWidth(); x++)
 	{
-		pixelColor  = vector3();
-		currentNode = renderRay(rayStart, pixelColor);
+		int	hit		= renderRay(rayStart);
+		currentNode = (hit >= 0) ? hits[hit].primitive : NULL;
+		lineSamples.push_back(hit);
+		pixelSamples.push_back(1);
 
 		if(params[Supersampling] == Full || currentNode != lastRenderedNode)
 		{
@@ -253,72 +255,75 @@ void Renderer::renderScanline(const unsigned int y)
 
 				for(int sy=0; sy<params[RenderSamples]-skipLast; sy++)
 				{
-					renderRay(rayStart + camDelta[0]*float(sx)*sampleDelta + camDelta[1]*float(sy)*sampleDelta,
-						pixelSample);
-					pixelColor += pixelSample;
+					lineSamples.push_back(renderRay(rayStart + camDelta[0]*float(sx)*sampleDelta + camDelta[1]*float(sy)*sampleDelta));
+					pixelSamples.back()++;
 				}
 			}
 			lastRenderedNode = currentNode;
-			pixelColor      /= float(SQR(params[RenderSamples]));
 		}
 
 		rayStart   += camDelta[0];
-
-		if(pixelColor.r > 1.0f) pixelColor.r = 1.0f;
-		if(pixelColor.g > 1.0f) pixelColor.g = 1.0f;
-		if(pixelColor.b > 1.0f) pixelColor.b = 1.0f;
-		frameBuffer->putPixel(x, y, pixelColor);
 	}
-}
+	shadeLine();
 
-Node* Renderer::findNearestIntersection(vector3 &rayOrigin, vector3 &rayDirection, float &rayDistance,
-										int &hitFactor, int &hitFlag, Node *force)
-{
-	Node	*hitNode	= NULL;
-	Node	*testNode	= NULL;
-	float	minDistance	= 10000.0f;
-	int		testFactor, testFlag;
-
-	for(unsigned int i=0; i<cacheSize; i++)
+	const int *sample = &lineSamples[0];
+	for(unsigned int x=0; x<frameBuffer->getWidth(); x++, span+=3)
 	{
-		if(cacheNodes[i]->ignoreIntersection() && cacheNodes[i] != force)
-			continue;
-		testNode = cacheNodes[i]->intersect(rayOrigin, rayDirection, minDistance, testFactor, testFlag);
-		if(testNode)
+		pixelColor = composeHit(*sample++);
+		if(pixelSamples[x] > 1)
 		{
-			if(minDistance < rayDistance)
-			{
-				hitNode		= testNode;
-				hitFactor	= testFactor;
-				hitFlag		= testFlag;
-				rayDistance	= minDistance;
-			}
+			for(unsigned int s=1; s<pixelSamples[x]; s++)
+				pixelColor += composeHit(*sample++);
+			pixelColor /= float(SQR(params[RenderSamples]));
 		}
+
+		span[0] = pixelColor.r;
+		span[1] = pixelColor.g;
+		span[2] = pixelColor.b;
+	}
+
+	// Caa linia trafia do bufora klatki jednym wywoaniem (obcicie, kwantyzacja, BGR).
+	if(hdrBuffer)
+	{
+		hdrBuffer->putSpan(0, y, lineBuffer, frameBuffer->getWidth());
+		return;
 	}
-	return hitNode;
+	frameBuffer->beginLine(y);
+	frameBuffer->putSpan(0, y, lineBuffer, frameBuffer->getWidth());
+	frameBuffer->commitLine(y);
 }
 
-Node* Renderer::findAnyIntersection(vector3 &rayOrigin, vector3 &rayDirection, float &rayDistance,
-									int &hitFactor, int &hitFlag, Node *force)
+// Dodaje do bufora akumulacji [samples] losowo rozrzuconych prbek na kady piksel linii.
+// Bufor przechowuje sumy skadowych RGB oraz sum kwadratw luminancji (4 floaty na piksel).
+void Renderer::accumulateScanline(const unsigned int y, float *accum, const unsigned int samples)
 {
-	Node	*hitNode	= NULL;
-	Node	*testNode	= NULL;
-	int		testFactor, testFlag;
+	vector3	rayStart	= camPosition[0] + float(y) * camDelta[1];
+	vector3	pixelSample;
+	float	luminance;
 
-	for(unsigned int i=0; i<cacheSize; i++)
+	beginLine();
+	for(unsigned int x=0; x<frameBuffer->getWidth(); x++)
 	{
-		if(cacheNodes[i]->ignoreIntersection() && cacheNodes[i] != force)
-			continue;
-		testNode = cacheNodes[i]->intersect(rayOrigin, rayDirection, rayDistance, testFactor, testFlag);
-		if(testNode)
+		for(unsigned int s=0; s<samples; s++)
+			lineSamples.push_back(renderRay(rayStart + camDelta[0]*getRandomNumber(1.0f) + camDelta[1]*getRandomNumber(1.0f)));
+		rayStart += camDelta[0];
+	}
+	shadeLine();
+
+	const int *sample = &lineSamples[0];
+	for(unsigned int x=0; x<frameBuffer->getWidth(); x++, accum+=4)
+	{
+		for(unsigned int s=0; s<samples; s++)
 		{
-			hitNode		= testNode;
-			hitFactor	= testFactor;
-			hitFlag		= testFlag;
-			break;
+			pixelSample = composeHit(*sample++);
+			luminance = 0.2126f*pixelSample.r + 0.7152f*pixelSample.g + 0.0722f*pixelSample.b;
+
+			accum[0] += pixelSample.r;
+			accum[1] += pixelSample.g;
+			accum[2] += pixelSample.b;
+			accum[3] += SQR(luminance);
 		}
 	}
-	return hitNode;	
 }
 
 float Renderer::getRandomNumber(const float fmax)
@@ -326,130 +331,267 @@ float Renderer::getRandomNumber(const float fmax)
 	return fmax * (float(rand()%1000) / 1000.0f);
 }
 
-Node* Renderer::raytrace(vector3 &rayOrigin, vector3 &rayDirection, vector3 &pixel, float &outDistance,
-						 const float rindex, unsigned int depth)
+/** Zwraca indeks trafienia (RenderHit::NoHit, gdy promie nie trafi). Trafienie dodawane jest do kolejki
+	cieniowania swojego shadera razem z widocznoci wiate; jego kolor skada composeHit() po cieniowaniu.
+	Dalsz obsug trafienia wykonuje wariant traceHit wybrany przez zestaw cech materiau.
+*/
+int Renderer::raytrace(const vector3 &rayOrigin, const vector3 &rayDirection, float &outDistance,
+					   const float rindex, unsigned int depth)
 {	
 	float	rayDistance = 10000.0f;
-	Node	*hitNode	= NULL;
-	Node	*testNode	= NULL;
-
-	vector3	intPoint;
+	int		hitIndex	= RenderScene::NoPrimitive;
 	int		intFactor, intFlag;
-	int		testFactor, testFlag;
 
 	if(depth == 0) primaryRays++;
 	else		   secondaryRays++;
-	hitNode = findNearestIntersection(rayOrigin, rayDirection, rayDistance, intFactor, intFlag);
-	if(hitNode == NULL)
-	{
-		pixel = vector3(0.0f, 0.0f, 0.0f);
-		return NULL;
-	}
+	hitIndex = scene->findNearestIntersection(rayOrigin, rayDirection, rayDistance, intFactor, intFlag);
+	if(hitIndex == RenderScene::NoPrimitive)
+		return RenderHit::NoHit;
 	
-	Object			*hitObject	= (Object*)hitNode;
-	Shader			*hitShader	= hitObject->getCachedShader();
-	NodeMaterial	*hitMaterial= (NodeMaterial*)hitObject->getCachedMaterial();
+	const RenderPrimitive	*hitNode	= &scene->getPrimitive(hitIndex);
+	const RenderMaterial	*hitMaterial= &scene->getMaterial(hitNode->material);
+	if(depth == 0)
+		lastHitNode = hitNode;
 
-	if(hitNode != lastHitNode[0] || hitNode != lastHitNode[1])
+	outDistance	= rayDistance;
+	return (this->*traceVariants[hitMaterial->features])(hitNode, hitMaterial, rayOrigin, rayDirection, rayDistance,
+														 intFactor, intFlag, rindex, depth);
+}
+
+/** Warunki zalene od cech materiau (Features) s staymi czasu kompilacji, wic kady wariant zawiera
+	jedynie potrzebne mu gazie.
+*/
+template<unsigned int Features>
+int Renderer::traceHit(const RenderPrimitive *hitNode, const RenderMaterial *hitMaterial,
+					   const vector3 &rayOrigin, const vector3 &rayDirection, float rayDistance,
+					   const int intFactor, const int intFlag, const float rindex, unsigned int depth)
+{
+	const unsigned int	queueIndex	= hitNode->shader*(RenderMaterial::ShadingFeatures+1) + (Features & RenderMaterial::ShadingFeatures);
+	if(!shadingQueues[queueIndex])
+		shadingQueues[queueIndex] = new ShadingQueue(&scene->getLights(), scene->getShaderLights(hitNode->shader),
+													 Features & RenderMaterial::ShadingFeatures);
+	ShadingQueue	*queue	= shadingQueues[queueIndex];
+
+	vector3	intPoint	= rayOrigin + rayDirection*rayDistance;
+	vector3	normal		= RenderScene::getNormal(*hitNode, intPoint, intFlag);
+	int		hit			= (int)hits.size();
 	{
-		delete cacheShader[depth];
-		cacheShader[depth] = hitShader->createRenderingCache();
-		if(depth == 0)
-			lastHitNode[0] = hitNode;
-		lastHitNode[1]	   = hitNode;
+		RenderHit	record;
+		record.primitive	= hitNode;
+		record.material		= hitMaterial;
+		record.shader		= hitNode->shader;
+		record.queue		= queueIndex;
+		record.slot			= queue->push(intPoint, normal, rayDirection, hitNode->material, *hitMaterial);
+		record.reflect		= RenderHit::NotTraced;
+		record.refract		= RenderHit::NotTraced;
+		record.absorbance	= 0.0f;
+		hits.push_back(record);
 	}
+	const unsigned int slot = hits[hit].slot;
+
+	// Przy losowaniu wiate koszt trafienia nie zaley od ich liczby. W przeciwnym razie ledzone s wszystkie
+	// wiata shadera, ktre mog owietli trafienie; przy wietle o ograniczonym zasigu wskazuje je hierarchia
+	// wiate sceny. Kandydaci porzdkowani s wedug pozycji na licie wiate shadera, dziki czemu kolejno
+	// sumowania przy cieniowaniu nie zaley od przejcia hierarchii. Do kolejki trafiaj tylko wiata widoczne.
+	if(params[LightSamples] > 0 && queue->lightCount > (unsigned int)params[LightSamples])
+		sampleLights(queue, hitNode->shader, slot, intPoint, normal, depth);
+	else
+	{
+		if(scene->getLightHierarchySize() == 0)
+			lightCandidates.assign(queue->lightIndex, queue->lightIndex + queue->lightCount);
+		else
+		{
+			lightRows.clear();
+			scene->findLights(intPoint, normal, lightCandidates);
+			for(unsigned int c=0; c<(unsigned int)lightCandidates.size(); c++)
+			{
+				int row = scene->getShaderLightRow(hitNode->shader, lightCandidates[c]);
+				if(row >= 0)
+					lightRows.push_back(std::make_pair((unsigned int)row, lightCandidates[c]));
+			}
+			std::sort(lightRows.begin(), lightRows.end());
 
-	intPoint	= rayOrigin + rayDirection*rayDistance;
-	outDistance	= rayDistance;
+			lightCandidates.resize(lightRows.size());
+			for(unsigned int c=0; c<(unsigned int)lightRows.size(); c++)
+				lightCandidates[c] = lightRows[c].second;
+		}
 
-	cacheShader[depth]->IntPoint		= &intPoint;
-	cacheShader[depth]->RayDirection	= &rayDirection;
-	cacheShader[depth]->RayOrigin		= &rayOrigin;
-	cacheShader[depth]->Normal			= hitObject->getNormal(intPoint, intFlag);
+		for(unsigned int c=0; c<(unsigned int)lightCandidates.size(); c++)
+			queue->addLight(slot, lightCandidates[c], traceLight(lightCandidates[c], intPoint, normal, depth));
+	}
 
-	for(unsigned int i=0; i<cacheLightsSize; i++)
+	if((Features & RenderMaterial::FeatureReflection) && depth < (unsigned int)params[TraceDepth])
 	{
-		NodeLight	*light	= (NodeLight*)cacheLights[i];
-		int			isamples= params[ShadowSamples];
-
-		if(isamples > 2)
-		{ isamples -= depth; if(isamples < 2) isamples = 2; }
+		vector3	reflectVec	= rayDirection - 2.0f * rayDirection.dot(normal) * normal;
+		int		reflected	= raytrace(intPoint + reflectVec*MEPSILON, reflectVec, rayDistance, rindex, depth+1);
+		hits[hit].reflect	= reflected;
+	}
+	
+	if((Features & RenderMaterial::FeatureRefraction) && depth < (unsigned int)params[TraceDepth])
+	{
+		float	rn		= rindex / hitMaterial->refraction;
+		vector3	rnormal = normal * (float)intFactor;
 
-		if(light->isAreaLight())
+		float	cosI	= rayDirection.dot(rnormal); // dotND
+		float	cos2T	= 1.0f - SQR(rn) * (1.0f - SQR(cosI)); // cos2T = 1 - sin2T
+		if(cos2T > 0.0f) // Dla sin2T > 1 (cos2T < 0) zachodzi cakowite wewntrzne odbicie.
 		{
-			cacheLightVisibility[depth][i] = 0.0f;
+			vector3	refractVec	= rn * rayDirection - (rn * cosI + sqrtf(cos2T)) * normal;
+			int		refracted	= raytrace(intPoint + refractVec*0.001f, refractVec, rayDistance, hitMaterial->refraction, depth+1);
+			hits[hit].refract	 = refracted;
+			hits[hit].absorbance = hitMaterial->density * -rayDistance;
+		}
+	}
+	return hit; 
+}
 
-			vector3	lightPos		= light->getCachedPosition();
-			vector2	lightArea		= light->getCachedArea();
+/** Zwraca widoczno wiata [light] z punktu [intPoint] przemnoon przez wygaszenie zasigu. wiato,
+	ktrego nieprzesonity wkad nie przekracza progu LightThreshold, pomijane jest bez wysyania promieni
+	cienia - zawsze dotyczy to wiate poza zasigiem i lecych za paszczyzn styczn (cieniowanie i tak
+	ich nie uwzgldnia).
+*/
+float Renderer::traceLight(const unsigned int light, const vector3 &intPoint, const vector3 &normal, const unsigned int depth)
+{
+	const RenderLightTable	&lights		  = scene->getLights();
+	const vector3			lightPosition = lights.getPosition(light);
+	const float				attenuation	  = lights.getAttenuation(light, intPoint);
+	float					rayDistance;
+	int						testIndex, testFactor, testFlag;
 
-			vector2	gridDelta(lightArea.x/float(isamples), lightArea.y/float(isamples));
-			float	increment		= 1.0f / float(SQR(isamples));
+	if(estimateLight(light, intPoint, normal) <= paramsf[LightThreshold])
+		return 0.0f;
 
-			for(int x=0; x<isamples; x++) for(int y=0; y<isamples; y++)
-			{
-				vector3	samplePos(lightPos.x + float(x)*gridDelta.x, lightPos.y, lightPos.z + float(y)*gridDelta.y);
-				if(params[ShadowSampling] == MonteCarlo)
-				{
-					samplePos.x += getRandomNumber(gridDelta.x);
-					samplePos.z += getRandomNumber(gridDelta.y);
-				}
+	int		isamples	= params[ShadowSamples];
+	float	visibility	= 0.0f;
 
-				vector3	lightVec	= samplePos - intPoint;
-				rayDistance			= lightVec.length();
-				lightVec			/= rayDistance;
+	if(isamples > 2)
+	{ isamples -= depth; if(isamples < 2) isamples = 2; }
 
-				if(depth == 0) primaryRays++;
-				else		   secondaryRays++;
-				testNode = findNearestIntersection(intPoint + lightVec * MEPSILON, lightVec, rayDistance,
-												testFactor, testFlag, cacheLights[i]);
-				if(testNode == cacheLights[i])
-					cacheLightVisibility[depth][i] += increment;
-			}
-		}
-		else
+	if(lights.type[light] == RenderLightTable::LightArea)
+	{
+		vector2	gridDelta(lights.area[0][light]/float(isamples), lights.area[1][light]/float(isamples));
+		float	increment		= 1.0f / float(SQR(isamples));
+		vector3	corners[4]		= { lightPosition,
+									lightPosition + vector3(lights.area[0][light], 0.0f, 0.0f),
+									lightPosition + vector3(lights.area[0][light], 0.0f, lights.area[1][light]),
+									lightPosition + vector3(0.0f, 0.0f, lights.area[1][light]) };
+
+		// Prbki wiata ledzone s jednym pakietem o wsplnym pocztku.
+		shadowPacket->clear();
+		for(int x=0; x<isamples; x++) for(int y=0; y<isamples; y++)
 		{
-			cacheLightVisibility[depth][i] = 0.0f;
+			vector3	samplePos(lightPosition.x + float(x)*gridDelta.x, lightPosition.y, lightPosition.z + float(y)*gridDelta.y);
+			if(params[ShadowSampling] == MonteCarlo)
+			{
+				samplePos.x += getRandomNumber(gridDelta.x);
+				samplePos.z += getRandomNumber(gridDelta.y);
+			}
 
-			vector3	lightVec		= light->getCachedPosition() - intPoint;
-			rayDistance				= lightVec.length();
-			lightVec			   /= rayDistance;
+			vector3	lightVec	= samplePos - intPoint;
+#ifdef EXRAY_FASTMATH
+			float	invDistance	= fastRsqrt(lightVec.sqLength());
+			rayDistance			= lightVec.sqLength() * invDistance;
+			lightVec			*= invDistance;
+#else
+			rayDistance			= lightVec.length();
+			lightVec			/= rayDistance;
+#endif
 
 			if(depth == 0) primaryRays++;
 			else		   secondaryRays++;
-			testNode = findNearestIntersection(intPoint + lightVec * MEPSILON, lightVec, rayDistance, testFactor, testFlag);
-			if(testNode == NULL)
-			{
-				//if(testFactor == 1)
-					cacheLightVisibility[depth][i] = 1.0f;
-			}
+			shadowPacket->push(intPoint + lightVec * MEPSILON, lightVec, rayDistance);
 		}
-	}
 
-	if(hitMaterial->isReflective() && depth < (unsigned int)params[TraceDepth])
+		scene->traceShadowPacket(*shadowPacket, intPoint, corners, lights.primitive[light]);
+		for(unsigned int r=0; r<shadowPacket->size(); r++)
+		{
+			if(shadowPacket->isVisible(r))
+				visibility += increment;
+		}
+	}
+	else
 	{
-		vector3	reflectVec = rayDirection - 2.0f * rayDirection.dot(cacheShader[depth]->Normal) * cacheShader[depth]->Normal;
-		raytrace(intPoint + reflectVec*MEPSILON, reflectVec, cacheShader[depth]->ReflectComponent, rayDistance, rindex, depth+1);
-		cacheShader[depth]->ReflectFlag = true;
+		vector3	lightVec		= lightPosition - intPoint;
+#ifdef EXRAY_FASTMATH
+		float	invDistance		= fastRsqrt(lightVec.sqLength());
+		rayDistance				= lightVec.sqLength() * invDistance;
+		lightVec			   *= invDistance;
+#else
+		rayDistance				= lightVec.length();
+		lightVec			   /= rayDistance;
+#endif
+
+		if(depth == 0) primaryRays++;
+		else		   secondaryRays++;
+		testIndex = scene->findNearestIntersection(intPoint + lightVec * MEPSILON, lightVec, rayDistance, testFactor, testFlag);
+		if(testIndex == RenderScene::NoPrimitive)
+		{
+			//if(testFactor == 1)
+				visibility = 1.0f;
+		}
 	}
-	
-	if(hitMaterial->getRefractionIndex() > 0.0f && depth < (unsigned int)params[TraceDepth])
+	return visibility * attenuation;
+}
+
+/** Oszacowanie nieprzesonitego wkadu wiata: najsilniejsza skadowa koloru, wygaszenie zasigu i kosinus
+	kta padania liczony jak przy cieniowaniu (kierunek do pozycji wiata). Zero dla wiata poza zasigiem
+	lub za paszczyzn styczn.
+*/
+float Renderer::estimateLight(const unsigned int light, const vector3 &intPoint, const vector3 &normal) const
+{
+	const RenderLightTable	&lights		= scene->getLights();
+	const float				attenuation	= lights.getAttenuation(light, intPoint);
+
+	vector3	lightDir	= lights.getPosition(light) - intPoint;
+	float	cosine		= normal.dot(lightDir);
+	if(attenuation <= 0.0f || cosine <= 0.0f)
+		return 0.0f;
+
+	float	intensity	= lights.color[0][light];
+	if(lights.color[1][light] > intensity) intensity = lights.color[1][light];
+	if(lights.color[2][light] > intensity) intensity = lights.color[2][light];
+	return intensity * attenuation * cosine / lightDir.length();
+}
+
+/** Losuje LightSamples wiate shadera (RenderScene::sampleLight: rozkad mocy wiate zapisany w hierarchii
+	wiate, bez przegldania wszystkich wiate) i dodaje ich widoczno podzielon przez LightSamples
+	i prawdopodobiestwo wyboru. Cieniowanie jest liniowe wzgldem widocznoci, wic oczekiwany wynik jest rwny
+	owietleniu wszystkimi wiatami. Czynnik geometryczny (kt i odlego) liczony jest tylko dla wylosowanych
+	wiate, a koszt trafienia zaley od LightSamples i gbokoci hierarchii, nie od liczby wiate. Szum
+	usuwa prbkowanie progresywne lub nadprbkowanie.
+*/
+void Renderer::sampleLights(ShadingQueue *queue, const unsigned int shader, const unsigned int slot,
+							const vector3 &intPoint, const vector3 &normal, const unsigned int depth)
+{
+	const int	samples	= params[LightSamples];
+	unsigned int	light;
+
+	// Wylosowane wiata w kolejnoci listy wiate shadera; wiato wylosowane kilkukrotnie ma jeden wpis.
+	lightRows.clear();
+	lightSampled.clear();
+	for(int s=0; s<samples; s++)
 	{
-		float	rn		= rindex / hitMaterial->getRefractionIndex();
-		vector3	rnormal = cacheShader[depth]->Normal * (float)intFactor;
+		// Dwa losowania daj rozdzielczo 10^-6.
+		float	u			= getRandomNumber(1.0f) + getRandomNumber(0.001f);
+		float	probability	= scene->sampleLight(shader, intPoint, normal, u, light);
+		if(probability <= 0.0f)
+			continue;
 
-		float	cosI	= rayDirection.dot(rnormal); // dotND
-		float	cos2T	= 1.0f - SQR(rn) * (1.0f - SQR(cosI)); // cos2T = 1 - sin2T
-		if(cos2T > 0.0f) // Dla sin2T > 1 (cos2T < 0) zachodzi cakowite wewntrzne odbicie.
+		const std::pair<unsigned int, unsigned int>	entry((unsigned int)scene->getShaderLightRow(shader, light), light);
+		unsigned int	c = (unsigned int)(std::lower_bound(lightRows.begin(), lightRows.end(), entry) - lightRows.begin());
+		if(c == (unsigned int)lightRows.size() || lightRows[c] != entry)
 		{
-			vector3	refractVec = rn * rayDirection - (rn * cosI + sqrtf(cos2T)) * cacheShader[depth]->Normal;
-			raytrace(intPoint + refractVec*0.001f, refractVec, cacheShader[depth]->RefractComponent, rayDistance,
-				hitMaterial->getRefractionIndex(), depth+1);
-			cacheShader[depth]->RefractFlag = true;
-			cacheShader[depth]->MaterialAbsorbance = hitMaterial->getDensity() * -rayDistance;
+			lightRows.insert(lightRows.begin()+c, entry);
+			lightSampled.insert(lightSampled.begin()+c, 0.0f);
 		}
+		lightSampled[c] += traceLight(light, intPoint, normal, depth) / (float(samples) * probability);
 	}
 
-	hitMaterial->updateShader(cacheShader[depth]);
-	pixel = hitShader->computeShading(cacheShader[depth], cacheLightVisibility[depth]);
-	return hitNode; 
-}
\ No newline at end of file
+	for(unsigned int c=0; c<(unsigned int)lightRows.size(); c++)
+		queue->addLight(slot, lightRows[c].second, lightSampled[c]);
+}
+
+// Warianty obsugi trafienia dla kolejnych zestaww cech materiau (RenderMaterial::features).
+const Renderer::TraceVariant Renderer::traceVariants[RenderMaterial::FeatureSets] = {
+	&Renderer::traceHit<0>, &Renderer::traceHit<1>, &Renderer::traceHit<2>, &Renderer::traceHit<3>,
+	&Renderer::traceHit<4>, &Renderer::traceHit<5>, &Renderer::traceHit<6>, &Renderer::traceHit<7> };
\ No newline at end of file
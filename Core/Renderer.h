@@ -22,8 +22,14 @@
 namespace exRay {
 
 class Image;
+class ImageHDR;
 class Node;
-class ShaderUniforms;
+class ShadingQueue;
+class RenderScene;
+class RenderPrimitive;
+class RenderMaterial;
+class RenderCamera;
+class RenderShadowPacket;
 
 /// Definicje parametrw renderera.
 enum Parameters
@@ -34,11 +40,14 @@ enum Parameters
 	ShadowSampling,
 	RenderSamples,
 	ShadowSamples,
+	LightSamples,		// Liczba wiate losowanych na trafienie (0 - wszystkie wiata)
 	// Reserved
+	LightThresholdCode	= 253,	// Kod skryptu dla LightThreshold (identyfikator 1 zajmuje Supersampling)
 	FrameWidth	= 254,
 	FrameHeight	= 255,
 
 	EnvRIndex = 0,
+	LightThreshold,		// Minimalny nieprzesonity wkad wiata, dla ktrego wysyane s promienie cienia
 
 	// Values
 	Full = 0,
@@ -47,17 +56,45 @@ enum Parameters
 	MonteCarlo,
 
 	// Param-array size
-	ParamsCount		= 5,
-	FParamsCount	= 1,
+	ParamsCount		= 6,
+	FParamsCount	= 2,
+};
+
+/// Trafienie promienia oczekujce na zoenie koloru.
+/** Odwouje si do pozycji w kolejce cieniowania shadera oraz do trafie promieni wtrnych: indeks trafienia,
+	NoHit dla promienia, ktry nie trafi w aden prymityw, lub NotTraced, gdy promienia nie wysano.
+*/
+class RenderHit
+{
+public:
+	const RenderPrimitive*	primitive;
+	const RenderMaterial*	material;
+	unsigned int			shader;
+	unsigned int			queue;
+	unsigned int			slot;
+	int						reflect;
+	int						refract;
+	float					absorbance;
+
+	enum
+	{
+		NoHit		= -1,
+		NotTraced	= -2,
+	};
 };
 
 /// Klasa renderera (raytracera).
 /** Podstawowy element silnika. Raytracer wykonujcy proces rekurencyjnego, wstecznego
 	ledzenia promieni i syntezy obrazu.
-	Klasa renderuje pojedyncze linie obrazu piksel po pikselu. Znajduje przecicia z prymitywami na scenie
-	oraz zarzdza cachem renderowania. W razie potrzeby generuje promienie wtrne, wylicza
+	Klasa renderuje pojedyncze linie obrazu piksel po pikselu. Znajduje przecicia z prymitywami
+	wspdzielonej sceny renderowania (RenderScene) i przechowuje jedynie wasne dane robocze. W razie potrzeby generuje promienie wtrne, wylicza
 	odbicie, refrakcj oraz aproksymuje cienie. W ostatnim etapie renderowania przekazuje
 	informacje do aktualnego shadera, ktry wylicza ostateczny kolor piksela.
+	Trafienia caej linii zbierane s najpierw w kolejkach cieniowania (po jednej na shader sceny i zestaw
+	cech owietlenia materiau), shadery owietlaj je wsadowo, a kolory pikseli skadane s z wynikw dopiero
+	na kocu. Obsuga trafienia jest wyspecjalizowana (traceHit) dla kadego zestawu cech materiau, wic
+	np. nieprzezroczysta powierzchnia rozpraszajca nie sprawdza warunkw odbicia i refrakcji.
+	Jeli ustawiony jest bufor HDR, piksele zapisywane s do niego bez obcinania do zakresu [0,1].
 */
 class Renderer
 {
@@ -72,43 +109,65 @@ private:
 	float				paramsf[FParamsCount];
 
 	Image*				frameBuffer;
+	ImageHDR*			hdrBuffer;
+	float*				lineBuffer;
 	Node*				rootNode;
-	Node*				lastHitNode[2];
-	Node*				lastRenderedNode;
-
-	Node**				cacheNodes;
-	unsigned int		cacheSize;
-
-	Node**				cacheLights;
-	unsigned int		cacheLightsSize;
-	float**				cacheLightVisibility;
-
-	ShaderUniforms**	cacheShader;
+	const RenderScene*	scene;
+	const RenderPrimitive*	lastHitNode;
+	const RenderPrimitive*	lastRenderedNode;
+
+	std::vector<ShadingQueue*>	shadingQueues;	// Po jednej na shader sceny i zestaw cech owietlenia
+	std::vector<RenderHit>		hits;
+	std::vector<int>			lineSamples;	// Trafienia kolejnych prbek pikseli linii
+	std::vector<unsigned int>	pixelSamples;	// Liczba prbek piksela
+	std::vector<unsigned int>	lightCandidates;	// wiata shadera mogce owietli trafienie
+	std::vector<std::pair<unsigned int, unsigned int> >	lightRows;	// Pozycje wiate na licie wiate shadera
+	std::vector<float>			lightSampled;		// Suma prbek wylosowanych wiate (wg lightRows)
+	RenderShadowPacket*			shadowPacket;		// Promienie cienia prbek wiata powierzchniowego
 
 	vector3				camDelta[2];
 	vector3				camPosition[4];
 	vector3				camOrigin;
 private:
-	Node*			findNearestIntersection(vector3 &rayOrigin, vector3 &rayDirection, float &rayDistance,
-											int &hitFactor, int &hitFlag, Node *force=NULL);
-	Node*			findAnyIntersection(vector3 &rayOrigin, vector3 &rayDirection, float &rayDistance,
-										int &hitFactor, int &hitFlag, Node *force=NULL);
+	typedef int		(Renderer::*TraceVariant)(const RenderPrimitive *hitNode, const RenderMaterial *hitMaterial,
+											  const vector3 &rayOrigin, const vector3 &rayDirection, float rayDistance,
+											  const int intFactor, const int intFlag, const float rindex, unsigned int depth);
+	static const TraceVariant	traceVariants[];
+
+	template<unsigned int Features>
+	int				traceHit(const RenderPrimitive *hitNode, const RenderMaterial *hitMaterial,
+							 const vector3 &rayOrigin, const vector3 &rayDirection, float rayDistance,
+							 const int intFactor, const int intFlag, const float rindex, unsigned int depth);
+
+	float			traceLight(const unsigned int light, const vector3 &intPoint, const vector3 &normal, const unsigned int depth);
+	float			estimateLight(const unsigned int light, const vector3 &intPoint, const vector3 &normal) const;
+	void			sampleLights(ShadingQueue *queue, const unsigned int shader, const unsigned int slot,
+								 const vector3 &intPoint, const vector3 &normal, const unsigned int depth);
+
 	static float	getRandomNumber(const float fmax);
 	void			setDefaultParameters(void);
-	Node*			renderRay(const vector3 rayStart, vector3 &pixel);
-	void			applyCamera(Node *camNode);
+	int				renderRay(const vector3 rayStart);
+	void			applyCamera(const RenderCamera &camera);
+	void			freeShadingQueues(void);
+	void			beginLine(void);
+	void			shadeLine(void);
+	vector3			composeHit(const int index) const;
 public:
 	Renderer(Image *newBuffer, Node *newRoot, unsigned int depth);
 	~Renderer(void);
 
-	bool	cacheSceneGraph(void);
+	bool	setScene(const RenderScene *renderScene);
 	void	renderScanline(const unsigned int y);
-	Node*	raytrace(vector3 &rayOrigin, vector3 &rayDirection, vector3 &pixel, float &outDistance, 
+	void	accumulateScanline(const unsigned int y, float *accum, const unsigned int samples);
+	int		raytrace(const vector3 &rayOrigin, const vector3 &rayDirection, float &outDistance,
 					 const float rindex, unsigned int depth);
 
 	Node*	getRootNode(void) const;
+	const RenderScene*	getScene(void) const;
 	Image*	getFramebuffer(void) const;
 	void	setFramebuffer(Image *buffer);
+	ImageHDR*	getHDRFramebuffer(void) const;
+	void	setHDRFramebuffer(ImageHDR *buffer);
 
 	Node*	getLastHitNode(void) const;
 
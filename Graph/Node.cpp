@@ -20,34 +20,65 @@
 #include "Variable.h"
 #include "Node.h"
 #include "Object.h"
+#include "NodeGraph.h"
+#include "../Types/Arena.h"
 
 using namespace exRay;
 
-Node::Node(const std::string &name, Node *parent)
-{
-	nodeName	= name;
+// Wze podrzdny korzysta z obszaru rodzica, korze z obszaru podanego jawnie. Kontenery wza otrzymuj
+// ten obszar; nazwa kopiowana jest do tego samego obszaru.
+Node::Node(const std::string &name, Node *parent, Arena *arena) :
+	nodeArena(parent ? Node::getArena(parent) : arena),
+	nodeVars(VList::allocator_type(nodeArena)),
+	childList(NodeArenaList::allocator_type(nodeArena)),
+	affectedBy(NodeArenaList::allocator_type(nodeArena)),
+	childMap(NodeNameLess(), NodeMap::allocator_type(nodeArena)),
+	outputVars(VReferenceList::allocator_type(nodeArena)),
+	outputNodes(NodeArenaList::allocator_type(nodeArena)),
+	linkDestVars(VReferenceList::allocator_type(nodeArena)),
+	linkSourceVars(VReferenceList::allocator_type(nodeArena)),
+	linkNodes(NodeArenaList::allocator_type(nodeArena)),
+	mapNodes(NodeArenaList::allocator_type(nodeArena))
+{
+	char *nameCopy = (char*)Arena::allocateBlock(name.size()+1, nodeArena);
+	memcpy(nameCopy, name.c_str(), name.size()+1);
+
+	nodeName	= nameCopy;
+	nodeGraph	= NULL;
 	evaluated	= false;
+	modified	= false;
+	evalIndex	= 0;
 
 	if(parent)
 	{ if(!parent->addChild(this)) nodeParent = NULL;
 	} else nodeParent = NULL;
 
+	markModified();
 }
 
 Node::~Node()
 {
-	for(unsigned int i=0; i<childList.size(); i++)
-		deleteChild(i);
-	for(VMap::iterator vi=nodeVars.begin(); vi!=nodeVars.end(); vi++)
-		delete vi->second;
-	for(VReferenceList::iterator vi=outputVars.begin(); vi!=outputVars.end(); vi++)
-		delete (*vi);
-	for(VReferenceList::iterator vi=linkSourceVars.begin(); vi!=linkSourceVars.end(); vi++)
-		delete (*vi);
-	for(VReferenceList::iterator vi=linkDestVars.begin(); vi!=linkDestVars.end(); vi++)
+	if(nodeGraph)
+		nodeGraph->removeNode(this);
+	for(NodeArenaList::iterator ci=childList.begin(); ci!=childList.end(); ci++)
+		delete (*ci);
+	for(VList::iterator vi=nodeVars.begin(); vi!=nodeVars.end(); vi++)
 		delete (*vi);
+	Arena::freeBlock((void*)nodeName, nodeArena);
 }
 
+void* Node::operator new(size_t size)
+{ return Arena::allocateObject(size, NULL); }
+
+void* Node::operator new(size_t size, Arena *arena)
+{ return Arena::allocateObject(size, arena); }
+
+void Node::operator delete(void *object)
+{ Arena::freeObject(object); }
+
+void Node::operator delete(void *object, Arena *arena)
+{ Arena::freeObject(object); }
+
 Node* Node::getChild(unsigned int index)
 {
 	if(index >= childList.size())
@@ -57,7 +88,7 @@ Node* Node::getChild(unsigned int index)
 
 Node* Node::getChild(const std::string &cname)
 {
-	NodeMap::iterator	result = childMap.find(cname);
+	NodeMap::iterator	result = childMap.find(cname.c_str());
 	if(result == childMap.end())
 		return NULL;
 	return result->second;
@@ -67,12 +98,15 @@ bool Node::addChild(Node *child)
 {
 	if(!child)
 		return false;
-	if(getChild(child->getName()))
+	if(childMap.find(child->nodeName) != childMap.end())
 		return false;
 
 	child->nodeParent = this;
+	child->setGraph(nodeGraph, true);
 	childList.push_back(child);
-	childMap[child->getName()] = child;
+	childMap[child->nodeName] = child;
+	if(nodeGraph)
+		nodeGraph->invalidateOrder();
 	return true;
 }
 
@@ -81,62 +115,83 @@ bool Node::deleteChild(unsigned int index)
 	if(index >= childList.size())
 		return false;
 
-	NodeMap::iterator it = childMap.find(childList.at(index)->getName());
-
-	delete it->second;
+	// Klucz mapy wskazuje nazw w wle, wic wpis usuwany jest przed wzem.
+	Node *child = childList.at(index);
+	childMap.erase(child->nodeName);
 	childList.erase(childList.begin()+index);
-	childMap.erase(it);
+	delete child;
 	return true;
 }
 
 bool Node::deleteChild(const std::string &cname)
 {
-	NodeMap::iterator it = childMap.find(cname);
+	NodeMap::iterator it = childMap.find(cname.c_str());
 	if(it == childMap.end())
 		return false;
 
-	delete it->second;
-	for(NodeList::iterator i=childList.begin(); i<childList.end(); i++)
+	Node *child = it->second;
+	childMap.erase(it);
+	for(NodeArenaList::iterator i=childList.begin(); i<childList.end(); i++)
 	{
-		if((*i)->getName() == cname)
+		if((*i) == child)
 		{
 			childList.erase(i);
 			break;
 		}
 	}
-	childMap.erase(it);
+	delete child;
 	return true;
 }
 
+// Atrybuty numerowane s w kolejnoci rejestracji.
 Variable* Node::getAttrib(unsigned int index, bool update)
 {
 	if(index >= nodeVars.size())
 		return NULL;
-	VMap::iterator it = nodeVars.begin();
-	for(unsigned int i=0; i<index; i++) it++;
 	if(update)
-		updateAttrib(it->second);
-	return it->second;
+		updateAttrib(nodeVars[index]);
+	return nodeVars[index];
+}
+
+// Wze ma zwykle kilka atrybutw, wic liniowe porwnanie kluczy jest szybsze od mapy.
+Variable* Node::getAttrib(const AttribKey &key, bool update)
+{
+	for(VList::iterator it=nodeVars.begin(); it<nodeVars.end(); it++)
+	{
+		if((*it)->getKey() == key.getID())
+		{
+			if(update)
+				updateAttrib(*it);
+			return *it;
+		}
+	}
+	return NULL;
+}
+
+bool Node::getRenderPrimitive(RenderPrimitive *primitive) const
+{
+	return false;
 }
 
 Variable* Node::getAttrib(const std::string &name, bool update)
 {
-	VMap::iterator it = nodeVars.find(name);
-	if(it == nodeVars.end())
+	AttribKey key = AttribKey::find(name);
+	if(key.getID() == 0)
 		return NULL;
-	if(update)
-		updateAttrib(it->second);
-	return it->second;
+	return getAttrib(key, update);
 }
 
 Variable* Node::addAttrib(Variable *value)
 {
 	if(!value)	return NULL;
 
-	VMap::iterator it = nodeVars.find(value->getName());
-	if(it != nodeVars.end())
-		return false;
-	nodeVars[value->getName()] = value;
+	for(VList::iterator it=nodeVars.begin(); it<nodeVars.end(); it++)
+	{
+		if((*it)->getKey() == value->getKey())
+			return NULL;
+	}
+	value->setOwner(this);
+	nodeVars.push_back(value);
 	return value;
 }
 
@@ -155,9 +210,25 @@ bool Node::hasOutput(void)
 	return (outputNodes.size() > 0);
 }
 
+// Mapowanie (np. wiato w env_light shadera) nie przenosi wartoci podczas ewaluacji, ale wze docelowy
+// odczytuje mapowany wze przy buforowaniu, wic musi zosta zbuforowany ponownie po jego zmianie.
+bool Node::addMapNode(Node *pnode)
+{
+	for(NodeArenaList::iterator i=mapNodes.begin(); i!=mapNodes.end(); i++)
+	{
+		if((*i) == pnode)
+			return false;
+	}
+	mapNodes.push_back(pnode);
+	pnode->addDependencyNode(this);
+	if(nodeGraph)
+		nodeGraph->invalidateOrder();
+	return true;
+}
+
 bool Node::addDependencyNode(Node *pnode)
 {
-	for(NodeList::iterator i=affectedBy.begin(); i!=affectedBy.end(); i++)
+	for(NodeArenaList::iterator i=affectedBy.begin(); i!=affectedBy.end(); i++)
 	{
 		if((*i) == pnode)
 			return false;
@@ -167,10 +238,15 @@ bool Node::addDependencyNode(Node *pnode)
 }
 
 bool Node::connect(Node *pnode, const std::string &attrName, unsigned int index)
+{
+	return connect(pnode, AttribKey::find(attrName), index);
+}
+
+bool Node::connect(Node *pnode, const AttribKey &attrKey, unsigned int index)
 {
 //	if(outputNode)
 //		return false;
-	Variable *attrib = pnode->getAttrib(attrName);
+	Variable *attrib = pnode->getAttrib(attrKey);
 	if(!attrib)
 		return false;
 	if(attrib->isConnected())
@@ -184,7 +260,10 @@ bool Node::connect(Node *pnode, const std::string &attrName, unsigned int index)
 	pnode->addDependencyNode(this);
 
 	outputNodes.push_back(pnode);
-	outputVars.push_back(new VReference(attrib, index));
+	outputVars.push_back(VReference(attrib, index));
+	if(nodeGraph)
+		nodeGraph->invalidateOrder();
+	markModified();
 	
 //	outputNode	= pnode;
 //	outputIndex	= index;
@@ -215,8 +294,11 @@ bool Node::link(Node *pnode, const std::string &src, const std::string &dst, uns
 	pnode->addDependencyNode(this);
 
 	linkNodes.push_back(pnode);
-	linkSourceVars.push_back(new VReference(vsrc, srci));
-	linkDestVars.push_back(new VReference(vdst, dsti));
+	linkSourceVars.push_back(VReference(vsrc, srci));
+	linkDestVars.push_back(VReference(vdst, dsti));
+	if(nodeGraph)
+		nodeGraph->invalidateOrder();
+	markModified();
 	return true;
 }
 
@@ -231,10 +313,52 @@ void Node::clearEvaluated(bool recursive)
 	if(!recursive)
 		return;
 
-	for(NodeList::iterator i=childList.begin(); i<childList.end(); i++)
+	for(NodeArenaList::iterator i=childList.begin(); i<childList.end(); i++)
 	{ (*i)->clearEvaluated(true); }
 }
 
+void Node::markModified(void)
+{
+	if(modified)
+		return;
+	modified = true;
+	if(nodeGraph)
+		nodeGraph->markDirty(this);
+}
+
+void Node::clearModified(void)
+{
+	modified = false;
+}
+
+void Node::setGraph(NodeGraph *graph, bool recursive)
+{
+	nodeGraph = graph;
+	if(!recursive)
+		return;
+
+	for(NodeArenaList::iterator i=childList.begin(); i<childList.end(); i++)
+		(*i)->setGraph(graph, true);
+}
+
+void Node::setEvalIndex(unsigned int index)
+{
+	evalIndex = index;
+}
+
+// Wzy, do ktrych atrybutw ten wze przekazuje wartoci (connect, link) lub ktre go mapuj.
+void Node::getDependentNodes(NodeList *referenceList)
+{
+	referenceList->insert(referenceList->end(), outputNodes.begin(), outputNodes.end());
+	referenceList->insert(referenceList->end(), linkNodes.begin(), linkNodes.end());
+	referenceList->insert(referenceList->end(), mapNodes.begin(), mapNodes.end());
+}
+
+void Node::getMappedNodes(NodeList *referenceList)
+{
+	referenceList->insert(referenceList->end(), mapNodes.begin(), mapNodes.end());
+}
+
 void Node::updateAttrib(Variable *attrib)
 {
 	if(!attrib->isConnected())
@@ -247,7 +371,7 @@ void Node::getObjectsArray(NodeList *referenceList)
 {
 	if(isObject())
 		referenceList->push_back(this);
-	for(NodeList::iterator i=childList.begin(); i<childList.end(); i++)
+	for(NodeArenaList::iterator i=childList.begin(); i<childList.end(); i++)
 		(*i)->getObjectsArray(referenceList);
 }
 
@@ -255,7 +379,7 @@ void Node::getNodesArray(const std::string &type, NodeList *referenceList)
 {
 	if(getType() == type)
 		referenceList->push_back(this);
-	for(NodeList::iterator i=childList.begin(); i<childList.end(); i++)
+	for(NodeArenaList::iterator i=childList.begin(); i<childList.end(); i++)
 	{
 		if((*i)->getType() == type)
 			(*i)->getNodesArray(type, referenceList);
@@ -265,16 +389,26 @@ void Node::getNodesArray(const std::string &type, NodeList *referenceList)
 // Virtuals
 void Node::updateTransformation(const matrix4 *multiplyBy)
 {
-	for(NodeList::iterator i=childList.begin(); i<childList.end(); i++)
+	transformNode(multiplyBy);
+	for(NodeArenaList::iterator i=childList.begin(); i<childList.end(); i++)
 			(*i)->updateTransformation(multiplyBy);
 }
 
+void Node::transformNode(const matrix4 *multiplyBy)
+{
+}
+
 void Node::cacheVariables(void)
 {
-	for(NodeList::iterator i=childList.begin(); i<childList.end(); i++)
+	cacheNode();
+	for(NodeArenaList::iterator i=childList.begin(); i<childList.end(); i++)
 		(*i)->cacheVariables();
 }
 
+void Node::cacheNode(void)
+{
+}
+
 Node* Node::intersect(const vector3 &rayOrigin, const vector3 &rayDirection, float &rayDistance, int &factor, int &flag)
 {
 	factor	= 0;
@@ -286,23 +420,24 @@ void Node::evaluate(void)
 {
 	if(evaluated) return;
 
+	evaluateNode();
+	evaluated = true;
+
+	for(NodeArenaList::iterator i=childList.begin(); i<childList.end(); i++)
+		(*i)->evaluate();
+}
+
+void Node::evaluateNode(void)
+{
 	VReferenceList::iterator srci = linkSourceVars.begin();
 	VReferenceList::iterator dsti = linkDestVars.begin();
 
 	while((srci != linkSourceVars.end()) && (dsti != linkDestVars.end()))
 	{
-		(*srci)->first->copyValue((*dsti)->first, (*srci)->second, (*dsti)->second);
+		srci->first->copyValue(dsti->first, srci->second, dsti->second);
 		srci++;
 		dsti++;
 	}
-	evaluated = true;
-
-//	for(VMap::iterator i=nodeVars.begin(); i!=nodeVars.end(); i++)
-//		(*i).second->setClean();
-	for(NodeList::iterator i=childList.begin(); i<childList.end(); i++)
-		(*i)->evaluate();
-
-	//cacheVariables();
 }
 
 // output set
@@ -310,7 +445,7 @@ bool Node::setOutput(int value)
 {
 	for(VReferenceList::iterator vi=outputVars.begin(); vi!=outputVars.end(); vi++)
 	{
-		if(!(*vi)->first->setValue(value, (*vi)->second))
+		if(!vi->first->setValue(value, vi->second))
 			return false;
 	}
 	return true;
@@ -320,7 +455,7 @@ bool Node::setOutput(float value)
 {
 	for(VReferenceList::iterator vi=outputVars.begin(); vi!=outputVars.end(); vi++)
 	{
-		if(!(*vi)->first->setValue(value, (*vi)->second))
+		if(!vi->first->setValue(value, vi->second))
 			return false;
 	}
 	return true;
@@ -330,7 +465,7 @@ bool Node::setOutput(vector2 &value)
 {
 	for(VReferenceList::iterator vi=outputVars.begin(); vi!=outputVars.end(); vi++)
 	{
-		if(!(*vi)->first->setValue(value, (*vi)->second))
+		if(!vi->first->setValue(value, vi->second))
 			return false;
 	}
 	return true;
@@ -340,7 +475,7 @@ bool Node::setOutput(vector3 &value)
 {
 	for(VReferenceList::iterator vi=outputVars.begin(); vi!=outputVars.end(); vi++)
 	{
-		if(!(*vi)->first->setValue(value, (*vi)->second))
+		if(!vi->first->setValue(value, vi->second))
 			return false;
 	}
 	return true;
@@ -350,7 +485,7 @@ bool Node::setOutput(vector4 &value)
 {
 	for(VReferenceList::iterator vi=outputVars.begin(); vi!=outputVars.end(); vi++)
 	{
-		if(!(*vi)->first->setValue(value, (*vi)->second))
+		if(!vi->first->setValue(value, vi->second))
 			return false;
 	}
 	return true;
@@ -360,7 +495,7 @@ bool Node::setOutput(matrix4 &value)
 {
 	for(VReferenceList::iterator vi=outputVars.begin(); vi!=outputVars.end(); vi++)
 	{
-		if(!(*vi)->first->setValue(value, (*vi)->second))
+		if(!vi->first->setValue(value, vi->second))
 			return false;
 	}
 	return true;
@@ -370,7 +505,7 @@ bool Node::setOutput(std::string &value)
 {
 	for(VReferenceList::iterator vi=outputVars.begin(); vi!=outputVars.end(); vi++)
 	{
-		if(!(*vi)->first->setValue(value, (*vi)->second))
+		if(!vi->first->setValue(value, vi->second))
 			return false;
 	}
 	return true;
@@ -380,7 +515,7 @@ bool Node::setOutput(Mesh *value)
 {
 	for(VReferenceList::iterator vi=outputVars.begin(); vi!=outputVars.end(); vi++)
 	{
-		if(!(*vi)->first->setValue(value, (*vi)->second))
+		if(!vi->first->setValue(value, vi->second))
 			return false;
 	}
 	return true;
@@ -390,7 +525,7 @@ bool Node::setOutput(Shader *value)
 {
 	for(VReferenceList::iterator vi=outputVars.begin(); vi!=outputVars.end(); vi++)
 	{
-		if(!(*vi)->first->setValue(value, (*vi)->second))
+		if(!vi->first->setValue(value, vi->second))
 			return false;
 	}
 	return true;
@@ -400,7 +535,7 @@ bool Node::setOutput(Node *value)
 {
 	for(VReferenceList::iterator vi=outputVars.begin(); vi!=outputVars.end(); vi++)
 	{
-		if(!(*vi)->first->setValue(value, (*vi)->second))
+		if(!vi->first->setValue(value, vi->second))
 			return false;
 	}
 	return true;
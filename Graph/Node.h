@@ -19,48 +19,74 @@
 #ifndef __NODE_H
 #define __NODE_H
 
+#include "../Types/Arena.h"
+
 namespace exRay {
 
 class Node;
 class Variable;
+class AttribKey;
+template<class T> class AttribHandle;
 class Renderer;
 class Mesh;
 class Shader;
+class NodeGraph;
+class RenderPrimitive;
 
-typedef std::pair<Variable*, unsigned int>	VReference;
-typedef std::vector<VReference*>			VReferenceList;
+/// Porzdek nazw wzw w NodeMap.
+struct NodeNameLess
+{
+	bool operator()(const char *a, const char *b) const
+	{ return strcmp(a, b) < 0; }
+};
 
+typedef std::pair<Variable*, unsigned int>	VReference;
 typedef std::vector<Node*>					NodeList;
-typedef std::vector<Variable*>				VList;
-typedef std::map<std::string, Node*>		NodeMap;
-typedef std::map<std::string, Variable*>	VMap;
+
+// Kontenery przechowywane w wle; pami pochodzi z obszaru wza.
+typedef std::vector<VReference, ArenaAllocator<VReference> >	VReferenceList;
+typedef std::vector<Node*, ArenaAllocator<Node*> >				NodeArenaList;
+typedef std::vector<Variable*, ArenaAllocator<Variable*> >		VList;
+typedef std::map<const char*, Node*, NodeNameLess, ArenaAllocator<std::pair<const char* const, Node*> > >	NodeMap;
 
 /// Wze sceny.
 /** Klasa bazowa dla wszystkich elementw grafu sceny. Udostpnia metody operujce na grafie.
 	Zarzdza atrybutami i podwzami, tworzy poaczenia midzy wzami zalenymi, a take linki i
 	mapowania atrybutw. Zarzdza zalenociami pomidzy poszczeglnymi wzami podgrafu, ktrego
 	jest korzeniem, a take przelicza taki podgraf w razie koniecznoci. 
+	Wze utworzony w obszarze pamici (new(arena)) przekazuje ten obszar swoim atrybutom i podwzom
+	tworzonym przez kreatory, dziki czemu cay graf zajmuje kilka duych blokw zamiast tysicy
+	drobnych alokacji. Nazwa i listy wza take le w obszarze, wic graf z obszaru usuwa si razem
+	z nim, bez wywoywania destruktorw (destruktor potrzebny jest tylko przy deleteChild).
+	Zmiana wartoci atrybutu oznacza wze jako zmodyfikowany i zgasza go do grafu (NodeGraph), ktry
+	przelicza wycznie zmodyfikowane wzy oraz wzy od nich zalene.
 */
 class Node
 {
 protected:
-	std::string			nodeName;
+	Arena*				nodeArena;
+	const char*			nodeName;
 	Node*				nodeParent;
+	NodeGraph*			nodeGraph;
 
-	VMap				nodeVars;
-	NodeList			childList;
-	NodeList			affectedBy;
+	VList				nodeVars;
+	NodeArenaList		childList;
+	NodeArenaList		affectedBy;
 	NodeMap				childMap;
 
 	VReferenceList		outputVars;
-	NodeList			outputNodes;
+	NodeArenaList		outputNodes;
 	VReferenceList		linkDestVars;
 	VReferenceList		linkSourceVars;
-	NodeList			linkNodes;
+	NodeArenaList		linkNodes;
+	NodeArenaList		mapNodes;
 	 
 	bool				evaluated;
+	bool				modified;
+	unsigned int		evalIndex;		// Pozycja w porzdku topologicznym grafu
 protected:
 	bool			addDependencyNode(Node *pnode);
+	bool			addMapNode(Node *pnode);
 	void			updateAttrib(Variable *attrib);
 protected:
 	bool			setOutput(int);
@@ -74,9 +100,18 @@ protected:
 	bool			setOutput(Shader*);
 	bool			setOutput(Node*);
 public:
-	Node(const std::string &name, Node *parent);
+	Node(const std::string &name, Node *parent, Arena *arena=NULL);
 	virtual ~Node();
 
+	static void*	operator new(size_t size);
+	static void*	operator new(size_t size, Arena *arena);
+	static void		operator delete(void *object);
+	static void		operator delete(void *object, Arena *arena);
+
+	/// Zwraca obszar pamici wza (NULL dla wzw utworzonych na stercie).
+	static Arena*		getArena(const Node *pnode)
+	{ return pnode ? pnode->nodeArena : NULL; }
+
 	virtual const std::string getType(void) const
 	{ return std::string("node"); }
 
@@ -89,11 +124,20 @@ public:
 	virtual bool ignoreIntersection(void) const
 	{ return false; }
 
+	/// Czy cacheNode() zapisuje stan wspdzielony z innymi wzami (graf buforuje taki wze w jednym wtku).
+	virtual bool sharesCacheState(void) const
+	{ return false; }
+
 	bool isEvaluated(void) const
 	{ return evaluated; }
 
-	const std::string&	getName(void) const		{ return nodeName;		}
+	bool isModified(void) const
+	{ return modified; }
+
+	std::string			getName(void) const		{ return nodeName;		}
 	Node*				getParent(void) const	{ return nodeParent;	}
+	NodeGraph*			getGraph(void) const	{ return nodeGraph;		}
+	unsigned int		getEvalIndex(void) const{ return evalIndex;		}
 
 	Node*				getChild(unsigned int index);
 	Node*				getChild(const std::string &cname);
@@ -105,23 +149,41 @@ public:
 	bool				addChild(Node* child);
 
 	Variable*			getAttrib(unsigned int index, bool update=false);
+	Variable*			getAttrib(const AttribKey &key, bool update=false);
 	Variable*			getAttrib(const std::string &name, bool update=false);	
 	unsigned int		getAttribCount(void) const;
 	Variable*			addAttrib(Variable *value);
 
+	template<class T> bool getAttribValue(const AttribHandle<T> &handle, T &value, bool update=false)
+	{
+		Variable *attrib = getAttrib(handle, update);
+		return attrib && attrib->getValue(value);
+	}
+
 	bool				connect(Node *pnode, const std::string &attrName, unsigned int index=0);
+	bool				connect(Node *pnode, const AttribKey &attrKey, unsigned int index=0);
 	bool				link(Node *pnode, const std::string &src, const std::string &dst="", unsigned int srci=0, unsigned int dsti=0);
 	void				clearEvaluated(bool recursive);
+	void				evaluate(void);
+	void				cacheVariables(void);
+	void				markModified(void);
+	void				clearModified(void);
+	void				setGraph(NodeGraph *graph, bool recursive);
+	void				setEvalIndex(unsigned int index);
 	bool				hasOutput(void);
+	void				getDependentNodes(NodeList *referenceList);
+	void				getMappedNodes(NodeList *referenceList);
 	void				getObjectsArray(NodeList *referenceList);
 	void				getNodesArray(const std::string &type, NodeList *referenceList);
 
 	// Virtual methods
 	virtual bool		map(Node *pnode, unsigned int index=0);
 	virtual void		updateTransformation(const matrix4 *multiplyBy=NULL);
+	virtual void		transformNode(const matrix4 *multiplyBy=NULL);
 	virtual Node*		intersect(const vector3 &rayOrigin, const vector3 &rayDirection, float &rayDistance, int &factor, int &flag);
-	virtual void		evaluate(void);
-	virtual void		cacheVariables(void);
+	virtual bool		getRenderPrimitive(RenderPrimitive *primitive) const;
+	virtual void		evaluateNode(void);
+	virtual void		cacheNode(void);
 };
 
 /// Kreator klasy Node.
@@ -132,7 +194,7 @@ class NodeCreator
 {
 public:
 	virtual Node* operator()(const std::string &name, Node *parent=NULL) const
-	{ return new Node(name, parent); }
+	{ return new(Node::getArena(parent)) Node(name, parent); }
 };
 
 } // exRay
@@ -21,30 +21,34 @@
 #include "Node.h"
 #include "Object.h"
 #include "NodeBox.h"
+#include "../Core/RenderScene.h"
 
 using namespace exRay;
 
+// Uchwyty atrybutw.
+static const AttribHandle<vector3>	attrSize("size");
+
 NodeBox::NodeBox(const std::string &name, Node *parent) : Object(name, parent)
 {
-	addAttrib(new VFloat3("size"));
+	addAttrib(new(nodeArena) VFloat3(attrSize));
 }
 
 NodeBox::~NodeBox(void)
 {
 }
 
-void NodeBox::cacheVariables(void)
+void NodeBox::cacheNode(void)
 {
 	vector4	worldPosition(cPosition, 1.0f);
 	worldPosition	= worldTM * vector4(0.0f, 0.0f, 0.0f, 1.0f);
 	cPosition		= vector3(worldPosition.x, worldPosition.y, worldPosition.z);
 
-	getAttrib("size")->getValue(cSize);
+	getAttribValue(attrSize, cSize);
 
 	cDim[0] = cPosition;
 	cDim[1] = cPosition + cSize;
 
-	Object::cacheVariables();
+	Object::cacheNode();
 }
 
 vector3 NodeBox::getNormal(const vector3 &intPoint, const int intersectFlag)
@@ -126,3 +130,12 @@ Node* NodeBox::intersect(const vector3 &rayOrigin, const vector3 &rayDirection,
 	}
 	return result;
 }
+
+bool NodeBox::getRenderPrimitive(RenderPrimitive *primitive) const
+{
+	primitive->type		= RenderScene::PrimitiveBox;
+	primitive->data[0]	= cDim[0];
+	primitive->data[1]	= cDim[1];
+	primitive->scalar	= 0.0f;
+	return true;
+}
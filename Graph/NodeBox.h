@@ -32,9 +32,10 @@ public:
 	NodeBox(const std::string &name, Node *parent);
 	virtual ~NodeBox(void);
 
-	virtual void	cacheVariables(void);
+	virtual void	cacheNode(void);
 	virtual vector3	getNormal(const vector3 &intPoint, const int intersectFlag);
 	virtual Node*	intersect(const vector3 &rayOrigin, const vector3 &rayDirection, float &rayDistance, int &factor, int &flag);
+	virtual bool	getRenderPrimitive(RenderPrimitive *primitive) const;
 
 	virtual const std::string getType(void) const
 	{ return std::string("box"); }
@@ -55,7 +56,7 @@ class NodeBoxCreator : public NodeCreator
 {
 public:
 	virtual Node* operator()(const std::string &name, Node *parent=NULL) const
-	{ return new NodeBox(name, parent); }
+	{ return new(Node::getArena(parent)) NodeBox(name, parent); }
 };
 
 } // exRay
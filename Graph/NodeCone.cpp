@@ -32,7 +32,7 @@ NodeCone::~NodeCone(void)
 {
 }
 
-void NodeCone::cacheVariables(void)
+void NodeCone::cacheNode(void)
 {
 }
 
@@ -29,7 +29,7 @@ public:
 	NodeCone(const std::string &name, Node *parent);
 	virtual ~NodeCone(void);
 
-	virtual void	cacheVariables(void);
+	virtual void	cacheNode(void);
 	virtual vector3	getNormal(const vector3 &intPoint, const int intersectFlag);
 	virtual Node*	intersect(const vector3 &rayOrigin, const vector3 &rayDirection, float &rayDistance, int &factor, int &flag);
 
@@ -42,7 +42,7 @@ class NodeConeCreator : public NodeCreator
 {
 public:
 	virtual Node* operator()(const std::string &name, Node *parent=NULL) const
-	{ return new NodeCone(name, parent); }
+	{ return new(Node::getArena(parent)) NodeCone(name, parent); }
 };
 
 } // exRay
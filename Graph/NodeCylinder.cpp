@@ -33,9 +33,9 @@ NodeCylinder::~NodeCylinder(void)
 {
 }
 
-void NodeCylinder::cacheVariables(void)
+void NodeCylinder::cacheNode(void)
 {
-	Object::cacheVariables();
+	Object::cacheNode();
 }
 
 vector3 NodeCylinder::getNormal(const vector3 &intPoint, const int intersectFlag)
@@ -28,7 +28,7 @@ public:
 	NodeCylinder(const std::string &name, Node *parent);
 	virtual ~NodeCylinder(void);
 
-	virtual void	cacheVariables(void);
+	virtual void	cacheNode(void);
 	virtual vector3	getNormal(const vector3 &intPoint, const int intersectFlag);
 	virtual Node*	intersect(const vector3 &rayOrigin, const vector3 &rayDirection, float &rayDistance, int &factor, int &flag);
 
@@ -41,7 +41,7 @@ class NodeCylinderCreator : public NodeCreator
 {
 public:
 	virtual Node* operator()(const std::string &name, Node *parent=NULL) const
-	{ return new NodeCylinder(name, parent); }
+	{ return new(Node::getArena(parent)) NodeCylinder(name, parent); }
 };
 
 } // exRay
@@ -0,0 +1,478 @@
+/*
+	This file is part of EX-Ray Raytracing Engine.
+	(C)2007 - 2008 Micha Siejak.
+
+    EX-Ray is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EX-Ray is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with EX-Ray.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../Config.h"
+#include <algorithm>
+#include "Variable.h"
+#include "Node.h"
+#include "NodeGraph.h"
+
+#ifdef WIN32 // WIN32 PLATFORM SPECIFIC
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+using namespace exRay;
+
+/// Zadanie wtkw roboczych grafu.
+/** Wzy pobierane s z listy porcjami, dopki lista si nie wyczerpie. */
+class exRay::GraphTask
+{
+public:
+	NodeList				*nodes;
+	int						phase;
+	volatile unsigned int	next;
+};
+
+// Operacje atomowe na danych wspdzielonych przez wtki robocze.
+static unsigned int lockedExchangeAdd(volatile unsigned int *dest, unsigned int value)
+{
+#ifdef WIN32
+	return (unsigned int)InterlockedExchangeAdd((volatile LONG*)dest, (LONG)value);
+#else
+	unsigned int result = *dest;
+	*dest += value;
+	return result;
+#endif
+}
+
+static void acquireLock(volatile unsigned int *lock)
+{
+#ifdef WIN32
+	while(InterlockedCompareExchange((volatile LONG*)lock, 1, 0) != 0)
+		Sleep(0);
+#endif
+}
+
+static void releaseLock(volatile unsigned int *lock)
+{
+#ifdef WIN32
+	InterlockedExchange((volatile LONG*)lock, 0);
+#else
+	*lock = 0;
+#endif
+}
+
+NodeGraph::NodeGraph(Node *root, const unsigned int threads)
+{
+	rootNode		= root;
+	orderValid		= false;
+	orderAcyclic	= true;
+	dirtyLock		= 0;
+	workersActive	= false;
+	setThreads(threads);
+
+	rootNode->setGraph(this, true);
+	if(rootNode->isModified())
+		dirtyNodes.push_back(rootNode);
+}
+
+// Wzy grafu przestaj zgasza zmiany; niszczenie drzewa nie musi wtedy aktualizowa kolejki.
+// Drzewo z obszaru pamici nie jest niszczone wze po wle, tylko zwalniane razem z obszarem.
+NodeGraph::~NodeGraph(void)
+{
+	if(!Node::getArena(rootNode))
+		rootNode->setGraph(NULL, true);
+}
+
+void NodeGraph::setThreads(const unsigned int threads)
+{
+	threadCount = threads > 0 ? threads : 1;
+}
+
+unsigned int NodeGraph::getThreads(void) const
+{ return threadCount; }
+
+bool NodeGraph::earlierInOrder(const Node *a, const Node *b)
+{
+	return a->getEvalIndex() < b->getEvalIndex();
+}
+
+// Odwrcone porwnanie: std::push_heap utrzymuje na szczycie wze o najmniejszym indeksie.
+bool NodeGraph::laterInOrder(const Node *a, const Node *b)
+{
+	return a->getEvalIndex() > b->getEvalIndex();
+}
+
+void NodeGraph::getSubtree(Node *pnode, NodeList *referenceList)
+{
+	referenceList->push_back(pnode);
+	for(unsigned int i=0; i<pnode->getChildCount(); i++)
+		getSubtree(pnode->getChild(i), referenceList);
+}
+
+unsigned long __stdcall NodeGraph::workerProc(void *pTask)
+{
+	GraphTask		*task	= (GraphTask*)pTask;
+	unsigned int	count	= (unsigned int)task->nodes->size();
+
+	unsigned int	first;
+	while((first = lockedExchangeAdd(&task->next, NodeGraph::TaskChunkSize)) < count)
+	{
+		unsigned int last = first + NodeGraph::TaskChunkSize;
+		if(last > count)
+			last = count;
+
+		for(unsigned int i=first; i<last; i++)
+		{
+			Node *pnode = (*task->nodes)[i];
+			switch(task->phase)
+			{
+			case NodeGraph::TaskEvaluate:	pnode->evaluateNode();			break;
+			case NodeGraph::TaskTransform:	pnode->updateTransformation();	break;
+			case NodeGraph::TaskCache:		pnode->cacheNode();				break;
+			}
+		}
+	}
+	return 0;
+}
+
+// Wzy listy musz by od siebie niezalene. Wtek wywoujcy rwnie wykonuje zadanie.
+void NodeGraph::runTask(NodeList &nodes, const int phase)
+{
+	GraphTask	task;
+	task.nodes	= &nodes;
+	task.phase	= phase;
+	task.next	= 0;
+
+	unsigned int workers = threadCount;
+	if(nodes.size() < NodeGraph::MinParallelNodes)
+		workers = 1;
+
+	std::vector<void*>	threads(workers, (void*)NULL);
+	workersActive = (workers > 1);
+	for(unsigned int i=1; i<workers; i++)
+	{
+#ifdef WIN32
+		threads[i] = CreateThread(NULL, 0, NodeGraph::workerProc, &task, 0, NULL);
+#endif
+	}
+	workerProc(&task);
+
+	for(unsigned int i=1; i<workers; i++)
+	{
+		if(threads[i])
+		{
+#ifdef WIN32
+			WaitForSingleObject(threads[i], INFINITE);
+			CloseHandle(threads[i]);
+#endif
+		}
+	}
+	workersActive = false;
+}
+
+/** Algorytm Kahna wykonywany falami: poziom wza to dugo najduszej cieki zalenoci prowadzcej
+	do niego. W obrbie poziomu wzy uoone s w porzdku drzewa (preorder), dziki czemu wzy niezalene
+	zachowuj kolejno dotychczasowej rekurencji. Wzy tworzce cykl dopisywane s na kocu w porzdku
+	drzewa, kady na osobnym poziomie, a metoda zwraca wtedy false.
+*/
+bool NodeGraph::buildOrder(void)
+{
+	NodeList	treeOrder;
+	getSubtree(rootNode, &treeOrder);
+
+	const unsigned int nodeCount = (unsigned int)treeOrder.size();
+	for(unsigned int i=0; i<nodeCount; i++)
+		treeOrder[i]->setEvalIndex(i);
+
+	// Krawdzie zalenoci w jednej tablicy: zaleni wza i to dependents[dependentsStart[i]..dependentsStart[i+1]).
+	std::vector<unsigned int>	inDegree(nodeCount, 0);
+	std::vector<unsigned int>	dependentsStart(nodeCount+1, 0);
+	NodeList					dependents;
+	NodeList					mapped;
+	std::vector<char>			treeSerialCache(nodeCount, 0);
+	for(unsigned int i=0; i<nodeCount; i++)
+	{
+		const unsigned int first = (unsigned int)dependents.size();
+		treeOrder[i]->getDependentNodes(&dependents);
+
+		unsigned int last = first;
+		for(unsigned int d=first; d<dependents.size(); d++)
+		{
+			// Wzy spoza drzewa (np. odrzucone przy dodawaniu) nie maj pozycji w porzdku. Poczenia wza
+			// z samym sob (np. link wiata) kopiuje jego wasne evaluateNode, wic nie s zalenociami.
+			if(dependents[d]->getGraph() != this || dependents[d] == treeOrder[i])
+				continue;
+			dependents[last++] = dependents[d];
+			inDegree[dependents[d]->getEvalIndex()]++;
+		}
+		dependents.resize(last);
+		dependentsStart[i+1] = last;
+
+		if(treeOrder[i]->sharesCacheState())
+			treeSerialCache[i] = 1;
+		mapped.clear();
+		treeOrder[i]->getMappedNodes(&mapped);
+		for(NodeList::iterator d=mapped.begin(); d<mapped.end(); d++)
+		{
+			if((*d)->getGraph() == this)
+				treeSerialCache[(*d)->getEvalIndex()] = 1;
+		}
+	}
+
+	std::vector<unsigned int>	wave, nextWave;
+	for(unsigned int i=0; i<nodeCount; i++)
+	{
+		if(inDegree[i] == 0)
+			wave.push_back(i);
+	}
+
+	std::vector<unsigned int>	treeLevels(nodeCount, 0);
+	unsigned int				level = 0;
+
+	evalOrder.clear();
+	evalOrder.reserve(nodeCount);
+	while(!wave.empty())
+	{
+		nextWave.clear();
+		for(std::vector<unsigned int>::iterator w=wave.begin(); w<wave.end(); w++)
+		{
+			evalOrder.push_back(treeOrder[*w]);
+			treeLevels[*w] = level;
+
+			for(unsigned int d=dependentsStart[*w]; d<dependentsStart[*w+1]; d++)
+			{
+				unsigned int index = dependents[d]->getEvalIndex();
+				if(--inDegree[index] == 0)
+					nextWave.push_back(index);
+			}
+		}
+		std::sort(nextWave.begin(), nextWave.end());
+		wave.swap(nextWave);
+		level++;
+	}
+
+	orderAcyclic = (evalOrder.size() == nodeCount);
+	if(!orderAcyclic)
+	{
+		for(unsigned int i=0; i<nodeCount; i++)
+		{
+			if(inDegree[i] > 0)
+			{
+				evalOrder.push_back(treeOrder[i]);
+				treeLevels[i] = level++;
+			}
+		}
+	}
+
+	evalLevels.resize(nodeCount);
+	serialCache.resize(nodeCount);
+	for(unsigned int i=0; i<nodeCount; i++)
+	{
+		unsigned int treeIndex = evalOrder[i]->getEvalIndex();
+		evalLevels[i] = treeLevels[treeIndex];
+		serialCache[i] = treeSerialCache[treeIndex];
+	}
+	for(unsigned int i=0; i<nodeCount; i++)
+		evalOrder[i]->setEvalIndex(i);
+
+	std::make_heap(dirtyNodes.begin(), dirtyNodes.end(), NodeGraph::laterInOrder);
+	orderValid = true;
+	return orderAcyclic;
+}
+
+// Poziom wza w aktualnym porzdku (po buildOrder).
+unsigned int NodeGraph::getLevel(const Node *pnode) const
+{
+	return evalLevels[pnode->getEvalIndex()];
+}
+
+void NodeGraph::invalidateOrder(void)
+{
+	orderValid = false;
+}
+
+// Wywoywana take z wtkw roboczych (zmiany atrybutw podczas ewaluacji).
+void NodeGraph::markDirty(Node *pnode)
+{
+	if(workersActive)
+		acquireLock(&dirtyLock);
+
+	dirtyNodes.push_back(pnode);
+	if(orderValid)
+		std::push_heap(dirtyNodes.begin(), dirtyNodes.end(), NodeGraph::laterInOrder);
+
+	if(workersActive)
+		releaseLock(&dirtyLock);
+}
+
+void NodeGraph::removeNode(Node *pnode)
+{
+	orderValid = false;
+	if(pnode->isModified())
+	{
+		NodeList::iterator it = std::find(dirtyNodes.begin(), dirtyNodes.end(), pnode);
+		if(it != dirtyNodes.end())
+			dirtyNodes.erase(it);
+	}
+	NodeList::iterator it = std::find(cacheList.begin(), cacheList.end(), pnode);
+	if(it != cacheList.end())
+		cacheList.erase(it);
+	it = std::find(serialCacheList.begin(), serialCacheList.end(), pnode);
+	if(it != serialCacheList.end())
+		serialCacheList.erase(it);
+}
+
+/** Najwyej pooone zmienione wzy maj rozczne poddrzewa. Jeli jest ich za mao dla wszystkich wtkw,
+	s rozwijane: wze przelicza wasn transformacj, a jego dzieci staj si osobnymi zadaniami.
+*/
+void NodeGraph::updateTransformations(const NodeList &topNodes)
+{
+	NodeList	tasks(topNodes);
+	while(threadCount > 1 && tasks.size() < threadCount*NodeGraph::TasksPerThread)
+	{
+		NodeList	expanded;
+		bool		split = false;
+		for(NodeList::iterator i=tasks.begin(); i<tasks.end(); i++)
+		{
+			if((*i)->getChildCount() == 0)
+			{
+				expanded.push_back(*i);
+				continue;
+			}
+			(*i)->transformNode();
+			for(unsigned int j=0; j<(*i)->getChildCount(); j++)
+				expanded.push_back((*i)->getChild(j));
+			split = true;
+		}
+		tasks.swap(expanded);
+		if(!split)
+			break;
+	}
+	runTask(tasks, NodeGraph::TaskTransform);
+}
+
+/** Zwraca liczb przeliczonych wzw. Wzy przetwarzane s poziomami; wze pozostaje oznaczony jako
+	zmodyfikowany do koca ewaluacji, wic w obrbie jednego wywoania kady wze przeliczany jest co
+	najwyej raz (take w cyklu). Wze zgoszony rwnoczenie przez kilka wtkw trafia do kolejki
+	wielokrotnie - duplikaty ssiaduj w kopcu i s pomijane.
+*/
+unsigned int NodeGraph::evaluate(void)
+{
+	if(!orderValid)
+		buildOrder();
+
+	NodeList	updated;
+	NodeList	batch;
+
+	// Przy duej liczbie zmian (np. pierwsza ewaluacja) liniowy przegld porzdku jest taszy od kopca.
+	// Wzy oznaczone w trakcie przegldu le dalej w porzdku, wic zostan jeszcze odwiedzone.
+	if(dirtyNodes.size() > evalOrder.size()/NodeGraph::SweepRatio)
+	{
+		const unsigned int nodeCount = (unsigned int)evalOrder.size();
+		for(unsigned int first=0; first<nodeCount; )
+		{
+			unsigned int last = first;
+			batch.clear();
+			while(last < nodeCount && evalLevels[last] == evalLevels[first])
+			{
+				if(evalOrder[last]->isModified())
+					batch.push_back(evalOrder[last]);
+				last++;
+			}
+			runTask(batch, NodeGraph::TaskEvaluate);
+			updated.insert(updated.end(), batch.begin(), batch.end());
+			first = last;
+		}
+		dirtyNodes.clear();
+	}
+
+	while(!dirtyNodes.empty())
+	{
+		const unsigned int level = evalLevels[dirtyNodes.front()->getEvalIndex()];
+
+		batch.clear();
+		while(!dirtyNodes.empty() && evalLevels[dirtyNodes.front()->getEvalIndex()] == level)
+		{
+			std::pop_heap(dirtyNodes.begin(), dirtyNodes.end(), NodeGraph::laterInOrder);
+			Node *pnode = dirtyNodes.back();
+			dirtyNodes.pop_back();
+			if(batch.empty() || batch.back() != pnode)
+				batch.push_back(pnode);
+		}
+		runTask(batch, NodeGraph::TaskEvaluate);
+		updated.insert(updated.end(), batch.begin(), batch.end());
+	}
+
+	// Transformacje: wystarczy przeliczy najwyej pooone zmienione wzy, rekurencja obejmie reszt.
+	NodeList			topNodes;
+	std::vector<char>	cached(evalOrder.size(), 0);
+	for(NodeList::iterator i=cacheList.begin(); i<cacheList.end(); i++)
+		cached[(*i)->getEvalIndex()] = 1;
+	for(NodeList::iterator i=serialCacheList.begin(); i<serialCacheList.end(); i++)
+		cached[(*i)->getEvalIndex()] = 1;
+
+	for(NodeList::iterator i=updated.begin(); i<updated.end(); i++)
+	{
+		Node *ancestor = (*i)->getParent();
+		while(ancestor && !ancestor->isModified())
+			ancestor = ancestor->getParent();
+		if(ancestor)
+			continue;
+
+		topNodes.push_back(*i);
+
+		NodeList	subtree;
+		getSubtree(*i, &subtree);
+		for(NodeList::iterator j=subtree.begin(); j<subtree.end(); j++)
+		{
+			const unsigned int index = (*j)->getEvalIndex();
+			if(cached[index])
+				continue;
+			cached[index] = 1;
+			if(serialCache[index])
+				serialCacheList.push_back(*j);
+			else cacheList.push_back(*j);
+		}
+	}
+	updateTransformations(topNodes);
+
+	// Wzy mapujce zmienione wzy odczytuj je podczas buforowania, wic buforowane s po nich,
+	// w jednym wtku (mog wspdzieli instancj shadera, tak jak wszystkie wzy z sharesCacheState()).
+	for(unsigned int k=0; k<2; k++)
+	{
+		NodeList &source = k ? serialCacheList : cacheList;
+		for(unsigned int i=0; i<source.size(); i++)
+		{
+			NodeList	mapped;
+			source[i]->getMappedNodes(&mapped);
+			for(NodeList::iterator j=mapped.begin(); j<mapped.end(); j++)
+			{
+				if((*j)->getGraph() != this || cached[(*j)->getEvalIndex()])
+					continue;
+				cached[(*j)->getEvalIndex()] = 1;
+				serialCacheList.push_back(*j);
+			}
+		}
+	}
+	std::sort(serialCacheList.begin(), serialCacheList.end(), NodeGraph::earlierInOrder);
+
+	for(NodeList::iterator i=updated.begin(); i<updated.end(); i++)
+		(*i)->clearModified();
+	return (unsigned int)updated.size();
+}
+
+void NodeGraph::cacheVariables(void)
+{
+	runTask(cacheList, NodeGraph::TaskCache);
+	for(NodeList::iterator i=serialCacheList.begin(); i<serialCacheList.end(); i++)
+		(*i)->cacheNode();
+	cacheList.clear();
+	serialCacheList.clear();
+}
\ No newline at end of file
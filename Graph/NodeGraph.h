@@ -0,0 +1,99 @@
+/*
+	This file is part of EX-Ray Raytracing Engine.
+	(C)2007 - 2008 Micha Siejak.
+
+    EX-Ray is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EX-Ray is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with EX-Ray.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __NODE_GRAPH_H
+#define __NODE_GRAPH_H
+
+namespace exRay {
+
+class Node;
+class GraphTask;
+
+/// Przyrostowy ewaluator grafu sceny.
+/** Zalenoci midzy wzami (connect, link, map) kompilowane s do porzdku topologicznego, budowanego
+	ponownie tylko po zmianie struktury grafu. Wzy zmodyfikowane (Node::markModified) trafiaj do kolejki
+	uporzdkowanej wedug tego porzdku. Ewaluacja przelicza wycznie wzy z kolejki; wze zaleny trafia
+	do niej dopiero wtedy, gdy ewaluacja faktycznie zmieni warto jego atrybutu. Nastpnie przeliczane s
+	transformacje poddrzew zmienionych wzw, a buforowanie obejmuje tylko te poddrzewa oraz wzy,
+	ktre je mapuj.
+	Porzdek dzielony jest na poziomy: wzy jednego poziomu nie zale od siebie nawzajem. Due poziomy,
+	niezalene poddrzewa transformacji oraz buforowanie rozdzielane s pomidzy wtki robocze.
+*/
+class NodeGraph
+{
+private:
+	Node*						rootNode;
+	NodeList					evalOrder;
+	std::vector<unsigned int>	evalLevels;		// Poziom wza wedug pozycji w porzdku
+	std::vector<char>			serialCache;	// Wzy buforowane w jednym wtku (mapowane, shadery)
+	NodeList					dirtyNodes;		// Kopiec wedug Node::getEvalIndex()
+	NodeList					cacheList;
+	NodeList					serialCacheList;
+	bool						orderValid;
+	bool						orderAcyclic;
+
+	unsigned int				threadCount;
+	volatile unsigned int		dirtyLock;
+	bool						workersActive;
+private:
+	static bool					earlierInOrder(const Node *a, const Node *b);
+	static bool					laterInOrder(const Node *a, const Node *b);
+	static void					getSubtree(Node *pnode, NodeList *referenceList);
+	static unsigned long __stdcall	workerProc(void *pTask);
+
+	void						runTask(NodeList &nodes, const int phase);
+	void						updateTransformations(const NodeList &topNodes);
+public:
+	NodeGraph(Node *root, const unsigned int threads=1);
+	~NodeGraph(void);
+
+	Node*						getRootNode(void) const
+	{ return rootNode; }
+
+	bool						isAcyclic(void) const
+	{ return orderAcyclic; }
+
+	void						setThreads(const unsigned int threads);
+	unsigned int				getThreads(void) const;
+
+	bool						buildOrder(void);
+	unsigned int				getLevel(const Node *pnode) const;
+	void						invalidateOrder(void);
+	void						markDirty(Node *pnode);
+	void						removeNode(Node *pnode);
+
+	unsigned int				evaluate(void);
+	void						cacheVariables(void);
+
+	enum
+	{
+		// Fazy zada wtkw roboczych.
+		TaskEvaluate,
+		TaskTransform,
+		TaskCache,
+
+		MinParallelNodes	= 2048,	// Mniejsze zbiory wzw przetwarzane s w wtku wywoujcym
+		TaskChunkSize		= 64,	// Liczba wzw pobieranych jednorazowo przez wtek
+		TasksPerThread		= 8,
+		SweepRatio			= 16,	// Powyej 1/SweepRatio zmienionych wzw ewaluacja przeglda cay porzdek
+	};
+};
+
+} // exRay
+
+#endif
\ No newline at end of file
@@ -21,15 +21,22 @@
 #include "Node.h"
 #include "Object.h"
 #include "NodeLight.h"
+#include "../Core/RenderScene.h"
 
 using namespace exRay;
 
+// Uchwyty atrybutw.
+static const AttribHandle<vector2>	attrSize("size");
+static const AttribHandle<vector3>	attrDirection("direction");
+
 NodeLight::NodeLight(const std::string &name, Node *parent) : Object(name, parent)
 {
-	addAttrib(new VFloat3("direction"));
+	addAttrib(new(nodeArena) VFloat3(attrDirection));
 	link(this, "position", "direction");
 
-	addAttrib(new VFloat3("color"));
+	addAttrib(new(nodeArena) VFloat3(attrColor));
+	addAttrib(new(nodeArena) VFloat(attrRadius));
+	cRadius = 0.0f;
 	//addAttrib(new VFloat("ambient"));
 	//addAttrib(new VFloat("diffuse"));
 	//addAttrib(new VFloat("specular"));
@@ -39,46 +46,51 @@ NodeLight::~NodeLight(void)
 {
 }
 
-void NodeLight::cacheVariables(void)
+void NodeLight::cacheNode(void)
 {
 	vector4	worldPosition(cPosition, 1.0f);
 	worldPosition	= worldTM * vector4(0.0f, 0.0f, 0.0f, 1.0f);
 	cPosition		= vector3(worldPosition.x, worldPosition.y, worldPosition.z);
+	getAttribValue(attrColor, cColor);
+	getAttribValue(attrRadius, cRadius);
+	if(cRadius < 0.0f)
+		cRadius = 0.0f;
 
-	Object::cacheVariables();
+	Object::cacheNode();
 }
 
 bool NodeLight::map(Node *pnode, unsigned int index)
 {
-	Variable	*envLight = pnode->getAttrib("env_light");
+	Variable	*envLight = pnode->getAttrib(attrEnvLight);
 	if(envLight == NULL)
 		return false;
 	Node	*outReference = (Node*)this;
 	envLight->pushValue(outReference);
+	addMapNode(pnode);
 	return true;
 }
 
 NodeAreaLight::NodeAreaLight(const std::string &name, Node *parent) : NodeLight(name, parent)
 {
-	addAttrib(new VFloat2("size"));
+	addAttrib(new(nodeArena) VFloat2(attrSize));
 }
 
 NodeAreaLight::~NodeAreaLight(void)
 {
 }
 
-void NodeAreaLight::cacheVariables(void)
+void NodeAreaLight::cacheNode(void)
 {
-	NodeLight::cacheVariables();
+	NodeLight::cacheNode();
 
 	vector2	cArea;
-	getAttrib("size")->getValue(cArea);
+	getAttribValue(attrSize, cArea);
 	cSize	= vector3(cArea.x, 0.0f, cArea.y);
 
 	cDim[0] = cPosition;
 	cDim[1] = cPosition + cSize;
 
-	//Object::cacheVariables();
+	//Object::cacheNode();
 }
 
 Node* NodeAreaLight::intersect(const vector3 &rayOrigin, const vector3 &rayDirection, float &rayDistance, int &factor, int &flag)
@@ -125,4 +137,13 @@ Node* NodeAreaLight::intersect(const vector3 &rayOrigin, const vector3 &rayDirec
 		}
 	}
 	return result;
+}
+
+bool NodeAreaLight::getRenderPrimitive(RenderPrimitive *primitive) const
+{
+	primitive->type		= RenderScene::PrimitiveAreaLight;
+	primitive->data[0]	= cDim[0];
+	primitive->data[1]	= cDim[1];
+	primitive->scalar	= 0.0f;
+	return true;
 }
\ No newline at end of file
@@ -22,10 +22,15 @@
 namespace exRay {
 
 /// Standardowe wiato punktowe.
+/** Atrybut radius (domylnie 0 - zasig nieograniczony) ogranicza zasig wiata: jego wkad maleje agodnie
+	do zera w odlegoci radius, a dalsze punkty nie wysyaj do niego promieni cienia.
+*/
 class NodeLight : public Object
 {
 protected:
 	vector3	cPosition;
+	vector3	cColor;
+	float	cRadius;
 public:
 	NodeLight(const std::string &name, Node *parent);
 	virtual ~NodeLight(void);
@@ -34,7 +39,7 @@ public:
 	virtual const std::string getType(void) const
 	{ return std::string("light"); }
 
-	virtual void	cacheVariables(void);
+	virtual void	cacheNode(void);
 	virtual bool	isAreaLight(void) const
 	{ return false; }
 
@@ -45,6 +50,10 @@ public:
 	{ return cPosition; }
 	virtual vector2	getCachedArea(void) const
 	{ return vector2(); }
+	vector3			getCachedColor(void) const
+	{ return cColor; }
+	float			getCachedRadius(void) const
+	{ return cRadius; }
 };
 
 /// Kreator klasy NodeLight.
@@ -52,7 +61,7 @@ class NodeLightCreator : public NodeCreator
 {
 public:
 	virtual Node* operator()(const std::string &name, Node *parent=NULL) const
-	{ return new NodeLight(name, parent); }
+	{ return new(Node::getArena(parent)) NodeLight(name, parent); }
 };
 
 /// wiato powierzchniowe.
@@ -74,8 +83,9 @@ public:
 	virtual bool ignoreIntersection(void) const
 	{ return true; }
 
-	virtual void	cacheVariables(void);
+	virtual void	cacheNode(void);
 	virtual Node*	intersect(const vector3 &rayOrigin, const vector3 &rayDirection, float &rayDistance, int &factor, int &flag);
+	virtual bool	getRenderPrimitive(RenderPrimitive *primitive) const;
 
 	virtual vector2	getCachedArea(void) const
 	{ return vector2(cSize.x, cSize.z); }
@@ -86,7 +96,7 @@ class NodeAreaLightCreator : public NodeCreator
 {
 public:
 	virtual Node* operator()(const std::string &name, Node *parent=NULL) const
-	{ return new NodeAreaLight(name, parent); }
+	{ return new(Node::getArena(parent)) NodeAreaLight(name, parent); }
 };
 
 } // exRay
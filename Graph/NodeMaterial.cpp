@@ -20,19 +20,27 @@
 #include "Variable.h"
 #include "Node.h"
 #include "NodeMaterial.h"
-#include "../Types/Shader.h"
+#include "../Core/RenderScene.h"
 
 using namespace exRay;
 
+// Uchwyty atrybutw.
+static const AttribHandle<float>	attrDiffuse("diffuse");
+static const AttribHandle<float>	attrSpecular("specular");
+static const AttribHandle<float>	attrSpecularExponent("specular_exponent");
+static const AttribHandle<float>	attrReflectance("reflectance");
+static const AttribHandle<float>	attrRefraction("refraction");
+static const AttribHandle<float>	attrDensity("density");
+
 NodeMaterial::NodeMaterial(const std::string &name, Node *parent) : Node(name, parent)
 {
-	addAttrib(new VFloat3("color"));
-	addAttrib(new VFloat("diffuse"));
-	addAttrib(new VFloat("specular"));
-	addAttrib(new VFloat("specular_exponent"));
-	addAttrib(new VFloat("reflectance"));
-	addAttrib(new VFloat("refraction"));
-	addAttrib(new VFloat("density"));
+	addAttrib(new(nodeArena) VFloat3(attrColor));
+	addAttrib(new(nodeArena) VFloat(attrDiffuse));
+	addAttrib(new(nodeArena) VFloat(attrSpecular));
+	addAttrib(new(nodeArena) VFloat(attrSpecularExponent));
+	addAttrib(new(nodeArena) VFloat(attrReflectance));
+	addAttrib(new(nodeArena) VFloat(attrRefraction));
+	addAttrib(new(nodeArena) VFloat(attrDensity));
 }
 
 NodeMaterial::~NodeMaterial(void)
@@ -46,35 +54,41 @@ bool NodeMaterial::acceptsConnection(Variable *cvariable) const
 	return true;
 }
 
-void NodeMaterial::cacheVariables(void)
+void NodeMaterial::cacheNode(void)
 {
-	getAttrib("color")->getValue(cColor);
-	getAttrib("diffuse")->getValue(cDiffuse);
-	getAttrib("specular")->getValue(cSpecular);
-	getAttrib("specular_exponent")->getValue(cSpecularExponent);
-	getAttrib("reflectance")->getValue(cReflectance);
-	getAttrib("refraction")->getValue(cRefraction);
-	getAttrib("density")->getValue(cDensity);
+	getAttribValue(attrColor, cColor);
+	getAttribValue(attrDiffuse, cDiffuse);
+	getAttribValue(attrSpecular, cSpecular);
+	getAttribValue(attrSpecularExponent, cSpecularExponent);
+	getAttribValue(attrReflectance, cReflectance);
+	getAttribValue(attrRefraction, cRefraction);
+	getAttribValue(attrDensity, cDensity);
 	
-	Node::cacheVariables();
+	Node::cacheNode();
 }
 
-void NodeMaterial::updateShader(ShaderUniforms *su)
+void NodeMaterial::getRenderMaterial(RenderMaterial *material) const
 {
-	su->MaterialColor			 = &cColor;
-	su->MaterialDiffuse			 = cDiffuse;
-	su->MaterialSpecular		 = cSpecular;
-	su->MaterialSpecularExponent = cSpecularExponent;
-	su->MaterialReflectance		 = cReflectance;
+	material->color				= cColor;
+	material->diffuse			= cDiffuse;
+	material->specular			= cSpecular;
+	material->specularExponent	= cSpecularExponent;
+	material->reflectance		= cReflectance;
+	material->refraction		= cRefraction;
+	material->density			= cDensity;
+
+	material->features			= RenderMaterial::FeatureDiffuse;
+	if(cSpecular > 0.0f)	material->features |= RenderMaterial::FeatureSpecular;
+	if(cReflectance > 0.0f)	material->features |= RenderMaterial::FeatureReflection;
+	if(cRefraction > 0.0f)	material->features |= RenderMaterial::FeatureRefraction;
 }
 
-void NodeMaterial::evaluate(void)
+void NodeMaterial::evaluateNode(void)
 {
-	if(evaluated) return;
 	if(hasOutput())
 		setOutput(this);
 
-	Node::evaluate();
+	Node::evaluateNode();
 }
 
 bool NodeMaterial::isReflective(void) const
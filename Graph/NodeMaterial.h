@@ -21,7 +21,7 @@
 
 namespace exRay {
 
-class ShaderUniforms;
+class RenderMaterial;
 
 /// Standardowy materia obiektu.
 /** Wze sceny bdcy definicj standardowego materiau */
@@ -39,9 +39,9 @@ public:
 	NodeMaterial(const std::string &name, Node *parent);
 	virtual ~NodeMaterial(void);
 
-	virtual void	cacheVariables(void);
+	virtual void	cacheNode(void);
 	virtual bool	acceptsConnection(Variable *cvariable) const;
-	virtual void	evaluate(void);
+	virtual void	evaluateNode(void);
 
 	bool			isReflective(void) const;
 	bool			isRefractive(const float rindex) const;
@@ -50,7 +50,7 @@ public:
 	float			getRefractionIndex(void) const;
 	float			getDensity(void) const;
 
-	void			updateShader(ShaderUniforms *su);
+	void			getRenderMaterial(RenderMaterial *material) const;
 
 	virtual const std::string getType(void) const
 	{ return std::string("material"); }
@@ -61,7 +61,7 @@ class NodeMaterialCreator : public NodeCreator
 {
 public:
 	virtual Node* operator()(const std::string &name, Node *parent=NULL) const
-	{ return new NodeMaterial(name, parent); }
+	{ return new(Node::getArena(parent)) NodeMaterial(name, parent); }
 };
 
 } // exRay
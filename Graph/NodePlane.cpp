@@ -21,35 +21,37 @@
 #include "Node.h"
 #include "Object.h"
 #include "NodePlane.h"
+#include "../Core/RenderScene.h"
 
 using namespace exRay;
 
+// Uchwyty atrybutw.
+static const AttribHandle<vector3>	attrNormal("normal");
+static const AttribHandle<float>	attrDistance("distance");
+
 NodePlane::NodePlane(const std::string &name, Node *parent) : Object(name, parent)
 {
-	addAttrib(new VFloat3("normal"));
-	addAttrib(new VFloat("distance"));
+	addAttrib(new(nodeArena) VFloat3(attrNormal));
+	addAttrib(new(nodeArena) VFloat(attrDistance));
 }
 
 NodePlane::~NodePlane(void)
 {
 }
 
-void NodePlane::cacheVariables(void)
+void NodePlane::cacheNode(void)
 {
-	getAttrib("normal")->getValue(cNormal);
-	getAttrib("distance")->getValue(cDistance);
+	getAttribValue(attrNormal, cNormal);
+	getAttribValue(attrDistance, cDistance);
 	cNormal.normalize();
 
-	vector4	worldPosition(cNormal*-cDistance, 1.0f);
-	vector4	worldNormal(cNormal, 1.0f);
-
-	worldPosition	= worldTM * worldPosition;
-	worldNormal		= inverseTM.getTransposed() * worldNormal;
+	vector3	worldPosition	= worldTM * (cNormal*-cDistance);
+	vector3	worldNormal		= inverseTM.transformNormal(cNormal);
 
-	cNormal		= vector3(worldNormal.x, worldNormal.y, worldNormal.z).getNormalized();
-	cDistance	= vector3(worldPosition.x, worldPosition.y, worldPosition.z).length();
+	cNormal		= worldNormal.getNormalized();
+	cDistance	= worldPosition.length();
 
-	Object::cacheVariables();
+	Object::cacheNode();
 }
 
 vector3 NodePlane::getNormal(const vector3 &intPoint, const int intersectFlag)
@@ -73,4 +75,12 @@ Node* NodePlane::intersect(const vector3 &rayOrigin, const vector3 &rayDirection
 		}
 	}
 	return NULL;
+}
+
+bool NodePlane::getRenderPrimitive(RenderPrimitive *primitive) const
+{
+	primitive->type		= RenderScene::PrimitivePlane;
+	primitive->data[0]	= cNormal;
+	primitive->scalar	= cDistance;
+	return true;
 }
\ No newline at end of file
@@ -31,9 +31,10 @@ public:
 	NodePlane(const std::string &name, Node *parent);
 	virtual ~NodePlane(void);
 
-	virtual void	cacheVariables(void);
+	virtual void	cacheNode(void);
 	virtual vector3	getNormal(const vector3 &intPoint, const int intersectFlag);
 	virtual Node*	intersect(const vector3 &rayOrigin, const vector3 &rayDirection, float &rayDistance, int &factor, int &flag);
+	virtual bool	getRenderPrimitive(RenderPrimitive *primitive) const;
 
 	virtual const std::string getType(void) const
 	{ return std::string("plane"); }
@@ -44,7 +45,7 @@ class NodePlaneCreator : public NodeCreator
 {
 public:
 	virtual Node* operator()(const std::string &name, Node *parent=NULL) const
-	{ return new NodePlane(name, parent); }
+	{ return new(Node::getArena(parent)) NodePlane(name, parent); }
 };
 
 } // exRay
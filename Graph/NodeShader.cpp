@@ -25,22 +25,22 @@ using namespace exRay;
 
 NodeShader::NodeShader(const std::string &name, Node *parent) : Node(name, parent)
 {
-	addAttrib(new VShader("cgfx_shader"));
-	addAttrib(new VNode("env_light", true));
+	addAttrib(new(nodeArena) VShader(attrShader));
+	addAttrib(new(nodeArena) VNode(attrEnvLight, true));
 }
 
 NodeShader::~NodeShader(void)
 {
 }
 
-void NodeShader::cacheVariables(void)
+void NodeShader::cacheNode(void)
 {
 	Shader	*theShader;
-	getAttrib("cgfx_shader")->getValue(theShader);
+	getAttribValue(attrShader, theShader);
 	if(theShader)
 		theShader->cacheVariables(this);
 
-	Node::cacheVariables();
+	Node::cacheNode();
 }
 
 bool NodeShader::acceptsConnection(Variable *cvariable) const
@@ -50,15 +50,14 @@ bool NodeShader::acceptsConnection(Variable *cvariable) const
 	return false;
 }
 
-void NodeShader::evaluate(void)
+void NodeShader::evaluateNode(void)
 {
-	if(evaluated) return;
 	if(hasOutput())
 	{
 		Shader	*funcShader;
-		getAttrib("cgfx_shader")->getValue(funcShader);
+		getAttribValue(attrShader, funcShader);
 		setOutput(funcShader);
 	}
 
-	Node::evaluate();
+	Node::evaluateNode();
 }
\ No newline at end of file
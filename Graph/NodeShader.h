@@ -31,9 +31,13 @@ public:
 	NodeShader(const std::string &name, Node *parent);
 	virtual ~NodeShader(void);
 
-	virtual void	cacheVariables(void);
+	virtual void	cacheNode(void);
 	virtual bool	acceptsConnection(Variable *cvariable) const;
-	virtual void	evaluate(void);
+	virtual void	evaluateNode(void);
+
+	// Wbudowane shadery s instancjami wsplnymi dla caego procesu (Shader::cacheVariables).
+	virtual bool sharesCacheState(void) const
+	{ return true; }
 
 	virtual const std::string getType(void) const
 	{ return std::string("shader"); }
@@ -44,7 +48,7 @@ class NodeShaderCreator : public NodeCreator
 {
 public:
 	virtual Node* operator()(const std::string &name, Node *parent=NULL) const
-	{ return new NodeShader(name, parent); }
+	{ return new(Node::getArena(parent)) NodeShader(name, parent); }
 };
 
 } // exRay
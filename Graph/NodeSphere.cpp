@@ -21,21 +21,22 @@
 #include "Node.h"
 #include "Object.h"
 #include "NodeSphere.h"
+#include "../Core/RenderScene.h"
 
 using namespace exRay;
 
 NodeSphere::NodeSphere(const std::string &name, Node *parent) : Object(name, parent)
 {
-	addAttrib(new VFloat("radius"));
+	addAttrib(new(nodeArena) VFloat(attrRadius));
 }
 
 NodeSphere::~NodeSphere(void)
 {	
 }
 
-void NodeSphere::cacheVariables(void)
+void NodeSphere::cacheNode(void)
 {
-	getAttrib("radius")->getValue(cRadius);
+	getAttribValue(attrRadius, cRadius);
 	cSqRadius  = SQR(cRadius);
 	cInvRadius = INV(cRadius);
 
@@ -43,7 +44,7 @@ void NodeSphere::cacheVariables(void)
 	worldCentre = worldTM * worldCentre;
 	cCentre = vector3(worldCentre.x, worldCentre.y, worldCentre.z);
 
-	Object::cacheVariables();
+	Object::cacheNode();
 }
 
 vector3 NodeSphere::getNormal(const vector3 &intPoint, const int intersectFlag)
@@ -77,3 +78,11 @@ Node* NodeSphere::intersect(const vector3 &rayOrigin, const vector3 &rayDirectio
 	}
 	return this;
 }
+
+bool NodeSphere::getRenderPrimitive(RenderPrimitive *primitive) const
+{
+	primitive->type		= RenderScene::PrimitiveSphere;
+	primitive->data[0]	= cCentre;
+	primitive->scalar	= cSqRadius;
+	return true;
+}
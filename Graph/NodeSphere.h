@@ -33,9 +33,10 @@ public:
 	NodeSphere(const std::string &name, Node *parent);
 	virtual ~NodeSphere(void);
 
-	virtual void	cacheVariables(void);
+	virtual void	cacheNode(void);
 	virtual vector3	getNormal(const vector3 &intPoint, const int intersectFlag);
 	virtual Node*	intersect(const vector3 &rayOrigin, const vector3 &rayDirection, float &rayDistance, int &factor, int &flag);
+	virtual bool	getRenderPrimitive(RenderPrimitive *primitive) const;
 
 	virtual const std::string getType(void) const
 	{ return std::string("sphere"); }
@@ -46,7 +47,7 @@ class NodeSphereCreator : public NodeCreator
 {
 public:
 	virtual Node* operator()(const std::string &name, Node *parent=NULL) const
-	{ return new NodeSphere(name, parent); }
+	{ return new(Node::getArena(parent)) NodeSphere(name, parent); }
 };
 
 } // exRay
@@ -32,7 +32,7 @@ NodeTorus::~NodeTorus(void)
 {
 }
 
-void NodeTorus::cacheVariables(void)
+void NodeTorus::cacheNode(void)
 {
 }
 
@@ -29,7 +29,7 @@ public:
 	NodeTorus(const std::string &name, Node *parent);
 	virtual ~NodeTorus(void);
 
-	virtual void	cacheVariables(void);
+	virtual void	cacheNode(void);
 	virtual vector3	getNormal(const vector3 &intPoint, const int intersectFlag);
 	virtual Node*	intersect(const vector3 &rayOrigin, const vector3 &rayDirection, float &rayDistance, int &factor, int &flag);
 
@@ -42,7 +42,7 @@ class NodeTorusCreator : public NodeCreator
 {
 public:
 	virtual Node* operator()(const std::string &name, Node *parent=NULL) const
-	{ return new NodeTorus(name, parent); }
+	{ return new(Node::getArena(parent)) NodeTorus(name, parent); }
 };
 
 } // exRay
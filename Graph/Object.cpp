@@ -23,14 +23,19 @@
 
 using namespace exRay;
 
+// Uchwyty atrybutw.
+static const AttribHandle<vector3>	attrPosition("position");
+static const AttribHandle<vector3>	attrRotation("rotation");
+static const AttribHandle<vector3>	attrScale("scale");
+
 Object::Object(const std::string &name, Node *parent) : Node(name, parent)
 {
-	addAttrib(new VFloat3("position"));
-	addAttrib(new VFloat3("rotation"));
-	addAttrib(new VFloat3("scale"))->setValue(vector3(1.0f, 1.0f, 1.0f));
+	addAttrib(new(nodeArena) VFloat3(attrPosition));
+	addAttrib(new(nodeArena) VFloat3(attrRotation));
+	addAttrib(new(nodeArena) VFloat3(attrScale))->setValue(vector3(1.0f, 1.0f, 1.0f));
 
-	addAttrib(new VShader("cgfx_shader"));
-	addAttrib(new VNode("material"));
+	addAttrib(new(nodeArena) VShader(attrShader));
+	addAttrib(new(nodeArena) VNode(attrMaterial));
 
 	cShader		= NULL;
 	cMaterial	= NULL;
@@ -43,11 +48,11 @@ Object::~Object()
 {
 }
 
-void Object::cacheVariables(void)
+void Object::cacheNode(void)
 {
-	getAttrib("cgfx_shader")->getValue(cShader);
-	getAttrib("material")->getValue(cMaterial);
-	Node::cacheVariables();
+	getAttribValue(attrShader, cShader);
+	getAttribValue(attrMaterial, cMaterial);
+	Node::cacheNode();
 }
 
 vector3 Object::getNormal(const vector3& intPoint, const int intersectFlag)
@@ -55,11 +60,11 @@ vector3 Object::getNormal(const vector3& intPoint, const int intersectFlag)
 	return vector3();
 }
 
-void Object::updateTransformation(const matrix4 *multiplyBy)
+void Object::transformNode(const matrix4 *multiplyBy)
 {
-	Variable	*position = getAttrib("position");
-	Variable	*rotation = getAttrib("rotation");
-	Variable	*scale    = getAttrib("scale");
+	Variable	*position = getAttrib(attrPosition);
+	Variable	*rotation = getAttrib(attrRotation);
+	Variable	*scale    = getAttrib(attrScale);
 
 	if(position->isDirty() || rotation->isDirty() || scale->isDirty())
 	{
@@ -72,25 +77,22 @@ void Object::updateTransformation(const matrix4 *multiplyBy)
 		vecRotation *= MPI180;
 
 		localTM.loadIdentity();
-		localTM = localTM.scale(vecScale) * localTM.rotate(vecRotation) * localTM.translate(vecPosition);
-		inverseTM.loadIdentity();
-		inverseTM = inverseTM.scale(vecScale) * inverseTM.translate(-vecPosition) * inverseTM.rotate(-vecRotation);
+		localTM = localTM.scale(vecScale).multiplyAffine(localTM.rotate(vecRotation)).multiplyAffine(localTM.translate(vecPosition));
 	}
 
+	// Transformacja przeliczana jest ponownie po kadej zmianie, wic nie moe kumulowa poprzedniego wyniku.
 	worldTM = localTM;
 	if(nodeParent)
 	{
 		if(nodeParent->isObject())
-		{
-			worldTM		= worldTM * ((Object*)nodeParent)->worldTM;
-			inverseTM	= inverseTM * ((Object*)nodeParent)->inverseTM;
-		}
+			worldTM = worldTM.multiplyAffine(((Object*)nodeParent)->worldTM);
 	}
 
 	if(multiplyBy)
 		worldTM = worldTM * (*multiplyBy);
 
-	Node::updateTransformation(multiplyBy);
+	// Odwrotno liczona jest z macierzy wynikowej, wic zawsze odpowiada kolejnoci zoenia przeksztace.
+	inverseTM = worldTM.getInverted();
 
 	position->setClean();
 	rotation->setClean();
@@ -99,8 +101,8 @@ void Object::updateTransformation(const matrix4 *multiplyBy)
 
 NodeCamera::NodeCamera(const std::string &name, Node *parent) : Object(name, parent)
 {
-	addAttrib(new VFloat2("screen"))->setValue(vector2(8.0f, 6.0f));
-	addAttrib(new VFloat3("origin"))->setValue(vector3(0.0f, 0.0f, -5.0f));
+	addAttrib(new(nodeArena) VFloat2(attrScreen))->setValue(vector2(8.0f, 6.0f));
+	addAttrib(new(nodeArena) VFloat3(attrOrigin))->setValue(vector3(0.0f, 0.0f, -5.0f));
 }
 
 NodeCamera::~NodeCamera(void)
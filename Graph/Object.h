@@ -47,8 +47,8 @@ public:
 	virtual bool isObject(void) const
 	{ return true; }
 
-	virtual void	cacheVariables(void);
-	virtual void	updateTransformation(const matrix4 *multiplyBy=NULL);
+	virtual void	cacheNode(void);
+	virtual void	transformNode(const matrix4 *multiplyBy=NULL);
 	virtual vector3	getNormal(const vector3 &intPoint, const int intersectFlag=0);
 
 	matrix4			getTM(void) const
@@ -69,7 +69,7 @@ class ObjectCreator : public NodeCreator
 {
 public:
 	virtual Node* operator()(const std::string &name, Node *parent=NULL) const
-	{ return new Object(name, parent); }
+	{ return new(Node::getArena(parent)) Object(name, parent); }
 };
 
 /// Grupa obiektw na scenie.
@@ -88,7 +88,7 @@ class GroupCreator : public NodeCreator
 {
 public:
 	virtual Node* operator()(const std::string &name, Node *parent=NULL) const
-	{ return new Group(name, parent); }
+	{ return new(Node::getArena(parent)) Group(name, parent); }
 };
 
 /// Kamera.
@@ -114,7 +114,7 @@ class NodeCameraCreator : public NodeCreator
 {
 public:
 	virtual Node* operator()(const std::string &name, Node *parent=NULL) const
-	{ return new NodeCamera(name, parent); }
+	{ return new(Node::getArena(parent)) NodeCamera(name, parent); }
 };
 
 } // exRay
@@ -18,25 +18,105 @@
 
 #include "../Config.h"
 #include "Variable.h"
+#include "Node.h"
+#include "../Types/Arena.h"
 
 using namespace exRay;
 
-Variable::Variable(const std::string &varName, bool isArray)
+// Uchwyty atrybutw wsplnych (Variable.h).
+const AttribHandle<Shader*>	exRay::attrShader("cgfx_shader");
+const AttribHandle<Node*>	exRay::attrMaterial("material");
+const AttribHandle<Node*>	exRay::attrEnvLight("env_light");
+const AttribHandle<vector3>	exRay::attrOrigin("origin");
+const AttribHandle<vector2>	exRay::attrScreen("screen");
+const AttribHandle<vector3>	exRay::attrColor("color");
+const AttribHandle<float>	exRay::attrRadius("radius");
+
+// Porwnanie bajtowe wystarcza dla typw prostych, wektorw i wskanikw; -0.0f i 0.0f traktowane s
+// jako rne wartoci, co najwyej powodujc zbdne przeliczenie.
+template<class T> static inline bool sameValue(const T &a, const T &b)
+{ return memcmp(&a, &b, sizeof(T)) == 0; }
+
+// Rejestr nazw atrybutw: nazwa -> klucz (od 1) oraz klucz -> nazwa.
+static std::map<std::string, unsigned int>& getNameRegistry(void)
+{
+	static std::map<std::string, unsigned int> registry;
+	return registry;
+}
+
+static std::vector<const std::string*>& getKeyRegistry(void)
+{
+	static std::vector<const std::string*> registry(1, new std::string(""));
+	return registry;
+}
+
+unsigned int Variable::internName(const std::string &varName)
+{
+	std::map<std::string, unsigned int> &registry = getNameRegistry();
+	std::map<std::string, unsigned int>::iterator it = registry.find(varName);
+	if(it != registry.end())
+		return it->second;
+
+	unsigned int id = (unsigned int)registry.size()+1;
+	it = registry.insert(std::make_pair(varName, id)).first;
+	getKeyRegistry().push_back(&it->first);
+	return id;
+}
+
+const std::string& Variable::getKeyName(const unsigned int varKey)
 {
-	name	= varName;
+	std::vector<const std::string*> &registry = getKeyRegistry();
+	if(varKey >= registry.size())
+		return *registry[0];
+	return *registry[varKey];
+}
+
+unsigned int Variable::findName(const std::string &varName)
+{
+	std::map<std::string, unsigned int> &registry = getNameRegistry();
+	std::map<std::string, unsigned int>::iterator it = registry.find(varName);
+	if(it == registry.end())
+		return 0;
+	return it->second;
+}
+
+Variable::Variable(const AttribKey &varKey, bool isArray)
+{
+	key		= varKey.getID();
 	parent	= NULL;
 	dirty	= true;
 	array	= isArray;
 	vnode	= NULL;
+	owner	= NULL;
 }
 
 Variable::~Variable()
 { }
 
-VInteger::VInteger(const std::string &varName, bool isArray) : Variable(varName, isArray)
+// Zmiana wartoci oznacza atrybut i wze, do ktrego naley, jako wymagajce przeliczenia.
+void Variable::touch(void)
+{
+	dirty = true;
+	if(owner)
+		owner->markModified();
+}
+
+void* Variable::operator new(size_t size)
+{ return Arena::allocateObject(size, NULL); }
+
+void* Variable::operator new(size_t size, Arena *arena)
+{ return Arena::allocateObject(size, arena); }
+
+void Variable::operator delete(void *object)
+{ Arena::freeObject(object); }
+
+void Variable::operator delete(void *object, Arena *arena)
+{ Arena::freeObject(object); }
+
+VInteger::VInteger(const AttribKey &varKey, bool isArray) : Variable(varKey, isArray)
 {
 	if(!isArray)
-		value.push_back(0);
+		value.push_back(0, getArena());
 }
 
 VInteger::~VInteger()
@@ -44,44 +124,50 @@ VInteger::~VInteger()
 
 bool VInteger::getValue(int&out,int i)
 { 
-	out = value.at(i);
+	if((unsigned int)i >= value.size())
+		return false;
+	out = value[i];
 	return true;
 }
 
 bool VInteger::setValue(int in,int i)
 { 
+	if(sameValue(value[i], in))
+		return true;
 	value[i] = in;
-	dirty	 = true;
+	touch();
 	return true;
 }
 
 bool VInteger::pushValue(int in)
 { 
-	value.push_back(in);
+	value.push_back(in, getArena());
 	array	= true;
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VInteger::popValue(void)
 { 
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VInteger::popValue(int& out)
 {
-	out = value.at(value.size()-1);
+	if(value.size() == 0)
+		return false;
+	out = value[value.size()-1];
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VInteger::removeValue(int i)
 {
-	value.erase(value.begin()+i);
-	dirty	= true;
+	value.erase(i);
+	touch();
 	return true;
 }
 
@@ -99,10 +185,10 @@ bool VInteger::copyValue(Variable *v, int i, int j)
 	return true;
 }
 
-VFloat::VFloat(const std::string &varName, bool isArray) : Variable(varName, isArray)
+VFloat::VFloat(const AttribKey &varKey, bool isArray) : Variable(varKey, isArray)
 {
 	if(!isArray)
-		value.push_back(0.0f);
+		value.push_back(0.0f, getArena());
 }
 
 VFloat::~VFloat()
@@ -110,44 +196,50 @@ VFloat::~VFloat()
 
 bool VFloat::getValue(float&out,int i)
 {
-	out = value.at(i);
+	if((unsigned int)i >= value.size())
+		return false;
+	out = value[i];
 	return true;
 }
 
 bool VFloat::setValue(float in,int i)
 {
+	if(sameValue(value[i], in))
+		return true;
 	value[i] = in;
-	dirty	 = true;
+	touch();
 	return true;
 }
 
 bool VFloat::pushValue(float in)
 {
-	value.push_back(in);
+	value.push_back(in, getArena());
 	array	= true;
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VFloat::popValue(void)
 {
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VFloat::popValue(float& out)
 {
-	out = value.at(value.size()-1);
+	if(value.size() == 0)
+		return false;
+	out = value[value.size()-1];
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VFloat::removeValue(int i)
 { 
-	value.erase(value.begin()+i);
-	dirty	= true;
+	value.erase(i);
+	touch();
 	return true;
 }
 
@@ -165,10 +257,10 @@ bool VFloat::copyValue(Variable *v, int i, int j)
 	return true;
 }
 
-VFloat2::VFloat2(const std::string &varName, bool isArray) : Variable(varName, isArray)
+VFloat2::VFloat2(const AttribKey &varKey, bool isArray) : Variable(varKey, isArray)
 {
 	if(!isArray)
-		value.push_back(vector2());
+		value.push_back(vector2(), getArena());
 }
 
 VFloat2::~VFloat2()
@@ -176,44 +268,50 @@ VFloat2::~VFloat2()
 
 bool VFloat2::getValue(vector2 &out,int i)
 {
-	out = value.at(i);
+	if((unsigned int)i >= value.size())
+		return false;
+	out = value[i];
 	return true;
 }
 
 bool VFloat2::setValue(vector2 &in,int i)
 {
+	if(sameValue(value[i], in))
+		return true;
 	value[i] = in;
-	dirty	 = true;
+	touch();
 	return true;
 }
 
 bool VFloat2::pushValue(vector2 &in)
 {
-	value.push_back(in);
+	value.push_back(in, getArena());
 	array	= true;
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VFloat2::popValue(void)
 {
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VFloat2::popValue(vector2 &out)
 {
-	out = value.at(value.size()-1);
+	if(value.size() == 0)
+		return false;
+	out = value[value.size()-1];
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VFloat2::removeValue(int i)
 { 
-	value.erase(value.begin()+i);
-	dirty	= true;
+	value.erase(i);
+	touch();
 	return true;
 }
 
@@ -231,10 +329,10 @@ bool VFloat2::copyValue(Variable *v, int i, int j)
 	return true;
 }
 
-VFloat3::VFloat3(const std::string &varName, bool isArray) : Variable(varName, isArray)
+VFloat3::VFloat3(const AttribKey &varKey, bool isArray) : Variable(varKey, isArray)
 {
 	if(!isArray)
-		value.push_back(vector3());
+		value.push_back(vector3(), getArena());
 }
 
 VFloat3::~VFloat3()
@@ -242,44 +340,50 @@ VFloat3::~VFloat3()
 
 bool VFloat3::getValue(vector3 &out,int i)
 {
-	out = value.at(i);
+	if((unsigned int)i >= value.size())
+		return false;
+	out = value[i];
 	return true;
 }
 
 bool VFloat3::setValue(vector3 &in,int i)
 {
+	if(sameValue(value[i], in))
+		return true;
 	value[i] = in;
-	dirty	 = true;
+	touch();
 	return true;
 }
 
 bool VFloat3::pushValue(vector3 &in)
 {
-	value.push_back(in);
+	value.push_back(in, getArena());
 	array	= true;
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VFloat3::popValue(void)
 {
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VFloat3::popValue(vector3 &out)
 {
-	out = value.at(value.size()-1);
+	if(value.size() == 0)
+		return false;
+	out = value[value.size()-1];
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VFloat3::removeValue(int i)
 { 
-	value.erase(value.begin()+i);
-	dirty	= true;
+	value.erase(i);
+	touch();
 	return true;
 }
 
@@ -297,10 +401,10 @@ bool VFloat3::copyValue(Variable *v, int i, int j)
 	return true;
 }
 
-VFloat4::VFloat4(const std::string &varName, bool isArray) : Variable(varName, isArray)
+VFloat4::VFloat4(const AttribKey &varKey, bool isArray) : Variable(varKey, isArray)
 {
 	if(!isArray)
-		value.push_back(vector4());
+		value.push_back(vector4(), getArena());
 }
 
 VFloat4::~VFloat4()
@@ -308,44 +412,50 @@ VFloat4::~VFloat4()
 
 bool VFloat4::getValue(vector4 &out,int i)
 {
-	out = value.at(i);
+	if((unsigned int)i >= value.size())
+		return false;
+	out = value[i];
 	return true;
 }
 
 bool VFloat4::setValue(vector4 &in,int i)
 {
+	if(sameValue(value[i], in))
+		return true;
 	value[i] = in;
-	dirty	 = true;
+	touch();
 	return true;
 }
 
 bool VFloat4::pushValue(vector4 &in)
 {
-	value.push_back(in);
+	value.push_back(in, getArena());
 	array	= true;
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VFloat4::popValue(void)
 {
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VFloat4::popValue(vector4 &out)
 {
-	out = value.at(value.size()-1);
+	if(value.size() == 0)
+		return false;
+	out = value[value.size()-1];
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VFloat4::removeValue(int i)
 { 
-	value.erase(value.begin()+i);
-	dirty	= true;
+	value.erase(i);
+	touch();
 	return true;
 }
 
@@ -363,10 +473,10 @@ bool VFloat4::copyValue(Variable *v, int i, int j)
 	return true;
 }
 
-VMatrix4::VMatrix4(const std::string &varName, bool isArray) : Variable(varName, isArray)
+VMatrix4::VMatrix4(const AttribKey &varKey, bool isArray) : Variable(varKey, isArray)
 {
 	if(!isArray)
-		value.push_back(matrix4());
+		value.push_back(matrix4(), getArena());
 }
 
 VMatrix4::~VMatrix4()
@@ -374,44 +484,50 @@ VMatrix4::~VMatrix4()
 
 bool VMatrix4::getValue(matrix4 &out,int i)
 {
-	out = value.at(i);
+	if((unsigned int)i >= value.size())
+		return false;
+	out = value[i];
 	return true;
 }
 
 bool VMatrix4::setValue(matrix4 &in,int i)
 {
+	if(sameValue(value[i], in))
+		return true;
 	value[i] = in;
-	dirty	 = true;
+	touch();
 	return true;
 }
 
 bool VMatrix4::pushValue(matrix4 &in)
 {
-	value.push_back(in);
+	value.push_back(in, getArena());
 	array	= true;
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VMatrix4::popValue(void)
 {
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VMatrix4::popValue(matrix4 &out)
 {
-	out = value.at(value.size()-1);
+	if(value.size() == 0)
+		return false;
+	out = value[value.size()-1];
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VMatrix4::removeValue(int i)
 { 
-	value.erase(value.begin()+i);
-	dirty	= true;
+	value.erase(i);
+	touch();
 	return true;
 }
 
@@ -429,55 +545,78 @@ bool VMatrix4::copyValue(Variable *v, int i, int j)
 	return true;
 }
 
-VString::VString(const std::string &varName, bool isArray) : Variable(varName, isArray)
+// Napisy kopiowane s do obszaru atrybutu; kopie na stercie zwalniane s przy zmianie wartoci.
+static const char* copyString(const std::string &in, Arena *arena)
+{
+	char *text = (char*)Arena::allocateBlock(in.size()+1, arena);
+	memcpy(text, in.c_str(), in.size()+1);
+	return text;
+}
+
+VString::VString(const AttribKey &varKey, bool isArray) : Variable(varKey, isArray)
 {
 	if(!isArray)
-		value.push_back(std::string(""));
+		value.push_back(copyString(std::string(""), getArena()), getArena());
 }
 
 VString::~VString()
-{ }
+{
+	for(unsigned int i=0; i<value.size(); i++)
+		Arena::freeBlock((void*)value[i], getArena());
+}
 
 bool VString::getValue(std::string &out,int i)
 {
-	out = value.at(i);
+	if((unsigned int)i >= value.size())
+		return false;
+	out = value[i];
 	return true;
 }
 
 bool VString::setValue(std::string &in,int i)
 {
-	value[i] = in;
-	dirty	 = true;
+	if(in == value[i])
+		return true;
+	Arena::freeBlock((void*)value[i], getArena());
+	value[i] = copyString(in, getArena());
+	touch();
 	return true;
 }
 
 bool VString::pushValue(std::string &in)
 {
-	value.push_back(in);
+	value.push_back(copyString(in, getArena()), getArena());
 	array	= true;
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VString::popValue(void)
 {
+	if(value.size() > 0)
+		Arena::freeBlock((void*)value[value.size()-1], getArena());
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VString::popValue(std::string &out)
 {
-	out = value.at(value.size()-1);
+	if(value.size() == 0)
+		return false;
+	out = value[value.size()-1];
+	Arena::freeBlock((void*)value[value.size()-1], getArena());
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VString::removeValue(int i)
 { 
-	value.erase(value.begin()+i);
-	dirty	= true;
+	if((unsigned int)i < value.size())
+		Arena::freeBlock((void*)value[i], getArena());
+	value.erase(i);
+	touch();
 	return true;
 }
 
@@ -495,10 +634,10 @@ bool VString::copyValue(Variable *v, int i, int j)
 	return true;
 }
 
-VMesh::VMesh(const std::string &varName, bool isArray) : Variable(varName, isArray)
+VMesh::VMesh(const AttribKey &varKey, bool isArray) : Variable(varKey, isArray)
 {
 	if(!isArray)
-		value.push_back(NULL);
+		value.push_back(NULL, getArena());
 }
 
 VMesh::~VMesh()
@@ -506,44 +645,50 @@ VMesh::~VMesh()
 
 bool VMesh::getValue(Mesh *&out,int i)
 {
-	out = value.at(i);
+	if((unsigned int)i >= value.size())
+		return false;
+	out = value[i];
 	return true;
 }
 
 bool VMesh::setValue(Mesh *&in,int i)
 {
+	if(sameValue(value[i], in))
+		return true;
 	value[i] = in;
-	dirty	 = true;
+	touch();
 	return true;
 }
 
 bool VMesh::pushValue(Mesh *&in)
 {
-	value.push_back(in);
+	value.push_back(in, getArena());
 	array	= true;
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VMesh::popValue(void)
 {
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VMesh::popValue(Mesh *&out)
 {
-	out = value.at(value.size()-1);
+	if(value.size() == 0)
+		return false;
+	out = value[value.size()-1];
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VMesh::removeValue(int i)
 { 
-	value.erase(value.begin()+i);
-	dirty	= true;
+	value.erase(i);
+	touch();
 	return true;
 }
 
@@ -561,10 +706,10 @@ bool VMesh::copyValue(Variable *v, int i, int j)
 	return true;
 }
 
-VShader::VShader(const std::string &varName, bool isArray) : Variable(varName, isArray)
+VShader::VShader(const AttribKey &varKey, bool isArray) : Variable(varKey, isArray)
 {
 	if(!isArray)
-		value.push_back(NULL);
+		value.push_back(NULL, getArena());
 }
 
 VShader::~VShader()
@@ -572,44 +717,50 @@ VShader::~VShader()
 
 bool VShader::getValue(Shader *&out,int i)
 {
-	out = value.at(i);
+	if((unsigned int)i >= value.size())
+		return false;
+	out = value[i];
 	return true;
 }
 
 bool VShader::setValue(Shader *&in,int i)
 {
+	if(sameValue(value[i], in))
+		return true;
 	value[i] = in;
-	dirty	 = true;
+	touch();
 	return true;
 }
 
 bool VShader::pushValue(Shader *&in)
 {
-	value.push_back(in);
+	value.push_back(in, getArena());
 	array	= true;
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VShader::popValue(void)
 {
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VShader::popValue(Shader *&out)
 {
-	out = value.at(value.size()-1);
+	if(value.size() == 0)
+		return false;
+	out = value[value.size()-1];
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VShader::removeValue(int i)
 { 
-	value.erase(value.begin()+i);
-	dirty	= true;
+	value.erase(i);
+	touch();
 	return true;
 }
 
@@ -627,10 +778,10 @@ bool VShader::copyValue(Variable *v, int i, int j)
 	return true;
 }
 
-VNode::VNode(const std::string &varName, bool isArray) : Variable(varName, isArray)
+VNode::VNode(const AttribKey &varKey, bool isArray) : Variable(varKey, isArray)
 {
 	if(!isArray)
-		value.push_back(NULL);
+		value.push_back(NULL, getArena());
 }
 
 VNode::~VNode()
@@ -638,44 +789,50 @@ VNode::~VNode()
 
 bool VNode::getValue(Node *&out,int i)
 {
-	out = value.at(i);
+	if((unsigned int)i >= value.size())
+		return false;
+	out = value[i];
 	return true;
 }
 
 bool VNode::setValue(Node *&in,int i)
 {
+	if(sameValue(value[i], in))
+		return true;
 	value[i] = in;
-	dirty	 = true;
+	touch();
 	return true;
 }
 
 bool VNode::pushValue(Node *&in)
 {
-	value.push_back(in);
+	value.push_back(in, getArena());
 	array	= true;
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VNode::popValue(void)
 {
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VNode::popValue(Node *&out)
 {
-	out = value.at(value.size()-1);
+	if(value.size() == 0)
+		return false;
+	out = value[value.size()-1];
 	value.pop_back();
-	dirty	= true;
+	touch();
 	return true;
 }
 
 bool VNode::removeValue(int i)
 { 
-	value.erase(value.begin()+i);
-	dirty	= true;
+	value.erase(i);
+	touch();
 	return true;
 }
 
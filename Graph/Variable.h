@@ -21,6 +21,7 @@
 
 #include "../types/Mesh.h"
 #include "../types/Image.h"
+#include "../types/Arena.h"
 
 namespace exRay {
 
@@ -44,32 +45,108 @@ enum VARTYPE
 class Node;
 class Shader;
 class VCompound;
+class AttribKey;
+
+/// Magazyn wartoci atrybutu.
+/** Interfejs zbliony do std::vector. Pierwsza warto przechowywana jest bezporednio w obiekcie, dziki
+	czemu atrybut skalarny nie wymaga adnej dodatkowej alokacji. Dopiero tablica (pushValue) przenoszona
+	jest do obszaru atrybutu (lub na stert). Wartoci nie s niszczone, wic typ T nie moe wymaga
+	destruktora (napisy VString przechowywane s jako wskaniki do kopii w obszarze).
+*/
+template<class T> class VStorage
+{
+private:
+	T				local;
+	T*				data;
+	Arena*			arena;
+	unsigned int	count;
+	unsigned int	capacity;
+private:
+	VStorage(const VStorage&);
+	VStorage& operator=(const VStorage&);
+
+	void	grow(Arena *owner)
+	{
+		T *newData = (T*)Arena::allocateBlock(sizeof(T)*capacity*2, owner);
+		for(unsigned int i=0; i<count; i++)
+			new(&newData[i]) T(data[i]);
+		if(data != &local)
+			Arena::freeBlock(data, arena);
+		data	  = newData;
+		arena	  = owner;
+		capacity *= 2;
+	}
+public:
+	VStorage(void) : local(), data(&local), arena(NULL), count(0), capacity(1)
+	{ }
+	~VStorage(void)
+	{ if(data != &local) Arena::freeBlock(data, arena); }
+
+	unsigned int	size(void) const
+	{ return count; }
+	T&				operator[](const unsigned int i)
+	{ return data[i]; }
+
+	void	push_back(const T &in, Arena *owner)
+	{
+		if(count == capacity)
+			grow(owner);
+		new(&data[count++]) T(in);
+	}
+	void	pop_back(void)
+	{
+		if(count > 0)
+			data[--count] = T();
+	}
+	void	erase(const unsigned int i)
+	{
+		if(i >= count)
+			return;
+		for(unsigned int j=i+1; j<count; j++)
+			data[j-1] = data[j];
+		data[--count] = T();
+	}
+};
 
 /// Generyczny atrybut (zmienna) wza.
 /** Bazowa klasa dla wszystkich klas atrybutw wzw. */
 class Variable
 {
 protected:
-	std::string		name;
+	unsigned int	key;
 	VCompound		*parent;
 	Node			*vnode;
+	Node			*owner;
 	bool			dirty;
 	bool			array;
+protected:
+	void			touch(void);
 public:
-	Variable(const std::string &varName, bool isArray=false);
+	Variable(const AttribKey &varKey, bool isArray=false);
 	virtual ~Variable();
 
+	static void*	operator new(size_t size);
+	static void*	operator new(size_t size, Arena *arena);
+	static void		operator delete(void *object);
+	static void		operator delete(void *object, Arena *arena);
+
 	virtual VARTYPE	getType() const				{ return NONE;		}
 
-	const std::string&		getName() const		{ return name;			}
+	const std::string&		getName() const		{ return getKeyName(key); }
+	unsigned int			getKey() const		{ return key;			}
 	VCompound*				getParent() const	{ return parent;		}
 	bool					isDirty() const		{ return dirty;			}
 	bool					isArray() const		{ return array;			}
 	bool					isConnected() const	{ return !(vnode==NULL);}
 	void					setClean()			{ dirty = false;		}
 
+	/// Zwraca obszar pamici atrybutu (NULL dla atrybutw utworzonych na stercie).
+	Arena*					getArena(void) const		{ return Arena::getOwner(this); }
+
 	void					setOutputNode(Node *pnode) { vnode = pnode; }
 	Node*					getOutputNode(void)		   { return vnode;  }
+	void					setOwner(Node *pnode)	   { owner = pnode; }
+	Node*					getOwner(void)			   { return owner;  }
 
 	virtual unsigned int	size() const			{ return 0;		}
 
@@ -120,15 +197,64 @@ public:
 
 	virtual bool	removeValue(int i)						{ return false; }
 	virtual bool	copyValue(Variable*, int i=0, int j=-1)	{ return false; }
+
+	static unsigned int		internName(const std::string &varName);
+	static unsigned int		findName(const std::string &varName);
+	static const std::string&	getKeyName(const unsigned int varKey);
 };
 
+/// Klucz nazwy atrybutu.
+/** Nazwy atrybutw zamieniane s na liczby cakowite przy rejestracji (Variable::internName), dziki
+	czemu wyszukiwanie atrybutu wza nie wymaga porwnywania napisw. Klucz 0 nie odpowiada adnej nazwie.
+*/
+class AttribKey
+{
+protected:
+	unsigned int	id;
+public:
+	AttribKey(void) : id(0)
+	{ }
+	explicit AttribKey(const std::string &varName) : id(Variable::internName(varName))
+	{ }
+
+	unsigned int	getID(void) const	{ return id; }
+
+	/// Klucz istniejcej nazwy (bez rejestracji); dla nieznanej nazwy klucz 0.
+	static AttribKey find(const std::string &varName)
+	{
+		AttribKey key;
+		key.id = Variable::findName(varName);
+		return key;
+	}
+};
+
+/// Typowany uchwyt atrybutu.
+/** Tworzony raz (zwykle jako obiekt statyczny) i uywany wielokrotnie do odczytu wartoci atrybutu
+	przez Node::getAttribValue, np. AttribHandle<vector3> attrPosition("position").
+*/
+template<class T> class AttribHandle : public AttribKey
+{
+public:
+	explicit AttribHandle(const std::string &varName) : AttribKey(varName)
+	{ }
+};
+
+// Uchwyty atrybutw odczytywanych w wielu moduach (definicje w Variable.cpp).
+extern const AttribHandle<Shader*>	attrShader;
+extern const AttribHandle<Node*>	attrMaterial;
+extern const AttribHandle<Node*>	attrEnvLight;
+extern const AttribHandle<vector3>	attrOrigin;
+extern const AttribHandle<vector2>	attrScreen;
+extern const AttribHandle<vector3>	attrColor;
+extern const AttribHandle<float>	attrRadius;
+
 /// Atrybut typu Integer.
 class VInteger : public Variable
 {
 protected:
-	std::vector<int>	value;
+	VStorage<int>	value;
 public:
-	VInteger(const std::string &varName, bool isArray=false);
+	VInteger(const AttribKey &varKey, bool isArray=false);
 	virtual ~VInteger();
 
 	virtual VARTYPE	getType() const					{ return INTEGER;	}
@@ -148,9 +274,9 @@ public:
 class VFloat : public Variable
 {
 protected:
-	std::vector<float>	value;
+	VStorage<float>	value;
 public:
-	VFloat(const std::string &varName, bool isArray=false);
+	VFloat(const AttribKey &varKey, bool isArray=false);
 	virtual ~VFloat();
 
 	virtual VARTYPE	getType() const					{ return FLOAT;		}
@@ -170,9 +296,9 @@ public:
 class VFloat2 : public Variable
 {
 protected:
-	std::vector<vector2>	value;
+	VStorage<vector2>	value;
 public:
-	VFloat2(const std::string &varName, bool isArray=false);
+	VFloat2(const AttribKey &varKey, bool isArray=false);
 	virtual ~VFloat2();
 
 	virtual VARTYPE	getType() const					{ return FLOAT2;	}
@@ -192,9 +318,9 @@ public:
 class VFloat3 : public Variable
 {
 protected:
-	std::vector<vector3>	value;
+	VStorage<vector3>	value;
 public:
-	VFloat3(const std::string &varName, bool isArray=false);
+	VFloat3(const AttribKey &varKey, bool isArray=false);
 	virtual ~VFloat3();
 
 	virtual VARTYPE	getType() const					{ return FLOAT3;	}
@@ -214,9 +340,9 @@ public:
 class VFloat4 : public Variable
 {
 protected:
-	std::vector<vector4>	value;
+	VStorage<vector4>	value;
 public:
-	VFloat4(const std::string &varName, bool isArray=false);
+	VFloat4(const AttribKey &varKey, bool isArray=false);
 	virtual ~VFloat4();
 	
 	virtual VARTYPE	getType() const					{ return FLOAT4;	}
@@ -236,9 +362,9 @@ public:
 class VMatrix4 : public Variable
 {
 protected:
-	std::vector<matrix4>	value;
+	VStorage<matrix4>	value;
 public:
-	VMatrix4(const std::string &varName, bool isArray=false);
+	VMatrix4(const AttribKey &varKey, bool isArray=false);
 	virtual ~VMatrix4();
 
 	virtual VARTYPE	getType() const					{ return MATRIX4;	}
@@ -258,9 +384,9 @@ public:
 class VString : public Variable
 {
 protected:
-	std::vector<std::string> value;
+	VStorage<const char*> value;
 public:
-	VString(const std::string &varName, bool isArray=false);
+	VString(const AttribKey &varKey, bool isArray=false);
 	virtual ~VString();
 
 	virtual VARTYPE	getType() const						{ return STRING;	}
@@ -280,9 +406,9 @@ public:
 class VMesh : public Variable
 {
 protected:
-	std::vector<Mesh*> value;
+	VStorage<Mesh*> value;
 public:
-	VMesh(const std::string &varName, bool isArray=false);
+	VMesh(const AttribKey &varKey, bool isArray=false);
 	virtual ~VMesh();
 
 	virtual VARTYPE	getType() const						{ return MESH;	}
@@ -302,9 +428,9 @@ public:
 class VShader : public Variable
 {
 protected:
-	std::vector<Shader*> value;
+	VStorage<Shader*> value;
 public:
-	VShader(const std::string &varName, bool isArray=false);
+	VShader(const AttribKey &varKey, bool isArray=false);
 	virtual ~VShader();
 
 	virtual VARTYPE	getType() const						{ return SHADER;	}
@@ -324,9 +450,9 @@ public:
 class VNode : public Variable
 {
 protected:
-	std::vector<Node*> value;
+	VStorage<Node*> value;
 public:
-	VNode(const std::string &varName, bool isArray=false);
+	VNode(const AttribKey &varKey, bool isArray=false);
 	virtual ~VNode();
 
 	virtual VARTYPE	getType() const						{ return NODE;	}
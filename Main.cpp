@@ -18,9 +18,11 @@
 
 #include "Config.h"
 #include "Types/Image.h"
+#include "Types/ImageHDR.h"
 #include "Core/Application.h"
 #include "Core/Engine.h"
 #include "Graph/Node.h"
+#include "Graph/NodeGraph.h"
 #include "Types/Scene.h"
 
 #ifdef WIN32 // WIN32 PLATFORM SPECIFIC
@@ -38,7 +40,7 @@ int main(int argc, char *argv[])
 
 	theApp.setTitle(std::string("exRay ")+std::string(EXRAY_VERSION_STRING));
 	theApp.printStatus("Loading input scene script.");
-	Scene *scene = new Scene(theApp.getInput());
+	Scene *scene = new Scene(theApp.getInput(), theApp.getCores());
 	if(scene->getErrorCount() > 0)
 	{
 		theApp.printError("There were errors. Aborting.");
@@ -47,33 +49,72 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
+	// Zapis skryptu w postaci skompilowanej zamiast renderowania.
+	if(theApp.getCompileOutput().length() > 0)
+	{
+		theApp.printStatus("Writing compiled scene to file.");
+		bool written = scene->writeCompiled(theApp.getCompileOutput());
+		delete scene;
+		if(!written)
+		{
+			theApp.printError("Operation failed!");
+			return 1;
+		}
+		return 0;
+	}
+
 	theApp.printStatus("Initializing the engine.");
-	Engine	*rayTracer		= new Engine(NULL, theApp.getDepth(), theApp.getCores());
+	Engine	*rayTracer		= new Engine(NULL, theApp.getDepth(), theApp.getCores(), theApp.getISA());
 	scene->setupEngine(rayTracer);
-	Image	*frameBuffer	= new Image(scene->getFrameX(), scene->getFrameY(), 3);
+	Image	*frameBuffer;
+	if(theApp.getStreamRows() > 0)
+	{
+		// Tryb strumieniowy: linie zapisywane s do pliku wyjciowego w trakcie renderowania.
+		frameBuffer = new Image();
+		if(!frameBuffer->createStream(theApp.getOutput(), scene->getFrameX(), scene->getFrameY(), 3, theApp.getStreamRows()))
+		{
+			theApp.printError("Failed to create output file. Aborting.");
+			delete scene; delete rayTracer; delete frameBuffer;
+			return 1;
+		}
+	}
+	else frameBuffer = new Image(scene->getFrameX(), scene->getFrameY(), 3);
 	rayTracer->setFramebuffer(frameBuffer);
 
+	// Formaty zmiennoprzecinkowe (.pfm, .exr) renderowane s do bufora HDR bez obcinania wartoci.
+	ImageHDR *hdrBuffer = NULL;
+	if(ImageHDR::isHDRFormat(theApp.getOutput()))
+	{
+		hdrBuffer = new ImageHDR(scene->getFrameX(), scene->getFrameY(), 3);
+		rayTracer->setHDRFramebuffer(hdrBuffer);
+	}
+
 	int	warnings, errors;
 	theApp.printStatus("Creating scene graph.");
 	warnings = scene->createGraph(rayTracer->getRootNode());
-	rayTracer->getRootNode()->clearEvaluated(true);
-	rayTracer->getRootNode()->evaluate();
-	rayTracer->getRootNode()->updateTransformation();
+	rayTracer->getGraph()->evaluate();
 
 	errors = scene->validateGraph(rayTracer->getRootNode());
 	if(errors > 0)
 	{
 		theApp.printError("There were errors. Aborting.");
 		theApp.showLog("Graph Status Log", scene->getScriptLog());
-		delete scene; delete rayTracer; delete frameBuffer;
+		delete scene; delete rayTracer; delete frameBuffer; delete hdrBuffer;
 		return 1;
 	}
 
-	rayTracer->getRootNode()->cacheVariables();
+	rayTracer->getGraph()->cacheVariables();
+	if(theApp.isProgressive())
+	{
+		rayTracer->setRenderMode(Engine::RenderProgressive);
+		rayTracer->setTimeLimit(theApp.getTimeLimit());
+		rayTracer->setNoiseTarget(theApp.getNoiseTarget());
+	}
+
 	theApp.printStatus("Spawning rendering threads.");
 	if(!rayTracer->createRenderingThreads())
 	{
-		delete scene; delete rayTracer; delete frameBuffer;
+		delete scene; delete rayTracer; delete frameBuffer; delete hdrBuffer;
 		theApp.printError("Failed to initialize rendering threads. Aborting.");
 		return 1;
 	}
@@ -94,6 +135,7 @@ int main(int argc, char *argv[])
 	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL);
 #endif
 
+	unsigned int	previewPass = 0;
 	rayTracer->resumeRendering();
 	do
 	{
@@ -103,6 +145,21 @@ int main(int argc, char *argv[])
 		_sleep(Application::MainThreadIdle);
 #endif
 		theApp.showProgress(rayTracer);
+
+		// Zapis podgldu po kadym ukoczonym przebiegu.
+		if(theApp.getPreview().length() > 0 && rayTracer->getPass() > previewPass)
+		{
+			previewPass = rayTracer->getPass();
+			rayTracer->resolveFramebuffer();
+			if(hdrBuffer && ImageHDR::isHDRFormat(theApp.getPreview()))
+				hdrBuffer->writeToFile(theApp.getPreview());
+			else
+			{
+				if(hdrBuffer)
+					hdrBuffer->resolve(frameBuffer);
+				frameBuffer->writeToFile(theApp.getPreview());
+			}
+		}
 	} while(!rayTracer->threadsFinished());
 
 	theApp.showProgress(rayTracer);
@@ -114,10 +171,23 @@ int main(int argc, char *argv[])
 	printf("  Total rendering time: %s.\n\n", timeString);
 #endif
 
+	if(rayTracer->getRenderMode() == Engine::RenderProgressive)
+	{
+		printf("  Progressive passes: %u, noise level: %.4f.\n\n", rayTracer->getPass()+1, rayTracer->getNoiseLevel());
+		rayTracer->resolveFramebuffer();
+	}
+
 	theApp.printStatus("Writing framebuffer to file.");
-	if(!frameBuffer->writeToFile(theApp.getOutput()))
+	bool written;
+	if(frameBuffer->isStreamed())
+		written = frameBuffer->closeStream();
+	else if(hdrBuffer)
+		written = hdrBuffer->writeToFile(theApp.getOutput());
+	else
+		written = frameBuffer->writeToFile(theApp.getOutput());
+	if(!written)
 	{
-		delete scene; delete rayTracer; delete frameBuffer;
+		delete scene; delete rayTracer; delete frameBuffer; delete hdrBuffer;
 		theApp.printError("Operation failed!");
 		return 1;
 	}
@@ -126,5 +196,6 @@ int main(int argc, char *argv[])
 	delete scene;
 	delete rayTracer;
 	delete frameBuffer;
+	delete hdrBuffer;
 	return 0;
 }
\ No newline at end of file
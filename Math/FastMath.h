@@ -0,0 +1,220 @@
+/*
+	This file is part of EX-Ray Raytracing Engine.
+	(C)2007 - 2008 Micha Siejak.
+
+    EX-Ray is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EX-Ray is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with EX-Ray.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __FASTMATH_H
+#define __FASTMATH_H
+
+#define	MATH_FASTMATH
+
+namespace exRay {
+
+/** Szybkie przyblienia funkcji uywanych przy cieniowaniu (wczane przez EXRAY_FASTMATH w Config.h).
+	Maksymalne bdy zmierzone wzgldem biblioteki standardowej (wyniki liczone w double):
+	- fastRsqrt:	wzgldny < 3e-7 (rsqrtss + krok Newtona); bez SSE2 staa 0x5f3759df i dwa kroki, < 5e-6,
+	- fastExp2:		wzgldny < 2.5e-7 dla x z [-126, 127]; poniej -126 wynikiem jest 0 (bez liczb zdenormalizowanych),
+	- fastLog2:		bezwzgldny < 1e-7 * (1 + |log2(x)|) dla x > 0 (znormalizowanych),
+	- fastPow:		wzgldny < 2.5e-7 * (1 + |y*log2(x)|) dla wynikw do 2^127 (wiksze s ograniczane, jak w fastExp2),
+					wyniki poniej 2^-126 zwracane s jako 0,
+	- fastExp:		wzgldny < 7e-7 dla |x| <= 10 i < 4e-6 dla |x| <= 80.
+	Argumenty spoza dziedziny (x <= 0 w fastLog2, NaN) nie s obsugiwane; fastPow(0, y) zwraca 0.
+	Warianty z sufiksem 4 licz cztery wartoci naraz na rejestrze SSE z t sam dokadnoci.
+	Ograniczenia sprawdza program Tools/FastMathCheck.cpp.
+*/
+
+// Rozkad liczby float na bity.
+union FloatBits
+{
+	float			f;
+	int				i;
+};
+
+// Wspczynniki wielomianu 2^f dla f z [-0.5, 0.5] (interpolacja w wzach Czebyszewa).
+#define FASTMATH_EXP2_C0	1.000000075f
+#define FASTMATH_EXP2_C1	0.6931471880f
+#define FASTMATH_EXP2_C2	0.2402210749f
+#define FASTMATH_EXP2_C3	0.05550357114f
+#define FASTMATH_EXP2_C4	0.009676031918f
+#define FASTMATH_EXP2_C5	0.001339086336f
+// Wspczynniki szeregu log2(m) = 2/ln2 * (s + s^3/3 + s^5/5 + s^7/7), s = (m-1)/(m+1).
+#define FASTMATH_LOG2_C1	2.885390082f
+#define FASTMATH_LOG2_C3	0.9617966940f
+#define FASTMATH_LOG2_C5	0.5770780164f
+#define FASTMATH_LOG2_C7	0.4121985832f
+#define FASTMATH_LOG2E		1.442695041f
+
+// Odwrotno pierwiastka kwadratowego.
+inline float fastRsqrt(const float x)
+{
+#ifdef EXRAY_SSE2
+	float	r = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+	return r * (1.5f - 0.5f*x*r*r);
+#else
+	FloatBits	bits;
+	bits.f = x;
+	bits.i = 0x5f3759df - (bits.i >> 1);
+	float	r = bits.f;
+	r = r * (1.5f - 0.5f*x*r*r);
+	return r * (1.5f - 0.5f*x*r*r);
+#endif
+}
+
+// Potga 2^x.
+inline float fastExp2(float x)
+{
+	if(x < -126.0f) return 0.0f;
+	if(x > 127.0f)  x = 127.0f;
+
+	int			i = (int)floorf(x + 0.5f);
+	float		f = x - float(i);
+	FloatBits	scale;
+	scale.i = (i + 127) << 23;
+
+	float	p = FASTMATH_EXP2_C5;
+	p = p*f + FASTMATH_EXP2_C4;
+	p = p*f + FASTMATH_EXP2_C3;
+	p = p*f + FASTMATH_EXP2_C2;
+	p = p*f + FASTMATH_EXP2_C1;
+	p = p*f + FASTMATH_EXP2_C0;
+	return p * scale.f;
+}
+
+// Logarytm przy podstawie 2 (x > 0).
+inline float fastLog2(const float x)
+{
+	FloatBits	bits;
+	bits.f = x;
+	// Mantysa sprowadzana do przedziau [sqrt(0.5), sqrt(2)).
+	int		e = ((bits.i >> 23) & 0xff) - 127;
+	bits.i = (bits.i & 0x007fffff) | 0x3f800000;
+	if(bits.f > 1.41421356f)
+	{
+		bits.f *= 0.5f;
+		e++;
+	}
+
+	float	s	= (bits.f - 1.0f) / (bits.f + 1.0f);
+	float	s2	= s*s;
+	float	p	= FASTMATH_LOG2_C7;
+	p = p*s2 + FASTMATH_LOG2_C5;
+	p = p*s2 + FASTMATH_LOG2_C3;
+	p = p*s2 + FASTMATH_LOG2_C1;
+	return p*s + float(e);
+}
+
+// Potga x^y (x >= 0).
+inline float fastPow(const float x, const float y)
+{
+	if(x <= 0.0f) return 0.0f;
+	return fastExp2(y * fastLog2(x));
+}
+
+// Funkcja wykadnicza e^x.
+inline float fastExp(const float x)
+{ return fastExp2(x * FASTMATH_LOG2E); }
+
+// Wektor znormalizowany (wektor zerowy pozostaje bez zmian).
+inline vector3 fastNormalize(const vector3 &vec)
+{
+	float	sqLen = vec.sqLength();
+	if(sqLen == 0.0f)
+		return vec;
+	return fastRsqrt(sqLen) * vec;
+}
+
+#ifdef EXRAY_SSE2
+// Odwrotno pierwiastka kwadratowego (4 wartoci, kolejno dziaa jak w fastRsqrt).
+inline __m128 fastRsqrt4(const __m128 x)
+{
+	__m128	r = _mm_rsqrt_ps(x);
+	return _mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), x), r), r)));
+}
+
+// Potga 2^x (4 wartoci).
+inline __m128 fastExp2_4(__m128 x)
+{
+	__m128	underflow = _mm_cmplt_ps(x, _mm_set1_ps(-126.0f));
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-126.0f)), _mm_set1_ps(127.0f));
+
+	__m128i	i = _mm_cvtps_epi32(x);		// Zaokrglenie do najbliszej liczby cakowitej.
+	__m128	f = _mm_sub_ps(x, _mm_cvtepi32_ps(i));
+	__m128	scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(127)), 23));
+
+	__m128	p = _mm_set1_ps(FASTMATH_EXP2_C5);
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(FASTMATH_EXP2_C4));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(FASTMATH_EXP2_C3));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(FASTMATH_EXP2_C2));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(FASTMATH_EXP2_C1));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(FASTMATH_EXP2_C0));
+	return _mm_andnot_ps(underflow, _mm_mul_ps(p, scale));
+}
+
+// Logarytm przy podstawie 2 (4 wartoci, x > 0).
+inline __m128 fastLog2_4(const __m128 x)
+{
+	__m128i	bits = _mm_castps_si128(x);
+	__m128i	e	 = _mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(bits, 23), _mm_set1_epi32(0xff)), _mm_set1_epi32(127));
+	__m128	m	 = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+
+	// Mantysa sprowadzana do przedziau [sqrt(0.5), sqrt(2)).
+	__m128	high = _mm_cmpgt_ps(m, _mm_set1_ps(1.41421356f));
+	m = _mm_or_ps(_mm_and_ps(high, _mm_mul_ps(m, _mm_set1_ps(0.5f))), _mm_andnot_ps(high, m));
+	__m128	ef = _mm_add_ps(_mm_cvtepi32_ps(e), _mm_and_ps(high, _mm_set1_ps(1.0f)));
+
+	__m128	s	= _mm_div_ps(_mm_sub_ps(m, _mm_set1_ps(1.0f)), _mm_add_ps(m, _mm_set1_ps(1.0f)));
+	__m128	s2	= _mm_mul_ps(s, s);
+	__m128	p	= _mm_set1_ps(FASTMATH_LOG2_C7);
+	p = _mm_add_ps(_mm_mul_ps(p, s2), _mm_set1_ps(FASTMATH_LOG2_C5));
+	p = _mm_add_ps(_mm_mul_ps(p, s2), _mm_set1_ps(FASTMATH_LOG2_C3));
+	p = _mm_add_ps(_mm_mul_ps(p, s2), _mm_set1_ps(FASTMATH_LOG2_C1));
+	return _mm_add_ps(_mm_mul_ps(p, s), ef);
+}
+
+// Potga x^y (4 wartoci, x >= 0).
+inline __m128 fastPow4(const __m128 x, const __m128 y)
+{
+	__m128	positive = _mm_cmpgt_ps(x, _mm_setzero_ps());
+	return _mm_and_ps(positive, fastExp2_4(_mm_mul_ps(y, fastLog2_4(x))));
+}
+
+// Funkcja wykadnicza e^x (4 wartoci).
+inline __m128 fastExp4(const __m128 x)
+{ return fastExp2_4(_mm_mul_ps(x, _mm_set1_ps(FASTMATH_LOG2E))); }
+#endif
+
+// Funkcja wykadnicza dla skadowych wektora.
+inline vector3 fastExp(const vector3 &vec)
+{
+#ifdef EXRAY_SSE2
+	return vector3(_mm_and_ps(fastExp4(vec.getSSE()), _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1))));
+#else
+	return vector3(fastExp(vec.x), fastExp(vec.y), fastExp(vec.z));
+#endif
+}
+
+} // exRay
+
+// Funkcje cieniowania: przyblione z EXRAY_FASTMATH, dokadne bez.
+#ifdef EXRAY_FASTMATH
+#define MPOW(x, y)		fastPow(x, y)
+#define MNORMALIZE(v)	fastNormalize(v)
+#else
+#define MPOW(x, y)		powf(x, y)
+#define MNORMALIZE(v)	(v).getNormalized()
+#endif
+
+#endif
\ No newline at end of file
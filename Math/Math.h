@@ -56,5 +56,6 @@
 #include "Vector3.h"
 #include "Vector4.h"
 #include "Matrix4.h"
+#include "FastMath.h"
 
 #endif // __TYPESLIB_H
\ No newline at end of file
@@ -28,6 +28,11 @@ class vector3;
 class vector4;
 
 /// Macierz kwadratowa 4x4.
+/** Macierz przechowywana wierszami; wektor mnoony jest z prawej strony (kolumna), translacja zajmuje
+	komrki 3, 7 i 11. Przeksztacenia sceny s afiniczne (dolny wiersz 0 0 0 1), dla nich przeznaczone s
+	szybsze warianty mnoenia i odwracania. Z EXRAY_SSE2 iloczyny liczone s na rejestrach SSE w tej samej
+	kolejnoci dziaa co wersja skalarna, wic wyniki s identyczne.
+*/
 class matrix4
 {
 public:
@@ -51,9 +56,6 @@ public:
 		cell[12]=c13; cell[13]=c14; cell[14]=c15; cell[15]=c16;
 	}
 
-	// Destruktor.
-	virtual ~matrix4(void)			{ }
-
 	// Operatory:
 	// przypisanie (cast to float)
 	operator float* () const		{ return (float*)&cell;			}
@@ -85,31 +87,79 @@ public:
 		return result;
 	}
 
-	// Mnoenie (TODO: zoptymalizowa!)
+	// Czy macierz jest przeksztaceniem afinicznym (dolny wiersz 0 0 0 1).
+	bool	isAffine(void) const
+	{ return cell[12] == 0.0f && cell[13] == 0.0f && cell[14] == 0.0f && cell[15] == 1.0f; }
+
+#ifdef EXRAY_SSE2
+	// Wiersz macierzy w rejestrze SSE.
+	__m128	getRow(const int i) const
+	{ return _mm_loadu_ps(&cell[i*4]); }
+	// Wiersz [i] iloczynu (this * m): wiersze m waone komrkami wiersza [i].
+	__m128	multiplyRow(const int i, const matrix4 &m) const
+	{
+		__m128	r = _mm_mul_ps(_mm_set1_ps(cell[i*4]), m.getRow(0));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(cell[i*4+1]), m.getRow(1)));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(cell[i*4+2]), m.getRow(2)));
+		return _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(cell[i*4+3]), m.getRow(3)));
+	}
+	// Kolumny macierzy z wyzerowan czwart skadow (do przeksztacania wektorw vector3).
+	void	getColumns3(__m128 *columns) const
+	{
+		const __m128	mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		columns[0] = getRow(0); columns[1] = getRow(1); columns[2] = getRow(2); columns[3] = getRow(3);
+		_MM_TRANSPOSE4_PS(columns[0], columns[1], columns[2], columns[3]);
+		for(int i=0; i<4; i++)
+			columns[i] = _mm_and_ps(columns[i], mask);
+	}
+	// Wiersze macierzy z wyzerowan czwart skadow.
+	void	getRows3(__m128 *rows) const
+	{
+		const __m128	mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		for(int i=0; i<3; i++)
+			rows[i] = _mm_and_ps(getRow(i), mask);
+	}
+#endif
+
+	// Mnoenie.
 	matrix4 operator * (const matrix4 &m) const
 	{
 		matrix4 r;
+#ifdef EXRAY_SSE2
+		_mm_storeu_ps(&r.cell[0], multiplyRow(0, m));
+		_mm_storeu_ps(&r.cell[4], multiplyRow(1, m));
+		_mm_storeu_ps(&r.cell[8], multiplyRow(2, m));
+		_mm_storeu_ps(&r.cell[12], multiplyRow(3, m));
+#else
+		for(int i=0; i<16; i+=4)
+		{
+			r.cell[i]	= cell[i]*m.cell[0] + cell[i+1]*m.cell[4] + cell[i+2]*m.cell[8] + cell[i+3]*m.cell[12];
+			r.cell[i+1]	= cell[i]*m.cell[1] + cell[i+1]*m.cell[5] + cell[i+2]*m.cell[9] + cell[i+3]*m.cell[13];
+			r.cell[i+2]	= cell[i]*m.cell[2] + cell[i+1]*m.cell[6] + cell[i+2]*m.cell[10] + cell[i+3]*m.cell[14];
+			r.cell[i+3]	= cell[i]*m.cell[3] + cell[i+1]*m.cell[7] + cell[i+2]*m.cell[11] + cell[i+3]*m.cell[15];
+		}
+#endif
+		return r;
+	}
 
-		r.cell[0] = cell[0]*m.cell[0] + cell[1]*m.cell[4] + cell[2]*m.cell[8] + cell[3]*m.cell[12];
-		r.cell[1] = cell[0]*m.cell[1] + cell[1]*m.cell[5] + cell[2]*m.cell[9] + cell[3]*m.cell[13];
-		r.cell[2] = cell[0]*m.cell[2] + cell[1]*m.cell[6] + cell[2]*m.cell[10] + cell[3]*m.cell[14];
-		r.cell[3] = cell[0]*m.cell[3] + cell[1]*m.cell[7] + cell[2]*m.cell[11] + cell[3]*m.cell[15];
-
-		r.cell[4] = cell[4]*m.cell[0] + cell[5]*m.cell[4] + cell[6]*m.cell[8] + cell[7]*m.cell[12];
-		r.cell[5] = cell[4]*m.cell[1] + cell[5]*m.cell[5] + cell[6]*m.cell[9] + cell[7]*m.cell[13];
-		r.cell[6] = cell[4]*m.cell[2] + cell[5]*m.cell[6] + cell[6]*m.cell[10] + cell[7]*m.cell[14];
-		r.cell[7] = cell[4]*m.cell[3] + cell[5]*m.cell[7] + cell[6]*m.cell[11] + cell[7]*m.cell[15];
-
-		r.cell[8] = cell[8]*m.cell[0] + cell[9]*m.cell[4] + cell[10]*m.cell[8] + cell[11]*m.cell[12];
-		r.cell[9] = cell[8]*m.cell[1] + cell[9]*m.cell[5] + cell[10]*m.cell[9] + cell[11]*m.cell[13];
-		r.cell[10] = cell[8]*m.cell[2] + cell[9]*m.cell[6] + cell[10]*m.cell[10] + cell[11]*m.cell[14];
-		r.cell[11] = cell[8]*m.cell[3] + cell[9]*m.cell[7] + cell[10]*m.cell[11] + cell[11]*m.cell[15];
-
-		r.cell[12] = cell[12]*m.cell[0] + cell[13]*m.cell[4] + cell[14]*m.cell[8] + cell[15]*m.cell[12];
-		r.cell[13] = cell[12]*m.cell[1] + cell[13]*m.cell[5] + cell[14]*m.cell[9] + cell[15]*m.cell[13];
-		r.cell[14] = cell[12]*m.cell[2] + cell[13]*m.cell[6] + cell[14]*m.cell[10] + cell[15]*m.cell[14];
-		r.cell[15] = cell[12]*m.cell[3] + cell[13]*m.cell[7] + cell[14]*m.cell[11] + cell[15]*m.cell[15];
-
+	// Mnoenie macierzy afinicznych (dolny wiersz wyniku nie jest liczony).
+	matrix4 multiplyAffine(const matrix4 &m) const
+	{
+		matrix4 r;
+#ifdef EXRAY_SSE2
+		_mm_storeu_ps(&r.cell[0], multiplyRow(0, m));
+		_mm_storeu_ps(&r.cell[4], multiplyRow(1, m));
+		_mm_storeu_ps(&r.cell[8], multiplyRow(2, m));
+#else
+		for(int i=0; i<12; i+=4)
+		{
+			r.cell[i]	= cell[i]*m.cell[0] + cell[i+1]*m.cell[4] + cell[i+2]*m.cell[8] + cell[i+3]*m.cell[12];
+			r.cell[i+1]	= cell[i]*m.cell[1] + cell[i+1]*m.cell[5] + cell[i+2]*m.cell[9] + cell[i+3]*m.cell[13];
+			r.cell[i+2]	= cell[i]*m.cell[2] + cell[i+1]*m.cell[6] + cell[i+2]*m.cell[10] + cell[i+3]*m.cell[14];
+			r.cell[i+3]	= cell[i]*m.cell[3] + cell[i+1]*m.cell[7] + cell[i+2]*m.cell[11] + cell[i+3]*m.cell[15];
+		}
+#endif
+		r.cell[15] = 1.0f;
 		return r;
 	}
 
@@ -125,13 +175,64 @@ public:
 
 		return r;
 	}
+	// Przeksztacenie punktu (w = 1, macierz afiniczna).
 	vector3 operator * (const vector3 &v) const
 	{
-		vector4	r4, v4(v, 1.0f);
-		r4 = *this * v4;
-		return vector3(r4.x, r4.y, r4.z);
+		return vector3(cell[0]*v.x + cell[1]*v.y + cell[2]*v.z + cell[3],
+					   cell[4]*v.x + cell[5]*v.y + cell[6]*v.z + cell[7],
+					   cell[8]*v.x + cell[9]*v.y + cell[10]*v.z + cell[11]);
 	}
 
+	// Przeksztacenie [count] punktw (w = 1, macierz afiniczna).
+	void transformPoints(const vector3 *points, vector3 *result, const unsigned int count) const
+	{
+#ifdef EXRAY_SSE2
+		__m128	c[4];
+		getColumns3(c);
+		for(unsigned int i=0; i<count; i++)
+		{
+			__m128	r = _mm_mul_ps(c[0], _mm_set1_ps(points[i].x));
+			r = _mm_add_ps(r, _mm_mul_ps(c[1], _mm_set1_ps(points[i].y)));
+			r = _mm_add_ps(r, _mm_mul_ps(c[2], _mm_set1_ps(points[i].z)));
+			result[i] = vector3(_mm_add_ps(r, c[3]));
+		}
+#else
+		for(unsigned int i=0; i<count; i++)
+			result[i] = (*this) * points[i];
+#endif
+	}
+	// Przeksztacenie [count] normalnych. Macierz musi by odwrotnoci przeksztacenia obiektu:
+	// normalne mnoone s przez transpozycj jej czci 3x3.
+	void transformNormals(const vector3 *normals, vector3 *result, const unsigned int count) const
+	{
+#ifdef EXRAY_SSE2
+		// Iloczyny 0*n daj -0 dla ujemnych skadowych, wic czwarta skadowa wyniku jest zerowana.
+		const __m128	mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		__m128	r[3];
+		getRows3(r);
+		for(unsigned int i=0; i<count; i++)
+		{
+			__m128	n = _mm_mul_ps(r[0], _mm_set1_ps(normals[i].x));
+			n = _mm_add_ps(n, _mm_mul_ps(r[1], _mm_set1_ps(normals[i].y)));
+			n = _mm_add_ps(n, _mm_mul_ps(r[2], _mm_set1_ps(normals[i].z)));
+			result[i] = vector3(_mm_and_ps(n, mask));
+		}
+#else
+		for(unsigned int i=0; i<count; i++)
+		{
+			const vector3	&n = normals[i];
+			result[i] = vector3(cell[0]*n.x + cell[4]*n.y + cell[8]*n.z,
+								cell[1]*n.x + cell[5]*n.y + cell[9]*n.z,
+								cell[2]*n.x + cell[6]*n.y + cell[10]*n.z);
+		}
+#endif
+	}
+	vector3 transformNormal(const vector3 &normal) const
+	{
+		vector3	result;
+		transformNormals(&normal, &result, 1);
+		return result;
+	}
 	
 	void operator += (const matrix4 &m)
 	{ *this = m + *this; }
@@ -181,11 +282,45 @@ public:
 			cell[3], cell[7], cell[11], cell[15]);
 	}
 
-	// Odwracanie macierzy.
+	// Odwracanie macierzy (dla macierzy osobliwej wynikiem jest macierz jednostkowa).
 	void	invert(void)
 	{
-		// TODO: Zaimplementowa!
-		return;
+		if(isAffine())
+		{
+			*this = getAffineInverse();
+			return;
+		}
+
+		// Dopenienia algebraiczne (macierz doczona).
+		const float	*m = cell;
+		float		inv[16];
+
+		inv[0]  =  m[5]*m[10]*m[15] - m[5]*m[11]*m[14] - m[9]*m[6]*m[15] + m[9]*m[7]*m[14] + m[13]*m[6]*m[11] - m[13]*m[7]*m[10];
+		inv[4]  = -m[4]*m[10]*m[15] + m[4]*m[11]*m[14] + m[8]*m[6]*m[15] - m[8]*m[7]*m[14] - m[12]*m[6]*m[11] + m[12]*m[7]*m[10];
+		inv[8]  =  m[4]*m[9]*m[15]  - m[4]*m[11]*m[13] - m[8]*m[5]*m[15] + m[8]*m[7]*m[13] + m[12]*m[5]*m[11] - m[12]*m[7]*m[9];
+		inv[12] = -m[4]*m[9]*m[14]  + m[4]*m[10]*m[13] + m[8]*m[5]*m[14] - m[8]*m[6]*m[13] - m[12]*m[5]*m[10] + m[12]*m[6]*m[9];
+		inv[1]  = -m[1]*m[10]*m[15] + m[1]*m[11]*m[14] + m[9]*m[2]*m[15] - m[9]*m[3]*m[14] - m[13]*m[2]*m[11] + m[13]*m[3]*m[10];
+		inv[5]  =  m[0]*m[10]*m[15] - m[0]*m[11]*m[14] - m[8]*m[2]*m[15] + m[8]*m[3]*m[14] + m[12]*m[2]*m[11] - m[12]*m[3]*m[10];
+		inv[9]  = -m[0]*m[9]*m[15]  + m[0]*m[11]*m[13] + m[8]*m[1]*m[15] - m[8]*m[3]*m[13] - m[12]*m[1]*m[11] + m[12]*m[3]*m[9];
+		inv[13] =  m[0]*m[9]*m[14]  - m[0]*m[10]*m[13] - m[8]*m[1]*m[14] + m[8]*m[2]*m[13] + m[12]*m[1]*m[10] - m[12]*m[2]*m[9];
+		inv[2]  =  m[1]*m[6]*m[15]  - m[1]*m[7]*m[14]  - m[5]*m[2]*m[15] + m[5]*m[3]*m[14] + m[13]*m[2]*m[7]  - m[13]*m[3]*m[6];
+		inv[6]  = -m[0]*m[6]*m[15]  + m[0]*m[7]*m[14]  + m[4]*m[2]*m[15] - m[4]*m[3]*m[14] - m[12]*m[2]*m[7]  + m[12]*m[3]*m[6];
+		inv[10] =  m[0]*m[5]*m[15]  - m[0]*m[7]*m[13]  - m[4]*m[1]*m[15] + m[4]*m[3]*m[13] + m[12]*m[1]*m[7]  - m[12]*m[3]*m[5];
+		inv[14] = -m[0]*m[5]*m[14]  + m[0]*m[6]*m[13]  + m[4]*m[1]*m[14] - m[4]*m[2]*m[13] - m[12]*m[1]*m[6]  + m[12]*m[2]*m[5];
+		inv[3]  = -m[1]*m[6]*m[11]  + m[1]*m[7]*m[10]  + m[5]*m[2]*m[11] - m[5]*m[3]*m[10] - m[9]*m[2]*m[7]   + m[9]*m[3]*m[6];
+		inv[7]  =  m[0]*m[6]*m[11]  - m[0]*m[7]*m[10]  - m[4]*m[2]*m[11] + m[4]*m[3]*m[10] + m[8]*m[2]*m[7]   - m[8]*m[3]*m[6];
+		inv[11] = -m[0]*m[5]*m[11]  + m[0]*m[7]*m[9]   + m[4]*m[1]*m[11] - m[4]*m[3]*m[9]  - m[8]*m[1]*m[7]   + m[8]*m[3]*m[5];
+		inv[15] =  m[0]*m[5]*m[10]  - m[0]*m[6]*m[9]   - m[4]*m[1]*m[10] + m[4]*m[2]*m[9]  + m[8]*m[1]*m[6]   - m[8]*m[2]*m[5];
+
+		float	det = m[0]*inv[0] + m[1]*inv[4] + m[2]*inv[8] + m[3]*inv[12];
+		if(det == 0.0f)
+		{
+			loadIdentity();
+			return;
+		}
+		det = 1.0f / det;
+		for(int i=0; i<16; i++)
+			cell[i] = inv[i] * det;
 	}
 	matrix4 getInverted(void) const
 	{
@@ -193,6 +328,35 @@ public:
 		result.invert();
 		return result;
 	}
+	// Odwrotno przeksztacenia afinicznego: [A t] -> [A^-1  -A^-1*t].
+	matrix4 getAffineInverse(void) const
+	{
+		matrix4	r(true);
+
+		r.cell[0]	= cell[5]*cell[10] - cell[6]*cell[9];
+		r.cell[1]	= cell[2]*cell[9]  - cell[1]*cell[10];
+		r.cell[2]	= cell[1]*cell[6]  - cell[2]*cell[5];
+		r.cell[4]	= cell[6]*cell[8]  - cell[4]*cell[10];
+		r.cell[5]	= cell[0]*cell[10] - cell[2]*cell[8];
+		r.cell[6]	= cell[2]*cell[4]  - cell[0]*cell[6];
+		r.cell[8]	= cell[4]*cell[9]  - cell[5]*cell[8];
+		r.cell[9]	= cell[1]*cell[8]  - cell[0]*cell[9];
+		r.cell[10]	= cell[0]*cell[5]  - cell[1]*cell[4];
+
+		float	det = cell[0]*r.cell[0] + cell[1]*r.cell[4] + cell[2]*r.cell[8];
+		if(det == 0.0f)
+			return matrix4(true);
+		det = 1.0f / det;
+		for(int i=0; i<12; i+=4)
+		{
+			r.cell[i] *= det; r.cell[i+1] *= det; r.cell[i+2] *= det;
+		}
+
+		r.cell[3]	= -(r.cell[0]*cell[3] + r.cell[1]*cell[7] + r.cell[2]*cell[11]);
+		r.cell[7]	= -(r.cell[4]*cell[3] + r.cell[5]*cell[7] + r.cell[6]*cell[11]);
+		r.cell[11]	= -(r.cell[8]*cell[3] + r.cell[9]*cell[7] + r.cell[10]*cell[11]);
+		return r;
+	}
 	// Transformacje przestrzenne:
 
 	// Translacja
@@ -271,7 +435,7 @@ public:
 		mx.setRotationX(vec.x);
 		my.setRotationY(vec.y);
 		mz.setRotationZ(vec.z);
-		return mx * my * mz;
+		return mx.multiplyAffine(my).multiplyAffine(mz);
 	}
 	matrix4 rotate(const float x, const float y, const float z) const
 	{
@@ -279,7 +443,7 @@ public:
 		mx.setRotationX(x);
 		my.setRotationY(y);
 		mz.setRotationZ(z);
-		return mx * my * mz;
+		return mx.multiplyAffine(my).multiplyAffine(mz);
 	}
 
 	// Dane (zmienne z wartociami komrek macierzy)
@@ -35,9 +35,6 @@ public:
 	vector2(float newVal)		{ x=newVal;	y=newVal;	}
 	vector2(float nX, float nY)	{ x=nX;		y=nY;		}
 
-	// Destruktor.
-	virtual ~vector2(void)		{ }
-
 	// Operatory:
 	// Przypisanie (cast to float)
 	operator float* () const		{ return (float*)&cell;			}
@@ -27,25 +27,45 @@ class vector2;
 class vector4;
 
 /// Wektor przestrzeni trjwymiarowej.
+/** Klasa nie ma metod wirtualnych i jest trywialnie kopiowalna. Wektor zajmuje 16 bajtw: czwarta komrka
+	(lane[3]) jest wyrwnaniem do rejestru SSE i zawsze ma warto 0, dziki czemu podstawowe dziaania
+	wykonywane s na caym rejestrze bez zmiany wynikw wzgldem oblicze skalarnych.
+*/
 class vector3
 {
 public:
 	// Konstruktory.
-	vector3(void)							{ x=0.0f;	y=0.0f;		z=0.0f;		}
-	vector3(float newVal)					{ x=newVal;	y=newVal;	z=newVal;	}
-	vector3(float nX, float nY)				{ x=nX;		y=nY;		z=0.0f;		}
-	vector3(const vector2 &vec)				{ x=vec.x;	y=vec.y;	z=0.0f;		}
-	vector3(float nX, float nY, float nZ)	{ x=nX;		y=nY;		z=nZ;		}
-	vector3(const vector2 &vec, float nZ)	{ x=vec.x;	y=vec.y;	z=nZ;		}
-
-	// Destruktor.
-	virtual ~vector3(void)		{ }
+	vector3(void)							{ x=0.0f;	y=0.0f;		z=0.0f;		lane[3]=0.0f;	}
+	vector3(float newVal)					{ x=newVal;	y=newVal;	z=newVal;	lane[3]=0.0f;	}
+	vector3(float nX, float nY)				{ x=nX;		y=nY;		z=0.0f;		lane[3]=0.0f;	}
+	vector3(const vector2 &vec)				{ x=vec.x;	y=vec.y;	z=0.0f;		lane[3]=0.0f;	}
+	vector3(float nX, float nY, float nZ)	{ x=nX;		y=nY;		z=nZ;		lane[3]=0.0f;	}
+	vector3(const vector2 &vec, float nZ)	{ x=vec.x;	y=vec.y;	z=nZ;		lane[3]=0.0f;	}
+#ifdef EXRAY_SSE2
+	explicit vector3(const __m128 &vec)		{ _mm_storeu_ps(lane, vec);	}
+
+	// Zawarto wektora w rejestrze SSE (czwarta skadowa rwna 0).
+	__m128	getSSE(void) const				{ return _mm_loadu_ps(lane);	}
+	// Liczba rozszerzona na trzy skadowe (czwarta rwna 0).
+	static __m128	splat(const float value)	{ return _mm_set_ps(0.0f, value, value, value);	}
+#endif
 
 	// Operatory:
 	// Przypisanie (cast to float)
 	operator float* () const		{ return (float*)&cell;			}
 	operator const float* () const	{ return (const float*)&cell;	}
 
+#ifdef EXRAY_SSE2
+	// Dodawanie.
+	vector3 operator + (const vector3 &vec) const
+	{ return vector3(_mm_add_ps(getSSE(), vec.getSSE()));	}
+	// Odejmowanie.
+	vector3 operator - (const vector3 &vec) const
+	{ return vector3(_mm_sub_ps(getSSE(), vec.getSSE()));	}
+	// Mnoenie.
+	vector3 operator * (const vector3 &vec) const
+	{ return vector3(_mm_mul_ps(getSSE(), vec.getSSE()));	}
+#else
 	// Dodawanie.
 	vector3 operator + (const vector3 &vec) const
 	{ return vector3(x+vec.x, y+vec.y, z+vec.z);		}
@@ -55,6 +75,7 @@ public:
 	// Mnoenie.
 	vector3 operator * (const vector3 &vec) const
 	{ return vector3(x*vec.x, y*vec.y, z*vec.z);		}
+#endif
 	// Dzielenie.
 	vector3 operator / (const vector3 &vec) const
 	{	
@@ -62,6 +83,22 @@ public:
 		return vector3(x/vec.x, y/vec.y, z/vec.z);
 	}
 
+#ifdef EXRAY_SSE2
+	void operator += (const vector3 &vec)
+	{ _mm_storeu_ps(lane, _mm_add_ps(getSSE(), vec.getSSE())); }
+	void operator += (const float &value)
+	{ _mm_storeu_ps(lane, _mm_add_ps(getSSE(), splat(value))); }
+
+	void operator -= (const vector3 &vec)
+	{ _mm_storeu_ps(lane, _mm_sub_ps(getSSE(), vec.getSSE())); }
+	void operator -= (const float &value)
+	{ _mm_storeu_ps(lane, _mm_sub_ps(getSSE(), splat(value))); }
+
+	void operator *= (const vector3 &vec)
+	{ _mm_storeu_ps(lane, _mm_mul_ps(getSSE(), vec.getSSE())); }
+	void operator *= (const float &value)
+	{ _mm_storeu_ps(lane, _mm_mul_ps(getSSE(), splat(value))); }
+#else
 	void operator += (const vector3 &vec)
 	{ x+=vec.x; y+=vec.y; z+=vec.z; }
 	void operator += (const float &value)
@@ -76,6 +113,7 @@ public:
 	{ x*=vec.x; y*=vec.y; z*=vec.z; }
 	void operator *= (const float &value)
 	{ x*=value; y*=value; z*=value; }
+#endif
 
 	void operator /= (const vector3 &vec)
 	{
@@ -87,7 +125,12 @@ public:
 	{
 		if(value == 0.0f)
 			return;
+#ifdef EXRAY_SSE2
+		// Dzielnik 1 w czwartej skadowej: 0/value daoby -0 dla ujemnego value.
+		_mm_storeu_ps(lane, _mm_div_ps(getSSE(), _mm_set_ps(1.0f, value, value, value)));
+#else
 		x/=value; y/=value; z/=value;
+#endif
 	}
 
 	// Dodawanie liczby float.
@@ -97,8 +140,13 @@ public:
 	friend vector3 operator - (float value, const vector3 &vec)
 	{ return vector3(vec.y-value, vec.y-value, vec.z-value);		}
 	// Mnoenie przez liczb float.
+#ifdef EXRAY_SSE2
+	friend vector3 operator * (float value, const vector3 &vec)
+	{ return vector3(_mm_mul_ps(vec.getSSE(), splat(value)));		}
+#else
 	friend vector3 operator * (float value, const vector3 &vec)
 	{ return vector3(vec.x*value, vec.y*value, vec.z*value);		}
+#endif
 	// Dzielenie przez liczb float.
 	friend vector3 operator / (float value, const vector3 &vec)
 	{
@@ -108,8 +156,13 @@ public:
 
 	vector3 operator + (void) const
 	{ return *this; }
+#ifdef EXRAY_SSE2
+	vector3 operator - (void) const
+	{ return vector3(_mm_xor_ps(getSSE(), _mm_set_ps(0.0f, -0.0f, -0.0f, -0.0f))); }
+#else
 	vector3 operator - (void) const
 	{ return vector3(-x, -y, -z); }
+#endif
 
 	// Porwnanie dwch wektorw.
 	bool operator == (const vector3 &vec) const
@@ -144,9 +197,7 @@ public:
 	{
 		float	len = length();
 		if(len==0.0f || len==1.0f)	return;
-		x /= len;
-		y /= len;
-		z /= len;
+		*this /= len;
 	}
 	// Zwraca wektor znormalizowany.
 	vector3	getNormalized() const
@@ -189,6 +240,7 @@ public:
 		struct	{ float x; float y; float z; };
 		struct	{ float r; float g; float b; };
 		float	cell[3];
+		float	lane[4];	// Rejestr SSE; lane[3] == 0
 	};
 };
 
@@ -27,6 +27,7 @@ class vector2;
 class vector3;
 
 /// Wektor przestrzeni czterowymiarowej.
+/** Klasa nie ma metod wirtualnych i jest trywialnie kopiowalna; podstawowe dziaania wykonywane s na rejestrze SSE. */
 class vector4
 {
 public:
@@ -42,23 +43,39 @@ public:
 	vector4(const vector3 &vec, float nW)			{ x=vec.x;	y=vec.y;	z=vec.z;	w=nW;		}
 	vector4(const vector2 &v1, const vector2 &v2)	{ x=v1.x;	y=v1.y;		z=v2.x;		w=v2.y;		}
 
-	// Destruktor.
-	virtual ~vector4(void)		{ }
+#ifdef EXRAY_SSE2
+	explicit vector4(const __m128 &vec)				{ _mm_storeu_ps(cell, vec);	}
+
+	// Zawarto wektora w rejestrze SSE.
+	__m128	getSSE(void) const						{ return _mm_loadu_ps(cell);	}
+#endif
 
 	// Operatory:
 	// Przypisanie (cast to float)
 	operator float* () const		{ return (float*)&cell;			}
 	operator const float* () const	{ return (const float*)&cell;	}
 
+#ifdef EXRAY_SSE2
+	// Dodawanie.
+	vector4 operator + (const vector4 &vec) const
+	{ return vector4(_mm_add_ps(getSSE(), vec.getSSE()));		}
+	// Odejmowanie.
+	vector4 operator - (const vector4 &vec) const
+	{ return vector4(_mm_sub_ps(getSSE(), vec.getSSE()));		}
+	// Mnoenie.
+	vector4 operator * (const vector4 &vec) const
+	{ return vector4(_mm_mul_ps(getSSE(), vec.getSSE()));		}
+#else
 	// Dodawanie.
 	vector4 operator + (const vector4 &vec) const
 	{ return vector4(x+vec.x, y+vec.y, z+vec.z, w+vec.w);		}
 	// Odejmowanie.
 	vector4 operator - (const vector4 &vec) const
-	{ return vector4(x-vec.x, y-vec.y, y-vec.z, w-vec.w);		}
+	{ return vector4(x-vec.x, y-vec.y, z-vec.z, w-vec.w);		}
 	// Mnoenie.
 	vector4 operator * (const vector4 &vec) const
 	{ return vector4(x*vec.x, y*vec.y, z*vec.z, w*vec.w);		}
+#endif
 	// Dzielenie.
 	vector4 operator / (const vector4 &vec) const
 	{	
@@ -66,6 +83,22 @@ public:
 		return vector4(x/vec.x, y/vec.y, z/vec.z, w/vec.w);
 	}
 
+#ifdef EXRAY_SSE2
+	void operator += (const vector4 &vec)
+	{ _mm_storeu_ps(cell, _mm_add_ps(getSSE(), vec.getSSE())); }
+	void operator += (const float &value)
+	{ _mm_storeu_ps(cell, _mm_add_ps(getSSE(), _mm_set1_ps(value))); }
+
+	void operator -= (const vector4 &vec)
+	{ _mm_storeu_ps(cell, _mm_sub_ps(getSSE(), vec.getSSE())); }
+	void operator -= (const float &value)
+	{ _mm_storeu_ps(cell, _mm_sub_ps(getSSE(), _mm_set1_ps(value))); }
+
+	void operator *= (const vector4 &vec)
+	{ _mm_storeu_ps(cell, _mm_mul_ps(getSSE(), vec.getSSE())); }
+	void operator *= (const float &value)
+	{ _mm_storeu_ps(cell, _mm_mul_ps(getSSE(), _mm_set1_ps(value))); }
+#else
 	void operator += (const vector4 &vec)
 	{ x+=vec.x; y+=vec.y; z+=vec.z; w+=vec.w; }
 	void operator += (const float &value)
@@ -80,6 +113,7 @@ public:
 	{ x*=vec.x; y*=vec.y; z*=vec.z; w*=vec.w; }
 	void operator *= (const float &value)
 	{ x*=value; y*=value; z*=value; w*=value; }
+#endif
 
 	void operator /= (const vector4 &vec)
 	{
@@ -91,7 +125,11 @@ public:
 	{
 		if(value == 0.0f)
 			return;
+#ifdef EXRAY_SSE2
+		_mm_storeu_ps(cell, _mm_div_ps(getSSE(), _mm_set1_ps(value)));
+#else
 		x/=value; y/=value; z/=value; w/=value;
+#endif
 	}
 
 	// Dodawanie liczby float.
@@ -101,8 +139,13 @@ public:
 	friend vector4 operator - (float value, const vector4 &vec)
 	{ return vector4(vec.y-value, vec.y-value, vec.z-value, vec.w-value);	}
 	// Mnoenie liczby float.
+#ifdef EXRAY_SSE2
+	friend vector4 operator * (float value, const vector4 &vec)
+	{ return vector4(_mm_mul_ps(vec.getSSE(), _mm_set1_ps(value)));		}
+#else
 	friend vector4 operator * (float value, const vector4 &vec)
 	{ return vector4(vec.x*value, vec.y*value, vec.z*value, vec.w*value);	}
+#endif
 	// Dzielenie liczby float.
 	friend vector4 operator / (float value, const vector4 &vec)
 	{
@@ -149,10 +192,7 @@ public:
 	{
 		float	len = length();
 		if(len==0.0f || len==1.0f)	return;
-		x /= len;
-		y /= len;
-		z /= len;
-		w /= len;
+		*this /= len;
 	}
 	// Zwraca wektor znormalizowany.
 	vector4	getNormalized() const
@@ -20,79 +20,47 @@
 #include "../Types/Shader.h"
 #include "../Graph/Variable.h"
 #include "../Graph/Node.h"
+#include "../Core/RenderScene.h"
+#include "../Core/Kernels.h"
 #include "ShaderPhong.h"
 
 using namespace exRay;
 
 ShaderPhong::ShaderPhong(void) : Shader()
 {
-	cLightCount		= 0;
-	cLightColor		= NULL;
-	cLightPosition	= NULL;
 }
 
 ShaderPhong::~ShaderPhong(void)
 {
-	if(cLightColor)	delete[] cLightColor;
-	if(cLightPosition) delete[] cLightPosition;
 }
 
-void ShaderPhong::cacheVariables(Node *pnode)
+// wiata (pozycje i kolory) pobierane s z tablicy wiate sceny przez indeksy kolejki.
+void ShaderPhong::computeShading(ShadingQueue *queue)
 {
-	VNode	*lights = (VNode*)pnode->getAttrib("env_light");
-
-	if(!lights) return;
-	if(lights->size() == 0) return;
-
-	cLightCount		= lights->size();
-	cLightColor		= new vector3[cLightCount];
-	cLightPosition	= new vector3[cLightCount];
-
-	Node	*lightNode;
-	for(unsigned int i=0; i<cLightCount; i++)
-	{
-		lights->getValue(lightNode, i);
-		lightNode->getAttrib("color")->getValue(cLightColor[i]);
-		lightNode->getAttrib("position")->getValue(cLightPosition[i]);
-	}
+	if(queue->features & RenderMaterial::FeatureSpecular)
+		Kernels::get().shadePhong(queue, 0);
+	else
+		Kernels::get().shadeDiffuse(queue, 0);
 }
 
-vector3 ShaderPhong::computeShading(ShaderUniforms *su, const float *visibility)
+vector3 ShaderPhong::composeShading(const vector3 &direct, const RenderMaterial &material, const vector3 *reflected,
+									const vector3 *refracted, const float absorbance) const
 {
-	vector3	pixel, cLightDirection, cLightReflect;
-	float	diffuse, specular;
+	vector3	pixel = direct;
 
-	for(unsigned int i=0; i<cLightCount; i++)
+	if(reflected)
 	{
-		diffuse		= 0.0f;
-		specular	= 0.0f;
-
-		cLightDirection = (cLightPosition[i] - (*su->IntPoint)).getNormalized();
-		float dotNL = su->Normal.dot(cLightDirection);
-		if(dotNL > 0.0f)
-		{
-			diffuse = su->MaterialDiffuse * dotNL * visibility[i];
-			cLightReflect = 2.0f * su->Normal * cLightDirection.dot(su->Normal) - cLightDirection;
-			float dotNR = su->Normal.dot(cLightReflect);
-			if(dotNR > 0.0f)
-				specular = powf(dotNR, su->MaterialSpecularExponent) * su->MaterialSpecular * visibility[i];
-		}
-
-		pixel += diffuse * cLightColor[i] * (*su->MaterialColor);
-		pixel += specular * cLightColor[i];
-		//pixel += (*su->MaterialColor) * cLightDiffuse[i] * diffuse;
-		//pixel += cLightSpecular[i] * specular;
+		if(material.reflectance > 0.0f)
+			pixel += material.reflectance * (*reflected) * material.color;
 	}
-
-	if(su->ReflectFlag)
+	if(refracted)
 	{
-		if(su->MaterialReflectance > 0.0f)
-			pixel += su->MaterialReflectance * su->ReflectComponent * (*su->MaterialColor);
-	}
-	if(su->RefractFlag)
-	{
-		vector3	rAbsorbance = (*su->MaterialColor) * su->MaterialAbsorbance;
-		pixel += su->RefractComponent * vector3(expf(rAbsorbance.x), expf(rAbsorbance.y), expf(rAbsorbance.y));
+		vector3	rAbsorbance = material.color * absorbance;
+#ifdef EXRAY_FASTMATH
+		pixel += (*refracted) * fastExp(vector3(rAbsorbance.x, rAbsorbance.y, rAbsorbance.y));
+#else
+		pixel += (*refracted) * vector3(expf(rAbsorbance.x), expf(rAbsorbance.y), expf(rAbsorbance.y));
+#endif
 	}
 	return pixel;
-}
+}
\ No newline at end of file
@@ -24,22 +24,19 @@ namespace exRay {
 /// Shader: Owietlenie Lambert/Phong.
 /** Oblicza owietlenie rozproszone zgodnie z prawem Lamberta oraz owietlenie odbite
 	zgodnie z aproksymacj Phonga. Przy obliczeniach uwzgldnia cakowite odbicie
-	oraz refrakcj.
+	oraz refrakcj. Owietlenie bezporednie liczone jest dla caej kolejki trafie jdrem shadePhong
+	(Kernels), w wariancie SIMD przetwarzajcym 4 lub 8 trafie naraz; kolejki materiaw bez skadowej
+	odbitej owietlane s jdrem shadeDiffuse.
 */
 class ShaderPhong : public Shader
 {
-private: // cache
-	vector3			*cLightColor;
-	vector3			*cLightPosition;
-	//float			*cLightDiffuse;
-	//float			*cLightSpecular;
-	unsigned int	cLightCount;
 public:
 	ShaderPhong(void);
 	virtual ~ShaderPhong(void);
 
-	virtual void	cacheVariables(Node *pnode);
-	virtual vector3	computeShading(ShaderUniforms *su, const float *visibility=NULL);
+	virtual void	computeShading(ShadingQueue *queue);
+	virtual vector3	composeShading(const vector3 &direct, const RenderMaterial &material, const vector3 *reflected,
+								   const vector3 *refracted, const float absorbance) const;
 };
 
 } // exRay
@@ -0,0 +1,215 @@
+/*
+	This file is part of EX-Ray Raytracing Engine.
+	(C)2007 - 2008 Micha Siejak.
+
+    EX-Ray is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EX-Ray is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with EX-Ray.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/** Test dokadnoci funkcji z Math/FastMath.h.
+	Program przeglda dziedziny fastRsqrt, fastExp2, fastLog2, fastPow, fastExp oraz ich wariantw
+	czterowartociowych i porwnuje wyniki z bibliotek standardow (liczon w double). Zwraca 1, jeli
+	ktrykolwiek bd przekracza ograniczenie podane w opisie FastMath.h.
+	Program nie jest czci projektu exRay.vcproj; kompilacja z katalogu gwnego:
+		cl /O2 /EHsc /arch:SSE2 Tools\FastMathCheck.cpp
+*/
+
+#include "../Config.h"
+
+using namespace exRay;
+
+/// Wynik porwnania jednej funkcji z bibliotek standardow.
+class CheckResult
+{
+private:
+	const char*		name;
+	double			worst;		// Najwikszy stosunek bdu do dopuszczalnego ograniczenia.
+	float			worstArg[2];
+	unsigned int	samples;
+	unsigned int	failures;
+public:
+	CheckResult(const char *fname)
+	{
+		name		= fname;
+		worst		= 0.0;
+		worstArg[0]	= 0.0f;
+		worstArg[1]	= 0.0f;
+		samples		= 0;
+		failures	= 0;
+	}
+
+	// Bd err przy ograniczeniu bound dla argumentw (a, b); NaN liczony jest jako przekroczenie.
+	void	add(const double err, const double bound, const float a, const float b=0.0f)
+	{
+		const double ratio = err / bound;
+		samples++;
+		if(!(ratio <= 1.0))
+			failures++;
+		if(!(ratio <= worst))
+		{
+			worst		= ratio;
+			worstArg[0]	= a;
+			worstArg[1]	= b;
+		}
+	}
+
+	bool	report(void) const
+	{
+		printf("%-12s %9u samples, worst error %.3f of bound (x=%g, y=%g)%s\n", name, samples, worst,
+			worstArg[0], worstArg[1], failures ? " FAILED" : "");
+		return failures == 0;
+	}
+};
+
+static const double LN2 = 0.69314718055994530942;
+
+// Ograniczenia bdw z opisu FastMath.h.
+#ifdef EXRAY_SSE2
+static const double RSQRT_BOUND = 3e-7;
+#else
+static const double RSQRT_BOUND = 5e-6;
+#endif
+static const double EXP2_BOUND	= 2.5e-7;
+static const double LOG2_BOUND	= 1e-7;
+static const double POW_BOUND	= 2.5e-7;
+static const double EXP_BOUND	= 7e-7;		// |x| <= 10
+static const double EXP_BOUND80	= 4e-6;		// |x| <= 80
+
+static double relativeError(const double value, const double reference)
+{ return fabs(value - reference) / fabs(reference); }
+
+// Wartoci logarytmicznie rozoone w [low, high] (low > 0).
+static float logSample(const float low, const float high, const unsigned int i, const unsigned int count)
+{ return (float)(low * pow((double)high/low, (double)i/(count-1))); }
+
+// Wartoci rwnomiernie rozoone w [low, high].
+static float linearSample(const float low, const float high, const unsigned int i, const unsigned int count)
+{ return (float)(low + (high-low)*((double)i/(count-1))); }
+
+static void checkRsqrt(CheckResult &result, const float x, const float value)
+{ result.add(relativeError(value, 1.0/sqrt((double)x)), RSQRT_BOUND, x); }
+
+static void checkExp2(CheckResult &result, const float x, const float value)
+{
+	if(x < -126.0f)
+		result.add(value == 0.0f ? 0.0 : 1.0, 0.5, x);
+	else result.add(relativeError(value, pow(2.0, (double)x)), EXP2_BOUND, x);
+}
+
+static void checkLog2(CheckResult &result, const float x, const float value)
+{
+	const double reference = log((double)x) / LN2;
+	result.add(fabs(value - reference), LOG2_BOUND * (1.0 + fabs(reference)), x);
+}
+
+// Wyniki poniej 2^-126 mog by zwrcone jako 0; powyej 2^127 wynik jest ograniczany i nie jest sprawdzany.
+static void checkPow(CheckResult &result, const float x, const float y, const float value)
+{
+	if(x <= 0.0f)
+	{
+		result.add(value == 0.0f ? 0.0 : 1.0, 0.5, x, y);
+		return;
+	}
+	const double t = (double)y * log((double)x) / LN2;
+	if(t > 127.0)
+		return;
+	if(t < -126.0 && value == 0.0f)
+		result.add(0.0, 1.0, x, y);
+	else result.add(relativeError(value, pow((double)x, (double)y)), POW_BOUND * (1.0 + fabs(t)), x, y);
+}
+
+static void checkExp(CheckResult &result, const float x, const float value)
+{ result.add(relativeError(value, exp((double)x)), fabs(x) <= 10.0f ? EXP_BOUND : EXP_BOUND80, x); }
+
+int main(int argc, char *argv[])
+{
+	const unsigned int	count	= 200000;	// Prbki funkcji jednej zmiennej.
+	const unsigned int	side	= 1000;		// Siatka side x side dla fastPow.
+
+	CheckResult	rsqrtResult("fastRsqrt"), exp2Result("fastExp2"), log2Result("fastLog2");
+	CheckResult	powResult("fastPow"), expResult("fastExp");
+	for(unsigned int i=0; i<count; i++)
+	{
+		const float	x = logSample(1.0e-30f, 1.0e30f, i, count);
+		const float	e = linearSample(-130.0f, 127.0f, i, count);
+		const float	n = linearSample(-80.0f, 80.0f, i, count);
+		checkRsqrt(rsqrtResult, x, fastRsqrt(x));
+		checkExp2(exp2Result, e, fastExp2(e));
+		checkLog2(log2Result, x, fastLog2(x));
+		checkExp(expResult, n, fastExp(n));
+	}
+	// Podstawy z [0, 4], wykadniki jak w materiaach (do 512) oraz ujemne.
+	for(unsigned int i=0; i<=side; i++)
+	{
+		const float	x = i ? logSample(1.0e-6f, 4.0f, i-1, side) : 0.0f;
+		for(unsigned int j=0; j<side; j++)
+		{
+			const float	y = linearSample(-64.0f, 512.0f, j, side);
+			checkPow(powResult, x, y, fastPow(x, y));
+		}
+	}
+
+	bool	passed = true;
+	passed &= rsqrtResult.report();
+	passed &= exp2Result.report();
+	passed &= log2Result.report();
+	passed &= powResult.report();
+	passed &= expResult.report();
+
+#ifdef EXRAY_SSE2
+	// Warianty czterowartociowe: kada skadowa rejestru dostaje inn prbk.
+	CheckResult	rsqrt4Result("fastRsqrt4"), exp2Result4("fastExp2_4"), log2Result4("fastLog2_4");
+	CheckResult	pow4Result("fastPow4"), exp4Result("fastExp4");
+	for(unsigned int i=0; i<count; i+=4)
+	{
+		float	x[4], e[4], n[4], out[4];
+		for(int k=0; k<4; k++)
+		{
+			x[k] = logSample(1.0e-30f, 1.0e30f, i+k, count);
+			e[k] = linearSample(-130.0f, 127.0f, i+k, count);
+			n[k] = linearSample(-80.0f, 80.0f, i+k, count);
+		}
+
+		_mm_storeu_ps(out, fastRsqrt4(_mm_loadu_ps(x)));
+		for(int k=0; k<4; k++) checkRsqrt(rsqrt4Result, x[k], out[k]);
+		_mm_storeu_ps(out, fastExp2_4(_mm_loadu_ps(e)));
+		for(int k=0; k<4; k++) checkExp2(exp2Result4, e[k], out[k]);
+		_mm_storeu_ps(out, fastLog2_4(_mm_loadu_ps(x)));
+		for(int k=0; k<4; k++) checkLog2(log2Result4, x[k], out[k]);
+		_mm_storeu_ps(out, fastExp4(_mm_loadu_ps(n)));
+		for(int k=0; k<4; k++) checkExp(exp4Result, n[k], out[k]);
+	}
+	for(unsigned int i=0; i<=side; i++)
+	{
+		const float	x = i ? logSample(1.0e-6f, 4.0f, i-1, side) : 0.0f;
+		for(unsigned int j=0; j<side; j+=4)
+		{
+			float	y[4], out[4];
+			for(int k=0; k<4; k++)
+				y[k] = linearSample(-64.0f, 512.0f, j+k, side);
+			_mm_storeu_ps(out, fastPow4(_mm_set1_ps(x), _mm_loadu_ps(y)));
+			for(int k=0; k<4; k++) checkPow(pow4Result, x, y[k], out[k]);
+		}
+	}
+
+	passed &= rsqrt4Result.report();
+	passed &= exp2Result4.report();
+	passed &= log2Result4.report();
+	passed &= pow4Result.report();
+	passed &= exp4Result.report();
+#endif
+
+	printf(passed ? "All checks passed.\n" : "Some checks FAILED.\n");
+	return passed ? 0 : 1;
+}
\ No newline at end of file
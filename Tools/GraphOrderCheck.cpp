@@ -0,0 +1,157 @@
+/*
+	This file is part of EX-Ray Raytracing Engine.
+	(C)2007 - 2008 Micha Siejak.
+
+    EX-Ray is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EX-Ray is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with EX-Ray.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/** Test porzdku ewaluacji grafu sceny (NodeGraph::buildOrder).
+	Scena: korze, shader, wiato mapujce shader i grupa sfer poczonych z shaderem. wiato czy wasne
+	atrybuty (link position -> direction), co nie moe czyni grafu cyklicznym. Program sprawdza, e porzdek
+	jest acykliczny, wiato ley przed shaderem, shader przed sferami, a sfery na jednym poziomie. Scena
+	z poziomem sfer wikszym od NodeGraph::MinParallelNodes ewaluowana jest nastpnie przez 1, 2, 4 i 8
+	wtkw; transformacje sfer musz by identyczne. Zwraca 1, jeli ktrykolwiek warunek nie jest speniony.
+	Program nie jest czci projektu exRay.vcproj; czony jest z plikami silnika bez Main.cpp.
+*/
+
+#include "../Config.h"
+#include "../Graph/Variable.h"
+#include "../Graph/Node.h"
+#include "../Graph/NodeGraph.h"
+#include "../Graph/Object.h"
+#include "../Graph/NodeShader.h"
+#include "../Graph/NodeSphere.h"
+#include "../Graph/NodeLight.h"
+#include "../Types/Shader.h"
+#include "../Shaders/ShaderPhong.h"
+
+using namespace exRay;
+
+static bool check(const bool condition, const char *description)
+{
+	printf("%-44s %s\n", description, condition ? "ok" : "FAILED");
+	return condition;
+}
+
+// Scena testowa pod korzeniem grafu (jak w Engine, graf istnieje przed wzami, wic zgaszaj one zmiany).
+// Sfery le w grupie "field", ich pozycje zale tylko od indeksu.
+static void createScene(Node *root, const unsigned int spheres)
+{
+	static ShaderPhong	phong;
+	Shader		*phongShader	= &phong;
+	NodeShader	*shader	= new NodeShader("phong", root);
+	NodeLight	*light	= new NodeLight("lamp", root);
+	Group		*field	= new Group("field", root);
+	vector3		position(1.0f, 2.0f, 3.0f);
+	char		name[32];
+
+	shader->getAttrib("cgfx_shader")->setValue(phongShader);
+	field->getAttrib("position")->setValue(position);
+	for(unsigned int i=0; i<spheres; i++)
+	{
+		sprintf(name, "s%u", i);
+		NodeSphere	*sphere	= new NodeSphere(name, field);
+		position = vector3(float(i%64), float(i/64), float(i%7) * 0.5f);
+		sphere->getAttrib("position")->setValue(position);
+		shader->connect(sphere, "cgfx_shader");
+	}
+	light->map(shader);
+}
+
+// Kolejno i poziomy wzw maej sceny.
+static bool checkOrder(void)
+{
+	Node		*root	= new Node("root", NULL);
+	NodeGraph	*graph	= new NodeGraph(root);
+	bool		passed	= true;
+
+	createScene(root, 3);
+	Node		*shader	= root->getChild("phong");
+	Node		*light	= root->getChild("lamp");
+	Node		*field	= root->getChild("field");
+
+	passed &= check(graph->buildOrder(), "graph is acyclic");
+	passed &= check(graph->isAcyclic(), "isAcyclic() after buildOrder");
+	passed &= check(light->getEvalIndex() < shader->getEvalIndex(), "light evaluated before its shader");
+	passed &= check(graph->getLevel(light) < graph->getLevel(shader), "light on an earlier level than shader");
+	passed &= check(graph->getLevel(shader) < graph->getLevel(field->getChild(0)), "shader on an earlier level than spheres");
+	passed &= check(graph->getLevel(field->getChild(0)) == graph->getLevel(field->getChild(1)) &&
+					graph->getLevel(field->getChild(1)) == graph->getLevel(field->getChild(2)), "spheres share one level");
+
+	delete graph;
+	delete root;
+	return passed;
+}
+
+// Ewaluacja i buforowanie sceny z poziomem sfer dzielonym pomidzy wtki.
+static bool checkThreads(void)
+{
+	const unsigned int		spheres		= NodeGraph::MinParallelNodes*2;
+	const unsigned int		threads[]	= { 1, 2, 4, 8 };
+	std::vector<matrix4>	reference;
+	bool					passed		= true;
+
+	for(int t=0; t<4; t++)
+	{
+		Node		*root	= new Node("root", NULL);
+		NodeGraph	*graph	= new NodeGraph(root, threads[t]);
+		unsigned int level	= 0, sameLevel = 0, different = 0;
+
+		createScene(root, spheres);
+		Node		*field	= root->getChild("field");
+		graph->buildOrder();
+		level = graph->getLevel(field->getChild(0));
+		for(unsigned int i=0; i<spheres; i++)
+		{
+			if(graph->getLevel(field->getChild(i)) == level)
+				sameLevel++;
+		}
+		graph->evaluate();
+		graph->cacheVariables();
+
+		for(unsigned int i=0; i<spheres; i++)
+		{
+			const Object	*sphere	= (const Object*)field->getChild(i);
+			matrix4			tm[2]	= { sphere->getTM(), sphere->getInverseTM() };
+			if(t == 0)
+			{
+				reference.push_back(tm[0]);
+				reference.push_back(tm[1]);
+			}
+			else if(memcmp(&tm[0], &reference[2*i], sizeof(matrix4)) || memcmp(&tm[1], &reference[2*i+1], sizeof(matrix4)))
+				different++;
+			if(!sphere->getCachedShader())
+				different++;
+		}
+
+		char	description[64];
+		sprintf(description, "%u threads: sphere level runs in parallel", threads[t]);
+		passed &= check(graph->isAcyclic() && sameLevel == spheres, description);
+		sprintf(description, "%u threads: transformations and shaders match", threads[t]);
+		passed &= check(different == 0, description);
+
+		delete graph;
+		delete root;
+	}
+	return passed;
+}
+
+int main(int argc, char *argv[])
+{
+	bool	passed = true;
+	passed &= checkOrder();
+	passed &= checkThreads();
+	return passed ? 0 : 1;
+}
\ No newline at end of file
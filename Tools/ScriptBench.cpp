@@ -0,0 +1,85 @@
+/*
+	This file is part of EX-Ray Raytracing Engine.
+	(C)2007 - 2008 Micha Siejak.
+
+    EX-Ray is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EX-Ray is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with EX-Ray.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/** Pomiar czasu wczytywania skryptu sceny.
+	Program zapisuje do pliku [skrypt] scen z kamer, shaderem, materiaem, wiatem i [sfery] sferami
+	(domylnie 30000). Kad sfer opisuje 5 linii (konstruktor, promie, pozycja, shader, materia), wic
+	domylny skrypt ma 150 tys. linii. Nastpnie mierzy czas konstruktora Scene(skrypt), ktry jedynie
+	analizuje skrypt (graf tworzony jest dopiero przez setupEngine), i wypisuje liczb linii, liczb bdw
+	oraz czas w sekundach. Zwraca 1, jeli skrypt zawiera bdy.
+	Program nie jest czci projektu exRay.vcproj; czony jest z plikami silnika bez Main.cpp:
+		exScriptBench scene150k.txt 30000
+*/
+
+#include <time.h>
+#include "../Config.h"
+#include "../Types/Scene.h"
+
+using namespace exRay;
+
+// Skrypt testowy; pozycje i promienie zale tylko od indeksu sfery.
+static unsigned int writeScript(const char *filename, const unsigned int spheres)
+{
+	FILE	*file	= fopen(filename, "w");
+	if(!file)
+		return 0;
+
+	fprintf(file, "set Width 320\nset Height 240\n"
+				  "new Camera(cam)\ncam.position = (0, 0, -40)\n"
+				  "new Shader(phong)\nphong.shader(Phong)\n"
+				  "new Material(m)\nm.color = (0.8, 0.6, 0.4)\nm.diffuse = 0.8\n"
+				  "new Light(lamp)\nlamp.position = (0, 30, -30)\nlamp.map(phong)\n");
+	unsigned int lines = 12;
+	for(unsigned int i=0; i<spheres; i++)
+	{
+		fprintf(file, "new Sphere(s%u)\ns%u.radius = %.3f\ns%u.position = (%.3f, %.3f, %.3f)\n"
+					  "phong.connect(s%u, cgfx_shader)\nm.connect(s%u, material)\n",
+				i, i, 0.1f + float(i%17)*0.01f, i, float(i%200)*0.25f - 25.0f, float((i/200)%150)*0.25f - 18.0f,
+				float(i%13) * 0.5f, i, i);
+		lines += 5;
+	}
+	fclose(file);
+	return lines;
+}
+
+int main(int argc, char *argv[])
+{
+	if(argc < 2)
+	{
+		printf("usage: %s script [spheres]\n", argv[0]);
+		return 1;
+	}
+
+	const unsigned int	spheres	= (argc > 2) ? (unsigned int)atoi(argv[2]) : 30000;
+	const unsigned int	lines	= writeScript(argv[1], spheres);
+	if(lines == 0)
+	{
+		printf("cannot write %s\n", argv[1]);
+		return 1;
+	}
+
+	clock_t	start	= clock();
+	Scene	*scene	= new Scene(argv[1]);
+	clock_t	end		= clock();
+	int		errors	= scene->getErrorCount();
+	delete scene;
+
+	printf("%u lines, %d errors, %.3f s\n", lines, errors, double(end - start) / CLOCKS_PER_SEC);
+	return (errors > 0) ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+/*
+	This file is part of EX-Ray Raytracing Engine.
+	(C)2007 - 2008 Micha Siejak.
+
+    EX-Ray is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EX-Ray is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with EX-Ray.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../Config.h"
+#include "Arena.h"
+
+#ifdef WIN32 // WIN32 PLATFORM SPECIFIC
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+using namespace exRay;
+
+static void acquireLock(volatile unsigned int *lock)
+{
+#ifdef WIN32
+	while(InterlockedCompareExchange((volatile LONG*)lock, 1, 0) != 0)
+		Sleep(0);
+#endif
+}
+
+static void releaseLock(volatile unsigned int *lock)
+{
+#ifdef WIN32
+	InterlockedExchange((volatile LONG*)lock, 0);
+#else
+	*lock = 0;
+#endif
+}
+
+Arena::Arena(const size_t size)
+{
+	blockSize	= size;
+	current		= NULL;
+	remaining	= 0;
+	allocated	= 0;
+	lock		= 0;
+}
+
+Arena::~Arena(void)
+{
+	clear();
+}
+
+void* Arena::allocate(size_t size)
+{
+	size = (size + Arena::Alignment-1) & ~size_t(Arena::Alignment-1);
+
+	void *result;
+	acquireLock(&lock);
+	if(size > remaining && size > blockSize/4)
+	{
+		// Due obiekty otrzymuj wasny blok, bez porzucania reszty biecego.
+		char *block = new char[size + Arena::Alignment];
+		blocks.push_back(block);
+		result = (void*)(((size_t)block + Arena::Alignment-1) & ~size_t(Arena::Alignment-1));
+	}
+	else
+	{
+		if(size > remaining)
+		{
+			char *block = new char[blockSize + Arena::Alignment];
+			blocks.push_back(block);
+			current		= (char*)(((size_t)block + Arena::Alignment-1) & ~size_t(Arena::Alignment-1));
+			remaining	= blockSize;
+		}
+		result		= current;
+		current		+= size;
+		remaining	-= size;
+	}
+	allocated += size;
+	releaseLock(&lock);
+	return result;
+}
+
+// Bloki zwalniane s bez wywoywania destruktorw obiektw, ktre w nich le.
+void Arena::clear(void)
+{
+	for(std::vector<char*>::iterator i=blocks.begin(); i<blocks.end(); i++)
+		delete[] (*i);
+	blocks.clear();
+	current		= NULL;
+	remaining	= 0;
+	allocated	= 0;
+}
+
+// Przydziela pami obiektu w obszarze (lub na stercie, gdy arena == NULL) z nagwkiem waciciela.
+void* Arena::allocateObject(const size_t size, Arena *arena)
+{
+	char *memory;
+	if(arena)
+		memory = (char*)arena->allocate(size + Arena::HeaderSize);
+	else
+		memory = (char*)::operator new(size + Arena::HeaderSize);
+
+	*(Arena**)memory = arena;
+	return memory + Arena::HeaderSize;
+}
+
+void Arena::freeObject(void *object)
+{
+	if(!object)
+		return;
+
+	char *memory = (char*)object - Arena::HeaderSize;
+	if(*(Arena**)memory == NULL)
+		::operator delete(memory);
+}
+
+Arena* Arena::getOwner(const void *object)
+{
+	return *(Arena**)((const char*)object - Arena::HeaderSize);
+}
+
+// Pami kontenerw i tablic obiektw grafu; w obszarze zwalniana jest dopiero przez clear().
+void* Arena::allocateBlock(const size_t size, Arena *arena)
+{
+	if(arena)
+		return arena->allocate(size);
+	return ::operator new(size);
+}
+
+void Arena::freeBlock(void *memory, Arena *arena)
+{
+	if(!arena)
+		::operator delete(memory);
+}
\ No newline at end of file
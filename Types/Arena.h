@@ -0,0 +1,118 @@
+/*
+	This file is part of EX-Ray Raytracing Engine.
+	(C)2007 - 2008 Micha Siejak.
+
+    EX-Ray is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EX-Ray is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with EX-Ray.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __ARENA_H
+#define __ARENA_H
+
+namespace exRay {
+
+/// Obszar pamici dla obiektw grafu sceny.
+/** Pami przydzielana jest z duych blokw przez przesunicie wskanika, a zwalniana jednorazowo, razem
+	ze wszystkimi blokami. Obiekty utworzone w obszarze le w pamici obok siebie, w kolejnoci
+	tworzenia (wze i jego atrybuty zajmuj jeden cigy fragment).
+	Klasy korzystajce z obszaru (Node, Variable) przydzielaj pami przez allocateObject, ktre
+	poprzedza obiekt nagwkiem wskazujcym waciciela. Dziki temu zwyky operator delete zwalnia
+	tylko obiekty utworzone na stercie, a dla obiektw obszaru wywouje jedynie destruktor.
+	Kontenery, nazwy i tablice wartoci tych obiektw rwnie korzystaj z obszaru (ArenaAllocator,
+	allocateBlock), wic graf zbudowany w obszarze nie posiada adnej pamici poza nim. clear() nie
+	wywouje destruktorw - zwalnia same bloki, dlatego usunicie caego grafu nie zaley od jego rozmiaru.
+	Przydzia jest chroniony blokad, bo tablice atrybutw mog rosn podczas rwnolegej ewaluacji grafu.
+*/
+class Arena
+{
+private:
+	std::vector<char*>	blocks;
+	char*				current;
+	size_t				remaining;
+	size_t				blockSize;
+	size_t				allocated;
+	volatile unsigned int	lock;
+private:
+	Arena(const Arena&);
+	Arena& operator=(const Arena&);
+public:
+	Arena(const size_t size=Arena::DefaultBlockSize);
+	~Arena(void);
+
+	void*	allocate(size_t size);
+	void	clear(void);
+
+	size_t	getAllocatedSize(void) const
+	{ return allocated; }
+
+	static void*	allocateObject(const size_t size, Arena *arena);
+	static void		freeObject(void *object);
+	static Arena*	getOwner(const void *object);
+
+	static void*	allocateBlock(const size_t size, Arena *arena);
+	static void		freeBlock(void *memory, Arena *arena);
+
+	enum
+	{
+		DefaultBlockSize	= 1048576,
+		Alignment			= 16,
+		HeaderSize			= 16,	// Nagwek obiektu (wskanik waciciela), wyrwnany do Alignment.
+	};
+};
+
+/// Alokator STL korzystajcy z obszaru pamici.
+/** Bez obszaru (NULL) przydziela pami na stercie. Pami zwolniona przez kontener w obszarze wraca
+	dopiero razem z caym obszarem.
+*/
+template<class T> class ArenaAllocator
+{
+public:
+	typedef T			value_type;
+	typedef T*			pointer;
+	typedef const T*	const_pointer;
+	typedef T&			reference;
+	typedef const T&	const_reference;
+	typedef size_t		size_type;
+	typedef ptrdiff_t	difference_type;
+
+	template<class U> struct rebind
+	{ typedef ArenaAllocator<U> other; };
+
+	Arena*	arena;
+public:
+	ArenaAllocator(Arena *owner=NULL) : arena(owner)
+	{ }
+	template<class U> ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena)
+	{ }
+
+	pointer			address(reference x) const				{ return &x; }
+	const_pointer	address(const_reference x) const		{ return &x; }
+	size_type		max_size(void) const					{ return size_type(-1) / sizeof(T); }
+
+	pointer		allocate(size_type n, const void *hint=0)
+	{ return (pointer)Arena::allocateBlock(n*sizeof(T), arena); }
+	void		deallocate(pointer p, size_type n)
+	{ Arena::freeBlock(p, arena); }
+
+	void		construct(pointer p, const T &value)	{ new((void*)p) T(value); }
+	void		destroy(pointer p)						{ p->~T(); }
+
+	template<class U> bool operator==(const ArenaAllocator<U> &other) const
+	{ return arena == other.arena; }
+	template<class U> bool operator!=(const ArenaAllocator<U> &other) const
+	{ return arena != other.arena; }
+};
+
+} // exRay
+
+#endif
\ No newline at end of file
@@ -18,6 +18,14 @@
 
 #include "../Config.h"
 #include "Image.h"
+#include "../Core/Kernels.h"
+
+#ifdef WIN32 // WIN32 PLATFORM SPECIFIC
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <limits.h>
+#endif
 
 using namespace exRay;
 
@@ -57,6 +65,37 @@ struct TargaHeader
 };
 #pragma pack(pop)
 
+// Linie w pliku BMP wyrwnane s do 4 bajtw.
+static unsigned int getBMPStride(const unsigned int width, const unsigned int colorDepth)
+{ return (width*colorDepth + 3) & ~3u; }
+
+static void setupBMPHeader(BitmapHeader &bmpHeader, const unsigned int width, const unsigned int height,
+						   const unsigned int colorDepth)
+{
+	memset(&bmpHeader, 0, sizeof(BitmapHeader));
+	memcpy(&bmpHeader.id, "BM", 2);
+
+	unsigned int imageDataSize = getBMPStride(width, colorDepth)*height;
+
+	bmpHeader.fileSize	= sizeof(BitmapHeader) + imageDataSize;
+	bmpHeader.offset	= sizeof(BitmapHeader);
+	bmpHeader.infoSize	= sizeof(BitmapHeader) - 14;
+	bmpHeader.width		= width;
+	bmpHeader.height	= height;
+	bmpHeader.bitPlanes	= 1;
+	bmpHeader.bitDepth	= colorDepth*8;
+}
+
+static void setupTGAHeader(TargaHeader &tgaHeader, const unsigned int width, const unsigned int height,
+						   const unsigned int colorDepth)
+{
+	memset(&tgaHeader, 0, sizeof(TargaHeader));
+
+	tgaHeader.imgType	= 2; // RGB
+	tgaHeader.width		= width;
+	tgaHeader.height	= height;
+	tgaHeader.bitDepth	= colorDepth*8;
+}
 
 Image::Image(void)
 {
@@ -64,6 +103,13 @@ Image::Image(void)
 	width		= 0;
 	height		= 0;
 	colorDepth	= 0;
+
+	streamFile	= NULL;
+	streamHeader= 0;
+	streamStride= 0;
+	streamRows	= 0;
+	streamOwner	= NULL;
+	streamFailed= false;
 }
 
 Image::Image(unsigned int x, unsigned int y, unsigned int bpp)
@@ -73,17 +119,26 @@ Image::Image(unsigned int x, unsigned int y, unsigned int bpp)
 	height		= y;
 	colorDepth	= bpp;
 
+	streamFile	= NULL;
+	streamHeader= 0;
+	streamStride= 0;
+	streamRows	= 0;
+	streamOwner	= NULL;
+	streamFailed= false;
+
 	memset(imageData, 0, x*y*bpp);
 }
 
 Image::~Image(void)
 {
+	closeStream();
 	if(imageData)
 		delete[] imageData;
 }
 
 void Image::free(void)
 {
+	closeStream();
 	if(imageData)
 		delete[] imageData;
 	imageData	= NULL;
@@ -92,14 +147,6 @@ void Image::free(void)
 	colorDepth	= 0;
 }
 
-bool Image::getRawLine(const unsigned int y, unsigned char *line)
-{
-	if(y > height)
-		return false;
-	memcpy(line, &imageData[y*width*colorDepth], width*colorDepth);
-	return true;
-}
-
 int Image::getFormat(const std::string &filename)
 {
 	std::string	 extension;
@@ -127,6 +174,8 @@ bool Image::writeToFile(const std::string &filename)
 {
 	if(width == 0 || height == 0)
 		return false;
+	if(streamFile) // linie zostay ju zapisane
+		return false;
 	if(colorDepth != 3) // only 24bpp supported
 		return false;
 
@@ -147,35 +196,16 @@ bool Image::writeBMP(const std::string &filename)
 		return false;
 
 	BitmapHeader	bmpHeader;
-	memset(&bmpHeader, 0, sizeof(BitmapHeader));
-	memcpy(&bmpHeader.id, "BM", 2);
-
-	unsigned int imageDataSize = width*height*colorDepth;
-
-	bmpHeader.fileSize	= sizeof(BitmapHeader) + imageDataSize;
-	bmpHeader.offset	= sizeof(BitmapHeader);
-	bmpHeader.infoSize	= sizeof(BitmapHeader) - 14;
-	bmpHeader.width		= width;
-	bmpHeader.height	= height;
-	bmpHeader.bitPlanes	= 1;
-	bmpHeader.bitDepth	= colorDepth*8;
-
+	setupBMPHeader(bmpHeader, width, height, colorDepth);
 	file.write((char*)&bmpHeader, sizeof(BitmapHeader));
 
-	unsigned char	*line = new unsigned char[width*colorDepth];
-	unsigned char	swapValue;
+	unsigned int	lineSize = getBMPStride(width, colorDepth);
+	unsigned char	padding[4] = { 0, 0, 0, 0 };
 	for(unsigned int y=0; y<height; y++)
 	{
-		getRawLine(y, line);
-		for(unsigned int x=0; x<width; x++)
-		{
-			swapValue           = line[x*colorDepth];
-			line[x*colorDepth]  = line[x*colorDepth+2];
-			line[x*colorDepth+2]= swapValue;
-		}
-		file.write((char*)line, width*colorDepth);
+		file.write((char*)&imageData[y*width*colorDepth], width*colorDepth);
+		file.write((char*)padding, lineSize - width*colorDepth);
 	}
-	delete[] line;
 	file.close();
 	return true;
 }
@@ -187,41 +217,186 @@ bool Image::writeTGA(const std::string &filename)
 		return false;
 
 	TargaHeader	tgaHeader;
-	memset(&tgaHeader, 0, sizeof(TargaHeader));
+	setupTGAHeader(tgaHeader, width, height, colorDepth);
+	file.write((char*)&tgaHeader, sizeof(TargaHeader));
+	file.write((char*)imageData, width*height*colorDepth);
+	file.close();
+	return true;
+}
 
-	tgaHeader.imgType	= 2; // RGB
-	tgaHeader.width		= width;
-	tgaHeader.height	= height;
-	tgaHeader.bitDepth	= colorDepth*8;
+// Tworzy plik wyjciowy o docelowym rozmiarze i zapisuje jego nagwek. W pamici alokowane
+// jest jedynie okno [rows] linii, w ktrym renderowane s linie przed zapisaniem do pliku.
+bool Image::createStream(const std::string &filename, unsigned int x, unsigned int y, unsigned int bpp, unsigned int rows)
+{
+	free();
+	if(x == 0 || y == 0 || rows == 0 || bpp != 3)
+		return false;
+	if(rows > y)
+		rows = y;
 
-	file.write((char*)&tgaHeader, sizeof(TargaHeader));
+	BitmapHeader	bmpHeader;
+	TargaHeader		tgaHeader;
+	const char		*header;
+	unsigned __int64	fileSize;
 
-	unsigned char	*line = new unsigned char[width*colorDepth];
-	unsigned char	swapValue;
-	for(unsigned int y=0; y<height; y++)
+	if(getFormat(filename) == Image::FormatTGA)
 	{
-		getRawLine(y, line);
-		for(unsigned int x=0; x<width; x++)
-		{
-			swapValue           = line[x*colorDepth];
-			line[x*colorDepth]  = line[x*colorDepth+2];
-			line[x*colorDepth+2]= swapValue;
-		}
-		file.write((char*)line, width*colorDepth);
+		setupTGAHeader(tgaHeader, x, y, bpp);
+		header			= (const char*)&tgaHeader;
+		streamHeader	= sizeof(TargaHeader);
+		streamStride	= x*bpp;
 	}
-	delete[] line;
-	file.close();
+	else
+	{
+		setupBMPHeader(bmpHeader, x, y, bpp);
+		header			= (const char*)&bmpHeader;
+		streamHeader	= sizeof(BitmapHeader);
+		streamStride	= getBMPStride(x, bpp);
+	}
+	fileSize = streamHeader + (unsigned __int64)streamStride*y;
+
+	// Nagwek BMP przechowuje rozmiar pliku na 32 bitach.
+	if(getFormat(filename) != Image::FormatTGA && fileSize > 0xFFFFFFFF)
+		return false;
+
+#ifdef WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER	size;
+	size.QuadPart = (LONGLONG)fileSize;
+	if(!SetFilePointerEx(file, size, NULL, FILE_BEGIN) || !SetEndOfFile(file))
+	{
+		CloseHandle(file);
+		return false;
+	}
+	streamFile = file;
+#else
+	FILE *file = fopen(filename.c_str(), "wb");
+	if(!file)
+		return false;
+	if(fileSize-1 > (unsigned __int64)LONG_MAX || fseek(file, (long)(fileSize-1), SEEK_SET) != 0 || fputc(0, file) == EOF)
+	{
+		fclose(file);
+		return false;
+	}
+	streamFile = file;
+#endif
+
+	width		= x;
+	height		= y;
+	colorDepth	= bpp;
+	streamRows	= rows;
+	streamFailed= false;
+	imageData	= new unsigned char[x*rows*bpp];
+	streamOwner	= new volatile unsigned int[rows];
+	memset(imageData, 0, x*rows*bpp);
+	memset(const_cast<unsigned int*>(streamOwner), 0, rows*sizeof(unsigned int));
+
+	if(!writeStreamData(0, (const unsigned char*)header, streamHeader))
+	{
+		free();
+		return false;
+	}
+	return true;
+}
+
+// Zamyka plik strumienia. Zwraca false, jeli ktrykolwiek zapis (lub zamknicie pliku) si nie powid.
+bool Image::closeStream(void)
+{
+	if(!streamFile)
+		return false;
+#ifdef WIN32
+	if(!CloseHandle((HANDLE)streamFile))
+		streamFailed = true;
+#else
+	if(fclose((FILE*)streamFile) != 0)
+		streamFailed = true;
+#endif
+	delete[] streamOwner;
+	streamFile	= NULL;
+	streamOwner	= NULL;
+	streamRows	= 0;
+	return !streamFailed;
+}
+
+// Zapis pod zadanym przesuniciem. WriteFile z OVERLAPPED nie korzysta ze wsplnego
+// wskanika pliku, wic linie mog by zapisywane rwnolegle przez wiele wtkw.
+bool Image::writeStreamData(const unsigned __int64 offset, const unsigned char *data, const unsigned int size)
+{
+#ifdef WIN32
+	OVERLAPPED	position;
+	DWORD		written = 0;
+	memset(&position, 0, sizeof(OVERLAPPED));
+	position.Offset		= (DWORD)(offset & 0xFFFFFFFF);
+	position.OffsetHigh	= (DWORD)(offset >> 32);
+	if(!WriteFile((HANDLE)streamFile, data, size, &written, &position))
+		return false;
+	return written == size;
+#else
+	FILE *file = (FILE*)streamFile;
+	if(offset > (unsigned __int64)LONG_MAX || fseek(file, (long)offset, SEEK_SET) != 0)
+		return false;
+	return fwrite(data, 1, size, file) == size;
+#endif
+}
+
+// Rezerwuje w oknie miejsce na lini [y]. Jeli miejsce zajmuje jeszcze linia o [streamRows]
+// wczeniejsza, czeka a zostanie ona zapisana do pliku.
+bool Image::beginLine(const unsigned int y)
+{
+	if(!streamFile)
+		return true;
+	if(y >= height)
+		return false;
+
+	volatile unsigned int *owner = &streamOwner[y % streamRows];
+#ifdef WIN32
+	while(InterlockedCompareExchange((volatile LONG*)owner, (LONG)(y+1), 0) != 0)
+		Sleep(1);
+#else
+	*owner = y+1;
+#endif
+	memset(&imageData[getPixelOffset(0, y)], 0, width*colorDepth);
 	return true;
 }
 
+// Zapisuje ukoczon lini [y] do pliku i zwalnia jej miejsce w oknie. Po nieudanym zapisie
+// (np. brak miejsca na dysku) linie nie s ju zapisywane, ale nadal zwalniaj miejsce w oknie.
+bool Image::commitLine(const unsigned int y)
+{
+	if(!streamFile)
+		return true;
+	if(y >= height)
+		return false;
+
+	unsigned char	*line	= &imageData[getPixelOffset(0, y)];
+	bool			result	= !streamFailed;
+	if(result)
+	{
+		result = writeStreamData(streamHeader + (unsigned __int64)y*streamStride, line, width*colorDepth);
+		if(!result)
+			streamFailed = true;
+	}
+
+	volatile unsigned int *owner = &streamOwner[y % streamRows];
+#ifdef WIN32
+	InterlockedExchange((volatile LONG*)owner, 0);
+#else
+	*owner = 0;
+#endif
+	return result;
+}
+
 bool Image::putPixel(const int x, const int y, const vector3 &color)
 {
 	if(colorDepth < 3)
 		return false;
-	unsigned int loc = (y*width+x)*colorDepth;
-	imageData[loc]	 = unsigned char(color.r*255.0f);
+	unsigned int loc = getPixelOffset(x, y);
+	imageData[loc]	 = unsigned char(color.b*255.0f);
 	imageData[loc+1] = unsigned char(color.g*255.0f);
-	imageData[loc+2] = unsigned char(color.b*255.0f);
+	imageData[loc+2] = unsigned char(color.r*255.0f);
 	return true;
 }
 
@@ -229,10 +404,10 @@ bool Image::getPixel(const int x, const int y, vector3 &color)
 {
 	if(colorDepth < 3)
 		return false;
-	unsigned int loc = (y*width+x)*colorDepth;
-	color.r			 = float(imageData[loc])/255.0f;
+	unsigned int loc = getPixelOffset(x, y);
+	color.b			 = float(imageData[loc])/255.0f;
 	color.g			 = float(imageData[loc+1])/255.0f;
-	color.b			 = float(imageData[loc+2])/255.0f;
+	color.r			 = float(imageData[loc+2])/255.0f;
 	return true;
 }
 
@@ -240,10 +415,10 @@ bool Image::putPixel(const int x, const int y, const vector4 &color)
 {
 	if(colorDepth < 4)
 		return false;
-	unsigned int loc = (y*width+x)*colorDepth;
-	imageData[loc]	 = unsigned char(color.r*255.0f);
+	unsigned int loc = getPixelOffset(x, y);
+	imageData[loc]	 = unsigned char(color.b*255.0f);
 	imageData[loc+1] = unsigned char(color.g*255.0f);
-	imageData[loc+2] = unsigned char(color.b*255.0f);
+	imageData[loc+2] = unsigned char(color.r*255.0f);
 	imageData[loc+3] = unsigned char(color.a*255.0f);
 	return true;
 }
@@ -252,10 +427,36 @@ bool Image::getPixel(const int x, const int y, vector4 &color)
 {
 	if(colorDepth < 4)
 		return false;
-	unsigned int loc = (y*width+x)*colorDepth;
-	color.r			 = float(imageData[loc])/255.0f;
+	unsigned int loc = getPixelOffset(x, y);
+	color.b			 = float(imageData[loc])/255.0f;
 	color.g			 = float(imageData[loc+1])/255.0f;
-	color.b			 = float(imageData[loc+2])/255.0f;
+	color.r			 = float(imageData[loc+2])/255.0f;
 	color.a			 = float(imageData[loc+3])/255.0f;
 	return true;
+}
+
+// Zapisuje [count] pikseli (span RGB, 3 floaty na piksel) od pozycji [x, y]. Wartoci s obcinane
+// do [0,1], kwantowane i zapisywane od razu w kolejnoci BGR (jdro encodeSpan w wariancie wybranym
+// dla procesora).
+bool Image::putSpan(const int x, const int y, const float *span, const unsigned int count)
+{
+	if(colorDepth != 3)
+	{
+		for(unsigned int i=0; i<count; i++, span+=3)
+		{
+			vector3 color(span[0], span[1], span[2]);
+			if(color.r > 1.0f) color.r = 1.0f;
+			if(color.g > 1.0f) color.g = 1.0f;
+			if(color.b > 1.0f) color.b = 1.0f;
+			if(color.r < 0.0f) color.r = 0.0f;
+			if(color.g < 0.0f) color.g = 0.0f;
+			if(color.b < 0.0f) color.b = 0.0f;
+			if(!putPixel(x+i, y, color))
+				return false;
+		}
+		return true;
+	}
+
+	Kernels::get().encodeSpan(&imageData[getPixelOffset(x, y)], span, count);
+	return true;
 }
\ No newline at end of file
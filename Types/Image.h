@@ -28,6 +28,12 @@ namespace exRay {
 	Zapisywanie klatki do pliku obsugiwane jest tylko dla 24 bitw na piksel.
 	Przy operacjach get/put pixel konwersja z formatu wejciowego (96 bitw na piksel, IEEE floating-point)
 	na format wyjciowy (24 lub 32 bity na piksel, fixed point) wykonywana jest "w locie".
+	Piksele przechowywane s w kolejnoci BGR(A), takiej jak w plikach BMP/TGA, dziki czemu linie
+	zapisywane s bez konwersji. Cae linie (spany) zapisuje si metod putSpan().
+	W trybie strumieniowym (createStream) w pamici znajduje si jedynie okno kilku linii, a kada
+	ukoczona linia (commitLine) zapisywana jest od razu do pliku wyjciowego pod swoim przesuniciem.
+	Zuycie pamici nie zaley wtedy od wysokoci obrazu. Po pierwszym nieudanym zapisie kolejne linie
+	nie s ju zapisywane, a closeStream zwraca false.
 */
 class Image
 {
@@ -36,10 +42,25 @@ private:
 	unsigned int	width;
 	unsigned int	height;
 	unsigned int	colorDepth;
+
+	// Tryb strumieniowy
+	void*					streamFile;
+	unsigned int			streamHeader;
+	unsigned int			streamStride;
+	unsigned int			streamRows;
+	volatile unsigned int*	streamOwner;
+	volatile bool			streamFailed;	// Zapis do pliku nie powid si
 private:
 	bool			writeBMP(const std::string &filename);
 	bool			writeTGA(const std::string &filename);
-	bool			getRawLine(const unsigned int y, unsigned char *line);
+	bool			writeStreamData(const unsigned __int64 offset, const unsigned char *data, const unsigned int size);
+
+	unsigned int	getPixelOffset(const int x, const int y) const
+	{
+		if(streamRows > 0)
+			return ((y % streamRows)*width + x)*colorDepth;
+		return (y*width + x)*colorDepth;
+	}
 public:
 	Image();
 	Image(unsigned int x, unsigned int y, unsigned int bpp);
@@ -54,6 +75,14 @@ public:
 	static int		getFormat(const std::string &filename);
 	bool			writeToFile(const std::string &filename);
 
+	bool			createStream(const std::string &filename, unsigned int x, unsigned int y, unsigned int bpp, unsigned int rows);
+	bool			closeStream(void);
+	bool			isStreamed(void) const	{ return streamFile != NULL; }
+	bool			hasWriteFailed(void) const	{ return streamFailed; }
+	bool			beginLine(const unsigned int y);
+	bool			commitLine(const unsigned int y);
+
+	bool			putSpan(const int x, const int y, const float *span, const unsigned int count);
 	bool			putPixel(const int x, const int y, const vector3 &color);
 	bool			getPixel(const int x, const int y, vector3 &color);
 	bool			putPixel(const int x, const int y, const vector4 &color);
@@ -0,0 +1,418 @@
+/*
+	This file is part of EX-Ray Raytracing Engine.
+	(C)2007 - 2008 Micha Siejak.
+
+    EX-Ray is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EX-Ray is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with EX-Ray.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../Config.h"
+#include "Image.h"
+#include "ImageHDR.h"
+#include "../Core/Kernels.h"
+
+using namespace exRay;
+
+#pragma pack(push, 1)
+/// Wewntrzna struktura opisujca kana w nagwku pliku OpenEXR (atrybut chlist).
+struct EXRChannel
+{
+	int				pixelType;
+	unsigned char	pLinear;
+	unsigned char	reserved[3];
+	int				xSampling;
+	int				ySampling;
+};
+#pragma pack(pop)
+
+// Zapisuje atrybut nagwka OpenEXR: nazwa, typ, rozmiar, warto.
+static void writeEXRAttribute(std::ofstream &file, const char *name, const char *type, const void *value, const int size)
+{
+	file.write(name, (std::streamsize)strlen(name)+1);
+	file.write(type, (std::streamsize)strlen(type)+1);
+	file.write((const char*)&size, sizeof(int));
+	file.write((const char*)value, size);
+}
+
+ImageHDR::ImageHDR(void)
+{
+	imageData	= NULL;
+	width		= 0;
+	height		= 0;
+	channels	= 0;
+}
+
+ImageHDR::ImageHDR(unsigned int x, unsigned int y, unsigned int numChannels)
+{
+	imageData	= new float[x*y*numChannels];
+	width		= x;
+	height		= y;
+	channels	= numChannels;
+
+	memset(imageData, 0, x*y*numChannels*sizeof(float));
+}
+
+ImageHDR::~ImageHDR(void)
+{
+	if(imageData)
+		delete[] imageData;
+}
+
+void ImageHDR::free(void)
+{
+	if(imageData)
+		delete[] imageData;
+	imageData	= NULL;
+	width		= 0;
+	height		= 0;
+	channels	= 0;
+}
+
+void ImageHDR::clear(void)
+{
+	if(imageData)
+		memset(imageData, 0, width*height*channels*sizeof(float));
+}
+
+int ImageHDR::getFormat(const std::string &filename)
+{
+	std::string	 extension;
+	char		 *buffer;
+	std::string::size_type dotpos = filename.find_last_of('.');
+
+	if(dotpos == std::string::npos)
+		return ImageHDR::FormatUnknown;
+	extension = filename.substr(dotpos);
+
+	buffer = new char[extension.length()+1];
+	strcpy(buffer, extension.c_str());
+	_strlwr(buffer);
+	extension = std::string(buffer);
+	delete[] buffer;
+
+	if(extension == ".pfm")
+		return ImageHDR::FormatPFM;
+	if(extension == ".exr")
+		return ImageHDR::FormatEXR;
+	return ImageHDR::FormatUnknown;
+}
+
+bool ImageHDR::isHDRFormat(const std::string &filename)
+{ return getFormat(filename) != ImageHDR::FormatUnknown; }
+
+bool ImageHDR::writeToFile(const std::string &filename, const int compression)
+{
+	if(width == 0 || height == 0)
+		return false;
+	if(channels < 3)
+		return false;
+
+	switch(getFormat(filename))
+	{
+	case ImageHDR::FormatPFM:
+		return writePFM(filename);
+	case ImageHDR::FormatEXR:
+		return writeEXR(filename, compression);
+	}
+	return false;
+}
+
+// PFM: nagwek tekstowy, linie od dou do gry (jak w BMP/TGA), RGB float little-endian (skala ujemna).
+bool ImageHDR::writePFM(const std::string &filename)
+{
+	std::ofstream file(filename.c_str(), std::ios_base::out | std::ios_base::binary);
+	if(!file.is_open())
+		return false;
+
+	char header[64];
+	sprintf(header, "PF\n%u %u\n-1.0\n", width, height);
+	file.write(header, (std::streamsize)strlen(header));
+
+	float *line = new float[width*3];
+	for(unsigned int y=0; y<height; y++)
+	{
+		const float *pixel = getLine(y);
+		for(unsigned int x=0; x<width; x++, pixel+=channels)
+		{
+			line[x*3]	= pixel[0];
+			line[x*3+1]	= pixel[1];
+			line[x*3+2]	= pixel[2];
+		}
+		file.write((char*)line, width*3*sizeof(float));
+	}
+	delete[] line;
+	file.close();
+	return true;
+}
+
+// OpenEXR: plik jednoczciowy, linie skanowania, jedna linia na blok, kanay typu FLOAT.
+// Kanay zapisywane s w kolejnoci alfabetycznej nazw (A, B, G, R), jak wymaga specyfikacja.
+// Linie w OpenEXR biegn od gry obrazu, a bufor (jak BMP/TGA) przechowuje je od dou.
+bool ImageHDR::writeEXR(const std::string &filename, const int compression)
+{
+	std::ofstream file(filename.c_str(), std::ios_base::out | std::ios_base::binary);
+	if(!file.is_open())
+		return false;
+
+	const char*		channelNames[4]	= { "A", "B", "G", "R" };
+	const int		channelIndex[4]	= { 3, 2, 1, 0 };
+	unsigned int	firstChannel	= (channels > 3) ? 0 : 1;
+
+	int	magic	= 20000630;
+	int	version	= 2;
+	file.write((char*)&magic, sizeof(int));
+	file.write((char*)&version, sizeof(int));
+
+	// Nagwek
+	std::string	 chlist;
+	EXRChannel	 channel;
+	memset(&channel, 0, sizeof(EXRChannel));
+	channel.pixelType	= 2; // FLOAT
+	channel.xSampling	= 1;
+	channel.ySampling	= 1;
+	for(unsigned int c=firstChannel; c<4; c++)
+	{
+		chlist.append(channelNames[c], 2);
+		chlist.append((char*)&channel, sizeof(EXRChannel));
+	}
+	chlist.append(1, '\0');
+
+	int				window[4]		= { 0, 0, int(width)-1, int(height)-1 };
+	unsigned char	compressionType	= (unsigned char)compression;
+	unsigned char	lineOrder		= 0; // INCREASING_Y
+	float			aspectRatio		= 1.0f;
+	float			windowCenter[2]	= { 0.0f, 0.0f };
+	float			windowWidth		= 1.0f;
+
+	writeEXRAttribute(file, "channels", "chlist", chlist.data(), (int)chlist.length());
+	writeEXRAttribute(file, "compression", "compression", &compressionType, 1);
+	writeEXRAttribute(file, "dataWindow", "box2i", window, sizeof(window));
+	writeEXRAttribute(file, "displayWindow", "box2i", window, sizeof(window));
+	writeEXRAttribute(file, "lineOrder", "lineOrder", &lineOrder, 1);
+	writeEXRAttribute(file, "pixelAspectRatio", "float", &aspectRatio, sizeof(float));
+	writeEXRAttribute(file, "screenWindowCenter", "v2f", windowCenter, sizeof(windowCenter));
+	writeEXRAttribute(file, "screenWindowWidth", "float", &windowWidth, sizeof(float));
+	file.put('\0');
+
+	// Tabela przesuni blokw (64-bit), uzupeniana po zapisaniu danych.
+	std::streamoff	tableOffset = file.tellp();
+	unsigned int	offset[2]	= { 0, 0 };
+	for(unsigned int y=0; y<height; y++)
+		file.write((char*)offset, sizeof(offset));
+
+	unsigned int	lineSize	= width*(4-firstChannel)*sizeof(float);
+	float			*line		= new float[width*(4-firstChannel)];
+	unsigned char	*packed		= new unsigned char[lineSize*3/2+2];
+	unsigned int	*lineOffset	= new unsigned int[height];
+
+	for(unsigned int y=0; y<height; y++)
+	{
+		const float	*pixel	= getLine(height-1-y);
+		float		*dest	= line;
+		for(unsigned int c=firstChannel; c<4; c++)
+		{
+			for(unsigned int x=0; x<width; x++)
+				*dest++ = pixel[x*channels+channelIndex[c]];
+		}
+
+		const char	*data		= (char*)line;
+		int			dataSize	= (int)lineSize;
+		if(compression == ImageHDR::CompressionRLE)
+		{
+			unsigned int packedSize = compressRLE((unsigned char*)line, lineSize, packed);
+			if(packedSize < lineSize)
+			{
+				data		= (char*)packed;
+				dataSize	= (int)packedSize;
+			}
+		}
+
+		int lineY		= (int)y;
+		lineOffset[y]	= (unsigned int)file.tellp();
+		file.write((char*)&lineY, sizeof(int));
+		file.write((char*)&dataSize, sizeof(int));
+		file.write(data, dataSize);
+	}
+
+	file.seekp(tableOffset);
+	for(unsigned int y=0; y<height; y++)
+	{
+		offset[0] = lineOffset[y];
+		file.write((char*)offset, sizeof(offset));
+	}
+
+	delete[] lineOffset;
+	delete[] packed;
+	delete[] line;
+	file.close();
+	return true;
+}
+
+// Kompresja RLE w wariancie OpenEXR: rozdzielenie bajtw parzystych i nieparzystych,
+// predykcja rnicowa, a nastpnie kodowanie serii (-n: n literaw, n-1: powtrzenie).
+unsigned int ImageHDR::compressRLE(const unsigned char *data, const unsigned int size, unsigned char *out)
+{
+	const unsigned int	minRun	= 3;
+	const unsigned int	maxRun	= 127;
+
+	unsigned char	*tmp	= new unsigned char[size];
+	unsigned char	*t1		= tmp;
+	unsigned char	*t2		= tmp + (size+1)/2;
+	for(unsigned int i=0; i<size; i++)
+	{
+		if(i & 1) *t2++ = data[i];
+		else	  *t1++ = data[i];
+	}
+
+	int previous = tmp[0];
+	for(unsigned int i=1; i<size; i++)
+	{
+		int current	= tmp[i];
+		tmp[i]		= (unsigned char)(current - previous + 128 + 256);
+		previous	= current;
+	}
+
+	const unsigned char	*end		= tmp + size;
+	const unsigned char	*runStart	= tmp;
+	const unsigned char	*runEnd		= tmp + 1;
+	unsigned char		*outWrite	= out;
+
+	while(runStart < end)
+	{
+		while(runEnd < end && *runStart == *runEnd && (unsigned int)(runEnd - runStart - 1) < maxRun)
+			runEnd++;
+
+		if((unsigned int)(runEnd - runStart) >= minRun)
+		{
+			*outWrite++	= (unsigned char)((runEnd - runStart) - 1);
+			*outWrite++	= *runStart;
+			runStart	= runEnd;
+		}
+		else
+		{
+			while(runEnd < end &&
+				((runEnd+1 >= end || *runEnd != *(runEnd+1)) || (runEnd+2 >= end || *(runEnd+1) != *(runEnd+2))) &&
+				(unsigned int)(runEnd - runStart) < maxRun)
+				runEnd++;
+
+			*outWrite++ = (unsigned char)(runStart - runEnd);
+			while(runStart < runEnd)
+				*outWrite++ = *runStart++;
+		}
+		runEnd++;
+	}
+
+	delete[] tmp;
+	return (unsigned int)(outWrite - out);
+}
+
+// Konwersja do 8-bitowego bufora: ekspozycja i mapowanie tonw, a nastpnie obcicie do [0,1]
+// i kwantyzacja caymi liniami w Image::putSpan().
+bool ImageHDR::resolve(Image *target, const float exposure, const int tonemap) const
+{
+	if(!target || !imageData)
+		return false;
+	if(target->getWidth() != width || target->getHeight() != height)
+		return false;
+
+	float *span = new float[width*3];
+	for(unsigned int y=0; y<height; y++)
+	{
+		const float	*source	= getLine(y);
+		if(channels != 3)
+		{
+			const float	*pixel	= source;
+			float		*dest	= span;
+			for(unsigned int x=0; x<width; x++, pixel+=channels, dest+=3)
+			{
+				dest[0] = pixel[0];
+				dest[1] = pixel[1];
+				dest[2] = pixel[2];
+			}
+			source = span;
+		}
+		Kernels::get().exposeSpan(span, source, width*3, exposure, tonemap == ImageHDR::ToneReinhard);
+		target->putSpan(0, y, span, width);
+	}
+	delete[] span;
+	return true;
+}
+
+// Zapisuje [count] pikseli RGB (3 floaty na piksel) od pozycji [x, y].
+bool ImageHDR::putSpan(const int x, const int y, const float *span, const unsigned int count)
+{
+	float *pixel = &imageData[(y*width+x)*channels];
+	if(channels == 3)
+	{
+		memcpy(pixel, span, count*3*sizeof(float));
+		return true;
+	}
+	for(unsigned int i=0; i<count; i++, pixel+=channels, span+=3)
+	{
+		pixel[0] = span[0];
+		pixel[1] = span[1];
+		pixel[2] = span[2];
+	}
+	return true;
+}
+
+bool ImageHDR::putPixel(const int x, const int y, const vector3 &color)
+{
+	float *pixel = &imageData[(y*width+x)*channels];
+	pixel[0] = color.r;
+	pixel[1] = color.g;
+	pixel[2] = color.b;
+	return true;
+}
+
+bool ImageHDR::getPixel(const int x, const int y, vector3 &color)
+{
+	const float *pixel = &imageData[(y*width+x)*channels];
+	color.r = pixel[0];
+	color.g = pixel[1];
+	color.b = pixel[2];
+	return true;
+}
+
+bool ImageHDR::putPixel(const int x, const int y, const vector4 &color)
+{
+	if(channels < 4)
+		return false;
+	float *pixel = &imageData[(y*width+x)*channels];
+	pixel[0] = color.r;
+	pixel[1] = color.g;
+	pixel[2] = color.b;
+	pixel[3] = color.a;
+	return true;
+}
+
+bool ImageHDR::getPixel(const int x, const int y, vector4 &color)
+{
+	if(channels < 4)
+		return false;
+	const float *pixel = &imageData[(y*width+x)*channels];
+	color.r = pixel[0];
+	color.g = pixel[1];
+	color.b = pixel[2];
+	color.a = pixel[3];
+	return true;
+}
+
+bool ImageHDR::addPixel(const int x, const int y, const vector3 &color)
+{
+	float *pixel = &imageData[(y*width+x)*channels];
+	pixel[0] += color.r;
+	pixel[1] += color.g;
+	pixel[2] += color.b;
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+/*
+	This file is part of EX-Ray Raytracing Engine.
+	(C)2007 - 2008 Micha Siejak.
+
+    EX-Ray is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    EX-Ray is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with EX-Ray.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __IMAGEHDR_H
+#define __IMAGEHDR_H
+
+namespace exRay {
+
+class Image;
+
+/// Klasa zmiennoprzecinkowego bufora klatki (HDR).
+/** Przechowuje obraz jako 3 (RGB) lub 4 (RGBA) wartoci float na piksel, bez obcinania
+	do zakresu [0,1]. Pozwala akumulowa prbki z wielu przebiegw bez ponownego renderowania.
+	Konwersja do 8-bitowego bufora Image wykonywana jest jawnie metod resolve(), z opcjonaln
+	ekspozycj i mapowaniem tonw. Obraz mona zapisa do pliku Portable Float Map (.pfm)
+	lub OpenEXR (.exr, linie skanowania, kanay float, kompresja brak/RLE).
+*/
+class ImageHDR
+{
+private:
+	float*			imageData;
+	unsigned int	width;
+	unsigned int	height;
+	unsigned int	channels;
+private:
+	bool				writePFM(const std::string &filename);
+	bool				writeEXR(const std::string &filename, const int compression);
+	static unsigned int	compressRLE(const unsigned char *data, const unsigned int size, unsigned char *out);
+public:
+	ImageHDR();
+	ImageHDR(unsigned int x, unsigned int y, unsigned int numChannels);
+	virtual ~ImageHDR(void);
+	void	free(void);
+	void	clear(void);
+
+	float			*getData() const		{ return imageData; }
+	float			*getLine(const unsigned int y) const
+	{ return &imageData[y*width*channels]; }
+	unsigned int	getWidth() const		{ return width;		}
+	unsigned int	getHeight() const		{ return height;	}
+	unsigned int	getChannels() const		{ return channels;	}
+
+	static int		getFormat(const std::string &filename);
+	static bool		isHDRFormat(const std::string &filename);
+	bool			writeToFile(const std::string &filename, const int compression=CompressionRLE);
+	bool			resolve(Image *target, const float exposure=1.0f, const int tonemap=ToneClamp) const;
+
+	bool			putSpan(const int x, const int y, const float *span, const unsigned int count);
+	bool			putPixel(const int x, const int y, const vector3 &color);
+	bool			getPixel(const int x, const int y, vector3 &color);
+	bool			putPixel(const int x, const int y, const vector4 &color);
+	bool			getPixel(const int x, const int y, vector4 &color);
+	bool			addPixel(const int x, const int y, const vector3 &color);
+
+	enum
+	{
+		FormatUnknown = 0,
+		FormatPFM,
+		FormatEXR,
+
+		// Kody kompresji zgodne ze specyfikacj OpenEXR.
+		CompressionNone	= 0,
+		CompressionRLE	= 1,
+
+		ToneClamp = 0,
+		ToneReinhard,
+	};
+};
+
+} // exRay
+
+#endif
\ No newline at end of file
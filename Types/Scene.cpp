@@ -35,42 +35,152 @@
 #include "../Shaders/ShaderPhong.h"
 #include "Scene.h"
 
+#ifdef WIN32 // WIN32 PLATFORM SPECIFIC
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
 using namespace exRay;
 
-/// Wewntrzna klasa rozszerzajca funkcjonalnc std::vector<std::string>.
-class exRay::StringVector : public std::vector<std::string>
+/// Wewntrzna tablica napisw skryptu.
+/** Tablica haszujca z adresowaniem otwartym (FNV-1a). Napisy przechowywane s we wsplnej puli
+	sceny (zakoczone zerem), a tablica zwraca ich indeksy w licie [entries]. Wyszukiwanie i dodawanie
+	ma stay koszt, niezaleny od liczby wzw.
+*/
+class exRay::StringTable
 {
+private:
+	std::vector<char>			&pool;
+	std::vector<unsigned int>	&entries;	// przesunicia napisw w puli
+	std::vector<unsigned int>	slots;		// indeks+1, 0 oznacza wolne miejsce
+	unsigned int				mask;
+private:
+	static unsigned int hash(const char *text, const unsigned int length)
+	{
+		unsigned int value = 2166136261u;
+		for(unsigned int i=0; i<length; i++)
+			value = (value ^ (unsigned char)text[i]) * 16777619u;
+		return value;
+	}
+	void place(const unsigned int index)
+	{
+		const char		*name	= &pool[entries[index]];
+		unsigned int	slot	= hash(name, (unsigned int)strlen(name)) & mask;
+		while(slots[slot] != 0)
+			slot = (slot+1) & mask;
+		slots[slot] = index+1;
+	}
+	void grow(void)
+	{
+		slots.assign(slots.size()*2, 0);
+		mask = (unsigned int)slots.size()-1;
+		for(unsigned int i=0; i<entries.size(); i++)
+			place(i);
+	}
 public:
-	std::vector<std::string>::iterator find(const std::string &value)
+	StringTable(std::vector<char> &stringPool, std::vector<unsigned int> &entryList)
+		: pool(stringPool), entries(entryList)
 	{
-		std::vector<std::string>::iterator it = begin();
-		for(;it<end(); it++) if((*it) == value) return it;
-		return end();
+		slots.assign(1024, 0);
+		mask = (unsigned int)slots.size()-1;
+		for(unsigned int i=0; i<entries.size(); i++)
+			place(i);
+	}
+	unsigned int find(const ScriptToken &token) const
+	{
+		unsigned int slot = hash(token.text, token.length) & mask;
+		while(slots[slot] != 0)
+		{
+			const char *name = &pool[entries[slots[slot]-1]];
+			if(strncmp(name, token.text, token.length) == 0 && name[token.length] == 0)
+				return slots[slot]-1;
+			slot = (slot+1) & mask;
+		}
+		return Scene::NoIdentifier;
+	}
+	bool has(const ScriptToken &token) const
+	{ return find(token) != Scene::NoIdentifier; }
+	unsigned int insert(const ScriptToken &token)
+	{
+		if((entries.size()+1)*2 > slots.size())
+			grow();
+		entries.push_back((unsigned int)pool.size());
+		pool.insert(pool.end(), token.text, token.text+token.length);
+		pool.push_back(0);
+		place((unsigned int)entries.size()-1);
+		return (unsigned int)entries.size()-1;
+	}
+	// Przesunicie napisu w puli; napis dodawany jest, jeli jeszcze nie istnieje.
+	unsigned int intern(const ScriptToken &token)
+	{
+		unsigned int index = find(token);
+		if(index == Scene::NoIdentifier)
+			index = insert(token);
+		return entries[index];
 	}
-	bool has(const std::string &value)
-	{ return find(value) != end(); }
 };
 
-Scene::Scene(void)
+#pragma pack(push, 4)
+/// Wewntrzna struktura okrelajca nagwek skompilowanego pliku sceny.
+struct CompiledHeader
 {
-	errorCount		= 0;
-	scriptOpened	= false;
+	char			id[4];
+	unsigned int	version;
+	unsigned int	recordSize;
+	unsigned int	instructionCount;
+	unsigned int	identifierCount;
+	unsigned int	stringSize;
+	unsigned int	instructionOffset;
+	unsigned int	identifierOffset;
+	unsigned int	stringOffset;
+};
+#pragma pack(pop)
 
-	frameX = frameY = 0;
+// Sekcja [count] rekordw po [size] bajtw od [offset] mieci si w pliku (bez przepenienia sumy).
+static inline bool fitsSection(const unsigned int fileSize, const unsigned int offset, const unsigned int count,
+							   const unsigned int size)
+{ return offset <= fileSize && count <= (fileSize - offset) / size; }
+
+static inline bool isBlank(const char c)
+{ return c == ' ' || c == '\t' || c == '\r'; }
+
+static inline bool isDigit(const char c)
+{ return c >= '0' && c <= '9'; }
+
+static inline bool isDelimiter(const char c)
+{ return c == '.' || c == '(' || c == ')' || c == ',' || c == '"' || c == '\''; }
 
+static inline bool isTermEnd(const char c)
+{ return isBlank(c) || isDelimiter(c) || c == '#' || c == ';'; }
+
+static inline bool isVariableChar(const char c)
+{ return isDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+
+typedef std::map<unsigned int, AttribKey>		AttribKeyMap;
+typedef std::map<unsigned int, NodeCreator*>	CreatorCache;
+
+// Klucz atrybutu dla nazwy z puli napisw; wyznaczany raz dla kadej nazwy.
+static const AttribKey& findAttribKey(AttribKeyMap &keys, const unsigned int name, const char *string)
+{
+	AttribKeyMap::iterator key = keys.find(name);
+	if(key == keys.end())
+		key = keys.insert(AttribKeyMap::value_type(name, AttribKey::find(string))).first;
+	return key->second;
+}
+
+Scene::Scene(void)
+{
+	initialize();
 	createErrorMap();
 	createParameterMap();
 	registerBuiltInShaders();
 	registerBuiltInCreators();
 }
 
-Scene::Scene(const std::string &filename)
+Scene::Scene(const std::string &filename, const unsigned int threads)
 {
-	errorCount		= 0;
-	scriptOpened	= false;
-
-	frameX = frameY = 0;
-
+	initialize();
+	parseThreads = threads;
 	createErrorMap();
 	createParameterMap();
 	registerBuiltInShaders();
@@ -78,17 +188,14 @@ Scene::Scene(const std::string &filename)
 
 	if(filename.length() == 0)
 		return;
-
-	std::ifstream file(filename.c_str());
-	if(!file.is_open())
-		return;
-
-	parseFile(file);
-	file.close();
+	if(isCompiled(filename))
+		loadCompiled(filename);
+	else parseFile(filename);
 }
 
 Scene::~Scene(void)
 {
+	releaseCompiled();
 	for(CreatorMap::iterator it=creatorMap.begin(); it!=creatorMap.end(); it++)
 		delete it->second;
 	for(ShaderMap::iterator it=shaderMap.begin(); it!=shaderMap.end(); it++)
@@ -114,6 +221,10 @@ void Scene::createErrorMap(void)
 	errorMap[ArgumentMismatch]		= "Wrong number of arguments passed to a function.";
 	errorMap[UnknownFunction]		= "No such function.";
 	errorMap[UnknownShader]			= "Unknown shader object.";
+	errorMap[CompiledInvalid]		= "Invalid or incompatible compiled scene file.";
+	errorMap[RepeatInvalid]			= "Invalid repeat statement. Expected 'repeat <variable> <count>'.";
+	errorMap[RepeatNotClosed]		= "Repeat block is not closed with 'end'.";
+	errorMap[UnmatchedEnd]			= "'end' without matching repeat statement.";
 	errorMap[UnknownError]			= "An unknown error occured.";
 
 	errorMap[UnknownInstruction]	= "Unknown instruction code. Ignoring.";
@@ -134,7 +245,9 @@ void Scene::createParameterMap(void)
 	parameterMap.first["ShadowSampling"]	= exRay::ShadowSampling;
 	parameterMap.first["RenderSamples"]		= exRay::RenderSamples;
 	parameterMap.first["ShadowSamples"]		= exRay::ShadowSamples;
+	parameterMap.first["LightSamples"]		= exRay::LightSamples;
 	parameterMap.first["RefractionIndex"]	= exRay::EnvRIndex;
+	parameterMap.first["LightThreshold"]	= exRay::LightThresholdCode;
 
 	parameterMap.first["Width"]				= exRay::FrameWidth;
 	parameterMap.first["Height"]			= exRay::FrameHeight;
@@ -177,15 +290,50 @@ std::string Scene::getScriptLog(void) const
 	return logStream.str();
 }
 
+void Scene::initialize(void)
+{
+	errorCount		= 0;
+	scriptOpened	= false;
+	compiledView	= NULL;
+	parseThreads	= 1;
+
+	frameX = frameY = 0;
+	attachParsed();
+}
+
 void Scene::clear()
 {
 	errorCount		= 0;
 	scriptOpened	= false;
 
-	lines.clear();
+	releaseCompiled();
+	instructions.clear();
+	identifiers.clear();
+	stringPool.assign(1, 0); // przesunicie 0: pusty napis
+	attachParsed();
 	logStream.str().clear();
 }
 
+// Liczba wtkw analizy skryptu; Engine::Autodetect dopasowuje j do liczby procesorw.
+void Scene::setParseThreads(const unsigned int threads)
+{
+	parseThreads = threads;
+}
+
+// Ustawia widok skryptu na tablice wypenione przez parser.
+void Scene::attachParsed(void)
+{
+	if(stringPool.empty())
+		stringPool.assign(1, 0);
+
+	instructionCount	= (unsigned int)instructions.size();
+	instructionData		= instructionCount > 0 ? &instructions[0] : NULL;
+	identifierCount		= (unsigned int)identifiers.size();
+	identifierData		= identifierCount > 0 ? &identifiers[0] : NULL;
+	stringSize			= (unsigned int)stringPool.size();
+	stringData			= &stringPool[0];
+}
+
 bool Scene::registerCreator(const std::string &name, NodeCreator *creator)
 {
 	if(creator == NULL)
@@ -210,47 +358,187 @@ bool Scene::registerShader(const std::string &name, Shader *shader)
 	return true;
 }
 
-bool Scene::isValidValue(const std::string &value)
+// Zamienia sta liczbow na warto bez kopiowania leksemu. Dla typowych staych (do 15 cyfr
+// znaczcych, wykadnik dziesitny do 22) wynik jest dokadny; pozostae przypadki trafiaj do strtod.
+bool Scene::parseValue(const ScriptToken &token, float &value)
 {
-	float	test;
-	return sscanf(value.c_str(), "%f", &test) > 0;
+	static const double	powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+									 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	const char	*pos		= token.text;
+	const char	*end		= token.text + token.length;
+	double		mantissa	= 0.0;
+	int			exponent	= 0;
+	int			digits		= 0;
+	bool		negative	= false;
+	bool		exact		= true;
+
+	if(pos < end && (*pos == '-' || *pos == '+'))
+		negative = *pos++ == '-';
+	for(; pos < end && isDigit(*pos); pos++, digits++)
+	{
+		if(mantissa < 1e15) mantissa = mantissa*10.0 + (*pos - '0');
+		else { exponent++; exact = false; }
+	}
+	if(pos < end && *pos == '.')
+	{
+		for(pos++; pos < end && isDigit(*pos); pos++, digits++)
+		{
+			if(mantissa < 1e15) { mantissa = mantissa*10.0 + (*pos - '0'); exponent--; }
+			else exact = false;
+		}
+	}
+	if(digits == 0)
+		return false;
+	if(pos < end && (*pos == 'e' || *pos == 'E'))
+	{
+		int		power			= 0;
+		bool	negativePower	= false;
+		if(++pos < end && (*pos == '-' || *pos == '+'))
+			negativePower = *pos++ == '-';
+		if(pos == end || !isDigit(*pos))
+			return false;
+		for(; pos < end && isDigit(*pos); pos++)
+		{
+			if(power < 10000)
+				power = power*10 + (*pos - '0');
+		}
+		exponent += negativePower ? -power : power;
+	}
+	if(pos != end)
+		return false;
+
+	if(exact && exponent >= -22 && exponent <= 22)
+	{
+		double result = (exponent < 0) ? mantissa / powers[-exponent] : mantissa * powers[exponent];
+		value = (float)(negative ? -result : result);
+	}
+	else
+	{
+		char buffer[64];
+		if(token.length >= sizeof(buffer))
+			return false;
+		memcpy(buffer, token.text, token.length);
+		buffer[token.length] = 0;
+		value = (float)strtod(buffer, NULL);
+	}
+	return true;
 }
 
-void Scene::stripString(std::string &string)
+// Analizuje wyraenie liniowe: skadniki rozdzielone znakami '+' i '-', kady bdcy sta,
+// zmienn "$nazwa" lub iloczynem staej i zmiennej.
+bool Scene::parseExpression(const ScriptToken &token, ScriptExpression &expression)
 {
-	unsigned int	offset=0, loffset=0;
-	std::string		result;
-	while(offset < string.length() && offset != std::string::npos)
+	const char	*pos = token.text;
+	const char	*end = token.text + token.length;
+
+	expression		 = ScriptExpression();
+	expression.text	 = token;
+	while(pos < end)
 	{
-		offset	= (unsigned int)string.find_first_not_of(" \t", offset);
-		loffset	= (unsigned int)string.find_first_of(" \t", offset);
-		if(loffset == std::string::npos)
-			loffset = (unsigned int)string.length()+1;
+		float			sign	 = 1.0f;
+		float			factor	 = 1.0f;
+		bool			constant = false;
+		ScriptToken		variable;
 
-		result += string.substr(offset, loffset-offset+1);
-		offset = loffset+1;
+		if(*pos == '+' || *pos == '-')
+			sign = (*pos++ == '-') ? -1.0f : 1.0f;
+		else if(pos != token.text)
+			return false;
 
-		if(result.at(result.length()-1) == '\t')
-			result[result.length()-1] = ' ';
-	}
+		for(unsigned int operand=0; operand<2; operand++)
+		{
+			if(pos < end && *pos == '$')
+			{
+				const char *name = ++pos;
+				while(pos < end && isVariableChar(*pos))
+					pos++;
+				if(pos == name || variable.text)
+					return false;
+				variable = ScriptToken(name, (unsigned int)(pos-name));
+			}
+			else
+			{
+				const char *number = pos;
+				while(pos < end && (isDigit(*pos) || *pos == '.' || *pos == 'e' || *pos == 'E' ||
+					((*pos == '-' || *pos == '+') && pos > number && (pos[-1] == 'e' || pos[-1] == 'E'))))
+					pos++;
+				if(constant || !parseValue(ScriptToken(number, (unsigned int)(pos-number)), factor))
+					return false;
+				constant = true;
+			}
+			if(pos == end || *pos != '*')
+				break;
+			if(++pos == end)
+				return false;
+		}
+		if(pos < end && *pos != '+' && *pos != '-')
+			return false;
 
-	offset = (unsigned int)result.find_first_of(";#", 0);
-	string = result.substr(0, offset);
+		if(!variable.text)
+			expression.base += sign*factor;
+		else
+		{
+			if(expression.terms == ScriptExpression::MaxTerms)
+				return false;
+			expression.variable[expression.terms] = variable;
+			expression.factor[expression.terms]	  = sign*factor;
+			expression.terms++;
+		}
+	}
+	return expression.terms > 0;
 }
 
-bool Scene::reportError(unsigned int line, int errorID, const std::string &info)
+bool Scene::findLoopIndex(const ScriptToken &variable, const LoopList &loops, unsigned int &index)
 {
-	logStream << "(" << line << ") ";
-	if(info.length() > 0)
-		logStream << "'" << info << "': ";
-	logStream << errorMap[errorID] << std::endl;
+	for(LoopList::const_reverse_iterator i=loops.rbegin(); i!=loops.rend(); i++)
+	{
+		if(i->first.length == variable.length && strncmp(i->first.text, variable.text, variable.length) == 0)
+		{
+			index = i->second;
+			return true;
+		}
+	}
 	return false;
 }
 
-bool Scene::reportError(unsigned int line, int errorID, const char info)
+// Zastpuje zmienne "$nazwa" w identyfikatorze biecymi indeksami ptli. Identyfikator bez
+// zmiennych zwracany jest bez kopiowania.
+bool Scene::expandIdentifier(const ScriptToken &token, const LoopList &loops, std::string &buffer,
+							 ScriptToken &identifier)
+{
+	const char	*pos = (const char*)memchr(token.text, '$', token.length);
+	const char	*end = token.text + token.length;
+	char		number[16];
+
+	identifier = token;
+	if(!pos)
+		return true;
+
+	buffer.assign(token.text, pos);
+	while(pos < end)
+	{
+		if(*pos != '$')
+		{
+			buffer += *pos++;
+			continue;
+		}
+		const char		*name = ++pos;
+		unsigned int	index;
+		while(pos < end && isVariableChar(*pos))
+			pos++;
+		if(!findLoopIndex(ScriptToken(name, (unsigned int)(pos-name)), loops, index))
+			return false;
+		sprintf(number, "%u", index);
+		buffer += number;
+	}
+	identifier = ScriptToken(buffer.c_str(), (unsigned int)buffer.length());
+	return true;
+}
+
+bool Scene::reportError(unsigned int line, int errorID, const std::string &info)
 {
 	logStream << "(" << line << ") ";
-	if(info != 0)
+	if(info.length() > 0)
 		logStream << "'" << info << "': ";
 	logStream << errorMap[errorID] << std::endl;
 	return false;
@@ -272,238 +560,263 @@ void Scene::reportValidationError(int errorID, const std::string &info)
 	logStream << errorMap[errorID] << std::endl;
 }
 
-bool Scene::getTerm(std::string &result, const std::string &string, unsigned int &pos, unsigned int line)
+bool Scene::lineError(ScriptLine &result, int errorID, const ScriptToken &info)
 {
-	unsigned int	delim;
-	bool			number = false;
-	if(string.at(pos) == ' ') pos++;
+	result.error	 = errorID;
+	result.errorInfo = info;
+	return false;
+}
 
-	if(string.find_first_of("-0123456789", pos) == pos)
-		number = true;
+// Dzieli lini na leksemy: cigi znakw oraz pojedyncze ograniczniki ".(),\"'". Staa liczbowa
+// lub wyraenie ("$i*0.5") wraz z czciami uamkowymi tworzy jeden leksem. Komentarz rozpoczyna
+// si od znaku '#' lub ';'.
+bool Scene::getTokens(TokenList &tokens, const char *begin, const char *end, ScriptLine &result) const
+{
+	const char *pos = begin;
 
-	delim = (unsigned int)string.find_first_of(" .(),\"'", pos);
-	if(delim == std::string::npos)
-	{
-		result	= string.substr(pos, std::string::npos);
-		pos		= (unsigned int)string.length();
-		return true;
-	}
-	else if(delim == 0)
-		return reportError(line, Scene::ParseError, string.at(0));
-	else
+	tokens.clear();
+	while(pos < end)
 	{
-		result = string.substr(pos, delim-pos);
-		pos   += delim-pos;
-		if(number && string.at(pos) == '.')
+		while(pos < end && isBlank(*pos))
+			pos++;
+		if(pos == end || *pos == '#' || *pos == ';')
+			break;
+
+		if(isDelimiter(*pos))
 		{
-			if(string.find_first_of("0123456789", pos) == pos+1)
-			{
-				result += string.at(pos++);
-				delim = (unsigned int)string.find_first_of(" .(),\"'", pos+1);
-				result += string.substr(pos, delim-pos);
-				pos    += delim-pos;
-			}
+			if(tokens.empty())
+				return lineError(result, Scene::ParseError, ScriptToken(pos, 1));
+			tokens.push_back(ScriptToken(pos++, 1));
+			continue;
+		}
+
+		const char	*start	= pos;
+		bool		number	= (*pos == '-' || *pos == '$' || isDigit(*pos));
+		while(pos < end)
+		{
+			if(!isTermEnd(*pos))
+				pos++;
+			else if(number && *pos == '.' && pos+1 < end && isDigit(pos[1]))
+				pos++;
+			else break;
 		}
+		tokens.push_back(ScriptToken(start, (unsigned int)(pos-start)));
 	}
 	return true;
 }
 
-bool Scene::getTokens(TokenSet &tokens, std::string &string)
+bool Scene::functionCall(const TokenList &tokens, unsigned int offset, unsigned int argc, TokenList &args,
+						 ScriptLine &result) const
 {
-	std::string		term;
-	char			singleton[2];
-	unsigned int	position = 0;
+	if(tokens.size() != offset + 2*argc + 1)
+		return lineError(result, Scene::ArgumentMismatch, tokens.at(offset-1));
+	if(tokens.at(offset) != "(")
+		return lineError(result, Scene::ParenthesisExpected, tokens.at(offset));
 
-	singleton[1] = 0;
-	if(string.at(0) == '#' || string.at(0) == ';')
-		return true;
-
-	while(position < string.length())
+	for(unsigned int i=offset+1; i<tokens.size()-1; i++)
 	{
-		if(!getTerm(term, string, position, tokens.first)) return false;
-		if(term.length() > 0)
-			tokens.second.push_back(term);
-		if(position >= string.length())
-			break;
-		singleton[0] = string.at(position++);
-		if(singleton[0] != ' ')
-			tokens.second.push_back(std::string(singleton));
+		if((i-offset) % 2 != 0)
+			args.push_back(tokens.at(i));
+		else if(tokens.at(i) != ",")
+				return lineError(result, Scene::CallInvalid);
 	}
+	if(tokens.at(tokens.size()-1) != ")")
+		return lineError(result, Scene::ParenthesisExpected, tokens.at(tokens.size()-1));
 	return true;
 }
 
-bool Scene::functionCall(TokenSet &line, unsigned int offset, unsigned int argc, StringVector &args)
+// Staa liczbowa lub wyraenie zalene od zmiennych ptli (zapisywane w licie wyrae fragmentu).
+bool Scene::interpretValue(const ScriptToken &token, const unsigned int component, float &value,
+						   ScriptLine &result, ExpressionList &expressions) const
 {
-	if(line.second.size() != offset + 2*argc + 1)
-		return reportError(line.first, Scene::ArgumentMismatch, line.second.at(offset-1));
-	if(line.second.at(offset) != "(")
-		return reportError(line.first, Scene::ParenthesisExpected, line.second.at(offset));
+	if(parseValue(token, value))
+		return true;
+	if(!memchr(token.text, '$', token.length))
+		return false;
 
-	for(unsigned int i=offset+1; i<line.second.size()-1; i++)
+	ScriptExpression expression;
+	if(!parseExpression(token, expression))
+		return false;
+	if(component < 4)
 	{
-		if((i-offset) % 2 != 0)
-			args.push_back(line.second.at(i));
-		else if(line.second.at(i) != ",")
-				return reportError(line.first, Scene::CallInvalid);
+		if(result.expressionMask == 0)
+			result.expression = (unsigned int)expressions.size();
+		result.expressionMask |= 1 << component;
+		expressions.push_back(expression);
 	}
-	if(line.second.at(line.second.size()-1) != ")")
-		return reportError(line.first, Scene::ParenthesisExpected, line.second.at(line.second.size()-1));
+	value = 0.0f;
 	return true;
 }
 
-bool Scene::interpretLine(TokenSet &line, StringVector &identifiers)
+bool Scene::interpretLine(const TokenList &tokens, ScriptLine &result, ExpressionList &expressions) const
 {
-	TokenSet	instruction;
-	if(line.second.at(0) == "new")
-	{
-		instruction.first = Scene::Constructor;
-		if(line.second.size() < 5 || line.second.size() > 7)
-			return reportError(line.first, Scene::ConstructorInvalid); 
-		CreatorMap::iterator creatorLocation = creatorMap.find(line.second.at(1));
-		if(creatorLocation == creatorMap.end())
-			return reportError(line.first, Scene::UnknownNodeType, line.second.at(1));
-		instruction.second.push_back(line.second.at(1));
-		if(line.second.at(2) != "(")
-			return reportError(line.first, Scene::ParenthesisExpected, line.second.at(2));
-		if(identifiers.has(line.second.at(3)))
-			return reportError(line.first, Scene::RedeclaredIdentifier, line.second.at(3));
-		instruction.second.push_back(line.second.at(3));
+	SceneInstruction	&instruction = result.instruction;
 
-		if(line.second.at(4) == ")")
+	if(tokens.at(0) == "repeat" && (tokens.size() < 2 || tokens.at(1) != "."))
+	{
+		float count;
+		instruction.type = Scene::Repeat;
+		if(tokens.size() != 3)
+			return lineError(result, Scene::RepeatInvalid);
+		for(unsigned int i=0; i<tokens.at(1).length; i++)
 		{
-			if(line.second.size() > 5)
-				return reportError(line.first, Scene::ConstructorInvalid);
-			//identifiers.push_back(line.second.at(3));
-			//return true;
+			if(!isVariableChar(tokens.at(1).text[i]))
+				return lineError(result, Scene::RepeatInvalid, tokens.at(1));
 		}
+		if(!parseValue(tokens.at(2), count) || count < 0.0f || count != float(int(count)))
+			return lineError(result, Scene::RepeatInvalid, tokens.at(2));
+		result.node		 = tokens.at(1);
+		instruction.code = int(count);
+		return true;
+	}
+	if(tokens.at(0) == "end" && tokens.size() == 1)
+	{
+		instruction.type = Scene::RepeatEnd;
+		return true;
+	}
 
-		else if(line.second.at(4) == ",")
+	if(tokens.at(0) == "new")
+	{
+		instruction.type = Scene::Constructor;
+		if(tokens.size() < 5 || tokens.size() > 7)
+			return lineError(result, Scene::ConstructorInvalid); 
+		if(creatorMap.find(tokens.at(1).str()) == creatorMap.end())
+			return lineError(result, Scene::UnknownNodeType, tokens.at(1));
+		result.name = tokens.at(1);
+		if(tokens.at(2) != "(")
+			return lineError(result, Scene::ParenthesisExpected, tokens.at(2));
+		result.node = tokens.at(3);
+
+		if(tokens.at(4) == ")")
 		{
-			if(line.second.size() < 7)
-				return reportError(line.first, Scene::ConstructorInvalid);
-			if(!identifiers.has(line.second.at(5)))
-				return reportError(line.first, Scene::UndeclaredIdentifier, line.second.at(5));
-			instruction.second.push_back(line.second.at(5));
-			if(line.second.at(6) != ")")
-				return reportError(line.first, Scene::ParenthesisExpected, line.second.at(6));
+			if(tokens.size() > 5)
+				return lineError(result, Scene::ConstructorInvalid);
 		}
-
-		else return reportError(line.first, Scene::ConstructorInvalid);
-		identifiers.push_back(line.second.at(3));
+		else if(tokens.at(4) == ",")
+		{
+			if(tokens.size() < 7)
+				return lineError(result, Scene::ConstructorInvalid);
+			result.target = tokens.at(5);
+			if(tokens.at(6) != ")")
+				return lineError(result, Scene::ParenthesisExpected, tokens.at(6));
+		}
+		else return lineError(result, Scene::ConstructorInvalid);
 	}
-	else if(line.second.at(0) == "parameter" || line.second.at(0) == "set")
+	else if(tokens.at(0) == "parameter" || tokens.at(0) == "set")
 	{
-		instruction.first = Scene::Parameter;
-		if(line.second.size() < 3)
-			return reportError(line.first, Scene::UnexpectedEOL);
-		ParameterMap::iterator paramLocation = parameterMap.first.find(line.second.at(1));
+		instruction.type = Scene::Parameter;
+		if(tokens.size() < 3)
+			return lineError(result, Scene::UnexpectedEOL);
+		ParameterMap::const_iterator paramLocation = parameterMap.first.find(tokens.at(1).str());
 		if(paramLocation == parameterMap.first.end())
-			return reportError(line.first, Scene::UnknownParameter, line.second.at(1));
-		instruction.second.push_back(line.second.at(1));
+			return lineError(result, Scene::UnknownParameter, tokens.at(1));
+		result.name = tokens.at(1);
+		instruction.code = paramLocation->second;
 
-		ParameterMap::iterator valueLocation = parameterMap.second.find(line.second.at(2));
+		ParameterMap::const_iterator valueLocation;
 		switch(paramLocation->second)
 		{
 		case exRay::Supersampling:
-			if(valueLocation->second != exRay::Full && valueLocation->second != exRay::Adaptive)
-				return reportError(line.first, Scene::InvalidParameter, line.second.at(2));
+			valueLocation = parameterMap.second.find(tokens.at(2).str());
+			if(valueLocation == parameterMap.second.end() ||
+				(valueLocation->second != exRay::Full && valueLocation->second != exRay::Adaptive))
+				return lineError(result, Scene::InvalidParameter, tokens.at(2));
+			instruction.option = valueLocation->second;
 			break;
 		case exRay::ShadowSampling:
-			if(valueLocation->second != exRay::RegularGrid && valueLocation->second != exRay::MonteCarlo)
-				return reportError(line.first, Scene::InvalidParameter, line.second.at(2));
+			valueLocation = parameterMap.second.find(tokens.at(2).str());
+			if(valueLocation == parameterMap.second.end() ||
+				(valueLocation->second != exRay::RegularGrid && valueLocation->second != exRay::MonteCarlo))
+				return lineError(result, Scene::InvalidParameter, tokens.at(2));
+			instruction.option = valueLocation->second;
 			break;
 		default:
-			if(!isValidValue(line.second.at(2)))
-				return reportError(line.first, Scene::InvalidParameter, line.second.at(2));
+			if(!parseValue(tokens.at(2), instruction.value[0]))
+				return lineError(result, Scene::InvalidParameter, tokens.at(2));
+			instruction.valueCount = 1;
 		}
-		instruction.second.push_back(line.second.at(2));
 	}
 	else
 	{
-		instruction.first = Scene::Assignment;
-		if(line.second.size() < 5)
-			return reportError(line.first, Scene::AssignmentInvalid);
-		if(!identifiers.has(line.second.at(0)))
-			return reportError(line.first, Scene::UndeclaredIdentifier, line.second.at(0));
-		instruction.second.push_back(line.second.at(0));
-		if(line.second.at(1) != ".")
-			return reportError(line.first, Scene::DotExpected, line.second.at(1));
+		instruction.type = Scene::Assignment;
+		if(tokens.size() < 5)
+			return lineError(result, Scene::AssignmentInvalid);
+		result.node = tokens.at(0);
+		if(tokens.at(1) != ".")
+			return lineError(result, Scene::DotExpected, tokens.at(1));
 		
-		if(line.second.at(3) == "(")
+		if(tokens.at(3) == "(")
 		{
-			StringVector	fargs;
-			if(line.second.at(2) == "shader")
+			TokenList	fargs;
+			if(tokens.at(2) == "shader")
 			{
-				instruction.first = Scene::ShaderSet;
-				if(!functionCall(line, 3, 1, fargs))
+				instruction.type = Scene::ShaderSet;
+				if(!functionCall(tokens, 3, 1, fargs, result))
 					return false;
-				ShaderMap::iterator shaderLocation = shaderMap.find(fargs.at(0));
-				if(shaderLocation == shaderMap.end())
-					return reportError(line.first, Scene::UnknownShader, fargs.at(0));
-				instruction.second.push_back(fargs.at(0));
+				if(shaderMap.find(fargs.at(0).str()) == shaderMap.end())
+					return lineError(result, Scene::UnknownShader, fargs.at(0));
+				result.name = fargs.at(0);
 			}
-			else if(line.second.at(2) == "connect")
+			else if(tokens.at(2) == "connect")
 			{
-				instruction.first = Scene::Connection;
-				if(!functionCall(line, 3, 2, fargs))
+				instruction.type = Scene::Connection;
+				if(!functionCall(tokens, 3, 2, fargs, result))
 					return false;
-				if(!identifiers.has(fargs.at(0)))
-					return reportError(line.first, Scene::UndeclaredIdentifier, fargs.at(0));
-				instruction.second.push_back(fargs.at(0));
-				instruction.second.push_back(fargs.at(1));
+				result.target = fargs.at(0);
+				result.name	  = fargs.at(1);
 			}
-			else if(line.second.at(2) == "map")
+			else if(tokens.at(2) == "map")
 			{
-				instruction.first = Scene::Mapping;
-				if(!functionCall(line, 3, 1, fargs))
+				instruction.type = Scene::Mapping;
+				if(!functionCall(tokens, 3, 1, fargs, result))
 					return false;
-				if(!identifiers.has(fargs.at(0)))
-					return reportError(line.first, Scene::UndeclaredIdentifier, fargs.at(0));
-				instruction.second.push_back(fargs.at(0));
+				result.target = fargs.at(0);
 			}
-			else return reportError(line.first, Scene::UnknownFunction, line.second.at(2));
+			else return lineError(result, Scene::UnknownFunction, tokens.at(2));
 		}
 
-		else if(line.second.at(3) != "=")
-			return reportError(line.first, Scene::AssignmentInvalid);
-		else if(line.second.at(4) == "(")
+		else if(tokens.at(3) != "=")
+			return lineError(result, Scene::AssignmentInvalid);
+		else if(tokens.at(4) == "(")
 		{
-			instruction.second.push_back(line.second.at(2));
+			result.name = tokens.at(2);
 
 			unsigned int i=4;
 			bool		 vclosed=false;
-			while(++i < line.second.size())
+			float		 value;
+			while(++i < tokens.size())
 			{
 				if(i % 2 == 0)
 				{
-					if(line.second.at(i) == ")")
+					if(tokens.at(i) == ")")
 						vclosed = true;
-					else if(line.second.at(i) != ",")
-						return reportError(line.first, Scene::AssignmentInvalid);
+					else if(tokens.at(i) != ",")
+						return lineError(result, Scene::AssignmentInvalid);
 					continue;
 				}
-				if(!isValidValue(line.second.at(i)))
-					return reportError(line.first, Scene::ConstantInvalid, line.second.at(i));
-				instruction.second.push_back(line.second.at(i));
+				if(!interpretValue(tokens.at(i), instruction.valueCount, value, result, expressions))
+					return lineError(result, Scene::ConstantInvalid, tokens.at(i));
+				if(instruction.valueCount < 4)
+					instruction.value[instruction.valueCount] = value;
+				instruction.valueCount++;
 			}
 			if(!vclosed)
-				return reportError(line.first, Scene::ParenthesisExpected, line.second.at(i-1));
+				return lineError(result, Scene::ParenthesisExpected, tokens.at(i-1));
 		}
 		else
 		{
-			instruction.second.push_back(line.second.at(2));
-			if(!isValidValue(line.second.at(4)))
-				return reportError(line.first, Scene::ConstantInvalid, line.second.at(4));
-			instruction.second.push_back(line.second.at(4));
+			result.name = tokens.at(2);
+			if(!interpretValue(tokens.at(4), 0, instruction.value[0], result, expressions))
+				return lineError(result, Scene::ConstantInvalid, tokens.at(4));
+			instruction.valueCount = 1;
 		}
 	}
-	lines.push_back(instruction);
 	return true;
 }
 
 int Scene::parseFile(const std::string &filename)
 {
-	std::ifstream file(filename.c_str());
+	std::ifstream file(filename.c_str(), std::ios_base::in | std::ios_base::binary);
 	if(!file.is_open())
 	{
 		scriptOpened = false;
@@ -518,88 +831,505 @@ int Scene::parseFile(const std::string &filename)
 
 int Scene::parseFile(std::ifstream &file)
 {
-	unsigned int	lineCount = 1;
-	int				errors	  = 0;
-	char*			lineBuffer = new char[Scene::MaxLine];
-	std::string		currentLine;
+	file.seekg(0, std::ios_base::end);
+	std::streamoff size = file.tellg();
+	file.seekg(0, std::ios_base::beg);
+	if(size < 0)
+		size = 0;
 
-	TokenSet		tokenLine;
-	StringVector	identifiers;
+	char *buffer = new char[(unsigned int)size+1];
+	file.read(buffer, size);
 
-	clear();
-	while(!file.eof())
-	{
-		file.getline(lineBuffer, Scene::MaxLine);
-		currentLine = std::string(lineBuffer);
-		if(currentLine.length() == 0)
-		{ lineCount++; continue; }
+	int errors = parseBuffer(buffer, (unsigned int)file.gcount());
+	delete[] buffer;
+	return errors;
+}
+
+// Analizuje skadni fragmentu skryptu. Wywoywana rwnolegle dla wszystkich fragmentw; nie
+// modyfikuje sceny, a numery linii zapisywane s wzgldem pocztku fragmentu.
+unsigned long __stdcall Scene::parseChunk(void *pChunk)
+{
+	ScriptChunk	*chunk	= (ScriptChunk*)pChunk;
+	const char	*lineEnd;
+	TokenList	tokens;
+	ScriptLine	result;
 
-		stripString(currentLine);
-		if(currentLine.length() == 0)
-		{ lineCount++; continue; }
+	chunk->lineCount = 0;
+	for(const char *lineStart=chunk->begin; lineStart < chunk->end; lineStart=lineEnd+1)
+	{
+		lineEnd = (const char*)memchr(lineStart, '\n', chunk->end-lineStart);
+		if(!lineEnd)
+			lineEnd = chunk->end;
+		chunk->lineCount++;
+
+		result = ScriptLine();
+		result.instruction.line = chunk->lineCount;
+		if(chunk->scene->getTokens(tokens, lineStart, lineEnd, result))
+		{
+			if(tokens.empty())
+				continue;
+			chunk->scene->interpretLine(tokens, result, chunk->expressions);
+		}
+		chunk->lines.push_back(result);
+	}
+	return 0;
+}
 
-		tokenLine.first = lineCount;
-		tokenLine.second.clear();
-		if(!getTokens(tokenLine, currentLine))
-		{ errors++; lineCount++; continue; }
-		if(!interpretLine(tokenLine, identifiers))
-		{ errors++; lineCount++; continue; }
+// Rozwizuje identyfikatory linii w kolejnoci skryptu. Sprawdzenia identyfikatorw wykonywane s
+// w tej samej kolejnoci co w analizie skadniowej, wic zgaszany jest ten sam bd.
+bool Scene::resolveLine(const ScriptLine &result, const unsigned int lineBase, const ScriptExpression *expressions,
+						const LoopList &loops, StringTable &identifierTable, StringTable &nameTable)
+{
+	SceneInstruction	instruction = result.instruction;
+	ScriptToken			node, target;
+	std::string			nodeBuffer, targetBuffer;
+	instruction.line += lineBase;
 
-		lineCount++;
+	if(result.node.text)
+	{
+		if(!expandIdentifier(result.node, loops, nodeBuffer, node))
+			return reportError(instruction.line, Scene::UndeclaredIdentifier, result.node.str());
+		if(instruction.type == Scene::Constructor)
+		{
+			if(identifierTable.has(node))
+				return reportError(instruction.line, Scene::RedeclaredIdentifier, node.str());
+		}
+		else
+		{
+			instruction.node = identifierTable.find(node);
+			if(instruction.node == Scene::NoIdentifier)
+				return reportError(instruction.line, Scene::UndeclaredIdentifier, node.str());
+		}
+	}
+	if(result.target.text)
+	{
+		if(!expandIdentifier(result.target, loops, targetBuffer, target))
+			return reportError(instruction.line, Scene::UndeclaredIdentifier, result.target.str());
+		instruction.target = identifierTable.find(target);
+		if(instruction.target == Scene::NoIdentifier)
+			return reportError(instruction.line, Scene::UndeclaredIdentifier, target.str());
+	}
+	if(result.expressionMask)
+	{
+		const ScriptExpression *expression = expressions + result.expression;
+		for(unsigned int i=0; i<4; i++)
+		{
+			if(!(result.expressionMask & (1 << i)))
+				continue;
+			instruction.value[i] = expression->base;
+			for(unsigned int j=0; j<expression->terms; j++)
+			{
+				unsigned int index;
+				if(!findLoopIndex(expression->variable[j], loops, index))
+					return reportError(instruction.line, Scene::ConstantInvalid, expression->text.str());
+				instruction.value[i] += expression->factor[j] * float(index);
+			}
+			expression++;
+		}
 	}
-	delete[] lineBuffer;
+	if(result.error != Scene::NoError)
+		return reportError(instruction.line, result.error, result.errorInfo.str());
+
+	if(result.name.text)
+		instruction.name = nameTable.intern(result.name);
+	if(instruction.type == Scene::Constructor)
+		instruction.node = identifierTable.insert(node);
+	instructions.push_back(instruction);
+	return true;
+}
 
-	scriptOpened = errors == 0;
-	errorCount	 = errors;
+// Rozwija blok repeat: linie [first, last) wykonywane s dla kolejnych indeksw ptli. Po pierwszym
+// przebiegu zakoczonym bdem rozwijanie jest przerywane, aby nie powiela komunikatw.
+int Scene::expandBlock(const std::vector<ScriptLine> &block, const unsigned int first, const unsigned int last,
+					   const ExpressionList &expressions, LoopList &loops, StringTable &identifierTable,
+					   StringTable &nameTable)
+{
+	const ScriptExpression	*expressionData = expressions.empty() ? NULL : &expressions[0];
+	int						errors = 0;
+
+	for(unsigned int i=first; i<last; i++)
+	{
+		const ScriptLine &line = block[i];
+		if(line.instruction.type == Scene::Repeat)
+		{
+			unsigned int close = i+1;
+			for(unsigned int depth=1; close<last; close++)
+			{
+				if(block[close].instruction.type == Scene::Repeat)
+					depth++;
+				else if(block[close].instruction.type == Scene::RepeatEnd && --depth == 0)
+					break;
+			}
+
+			if(line.error != Scene::NoError)
+			{
+				reportError(line.instruction.line, line.error, line.errorInfo.str());
+				errors++;
+			}
+			else for(int index=0; index<line.instruction.code; index++)
+			{
+				loops.push_back(LoopIndex(line.node, index));
+				int blockErrors = expandBlock(block, i+1, close, expressions, loops, identifierTable, nameTable);
+				loops.pop_back();
+				if(blockErrors > 0)
+				{
+					errors += blockErrors;
+					break;
+				}
+			}
+			i = close;
+		}
+		else if(line.error != Scene::NoError && line.instruction.type == Scene::RepeatEnd)
+		{
+			reportError(line.instruction.line, line.error, line.errorInfo.str());
+			errors++;
+		}
+		else if(line.instruction.type != Scene::RepeatEnd &&
+			!resolveLine(line, 0, expressionData, loops, identifierTable, nameTable))
+			errors++;
+	}
 	return errors;
 }
 
-bool Scene::setupEngine(Engine *engine)
+int Scene::parseBuffer(const char *data, const unsigned int size)
 {
-	if(!scriptOpened || errorCount > 0 || !engine)
-		return false;
-
-	int	paramName, paramIValue;
-	float		   paramFValue;
+	unsigned int	chunkCount	= parseThreads;
+	unsigned int	lineBase	= 0;
+	int				errors		= 0;
 
-	for(std::vector<TokenSet>::iterator i=lines.begin(); i<lines.end(); i++)
+	clear();
+	if(chunkCount == Engine::Autodetect)
+		chunkCount = Engine::getLogicalCPUsCount();
+	if(chunkCount > size / Scene::MinChunkSize)
+		chunkCount = size / Scene::MinChunkSize;
+	if(chunkCount == 0)
+		chunkCount = 1;
+
+	// Podzia na fragmenty na granicach linii.
+	std::vector<ScriptChunk>	chunks(chunkCount);
+	const char					*chunkStart = data;
+	for(unsigned int i=0; i<chunkCount; i++)
 	{
-		if(i->first != Scene::Parameter)
-			continue;
-		paramName  = parameterMap.first.find(i->second.at(0))->second;
-
-		if(paramName == exRay::Supersampling || paramName == exRay::ShadowSampling)
+		const char *chunkEnd = data + size;
+		if(i < chunkCount-1)
 		{
-			paramIValue = parameterMap.second.find(i->second.at(1))->second;
-			engine->setParameter(paramName, paramIValue);
+			chunkEnd = data + (size/chunkCount)*(i+1);
+			if(chunkEnd < chunkStart)
+				chunkEnd = chunkStart;
+			chunkEnd = (const char*)memchr(chunkEnd, '\n', data+size-chunkEnd);
+			chunkEnd = chunkEnd ? chunkEnd+1 : data+size;
 		}
-		else if(paramName == exRay::EnvRIndex)
+		chunks[i].scene	= this;
+		chunks[i].begin	= chunkStart;
+		chunks[i].end	= chunkEnd;
+		chunkStart		= chunkEnd;
+	}
+
+	std::vector<void*> threads(chunkCount, (void*)NULL);
+	for(unsigned int i=1; i<chunkCount; i++)
+	{
+#ifdef WIN32
+		threads[i] = CreateThread(NULL, 0, Scene::parseChunk, &chunks[i], 0, NULL);
+#endif
+		if(threads[i] == NULL)
+			parseChunk(&chunks[i]);
+	}
+	parseChunk(&chunks[0]);
+
+	std::vector<unsigned int>	names;
+	StringTable					identifierTable(stringPool, identifiers);
+	StringTable					nameTable(stringPool, names);
+	std::vector<ScriptLine>		block;			// Linie otwartego bloku repeat.
+	ExpressionList				blockExpressions;
+	LoopList					loops;
+	unsigned int				depth = 0;
+
+	instructions.reserve(chunks[0].lines.size()*chunkCount);
+	for(unsigned int i=0; i<chunkCount; i++)
+	{
+		if(threads[i])
 		{
-			paramFValue = fabsf((float)atof(i->second.at(1).c_str()));
-			engine->setParameter(paramName, paramFValue);
+#ifdef WIN32
+			WaitForSingleObject(threads[i], INFINITE);
+			CloseHandle(threads[i]);
+#endif
 		}
-		else if(paramName == exRay::FrameWidth || paramName == exRay::FrameHeight)
+		const ScriptExpression *expressionData = chunks[i].expressions.empty() ? NULL : &chunks[i].expressions[0];
+		for(std::vector<ScriptLine>::const_iterator j=chunks[i].lines.begin(); j<chunks[i].lines.end(); j++)
 		{
-			if(paramName == exRay::FrameWidth)
+			int type = j->instruction.type;
+			if(depth == 0 && type != Scene::Repeat)
 			{
-				frameX = (int)abs(atoi(i->second.at(1).c_str()));
-				if(frameX < Scene::MinWH) frameX = Scene::MinWH;
+				if(type == Scene::RepeatEnd)
+				{
+					if(j->error != Scene::NoError)
+						reportError(j->instruction.line+lineBase, j->error, j->errorInfo.str());
+					else reportError(j->instruction.line+lineBase, Scene::UnmatchedEnd);
+					errors++;
+				}
+				else if(!resolveLine(*j, lineBase, expressionData, loops, identifierTable, nameTable))
+					errors++;
+				continue;
 			}
-			if(paramName == exRay::FrameHeight)
+
+			// Linie bloku kopiowane s wraz z wyraeniami do czasu zamknicia bloku zewntrznego.
+			block.push_back(*j);
+			block.back().instruction.line += lineBase;
+			if(j->expressionMask)
 			{
-				frameY = (int)abs(atoi(i->second.at(1).c_str()));
-				if(frameY < Scene::MinWH) frameY = Scene::MinWH;
+				const ScriptExpression *expression = expressionData + j->expression;
+				block.back().expression = (unsigned int)blockExpressions.size();
+				for(unsigned int k=0; k<4; k++)
+				{
+					if(j->expressionMask & (1 << k))
+						blockExpressions.push_back(*expression++);
+				}
+			}
+			if(type == Scene::Repeat)
+				depth++;
+			else if(type == Scene::RepeatEnd && --depth == 0)
+			{
+				errors += expandBlock(block, 0, (unsigned int)block.size(), blockExpressions, loops,
+									  identifierTable, nameTable);
+				block.clear();
+				blockExpressions.clear();
 			}
 		}
-		else
+		lineBase += chunks[i].lineCount;
+		std::vector<ScriptLine>().swap(chunks[i].lines);
+		ExpressionList().swap(chunks[i].expressions);
+	}
+	if(depth > 0)
+	{
+		reportError(block.front().instruction.line, Scene::RepeatNotClosed);
+		errors++;
+	}
+	attachParsed();
+
+	scriptOpened = errors == 0;
+	errorCount	 = errors;
+	return errors;
+}
+
+bool Scene::isCompiled(const std::string &filename)
+{
+	std::ifstream	file(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+	char			id[4];
+
+	if(!file.is_open())
+		return false;
+	file.read(id, 4);
+	return file.gcount() == 4 && memcmp(id, "EXRS", 4) == 0;
+}
+
+// Plik skompilowany: nagwek, tablica instrukcji, tablica identyfikatorw, pula napisw.
+// Sekcje zapisywane s bez konwersji, w kolejnoci bajtw x86.
+bool Scene::writeCompiled(const std::string &filename) const
+{
+	if(!scriptOpened || errorCount > 0)
+		return false;
+
+	std::ofstream file(filename.c_str(), std::ios_base::out | std::ios_base::binary);
+	if(!file.is_open())
+		return false;
+
+	CompiledHeader	header;
+	memcpy(header.id, "EXRS", 4);
+	header.version				= Scene::CompiledVersion;
+	header.recordSize			= sizeof(SceneInstruction);
+	header.instructionCount		= instructionCount;
+	header.identifierCount		= identifierCount;
+	header.stringSize			= stringSize;
+	header.instructionOffset	= sizeof(CompiledHeader);
+	header.identifierOffset		= header.instructionOffset + instructionCount*sizeof(SceneInstruction);
+	header.stringOffset			= header.identifierOffset + identifierCount*sizeof(unsigned int);
+
+	file.write((const char*)&header, sizeof(CompiledHeader));
+	file.write((const char*)instructionData, instructionCount*sizeof(SceneInstruction));
+	file.write((const char*)identifierData, identifierCount*sizeof(unsigned int));
+	file.write(stringData, stringSize);
+	file.close();
+	return !file.fail();
+}
+
+// Mapuje plik skompilowany do pamici. Instrukcje, identyfikatory i napisy uywane s
+// bezporednio z widoku pliku, po sprawdzeniu poprawnoci indeksw i przesuni.
+int Scene::loadCompiled(const std::string &filename)
+{
+	clear();
+
+	unsigned int	fileSize = 0;
+	const char		*view	 = NULL;
+#ifdef WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+		return -1;
+	fileSize = GetFileSize(file, NULL);
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if(mapping == NULL)
+		return -1;
+	view = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if(view == NULL)
+		return -1;
+#else
+	std::ifstream file(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+	if(!file.is_open())
+		return -1;
+	file.seekg(0, std::ios_base::end);
+	fileSize = (unsigned int)file.tellg();
+	file.seekg(0, std::ios_base::beg);
+	char *buffer = new char[fileSize];
+	file.read(buffer, fileSize);
+	view = buffer;
+#endif
+	compiledView = (void*)view;
+
+	const CompiledHeader *header = (const CompiledHeader*)view;
+	if(fileSize < sizeof(CompiledHeader) || memcmp(header->id, "EXRS", 4) != 0 ||
+		header->version != Scene::CompiledVersion || header->recordSize != sizeof(SceneInstruction) ||
+		!fitsSection(fileSize, header->instructionOffset, header->instructionCount, sizeof(SceneInstruction)) ||
+		!fitsSection(fileSize, header->identifierOffset, header->identifierCount, sizeof(unsigned int)) ||
+		!fitsSection(fileSize, header->stringOffset, header->stringSize, 1) || header->stringSize == 0)
+	{
+		reportError(0, Scene::CompiledInvalid, filename);
+		releaseCompiled();
+		attachParsed();
+		errorCount = 1;
+		return errorCount;
+	}
+
+	instructionData		= (const SceneInstruction*)(view + header->instructionOffset);
+	instructionCount	= header->instructionCount;
+	identifierData		= (const unsigned int*)(view + header->identifierOffset);
+	identifierCount		= header->identifierCount;
+	stringData			= view + header->stringOffset;
+	stringSize			= header->stringSize;
+
+	if(!validateCompiled())
+	{
+		releaseCompiled();
+		attachParsed();
+		errorCount = 1;
+		return errorCount;
+	}
+
+	scriptOpened = true;
+	errorCount	 = 0;
+	return 0;
+}
+
+// Sprawdza indeksy i przesunicia zapisane w pliku skompilowanym, nazwy typw i shaderw, kody parametrw
+// oraz to, e instrukcje odwouj si wycznie do wzw utworzonych przez wczeniejsze konstruktory.
+bool Scene::validateCompiled(void)
+{
+	std::vector<bool>	built(identifierCount, false);
+	
+	if(stringData[stringSize-1] != 0)
+		return reportError(0, Scene::CompiledInvalid);
+	for(unsigned int i=0; i<identifierCount; i++)
+	{
+		if(identifierData[i] >= stringSize)
+			return reportError(0, Scene::CompiledInvalid);
+	}
+
+	const SceneInstruction *end = instructionData + instructionCount;
+	for(const SceneInstruction *i=instructionData; i<end; i++)
+	{
+		if(i->name >= stringSize)
+			return reportError(i->line, Scene::CompiledInvalid);
+		switch(i->type)
 		{
-			paramIValue = (int)abs(atoi(i->second.at(1).c_str()));
-			engine->setParameter(paramName, paramIValue);
+		case Scene::Constructor:
+			// Identyfikator tworzony jest raz (kompilator odrzuca ponown deklaracj); drugi konstruktor
+			// nadpisaby wze w tablicy nodes.
+			if(i->node >= identifierCount || built[i->node] ||
+			   (i->target != Scene::NoIdentifier && (i->target >= i->node || !built[i->target])))
+				return reportError(i->line, Scene::CompiledInvalid);
+			if(creatorMap.find(getString(i->name)) == creatorMap.end())
+				return reportError(i->line, Scene::UnknownNodeType, getString(i->name));
+			built[i->node] = true;
+			break;
+		case Scene::Parameter:
+			{
+				ParameterMap::const_iterator parameter = parameterMap.first.find(getString(i->name));
+				if(parameter == parameterMap.first.end())
+					return reportError(i->line, Scene::UnknownParameter, getString(i->name));
+				if(i->code != parameter->second)
+					return reportError(i->line, Scene::CompiledInvalid);
+				if(i->code == exRay::Supersampling && i->option != exRay::Full && i->option != exRay::Adaptive)
+					return reportError(i->line, Scene::CompiledInvalid);
+				if(i->code == exRay::ShadowSampling && i->option != exRay::RegularGrid && i->option != exRay::MonteCarlo)
+					return reportError(i->line, Scene::CompiledInvalid);
+			}
+			break;
+		case Scene::ShaderSet:
+			if(i->node >= identifierCount || !built[i->node])
+				return reportError(i->line, Scene::CompiledInvalid);
+			if(shaderMap.find(getString(i->name)) == shaderMap.end())
+				return reportError(i->line, Scene::UnknownShader, getString(i->name));
+			break;
+		case Scene::Connection:
+		case Scene::Mapping:
+			if(i->target >= identifierCount || !built[i->target])
+				return reportError(i->line, Scene::CompiledInvalid);
+		case Scene::Assignment:
+			if(i->node >= identifierCount || !built[i->node])
+				return reportError(i->line, Scene::CompiledInvalid);
+			break;
+		default:
+			return reportError(i->line, Scene::CompiledInvalid);
 		}
 	}
 	return true;
 }
 
+void Scene::releaseCompiled(void)
+{
+	if(!compiledView)
+		return;
+#ifdef WIN32
+	UnmapViewOfFile(compiledView);
+#else
+	delete[] (char*)compiledView;
+#endif
+	compiledView = NULL;
+}
+
+bool Scene::setupEngine(Engine *engine)
+{
+	if(!scriptOpened || errorCount > 0 || !engine)
+		return false;
+
+	const SceneInstruction *end = instructionData + instructionCount;
+	for(const SceneInstruction *i=instructionData; i<end; i++)
+	{
+		if(i->type != Scene::Parameter)
+			continue;
+
+		if(i->code == exRay::Supersampling || i->code == exRay::ShadowSampling)
+			engine->setParameter(i->code, i->option);
+		else if(i->code == exRay::EnvRIndex)
+			engine->setParameter(i->code, fabsf(i->value[0]));
+		else if(i->code == exRay::LightThresholdCode)
+			engine->setParameter(exRay::LightThreshold, fabsf(i->value[0]));
+		else if(i->code == exRay::FrameWidth)
+		{
+			frameX = (unsigned int)abs((int)i->value[0]);
+			if(frameX < Scene::MinWH) frameX = Scene::MinWH;
+		}
+		else if(i->code == exRay::FrameHeight)
+		{
+			frameY = (unsigned int)abs((int)i->value[0]);
+			if(frameY < Scene::MinWH) frameY = Scene::MinWH;
+		}
+		else engine->setParameter(i->code, abs((int)i->value[0]));
+	}
+	return true;
+}
+
 int Scene::createGraph(Node *root)
 {
 	if(!scriptOpened || errorCount > 0 || !root)
@@ -608,73 +1338,77 @@ int Scene::createGraph(Node *root)
 	int			warnings = 0;
 	char		buffer[32];
 
-	Node		*node, *conNode;
-	Variable	*operand;
+	// Wzy indeksowane identyfikatorami skryptu - take te utworzone wewntrz grup.
+	std::vector<Node*>	nodes(identifierCount, (Node*)NULL);
+	Node				*node, *conNode;
+	Variable			*operand;
+	AttribKeyMap		attribKeys;
+	CreatorCache		creators;	// Kreator dla nazwy typu z puli napisw; wyznaczany raz dla kadej nazwy
+
+	vector2 v2; vector3 v3; vector4 v4;
 
-	float v1; vector2 v2; vector3 v3; vector4 v4;
-	for(std::vector<TokenSet>::iterator i=lines.begin(); i<lines.end(); i++)
+	const SceneInstruction *end = instructionData + instructionCount;
+	for(const SceneInstruction *i=instructionData; i<end; i++)
 	{
-		switch(i->first)
+		switch(i->type)
 		{
 		case Scene::Constructor:
-			if(i->second.size() == 2)
+			if(i->target == Scene::NoIdentifier)
 				node = root;
-			else node = root->getChild(i->second.at(2));
-			creatorMap[i->second.at(0)]->operator ()(i->second.at(1), node);
+			else node = nodes[i->target];
+			{
+				CreatorCache::iterator creator = creators.find(i->name);
+				if(creator == creators.end())
+					creator = creators.insert(CreatorCache::value_type(i->name, creatorMap[getString(i->name)])).first;
+				nodes[i->node] = creator->second->operator ()(getIdentifier(i->node), node);
+			}
 			break;
 		case Scene::Parameter:
 			break;
 		case Scene::Assignment:
-			node	= root->getChild(i->second.at(0));
-			operand	= node->getAttrib(i->second.at(1));
+			node	= nodes[i->node];
+			operand	= node->getAttrib(findAttribKey(attribKeys, i->name, getString(i->name)));
 			if(!operand)
 			{
-				reportWarning(UnknownAttribute, i->second.at(0)+"."+i->second.at(1));
+				reportWarning(UnknownAttribute, getIdentifier(i->node)+"."+getString(i->name));
 				warnings++;
 				break;
 			}
-			switch(i->second.size())
+			switch(i->valueCount)
 			{
-			case 3: // float
+			case 1: // float
 				if(operand->getType() != FLOAT)
 				{
 					reportWarning(InvalidValue);
 					warnings++; break;
 				}
-				v1 = (float)atof(i->second.at(2).c_str());
-				operand->setValue(v1);
+				operand->setValue(i->value[0]);
 				break;
-			case 4: // vector2
+			case 2: // vector2
 				if(operand->getType() != FLOAT2)
 				{
 					reportWarning(InvalidValue);
 					warnings++; break;
 				}
-				v2 = vector2((float)atof(i->second.at(2).c_str()),
-							 (float)atof(i->second.at(3).c_str()));
+				v2 = vector2(i->value[0], i->value[1]);
 				operand->setValue(v2);
 				break;
-			case 5: // vector3
+			case 3: // vector3
 				if(operand->getType() != FLOAT3)
 				{
 					reportWarning(InvalidValue);
 					warnings++; break;
 				}
-				v3 = vector3((float)atof(i->second.at(2).c_str()),
-							 (float)atof(i->second.at(3).c_str()),
-							 (float)atof(i->second.at(4).c_str()));
+				v3 = vector3(i->value[0], i->value[1], i->value[2]);
 				operand->setValue(v3);
 				break;
-			case 6: // vector4
+			case 4: // vector4
 				if(operand->getType() != FLOAT4)
 				{
 					reportWarning(InvalidValue);
 					warnings++; break;
 				}
-				v4 = vector4((float)atof(i->second.at(2).c_str()),
-							 (float)atof(i->second.at(3).c_str()),
-							 (float)atof(i->second.at(4).c_str()),
-							 (float)atof(i->second.at(5).c_str()));
+				v4 = vector4(i->value[0], i->value[1], i->value[2], i->value[3]);
 				operand->setValue(v4);
 				break;
 			default:
@@ -683,37 +1417,37 @@ int Scene::createGraph(Node *root)
 			}
 			break;
 		case Scene::ShaderSet:
-			node		= root->getChild(i->second.at(0));
-			operand		= node->getAttrib("cgfx_shader");
+			node		= nodes[i->node];
+			operand		= node->getAttrib(attrShader);
 			if(!operand)
 			{
-				reportWarning(Scene::ShaderSetFailed, i->second.at(0));
+				reportWarning(Scene::ShaderSetFailed, getIdentifier(i->node));
 				warnings++;
-			} else operand->setValue(shaderMap[i->second.at(1)]);
+			} else operand->setValue(shaderMap[getString(i->name)]);
 			break;
 		case Scene::Connection:
-			node		= root->getChild(i->second.at(0));
-			conNode		= root->getChild(i->second.at(1));
+			node		= nodes[i->node];
+			conNode		= nodes[i->target];
 
-			if(!node->connect(conNode, i->second.at(2)))
+			if(!node->connect(conNode, findAttribKey(attribKeys, i->name, getString(i->name))))
 			{
 				reportWarning(Scene::ConnectionFailed,
-					i->second.at(0)+"<->"+i->second.at(1)+"."+i->second.at(2));
+					getIdentifier(i->node)+"<->"+getIdentifier(i->target)+"."+getString(i->name));
 				warnings++;
 			}
 			break;
 		case Scene::Mapping:
-			node		= root->getChild(i->second.at(0));
-			conNode		= root->getChild(i->second.at(1));
+			node		= nodes[i->node];
+			conNode		= nodes[i->target];
 
 			if(!node->map(conNode))
 			{
-				reportWarning(Scene::MappingFailed, i->second.at(0)+"<->"+i->second.at(1));
+				reportWarning(Scene::MappingFailed, getIdentifier(i->node)+"<->"+getIdentifier(i->target));
 				warnings++;
 			}
 			break;
 		default:
-			sprintf(buffer, "%d", i->first);
+			sprintf(buffer, "%d", i->type);
 			reportWarning(UnknownInstruction, buffer);
 			warnings++;
 		}
@@ -737,13 +1471,15 @@ int Scene::validateGraph(Node *root)
 		if((*i)->ignoreIntersection())
 			continue;
 
-		(*i)->getAttrib("cgfx_shader")->getValue(testShader);
+		testShader	= NULL;
+		testNode	= NULL;
+		(*i)->getAttribValue(attrShader, testShader);
 		if(testShader == NULL)
 		{
 			reportValidationError(Scene::NoShaderAssigned, (*i)->getName());
 			errors++;
 		}
-		(*i)->getAttrib("material")->getValue(testNode);
+		(*i)->getAttribValue(attrMaterial, testNode);
 		if(testNode == NULL)
 		{
 			reportValidationError(Scene::NoMaterialAssigned, (*i)->getName());
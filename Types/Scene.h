@@ -25,10 +25,112 @@ class Node;
 class Engine;
 class Shader;
 class NodeCreator;
-class StringVector;
+class StringTable;
 
-typedef std::vector<std::string>				TokenString;
-typedef std::pair<unsigned int, TokenString>	TokenSet;
+/// Leksem skryptu.
+/** Fragment bufora wejciowego wskazywany bez kopiowania (wskanik + dugo).
+*/
+class ScriptToken
+{
+public:
+	const char*		text;
+	unsigned int	length;
+public:
+	ScriptToken(void)
+	{ text = NULL; length = 0; }
+	ScriptToken(const char *newText, const unsigned int newLength)
+	{ text = newText; length = newLength; }
+
+	std::string	str(void) const
+	{ return std::string(text, length); }
+	bool operator == (const char *string) const
+	{ return strncmp(text, string, length) == 0 && string[length] == 0; }
+	bool operator != (const char *string) const
+	{ return !(*this == string); }
+};
+
+/// Pojedyncza instrukcja skryptu po analizie skadniowej.
+/** Identyfikatory wzw zapisywane s jako indeksy do tablicy identyfikatorw sceny, nazwy jako
+	przesunicia w puli napisw, a stae liczbowe jako gotowe wartoci float. Instrukcja nie zawiera
+	wskanikw, dziki czemu tablica instrukcji moe by zapisana do pliku i odczytana bez konwersji.
+*/
+class SceneInstruction
+{
+public:
+	int				type;
+	unsigned int	line;
+	unsigned int	node;		// Konstruowany lub modyfikowany wze.
+	unsigned int	target;		// Rodzic (konstruktor) lub drugi wze (connect, map).
+	int				code;		// Identyfikator parametru.
+	int				option;		// Warto wyliczeniowa parametru.
+	unsigned int	name;		// Typ wza, nazwa parametru, atrybutu lub shadera (przesunicie w puli).
+	unsigned int	valueCount;
+	float			value[4];
+public:
+	SceneInstruction(void)
+	{ type = 0; line = 0; node = target = 0x7FFFFFFF; code = option = 0; name = 0; valueCount = 0; }
+};
+
+class Scene;
+
+/// Wyraenie liniowe wzgldem zmiennych ptli repeat.
+/** Warto wyraenia to [base] + suma [factor] * indeks zmiennej [variable], np. "$i*0.5-25".
+*/
+class ScriptExpression
+{
+public:
+	ScriptToken		text;
+	float			base;
+	unsigned int	terms;
+	ScriptToken		variable[4];
+	float			factor[4];
+public:
+	ScriptExpression(void)
+	{ base = 0.0f; terms = 0; }
+
+	enum { MaxTerms = 4 };
+};
+
+/// Wynik analizy skadniowej pojedynczej linii skryptu.
+/** Instrukcja z nierozwizanymi identyfikatorami: wze, cel i nazwa zapisane s jako leksemy i
+	zamieniane na indeksy dopiero w uporzdkowanym przebiegu sceny. Bd skadni zapamitywany jest
+	wraz z leksemem, ktrego dotyczy.
+*/
+class ScriptLine
+{
+public:
+	SceneInstruction	instruction;
+	ScriptToken			node;
+	ScriptToken			target;
+	ScriptToken			name;
+	ScriptToken			errorInfo;
+	int					error;
+	unsigned int		expression;		// Indeks pierwszego wyraenia linii we fragmencie.
+	unsigned int		expressionMask;	// Skadowe wartoci podane wyraeniem (bity 0-3).
+public:
+	ScriptLine(void)
+	{ error = 0; expression = expressionMask = 0; }
+};
+
+/// Fragment skryptu analizowany przez jeden wtek.
+class ScriptChunk
+{
+public:
+	const Scene*					scene;
+	const char*						begin;
+	const char*						end;
+	unsigned int					lineCount;
+	std::vector<ScriptLine>			lines;
+	std::vector<ScriptExpression>	expressions;
+public:
+	ScriptChunk(void)
+	{ scene = NULL; begin = end = NULL; lineCount = 0; }
+};
+
+typedef std::vector<ScriptToken>				TokenList;
+typedef std::vector<ScriptExpression>			ExpressionList;
+typedef std::pair<ScriptToken, unsigned int>	LoopIndex;
+typedef std::vector<LoopIndex>					LoopList;
 typedef std::map<int, std::string>				ErrorMap;
 typedef std::map<std::string, NodeCreator*>		CreatorMap;
 typedef std::map<std::string, Shader*>			ShaderMap;
@@ -38,22 +140,49 @@ typedef std::pair<ParameterMap, ParameterMap>	ParameterSet;
 /// Klasa sceny.
 /** Wczytuje skrypt konfiguracji sceny z pliku tekstowego i na jego podstawie
 	automatycznie konstruuje odpowiedni graf sceny oraz ustawia parametry silnika.
+	Plik wczytywany jest w caoci do pamici i dzielony na fragmenty na granicach linii. Fragmenty
+	analizowane s rwnolegle (leksemy wskazuj bezporednio na bufor, a stae liczbowe zamieniane
+	s na wartoci ju podczas walidacji), po czym identyfikatory rozwizywane s w jednym,
+	uporzdkowanym przebiegu przy uyciu tablicy haszujcej.
+	Bloki "repeat <zmienna> <liczba>" ... "end" analizowane s raz i rozwijane bezporednio w instrukcje
+	w przebiegu uporzdkowanym. Wewntrz bloku "$zmienna" w identyfikatorze zastpowana jest biecym
+	indeksem, a staa moe by wyraeniem liniowym, np. "ball$i.position = ($i*0.5-25, 0, 3)".
+	Przeanalizowany skrypt (tablica instrukcji, tablica identyfikatorw i pula napisw) mona zapisa
+	w postaci skompilowanej (writeCompiled). Plik skompilowany jest mapowany do pamici i uywany
+	bezporednio, bez ponownej analizy tekstu.
+	Plik skompilowany nie jest obrazem zbudowanego grafu, lecz zapisem instrukcji odtwarzanym przez
+	createGraph: atrybuty wzw tworzone s przez ich konstruktory, a klucze atrybutw (AttribKey)
+	nadawane s w czasie dziaania programu, wic nie mog by zapisane w pliku. Nazwy typw wzw
+	i atrybutw rozwizywane s raz dla kadej rnej nazwy w puli, a nie dla kadej instrukcji.
 */
 class Scene
 {
 private:
-	std::stringstream		logStream;
-	std::vector<TokenSet>	lines;
-	ErrorMap				errorMap;
-	CreatorMap				creatorMap;
-	ShaderMap				shaderMap;
-	ParameterSet			parameterMap;
-
-	int						errorCount;
-	bool					scriptOpened;
+	std::stringstream				logStream;
+	std::vector<SceneInstruction>	instructions;
+	std::vector<unsigned int>		identifiers;	// przesunicia nazw identyfikatorw w puli
+	std::vector<char>				stringPool;
+
+	// Aktualnie uywany skrypt: powysze tablice lub zmapowany plik skompilowany.
+	const SceneInstruction*			instructionData;
+	unsigned int					instructionCount;
+	const unsigned int*				identifierData;
+	unsigned int					identifierCount;
+	const char*						stringData;
+	unsigned int					stringSize;
+	void*							compiledView;
+
+	ErrorMap						errorMap;
+	CreatorMap						creatorMap;
+	ShaderMap						shaderMap;
+	ParameterSet					parameterMap;
+
+	int								errorCount;
+	bool							scriptOpened;
+	unsigned int					parseThreads;
 	
-	unsigned int			frameX;
-	unsigned int			frameY;
+	unsigned int					frameX;
+	unsigned int					frameY;
 private:
 	void		createErrorMap(void);
 	void		createParameterMap(void);
@@ -61,29 +190,56 @@ private:
 	void		registerBuiltInCreators(void);
 
 	bool		reportError(unsigned int line, int errorID, const std::string &info="");
-	bool		reportError(unsigned int line, int errorID, const char info);
 	void		reportWarning(int errorID, const std::string &ifno="");
 	void		reportValidationError(int errorID, const std::string &info="");
 
-	bool		getTokens(TokenSet &tokens, std::string &string);
-	bool		getTerm(std::string &result, const std::string &string, unsigned int &pos, unsigned int line=0);
-	bool		interpretLine(TokenSet &line, StringVector &identifiers);
-	bool		functionCall(TokenSet &line, unsigned int offset, unsigned int argc, StringVector &args);
+	static bool	lineError(ScriptLine &result, int errorID, const ScriptToken &info=ScriptToken());
+	bool		getTokens(TokenList &tokens, const char *begin, const char *end, ScriptLine &result) const;
+	bool		interpretLine(const TokenList &tokens, ScriptLine &result, ExpressionList &expressions) const;
+	bool		interpretValue(const ScriptToken &token, const unsigned int component, float &value,
+							   ScriptLine &result, ExpressionList &expressions) const;
+	bool		functionCall(const TokenList &tokens, unsigned int offset, unsigned int argc, TokenList &args,
+							 ScriptLine &result) const;
+	bool		resolveLine(const ScriptLine &result, const unsigned int lineBase, const ScriptExpression *expressions,
+							const LoopList &loops, StringTable &identifierTable, StringTable &nameTable);
+	int			expandBlock(const std::vector<ScriptLine> &block, const unsigned int first, const unsigned int last,
+							const ExpressionList &expressions, LoopList &loops, StringTable &identifierTable,
+							StringTable &nameTable);
+
+	static unsigned long __stdcall	parseChunk(void *pChunk);
 
-	static void		stripString(std::string &string);
-	static bool		isValidValue(const std::string &value);
+	static bool	parseValue(const ScriptToken &token, float &value);
+	static bool	parseExpression(const ScriptToken &token, ScriptExpression &expression);
+	static bool	expandIdentifier(const ScriptToken &token, const LoopList &loops, std::string &buffer,
+								 ScriptToken &identifier);
+	static bool	findLoopIndex(const ScriptToken &variable, const LoopList &loops, unsigned int &index);
+
+	void		initialize(void);
+	void		attachParsed(void);
+	void		releaseCompiled(void);
+	bool		validateCompiled(void);
+
+	const char*	getString(const unsigned int offset) const
+	{ return stringData + offset; }
+	std::string	getIdentifier(const unsigned int index) const
+	{ return std::string(stringData + identifierData[index]); }
 public:
 	Scene(void);
-	Scene(const std::string &filename);
+	Scene(const std::string &filename, const unsigned int threads=1);
 	virtual ~Scene(void);
 
 	std::string	getScriptLog(void) const;
 	void		clear(void);
+	void		setParseThreads(const unsigned int threads);
 
 	bool		registerCreator(const std::string &name, NodeCreator *creator);
 	bool		registerShader(const std::string &name, Shader *shader);
 	int			parseFile(const std::string &filename);
 	int			parseFile(std::ifstream &file);
+	int			parseBuffer(const char *data, const unsigned int size);
+	int			loadCompiled(const std::string &filename);
+	bool		writeCompiled(const std::string &filename) const;
+	static bool	isCompiled(const std::string &filename);
 	int			createGraph(Node *root);
 	bool		setupEngine(Engine *engine);
 	int			validateGraph(Node *root);
@@ -112,6 +268,13 @@ public:
 		DefaultX= 640,
 		DefaultY= 480,
 
+		MinChunkSize = 262144, // Minimalny rozmiar fragmentu skryptu na wtek (bajty).
+
+		NoIdentifier = 0x7FFFFFFF,
+
+		// Format skompilowany.
+		CompiledVersion	= 1,
+
 		// Typy instrukcji.
 		Constructor = 0,
 		Parameter,
@@ -119,6 +282,8 @@ public:
 		Connection,
 		Mapping,
 		ShaderSet,
+		Repeat,			// Tylko podczas analizy: pocztek bloku repeat.
+		RepeatEnd,		// Tylko podczas analizy: koniec bloku repeat.
 
 		// Bdy.
 		NoError	= 0,
@@ -138,6 +303,10 @@ public:
 		RedeclaredIdentifier,
 		ArgumentMismatch,
 		UnknownFunction,
+		CompiledInvalid,
+		RepeatInvalid,
+		RepeatNotClosed,
+		UnmatchedEnd,
 		UnknownError,
 
 		// Ostrzeenia.
@@ -18,7 +18,9 @@
 
 #include "../Config.h"
 #include "../Core/Renderer.h"
+#include "../Core/RenderScene.h"
 #include "../Graph/Variable.h"
+#include "../Graph/Node.h"
 #include "Shader.h"
 
 using namespace exRay;
@@ -32,16 +34,156 @@ Shader::~Shader(void)
 	
 }
 
-vector3 Shader::computeShading(ShaderUniforms *su, const float *visibility)
+void Shader::computeShading(ShadingQueue *queue)
 {
-	return vector3(1.0f, 1.0f, 1.0f);
+	for(unsigned int i=0; i<queue->count; i++)
+	{
+		queue->color[0][i] = 1.0f;
+		queue->color[1][i] = 1.0f;
+		queue->color[2][i] = 1.0f;
+	}
+}
+
+vector3 Shader::composeShading(const vector3 &direct, const RenderMaterial &material, const vector3 *reflected,
+							   const vector3 *refracted, const float absorbance) const
+{
+	return direct;
 }
 
 void Shader::cacheVariables(Node *pnode)
 {
+	VNode	*lights = (VNode*)pnode->getAttrib(attrEnvLight);
+
+	cLightNodes.clear();
+	if(!lights) return;
+
+	Node	*lightNode;
+	for(unsigned int i=0; i<lights->size(); i++)
+	{
+		lights->getValue(lightNode, i);
+		cLightNodes.push_back(lightNode);
+	}
+}
+
+ShadingQueue::ShadingQueue(const RenderLightTable *lightTable, const std::vector<unsigned int> &lightIndices,
+						   const unsigned int materialFeatures)
+{
+	count		= 0;
+	lights		= lightTable;
+	lightIndex	= lightIndices.empty() ? NULL : &lightIndices[0];
+	lightCount	= (unsigned int)lightIndices.size();
+	features	= materialFeatures;
+	for(int k=0; k<3; k++)
+	{
+		lightPosition[k]	= lightTable->size() ? &lightTable->position[k][0] : NULL;
+		lightColor[k]		= lightTable->size() ? &lightTable->color[k][0] : NULL;
+	}
+	material	= NULL;
+	block		= NULL;
+	bind(new float[InitialCapacity*Streams], InitialCapacity);
+	material		= new unsigned int[InitialCapacity];
+	hitLightFirst	= new unsigned int[InitialCapacity];
+	hitLightCount	= new unsigned int[InitialCapacity];
+
+	hitLightTotal	= 0;
+	hitLightCapacity= InitialCapacity;
+	hitLight		= new unsigned int[InitialCapacity];
+	hitLightWeight	= new float[InitialCapacity];
 }
 
-ShaderUniforms* Shader::createRenderingCache(void) const
+ShadingQueue::~ShadingQueue(void)
 {
-	return new ShaderUniforms();
+	delete[] block;
+	delete[] material;
+	delete[] hitLightFirst;
+	delete[] hitLightCount;
+	delete[] hitLight;
+	delete[] hitLightWeight;
+}
+
+// Przenosi [used] pocztkowych elementw tablicy do nowej o pojemnoci [newCapacity].
+template<class T> static void resizeArray(T *&array, const unsigned int used, const unsigned int newCapacity)
+{
+	T	*newArray = new T[newCapacity];
+	memcpy(newArray, array, used*sizeof(T));
+	delete[] array;
+	array = newArray;
+}
+
+// Rozmieszcza tablice skadowych w jednym bloku pamici o pojemnoci [newCapacity] trafie.
+void ShadingQueue::bind(float *newBlock, const unsigned int newCapacity)
+{
+	float	**streams[Streams] = {
+		&position[0], &position[1], &position[2], &normal[0], &normal[1], &normal[2],
+		&direction[0], &direction[1], &direction[2], &materialColor[0], &materialColor[1], &materialColor[2],
+		&materialDiffuse, &materialSpecular, &materialExponent, &color[0], &color[1], &color[2] };
+
+	for(unsigned int i=0; i<Streams; i++)
+	{
+		if(block)
+			memcpy(newBlock + i*newCapacity, *streams[i], count*sizeof(float));
+		*streams[i] = newBlock + i*newCapacity;
+	}
+
+	delete[] block;
+	block		= newBlock;
+	capacity	= newCapacity;
+}
+
+void ShadingQueue::grow(void)
+{
+	unsigned int	newCapacity	= capacity*2;
+
+	resizeArray(material, count, newCapacity);
+	resizeArray(hitLightFirst, count, newCapacity);
+	resizeArray(hitLightCount, count, newCapacity);
+	bind(new float[newCapacity*Streams], newCapacity);
+}
+
+void ShadingQueue::growLights(void)
+{
+	hitLightCapacity *= 2;
+	resizeArray(hitLight, hitLightTotal, hitLightCapacity);
+	resizeArray(hitLightWeight, hitLightTotal, hitLightCapacity);
+}
+
+// Dodaje trafienie do kolejki i zwraca jego pozycj. Lista wiate trafienia jest pocztkowo pusta (addLight).
+unsigned int ShadingQueue::push(const vector3 &intPoint, const vector3 &hitNormal, const vector3 &rayDirection,
+								const unsigned int materialIndex, const RenderMaterial &renderMaterial)
+{
+	if(count == capacity)
+		grow();
+
+	const unsigned int slot = count++;
+	for(int i=0; i<3; i++)
+	{
+		position[i][slot]		= intPoint.cell[i];
+		normal[i][slot]			= hitNormal.cell[i];
+		direction[i][slot]		= rayDirection.cell[i];
+		materialColor[i][slot]	= renderMaterial.color.cell[i];
+	}
+	material[slot]			= materialIndex;
+	materialDiffuse[slot]	= renderMaterial.diffuse;
+	materialSpecular[slot]	= renderMaterial.specular;
+	materialExponent[slot]	= renderMaterial.specularExponent;
+	hitLightFirst[slot]		= hitLightTotal;
+	hitLightCount[slot]		= 0;
+	return slot;
+}
+
+/** Dopisuje wiato do listy trafienia [slot]. Listy kolejnych trafie le jedna za drug, wic wiata
+	trafienia dodaje si zaraz po jego push(), przed nastpnym trafieniem tej kolejki. Wpisy o zerowej wadze
+	nie s zapisywane (nie zmieniaj wyniku cieniowania).
+*/
+void ShadingQueue::addLight(const unsigned int slot, const unsigned int light, const float weight)
+{
+	if(weight == 0.0f)
+		return;
+	if(hitLightTotal == hitLightCapacity)
+		growLights();
+
+	hitLight[hitLightTotal]			= light;
+	hitLightWeight[hitLightTotal]	= weight;
+	hitLightTotal++;
+	hitLightCount[slot]++;
 }
\ No newline at end of file
@@ -22,50 +22,97 @@
 namespace exRay {
 
 class Node;
-class ShaderUniforms;
+class RenderMaterial;
+class RenderLightTable;
+class ShadingQueue;
 
 /// Generyczna funkcja cieniujca.
-/** Bazowa klasa, ktrej funkcjonalnoc implementuj wszystkie shadery. */
+/** Bazowa klasa, ktrej funkcjonalnoc implementuj wszystkie shadery. Owietlenie bezporednie liczone jest
+	wsadowo dla caej kolejki trafie, a kolor trafienia skadany jest z niego i ze skadowych promieni
+	wtrnych dopiero po zakoczeniu ledzenia.
+	Bazowa klasa buforuje wiata przypisane shaderowi (env_light); scena renderowania zamienia je na indeksy
+	wsplnej tablicy wiate.
+*/
 class Shader
 {
+protected: // cache
+	std::vector<Node*>	cLightNodes;
 public:
 	Shader();
 	virtual ~Shader(void);
 
 	virtual void	cacheVariables(Node *pnode);
-	virtual vector3	computeShading(ShaderUniforms *su, const float *visibility=NULL);
-	virtual ShaderUniforms* createRenderingCache(void) const;
+	const std::vector<Node*>&	getLightNodes(void) const
+	{ return cLightNodes; }
+	virtual void	computeShading(ShadingQueue *queue);
+	virtual vector3	composeShading(const vector3 &direct, const RenderMaterial &material, const vector3 *reflected,
+								   const vector3 *refracted, const float absorbance) const;
 };
 
-/// Cache renderowania.
-class ShaderUniforms
+/// Kolejka trafie oczekujcych na cieniowanie.
+/** Renderer zbiera w niej trafienia linii obrazu w ukadzie SoA (osobna tablica dla kadej skadowej),
+	dziki czemu shader przetwarza kilka trafie jedn instrukcj. Kade trafienie ma wasn list wiate
+	o niezerowej widocznoci: hitLightCount[slot] wpisw (indeks w tablicy wiate sceny i waga) od pozycji
+	hitLightFirst[slot] tablic hitLight i hitLightWeight. Listy le jedna za drug w kolejnoci trafie, wic
+	ich rozmiar i koszt cieniowania zale od liczby wpisw, a nie od liczby wiate shadera. Wynik (owietlenie
+	bezporednie) trafia do tablic color. Wszystkie trafienia kolejki maj ten sam zestaw cech materiau, wic shader
+	moe wybra dla niej wyspecjalizowane jdro. Kolejka ronie w miar potrzeby i nie zwalnia pamici przy czyszczeniu.
+*/
+class ShadingQueue
 {
 public:
-	ShaderUniforms(void)
-	{
-		ReflectFlag			= false;
-		RefractFlag			= false;
-	}
-	virtual ~ShaderUniforms(void)
-	{ }
+	float*			position[3];
+	float*			normal[3];
+	float*			direction[3];		// Kierunek promienia
+	unsigned int*	material;			// Indeks materiau sceny renderowania
+	float*			materialColor[3];
+	float*			materialDiffuse;
+	float*			materialSpecular;
+	float*			materialExponent;
+	float*			color[3];
+	unsigned int*	hitLightFirst;		// Pierwszy wpis listy wiate trafienia
+	unsigned int*	hitLightCount;		// Liczba wpisw listy wiate trafienia
+	unsigned int*	hitLight;			// Indeks wiata wpisu w tablicy wiate sceny
+	float*			hitLightWeight;		// Widoczno wiata (z wag losowania)
+
+	const RenderLightTable*	lights;		// Tablica wiate sceny
+	const unsigned int*		lightIndex;	// Indeksy wiate shadera w tablicy
+	const float*			lightPosition[3];	// Skadowe tablicy wiate dla jder (bez wywoa std::vector)
+	const float*			lightColor[3];
 
+	unsigned int	count;
+	unsigned int	capacity;
+	unsigned int	lightCount;
+	unsigned int	hitLightTotal;		// Liczba wpisw list wiate wszystkich trafie
+	unsigned int	hitLightCapacity;
+	unsigned int	features;			// Wsplny zestaw cech materiaw trafie (RenderMaterial::Feature*)
+private:
+	float*			block;
+private:
+	ShadingQueue(const ShadingQueue&);
+	ShadingQueue& operator=(const ShadingQueue&);
+
+	void			bind(float *newBlock, const unsigned int newCapacity);
+	void			grow(void);
+	void			growLights(void);
 public:
-	vector3	Normal;
-	vector3	*IntPoint;
-	vector3	*RayDirection;
-	vector3	*RayOrigin;
-
-	bool	ReflectFlag;
-	bool	RefractFlag;
-	vector3	ReflectComponent;
-	vector3	RefractComponent;
-
-	vector3	*MaterialColor;
-	float	MaterialDiffuse;
-	float	MaterialSpecular;
-	float	MaterialSpecularExponent;
-	float	MaterialReflectance;
-	float	MaterialAbsorbance;
+	ShadingQueue(const RenderLightTable *lightTable, const std::vector<unsigned int> &lightIndices,
+				 const unsigned int materialFeatures);
+	~ShadingQueue(void);
+
+	unsigned int	push(const vector3 &intPoint, const vector3 &hitNormal, const vector3 &rayDirection,
+						 const unsigned int materialIndex, const RenderMaterial &renderMaterial);
+	void			addLight(const unsigned int slot, const unsigned int light, const float weight);
+	vector3			getColor(const unsigned int slot) const
+	{ return vector3(color[0][slot], color[1][slot], color[2][slot]); }
+	void			clear(void)
+	{ count = 0; hitLightTotal = 0; }
+
+	enum
+	{
+		InitialCapacity	= 256,
+		Streams			= 18,	// Liczba tablic float na trafienie
+	};
 };
 
 } // exRay